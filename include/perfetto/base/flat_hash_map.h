@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_PERFETTO_BASE_FLAT_HASH_MAP_H_
+#define INCLUDE_PERFETTO_BASE_FLAT_HASH_MAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "perfetto/base/logging.h"
+
+namespace perfetto {
+namespace base {
+
+// A hash map with open addressing and linear probing, meant to replace
+// std::unordered_map / std::map on hot paths.
+//
+// Keys and values are stored inline in a single array of slots, so inserting
+// does not allocate (other than when the table grows) and a lookup usually
+// touches at most two cache lines: one in the array of 1-byte tags, which
+// holds 7 bits of the hash of each key, and the slot of the key itself.
+// Erased slots become tombstones which are reused by insertions and dropped
+// when the table is rehashed.
+//
+// Differences from std::unordered_map:
+// - Pointers to the values are invalidated by Insert() and operator[], as the
+//   table can be rehashed.
+// - The iteration order is unspecified and changes when the table is
+//   rehashed.
+// - Key and Value must be movable.
+template <typename Key, typename Value, typename Hasher = std::hash<Key>>
+class FlatHashMap {
+ public:
+  class Iterator {
+   public:
+    explicit Iterator(FlatHashMap* map) : map_(map) { FindNextUsedSlot(); }
+
+    const Key& key() const { return map_->slot_at(idx_)->key; }
+    Value& value() const { return map_->slot_at(idx_)->value; }
+
+    explicit operator bool() const { return idx_ < map_->capacity_; }
+    Iterator& operator++() {
+      PERFETTO_DCHECK(idx_ < map_->capacity_);
+      idx_++;
+      FindNextUsedSlot();
+      return *this;
+    }
+
+   private:
+    void FindNextUsedSlot() {
+      for (; idx_ < map_->capacity_; idx_++) {
+        if (map_->tags_[idx_] >= kMinTag)
+          return;
+      }
+    }
+
+    FlatHashMap* map_ = nullptr;
+    size_t idx_ = 0;
+  };
+
+  FlatHashMap() = default;
+  ~FlatHashMap() { DestroySlots(); }
+
+  // Allow std::move().
+  FlatHashMap(FlatHashMap&& other) noexcept { MoveFrom(&other); }
+  FlatHashMap& operator=(FlatHashMap&& other) noexcept {
+    if (this != &other) {
+      DestroySlots();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  // Disable implicit copy.
+  FlatHashMap(const FlatHashMap&) = delete;
+  FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+  // Returns a pointer to the value of |key| or nullptr if |key| is not in the
+  // map.
+  Value* Find(const Key& key) {
+    size_t idx = FindSlot(key);
+    return idx == kNotFound ? nullptr : &slot_at(idx)->value;
+  }
+  const Value* Find(const Key& key) const {
+    return const_cast<FlatHashMap*>(this)->Find(key);
+  }
+
+  // Inserts |key| with |value| if |key| is not in the map already. Returns the
+  // pointer to the value of |key| in the map and whether the insertion took
+  // place (like std::unordered_map::emplace()).
+  std::pair<Value*, bool> Insert(Key key, Value value) {
+    if ((size_ + tombstones_ + 1) * 4 > capacity_ * 3)
+      Rehash();
+
+    const uint64_t hash = Hash(key);
+    const uint8_t tag = TagForHash(hash);
+    const size_t mask = capacity_ - 1;
+    size_t insertion_idx = kNotFound;
+    for (size_t idx = SlotForHash(hash);; idx = (idx + 1) & mask) {
+      const uint8_t slot_tag = tags_[idx];
+      if (slot_tag == kFreeSlot) {
+        if (insertion_idx == kNotFound)
+          insertion_idx = idx;
+        break;
+      }
+      if (slot_tag == kTombstone) {
+        if (insertion_idx == kNotFound)
+          insertion_idx = idx;
+        continue;
+      }
+      if (slot_tag == tag && slot_at(idx)->key == key)
+        return std::make_pair(&slot_at(idx)->value, false);
+    }
+
+    if (tags_[insertion_idx] == kTombstone)
+      tombstones_--;
+    tags_[insertion_idx] = tag;
+    Slot* slot = slot_at(insertion_idx);
+    new (slot) Slot{std::move(key), std::move(value)};
+    size_++;
+    return std::make_pair(&slot->value, true);
+  }
+
+  // Returns the value of |key|, inserting a default constructed value if
+  // |key| is not in the map.
+  Value& operator[](Key key) { return *Insert(std::move(key), Value()).first; }
+
+  // Removes |key| from the map. Returns false if |key| was not in the map.
+  bool Erase(const Key& key) {
+    size_t idx = FindSlot(key);
+    if (idx == kNotFound)
+      return false;
+    slot_at(idx)->~Slot();
+    tags_[idx] = kTombstone;
+    size_--;
+    tombstones_++;
+    return true;
+  }
+
+  // Removes all the entries, keeping the memory of the table.
+  void Clear() {
+    for (size_t i = 0; i < capacity_; i++) {
+      if (tags_[i] >= kMinTag)
+        slot_at(i)->~Slot();
+      tags_[i] = kFreeSlot;
+    }
+    size_ = 0;
+    tombstones_ = 0;
+  }
+
+  Iterator GetIterator() { return Iterator(this); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  struct Slot {
+    Key key;
+    Value value;
+  };
+  using SlotStorage =
+      typename std::aligned_storage<sizeof(Slot), alignof(Slot)>::type;
+
+  // Values of |tags_|. The tags of used slots always have the top bit set.
+  static constexpr uint8_t kFreeSlot = 0;
+  static constexpr uint8_t kTombstone = 1;
+  static constexpr uint8_t kMinTag = 0x80;
+
+  static constexpr size_t kMinCapacity = 16;
+  static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+  static uint64_t Hash(const Key& key) {
+    // Hashers like std::hash<int> are the identity function: multiply by
+    // 2^64 / phi so that all the bits of the key affect the top bits, which
+    // are used to pick the slot (Fibonacci hashing).
+    return static_cast<uint64_t>(Hasher()(key)) * 0x9E3779B97F4A7C15ull;
+  }
+
+  static uint8_t TagForHash(uint64_t hash) {
+    return static_cast<uint8_t>(hash) | kMinTag;
+  }
+
+  size_t SlotForHash(uint64_t hash) const {
+    return static_cast<size_t>(hash >> shift_);
+  }
+
+  Slot* slot_at(size_t idx) const {
+    return reinterpret_cast<Slot*>(&slots_[idx]);
+  }
+
+  size_t FindSlot(const Key& key) const {
+    if (size_ == 0)
+      return kNotFound;
+    const uint64_t hash = Hash(key);
+    const uint8_t tag = TagForHash(hash);
+    const size_t mask = capacity_ - 1;
+    // The load factor is < 1 so there is always a free slot which ends the
+    // probing.
+    for (size_t idx = SlotForHash(hash);; idx = (idx + 1) & mask) {
+      const uint8_t slot_tag = tags_[idx];
+      if (slot_tag == kFreeSlot)
+        return kNotFound;
+      if (slot_tag == tag && slot_at(idx)->key == key)
+        return idx;
+    }
+  }
+
+  // Moves all the entries to a new table, dropping the tombstones. The table
+  // doubles in size unless it is mostly made of tombstones.
+  void Rehash() {
+    size_t new_capacity = capacity_;
+    if (new_capacity == 0) {
+      new_capacity = kMinCapacity;
+    } else if ((size_ + 1) * 2 > capacity_) {
+      new_capacity *= 2;
+    }
+
+    std::unique_ptr<uint8_t[]> old_tags(std::move(tags_));
+    std::unique_ptr<SlotStorage[]> old_slots(std::move(slots_));
+    const size_t old_capacity = capacity_;
+
+    tags_.reset(new uint8_t[new_capacity]());
+    slots_.reset(new SlotStorage[new_capacity]);
+    capacity_ = new_capacity;
+    shift_ = 64;
+    for (size_t c = new_capacity; c > 1; c >>= 1)
+      shift_--;
+    tombstones_ = 0;
+
+    const size_t mask = capacity_ - 1;
+    for (size_t i = 0; i < old_capacity; i++) {
+      if (old_tags[i] < kMinTag)
+        continue;
+      Slot* old_slot = reinterpret_cast<Slot*>(&old_slots[i]);
+      size_t idx = SlotForHash(Hash(old_slot->key));
+      while (tags_[idx] != kFreeSlot)
+        idx = (idx + 1) & mask;
+      tags_[idx] = old_tags[i];
+      new (slot_at(idx)) Slot{std::move(old_slot->key),
+                              std::move(old_slot->value)};
+      old_slot->~Slot();
+    }
+  }
+
+  void DestroySlots() {
+    for (size_t i = 0; i < capacity_; i++) {
+      if (tags_[i] >= kMinTag)
+        slot_at(i)->~Slot();
+    }
+  }
+
+  void MoveFrom(FlatHashMap* other) {
+    tags_ = std::move(other->tags_);
+    slots_ = std::move(other->slots_);
+    capacity_ = other->capacity_;
+    size_ = other->size_;
+    tombstones_ = other->tombstones_;
+    shift_ = other->shift_;
+    other->capacity_ = 0;
+    other->size_ = 0;
+    other->tombstones_ = 0;
+  }
+
+  std::unique_ptr<uint8_t[]> tags_;
+  std::unique_ptr<SlotStorage[]> slots_;
+  size_t capacity_ = 0;  // Always 0 or a power of 2.
+  size_t size_ = 0;
+  size_t tombstones_ = 0;
+  uint32_t shift_ = 64;  // 64 - log2(capacity_).
+};
+
+}  // namespace base
+}  // namespace perfetto
+
+#endif  // INCLUDE_PERFETTO_BASE_FLAT_HASH_MAP_H_
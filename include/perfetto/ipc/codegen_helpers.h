@@ -22,9 +22,10 @@
 // A templated protobuf message decoder. Returns nullptr in case of failure.
 template <typename T>
 ::std::unique_ptr<::perfetto::ipc::ProtoMessage> _IPC_Decoder(
-    const std::string& proto_data) {
+    const uint8_t* proto_data,
+    size_t proto_size) {
   ::std::unique_ptr<::perfetto::ipc::ProtoMessage> msg(new T());
-  if (msg->ParseFromString(proto_data))
+  if (msg->ParseFromArray(proto_data, static_cast<int>(proto_size)))
     return msg;
   return nullptr;
 }
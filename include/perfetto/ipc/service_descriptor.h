@@ -17,6 +17,9 @@
 #ifndef INCLUDE_PERFETTO_IPC_SERVICE_DESCRIPTOR_H_
 #define INCLUDE_PERFETTO_IPC_SERVICE_DESCRIPTOR_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <functional>
 #include <string>
 #include <utility>
@@ -40,9 +43,11 @@ class ServiceDescriptor {
   struct Method {
     const char* name;
 
-    // DecoderFunc is pointer to a function that takes a string in input
+    // DecoderFunc is pointer to a function that takes a buffer in input
     // containing protobuf encoded data and returns a decoded protobuf message.
-    using DecoderFunc = std::unique_ptr<ProtoMessage> (*)(const std::string&);
+    // The buffer is not retained after the call.
+    using DecoderFunc = std::unique_ptr<ProtoMessage> (*)(const uint8_t* data,
+                                                          size_t size);
 
     // Function pointer to decode the request argument of the method.
     DecoderFunc request_proto_decoder;
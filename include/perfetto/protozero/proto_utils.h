@@ -200,7 +200,7 @@ void StaticAssertSingleBytePreamble() {
 // The parsed int value is stored in the output arg |value|. Returns a pointer
 // to the next unconsumed byte (so start < retval <= end) or |start| if the
 // VarInt could not be fully parsed because there was not enough space in the
-// buffer.
+// buffer or because it is longer than the 10 bytes of a 64-bit VarInt.
 inline const uint8_t* ParseVarInt(const uint8_t* start,
                                   const uint8_t* end,
                                   uint64_t* value) {
@@ -208,11 +208,10 @@ inline const uint8_t* ParseVarInt(const uint8_t* start,
   uint64_t shift = 0;
   *value = 0;
   do {
-    if (PERFETTO_UNLIKELY(pos >= end)) {
+    if (PERFETTO_UNLIKELY(pos >= end || shift >= 64ull)) {
       *value = 0;
       return start;
     }
-    PERFETTO_DCHECK(shift < 64ull);
     *value |= static_cast<uint64_t>(*pos & 0x7f) << shift;
     shift += 7;
   } while (*pos++ & 0x80);
@@ -25,6 +25,23 @@ namespace trace_processor {
 
 struct Config {
   uint64_t window_size_ns = 180 * 1000 * 1000 * 1000ULL;  // 3 minutes.
+
+  // Number of worker threads used to decode protobuf traces and to sort
+  // events while loading them. Parsing events into tables still happens on
+  // the thread calling Parse(). If 0, all the work happens on that thread.
+  uint32_t ingestion_threads = 0;
+
+  // Maximum amount of memory used to hold the events waiting to be sorted.
+  // Past this, the events are spilled to a temporary file and merged back
+  // when they are extracted, which allows to load traces larger than RAM at
+  // the cost of extra I/O. If 0, there is no limit.
+  uint64_t sorter_memory_budget_bytes = 0;
+
+  // If true, the args of the events of the raw table are stored in a compact
+  // encoding and only decoded when a query reads them from the args table or
+  // to_ftrace(). This makes the args of ftrace-heavy traces several times
+  // smaller, at the cost of slower queries on these args.
+  bool lazy_raw_args = false;
 };
 
 // Represents a dynamically typed value returned by SQL.
@@ -90,6 +90,17 @@ class TraceProcessor {
   // ignore the following Parse() requests and drop data on the floor.
   virtual bool Parse(std::unique_ptr<uint8_t[]>, size_t) = 0;
 
+  // Alternative to Parse() for traces stored in a regular file: pushes the
+  // whole content of |fd| into the processor by mapping the file read-only in
+  // memory, rather than copying it into heap buffers. The trace data is
+  // referenced in place by the parsing pipeline and the pages of the file are
+  // released once the events they contain have been sorted and parsed. |fd|
+  // can be closed once this function returns. NotifyEndOfFile() must still be
+  // called afterwards.
+  // Returns false if the file could not be mapped or, like Parse(), if some
+  // unrecoverable parsing error happened.
+  virtual bool ParseMappedFile(int fd) = 0;
+
   // When parsing a bounded file (as opposite to streaming from a device) this
   // function should be called when the last chunk of the file has been passed
   // into Parse(). This allows to flush the events queued in the ordering stage,
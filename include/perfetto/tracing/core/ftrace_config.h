@@ -102,12 +102,16 @@ class PERFETTO_EXPORT FtraceConfig {
   uint32_t drain_period_ms() const { return drain_period_ms_; }
   void set_drain_period_ms(uint32_t value) { drain_period_ms_ = value; }
 
+  bool compact_sched() const { return compact_sched_; }
+  void set_compact_sched(bool value) { compact_sched_ = value; }
+
  private:
   std::vector<std::string> ftrace_events_;
   std::vector<std::string> atrace_categories_;
   std::vector<std::string> atrace_apps_;
   uint32_t buffer_size_kb_ = {};
   uint32_t drain_period_ms_ = {};
+  bool compact_sched_ = {};
 
   // Allows to preserve unknown protobuf fields for compatibility
   // with future versions of .proto files.
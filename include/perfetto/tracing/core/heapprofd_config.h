@@ -71,9 +71,13 @@ class PERFETTO_EXPORT HeapprofdConfig {
     uint32_t dump_interval_ms() const { return dump_interval_ms_; }
     void set_dump_interval_ms(uint32_t value) { dump_interval_ms_ = value; }
 
+    bool incremental() const { return incremental_; }
+    void set_incremental(bool value) { incremental_ = value; }
+
    private:
     uint32_t dump_phase_ms_ = {};
     uint32_t dump_interval_ms_ = {};
+    bool incremental_ = {};
 
     // Allows to preserve unknown protobuf fields for compatibility
     // with future versions of .proto files.
@@ -38,6 +38,11 @@ struct Slice {
   explicit Slice(std::unique_ptr<std::string> str)
       : start(&(*str)[0]), size(str->size()), moved_str_data_(std::move(str)) {}
 
+  // Used to reference a range of a buffer shared with other slices (e.g. a
+  // pooled arena). The buffer is kept alive as long as any slice refers to it.
+  Slice(const void* st, size_t sz, std::shared_ptr<const uint8_t> shared_data)
+      : start(st), size(sz), shared_data_(std::move(shared_data)) {}
+
   Slice(Slice&& other) noexcept = default;
 
   // Create a Slice which owns |size| bytes of memory.
@@ -63,6 +68,7 @@ struct Slice {
 
   std::unique_ptr<uint8_t[]> own_data_;
   std::unique_ptr<std::string> moved_str_data_;
+  std::shared_ptr<const uint8_t> shared_data_;
 };
 
 // TODO(primiano): most TracePacket(s) fit in a slice or two. We need something
@@ -358,6 +358,16 @@ class PERFETTO_EXPORT TraceConfig {
     std::string unknown_fields_;
   };
 
+  enum CompressionType {
+    COMPRESSION_TYPE_UNSPECIFIED = 0,
+    COMPRESSION_TYPE_DEFLATE = 1,
+  };
+
+  enum FileSyncPolicy {
+    FILE_SYNC_POLICY_UNSPECIFIED = 0,
+    FILE_SYNC_POLICY_EVERY_BATCH = 1,
+  };
+
   TraceConfig();
   ~TraceConfig();
   TraceConfig(TraceConfig&&) noexcept;
@@ -456,6 +466,29 @@ class PERFETTO_EXPORT TraceConfig {
   const TriggerConfig& trigger_config() const { return trigger_config_; }
   TriggerConfig* mutable_trigger_config() { return &trigger_config_; }
 
+  CompressionType compression_type() const { return compression_type_; }
+  void set_compression_type(CompressionType value) {
+    compression_type_ = value;
+  }
+
+  bool file_write_async() const { return file_write_async_; }
+  void set_file_write_async(bool value) { file_write_async_ = value; }
+
+  uint32_t file_write_max_queued_kb() const {
+    return file_write_max_queued_kb_;
+  }
+  void set_file_write_max_queued_kb(uint32_t value) {
+    file_write_max_queued_kb_ = value;
+  }
+
+  bool file_write_direct_io() const { return file_write_direct_io_; }
+  void set_file_write_direct_io(bool value) { file_write_direct_io_ = value; }
+
+  FileSyncPolicy file_sync_policy() const { return file_sync_policy_; }
+  void set_file_sync_policy(FileSyncPolicy value) {
+    file_sync_policy_ = value;
+  }
+
  private:
   std::vector<BufferConfig> buffers_;
   std::vector<DataSource> data_sources_;
@@ -474,6 +507,11 @@ class PERFETTO_EXPORT TraceConfig {
   bool disable_clock_snapshotting_ = {};
   bool notify_traceur_ = {};
   TriggerConfig trigger_config_ = {};
+  CompressionType compression_type_ = {};
+  bool file_write_async_ = {};
+  uint32_t file_write_max_queued_kb_ = {};
+  bool file_write_direct_io_ = {};
+  FileSyncPolicy file_sync_policy_ = {};
 
   // Allows to preserve unknown protobuf fields for compatibility
   // with future versions of .proto files.
@@ -203,6 +203,23 @@ class PERFETTO_EXPORT TraceStats {
   uint64_t patches_discarded() const { return patches_discarded_; }
   void set_patches_discarded(uint64_t value) { patches_discarded_ = value; }
 
+  uint64_t file_write_batches() const { return file_write_batches_; }
+  void set_file_write_batches(uint64_t value) { file_write_batches_ = value; }
+
+  uint64_t file_write_max_queued_bytes() const {
+    return file_write_max_queued_bytes_;
+  }
+  void set_file_write_max_queued_bytes(uint64_t value) {
+    file_write_max_queued_bytes_ = value;
+  }
+
+  uint64_t file_write_backpressure_events() const {
+    return file_write_backpressure_events_;
+  }
+  void set_file_write_backpressure_events(uint64_t value) {
+    file_write_backpressure_events_ = value;
+  }
+
  private:
   std::vector<BufferStats> buffer_stats_;
   uint32_t producers_connected_ = {};
@@ -213,6 +230,9 @@ class PERFETTO_EXPORT TraceStats {
   uint32_t total_buffers_ = {};
   uint64_t chunks_discarded_ = {};
   uint64_t patches_discarded_ = {};
+  uint64_t file_write_batches_ = {};
+  uint64_t file_write_max_queued_bytes_ = {};
+  uint64_t file_write_backpressure_events_ = {};
 
   // Allows to preserve unknown protobuf fields for compatibility
   // with future versions of .proto files.
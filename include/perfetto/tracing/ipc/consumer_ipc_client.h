@@ -17,6 +17,8 @@
 #ifndef INCLUDE_PERFETTO_TRACING_IPC_CONSUMER_IPC_CLIENT_H_
 #define INCLUDE_PERFETTO_TRACING_IPC_CONSUMER_IPC_CLIENT_H_
 
+#include <stddef.h>
+
 #include <memory>
 #include <string>
 
@@ -41,8 +43,16 @@ class ConsumerIPCClient {
   // callbacks invoked on the Consumer interface: no more Consumer callbacks are
   // invoked immediately after its destruction and any pending callback will be
   // dropped.
-  static std::unique_ptr<TracingService::ConsumerEndpoint>
-  Connect(const char* service_sock_name, Consumer*, base::TaskRunner*);
+  // If |read_buffers_shm_size| is not zero, ReadBuffers() asks the service to
+  // transfer the trace packets through a shared memory buffer of about that
+  // size, rather than serializing them into the IPC replies. In this case the
+  // TracePacket(s) passed to Consumer::OnTraceData() point into the shared
+  // memory buffer and are valid only until OnTraceData() returns.
+  static std::unique_ptr<TracingService::ConsumerEndpoint> Connect(
+      const char* service_sock_name,
+      Consumer*,
+      base::TaskRunner*,
+      size_t read_buffers_shm_size = 0);
 
  protected:
   ConsumerIPCClient() = delete;
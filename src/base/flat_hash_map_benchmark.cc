@@ -0,0 +1,152 @@
+// Copyright (C) 2019 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "perfetto/base/flat_hash_map.h"
+
+namespace {
+
+using perfetto::base::FlatHashMap;
+
+// Adapters for the (different) APIs of the two maps.
+template <typename K, typename V>
+bool Insert(FlatHashMap<K, V>* map, K key, V value) {
+  return map->Insert(key, value).second;
+}
+
+template <typename K, typename V>
+bool Insert(std::unordered_map<K, V>* map, K key, V value) {
+  return map->emplace(key, value).second;
+}
+
+template <typename K, typename V>
+const V* Find(FlatHashMap<K, V>* map, K key) {
+  return map->Find(key);
+}
+
+template <typename K, typename V>
+const V* Find(std::unordered_map<K, V>* map, K key) {
+  auto it = map->find(key);
+  return it == map->end() ? nullptr : &it->second;
+}
+
+template <typename K, typename V>
+bool Erase(FlatHashMap<K, V>* map, K key) {
+  return map->Erase(key);
+}
+
+template <typename K, typename V>
+bool Erase(std::unordered_map<K, V>* map, K key) {
+  return map->erase(key) == 1;
+}
+
+// Sequential keys, like tids and utids.
+std::vector<uint64_t> SequentialKeys(size_t num_keys) {
+  std::vector<uint64_t> keys(num_keys);
+  for (size_t i = 0; i < num_keys; i++)
+    keys[i] = i;
+  return keys;
+}
+
+// Random 64-bit keys, like hashes and (aligned) heap addresses.
+std::vector<uint64_t> RandomKeys(size_t num_keys) {
+  std::mt19937_64 rnd(0);
+  std::vector<uint64_t> keys(num_keys);
+  for (size_t i = 0; i < num_keys; i++)
+    keys[i] = rnd() & ~uint64_t(0xf);
+  return keys;
+}
+
+// Inserts state.range(0) keys into an empty map.
+template <typename Map, std::vector<uint64_t> (*KeysFn)(size_t)>
+void BM_Insert(benchmark::State& state) {
+  std::vector<uint64_t> keys = KeysFn(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    Map map;
+    for (uint64_t key : keys)
+      Insert(&map, key, key);
+    benchmark::DoNotOptimize(map);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          state.range(0));
+}
+
+// Looks up state.range(0) keys, half of which are in the map, in random
+// order.
+template <typename Map, std::vector<uint64_t> (*KeysFn)(size_t)>
+void BM_Find(benchmark::State& state) {
+  const size_t num_keys = static_cast<size_t>(state.range(0));
+  std::vector<uint64_t> keys = KeysFn(num_keys * 2);
+  Map map;
+  for (size_t i = 0; i < num_keys; i++)
+    Insert(&map, keys[i * 2], keys[i * 2]);
+  std::shuffle(keys.begin(), keys.end(), std::minstd_rand0(0));
+
+  for (auto _ : state) {
+    uint64_t found = 0;
+    for (uint64_t key : keys) {
+      const uint64_t* value = Find(&map, key);
+      found += value ? *value : 0;
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(keys.size()));
+}
+
+// The pattern of the heapprofd bookkeeping: a sliding window of
+// state.range(0) live entries where each insertion is followed by the erasure
+// of an older entry.
+template <typename Map>
+void BM_InsertErase(benchmark::State& state) {
+  const size_t window = static_cast<size_t>(state.range(0));
+  std::vector<uint64_t> keys = RandomKeys(1024 * 1024);
+  for (auto _ : state) {
+    Map map;
+    for (size_t i = 0; i < keys.size(); i++) {
+      Insert(&map, keys[i], static_cast<uint64_t>(i));
+      if (i >= window)
+        Erase(&map, keys[i - window]);
+    }
+    benchmark::DoNotOptimize(map);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(keys.size()));
+}
+
+using FlatMap = FlatHashMap<uint64_t, uint64_t>;
+using StdMap = std::unordered_map<uint64_t, uint64_t>;
+
+void SizeArgs(benchmark::internal::Benchmark* b) {
+  b->Arg(1024)->Arg(64 * 1024)->Arg(1024 * 1024);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_Insert, FlatMap, SequentialKeys)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Insert, StdMap, SequentialKeys)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Insert, FlatMap, RandomKeys)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Insert, StdMap, RandomKeys)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Find, FlatMap, SequentialKeys)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Find, StdMap, SequentialKeys)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Find, FlatMap, RandomKeys)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_Find, StdMap, RandomKeys)->Apply(SizeArgs);
+BENCHMARK_TEMPLATE(BM_InsertErase, FlatMap)->Arg(1024)->Arg(64 * 1024);
+BENCHMARK_TEMPLATE(BM_InsertErase, StdMap)->Arg(1024)->Arg(64 * 1024);
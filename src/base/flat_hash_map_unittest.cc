@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "perfetto/base/flat_hash_map.h"
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include "gtest/gtest.h"
+
+namespace perfetto {
+namespace base {
+namespace {
+
+TEST(FlatHashMapTest, InsertAndFind) {
+  FlatHashMap<int, std::string> map;
+  EXPECT_EQ(map.Find(1), nullptr);
+
+  auto res = map.Insert(1, "foo");
+  EXPECT_TRUE(res.second);
+  EXPECT_EQ(*res.first, "foo");
+
+  res = map.Insert(1, "bar");
+  EXPECT_FALSE(res.second);
+  EXPECT_EQ(*res.first, "foo");
+
+  map[2] = "bar";
+  ASSERT_NE(map.Find(2), nullptr);
+  EXPECT_EQ(*map.Find(2), "bar");
+  EXPECT_EQ(map.Find(3), nullptr);
+  EXPECT_EQ(map.size(), 2u);
+}
+
+TEST(FlatHashMapTest, Erase) {
+  FlatHashMap<int, int> map;
+  for (int i = 0; i < 10; i++)
+    map[i] = i * 10;
+
+  EXPECT_TRUE(map.Erase(5));
+  EXPECT_FALSE(map.Erase(5));
+  EXPECT_EQ(map.Find(5), nullptr);
+  EXPECT_EQ(map.size(), 9u);
+  for (int i = 0; i < 10; i++) {
+    if (i != 5) {
+      EXPECT_EQ(*map.Find(i), i * 10);
+    }
+  }
+
+  map[5] = 42;
+  EXPECT_EQ(*map.Find(5), 42);
+  EXPECT_EQ(map.size(), 10u);
+}
+
+// Keeps inserting and erasing keys so that the table is mostly made of
+// tombstones and checks that it doesn't grow.
+TEST(FlatHashMapTest, TombstonesDontGrowTable) {
+  FlatHashMap<uint64_t, uint64_t> map;
+  for (uint64_t i = 0; i < 100000; i++) {
+    map.Insert(i, i);
+    if (i >= 8) {
+      ASSERT_TRUE(map.Erase(i - 8));
+    }
+  }
+  EXPECT_EQ(map.size(), 8u);
+  EXPECT_LE(map.capacity(), 32u);
+}
+
+TEST(FlatHashMapTest, MoveOnlyValues) {
+  FlatHashMap<int, std::unique_ptr<int>> map;
+  for (int i = 0; i < 1000; i++)
+    map.Insert(i, std::unique_ptr<int>(new int(i)));
+  for (int i = 0; i < 1000; i++)
+    ASSERT_EQ(**map.Find(i), i);
+
+  FlatHashMap<int, std::unique_ptr<int>> moved(std::move(map));
+  EXPECT_EQ(moved.size(), 1000u);
+  EXPECT_EQ(**moved.Find(999), 999);
+}
+
+TEST(FlatHashMapTest, Iterator) {
+  FlatHashMap<int, int> map;
+  std::map<int, int> expected;
+  for (int i = 0; i < 100; i += 3) {
+    map[i] = -i;
+    expected[i] = -i;
+  }
+  map.Erase(9);
+  expected.erase(9);
+
+  std::map<int, int> actual;
+  for (auto it = map.GetIterator(); it; ++it)
+    actual[it.key()] = it.value();
+  EXPECT_EQ(actual, expected);
+}
+
+// Applies the same random sequence of operations to a FlatHashMap and to an
+// std::unordered_map and checks that they agree.
+TEST(FlatHashMapTest, MatchesUnorderedMap) {
+  std::minstd_rand0 rnd(0);
+  FlatHashMap<uint32_t, uint32_t> map;
+  std::unordered_map<uint32_t, uint32_t> expected;
+  for (uint32_t i = 0; i < 200000; i++) {
+    uint32_t key = rnd() % 5000;
+    switch (rnd() % 3) {
+      case 0:
+        ASSERT_EQ(map.Insert(key, i).second, expected.emplace(key, i).second);
+        break;
+      case 1:
+        ASSERT_EQ(map.Erase(key), expected.erase(key) == 1);
+        break;
+      case 2: {
+        auto it = expected.find(key);
+        uint32_t* value = map.Find(key);
+        ASSERT_EQ(value != nullptr, it != expected.end());
+        if (value) {
+          ASSERT_EQ(*value, it->second);
+        }
+        break;
+      }
+    }
+    ASSERT_EQ(map.size(), expected.size());
+  }
+
+  map.Clear();
+  EXPECT_EQ(map.size(), 0u);
+  EXPECT_EQ(map.Find(expected.begin()->first), nullptr);
+}
+
+}  // namespace
+}  // namespace base
+}  // namespace perfetto
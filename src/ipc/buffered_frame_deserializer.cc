@@ -25,6 +25,7 @@
 #include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "perfetto/base/logging.h"
 #include "perfetto/base/utils.h"
+#include "perfetto/protozero/proto_decoder.h"
 
 #include "src/ipc/wire_protocol.pb.h"
 
@@ -33,10 +34,191 @@ namespace ipc {
 
 namespace {
 
+using protozero::proto_utils::ProtoWireType;
+
 // The header is just the number of bytes of the Frame protobuf message.
 constexpr size_t kHeaderSize = sizeof(uint32_t);
+
+// Field numbers from wire_protocol.proto, used by the FrameView decoder.
+constexpr uint32_t kFrameRequestId = 2;
+constexpr uint32_t kBindServiceServiceName = 1;
+constexpr uint32_t kBindServiceReplySuccess = 1;
+constexpr uint32_t kBindServiceReplyServiceId = 2;
+constexpr uint32_t kBindServiceReplyMethods = 3;
+constexpr uint32_t kMethodInfoId = 1;
+constexpr uint32_t kMethodInfoName = 2;
+constexpr uint32_t kInvokeMethodServiceId = 1;
+constexpr uint32_t kInvokeMethodMethodId = 2;
+constexpr uint32_t kInvokeMethodArgsProto = 3;
+constexpr uint32_t kInvokeMethodDropReply = 4;
+constexpr uint32_t kInvokeMethodReplySuccess = 1;
+constexpr uint32_t kInvokeMethodReplyHasMore = 2;
+constexpr uint32_t kInvokeMethodReplyReplyProto = 3;
+constexpr uint32_t kRequestErrorError = 1;
+
+// Invokes |fn| for each field of the encoded message |msg|, skipping the fields
+// whose wire type doesn't match the one of |fn|'s field, like libprotobuf does
+// for unknown fields. Returns false if |msg| or any nested message decoded by
+// |fn| is malformed.
+template <typename F>
+bool ForEachField(protozero::ConstBytes msg, F fn) {
+  protozero::ProtoDecoder decoder(msg.data, msg.size);
+  for (protozero::Field field = decoder.ReadField(); field.valid();
+       field = decoder.ReadField()) {
+    if (!fn(field))
+      return false;
+  }
+  return decoder.bytes_left() == 0;
+}
+
+inline bool IsVarInt(const protozero::Field& field) {
+  return field.type() == ProtoWireType::kVarInt;
+}
+
+inline bool IsLengthDelimited(const protozero::Field& field) {
+  return field.type() == ProtoWireType::kLengthDelimited;
+}
+
+inline base::StringView ToStringView(const protozero::Field& field) {
+  return base::StringView(reinterpret_cast<const char*>(field.data()),
+                          field.size());
+}
+
+bool DecodeMethodInfo(protozero::ConstBytes msg,
+                      uint32_t* id,
+                      base::StringView* name) {
+  *id = 0;
+  *name = base::StringView();
+  return ForEachField(msg, [id, name](const protozero::Field& field) {
+    if (field.id() == kMethodInfoId && IsVarInt(field))
+      *id = field.as_uint32();
+    else if (field.id() == kMethodInfoName && IsLengthDelimited(field))
+      *name = ToStringView(field);
+    return true;
+  });
+}
+
+bool DecodeBindService(protozero::ConstBytes msg,
+                       FrameView::BindService* res) {
+  *res = FrameView::BindService();
+  return ForEachField(msg, [res](const protozero::Field& field) {
+    if (field.id() == kBindServiceServiceName && IsLengthDelimited(field))
+      res->service_name = ToStringView(field);
+    return true;
+  });
+}
+
+bool DecodeBindServiceReply(protozero::ConstBytes msg,
+                            FrameView::BindServiceReply* res) {
+  *res = FrameView::BindServiceReply();
+  res->encoded = msg;
+  return ForEachField(msg, [res](const protozero::Field& field) {
+    if (field.id() == kBindServiceReplySuccess && IsVarInt(field)) {
+      res->success = field.as_bool();
+    } else if (field.id() == kBindServiceReplyServiceId && IsVarInt(field)) {
+      res->service_id = field.as_uint32();
+    } else if (field.id() == kBindServiceReplyMethods &&
+               IsLengthDelimited(field)) {
+      // Only validated here, see FrameView::BindServiceReply::ForEachMethod().
+      uint32_t id;
+      base::StringView name;
+      return DecodeMethodInfo(field.as_bytes(), &id, &name);
+    }
+    return true;
+  });
+}
+
+bool DecodeInvokeMethod(protozero::ConstBytes msg,
+                        FrameView::InvokeMethod* res) {
+  *res = FrameView::InvokeMethod();
+  return ForEachField(msg, [res](const protozero::Field& field) {
+    if (field.id() == kInvokeMethodServiceId && IsVarInt(field))
+      res->service_id = field.as_uint32();
+    else if (field.id() == kInvokeMethodMethodId && IsVarInt(field))
+      res->method_id = field.as_uint32();
+    else if (field.id() == kInvokeMethodArgsProto && IsLengthDelimited(field))
+      res->args_proto = field.as_bytes();
+    else if (field.id() == kInvokeMethodDropReply && IsVarInt(field))
+      res->drop_reply = field.as_bool();
+    return true;
+  });
+}
+
+bool DecodeInvokeMethodReply(protozero::ConstBytes msg,
+                             FrameView::InvokeMethodReply* res) {
+  *res = FrameView::InvokeMethodReply();
+  return ForEachField(msg, [res](const protozero::Field& field) {
+    if (field.id() == kInvokeMethodReplySuccess && IsVarInt(field))
+      res->success = field.as_bool();
+    else if (field.id() == kInvokeMethodReplyHasMore && IsVarInt(field))
+      res->has_more = field.as_bool();
+    else if (field.id() == kInvokeMethodReplyReplyProto &&
+             IsLengthDelimited(field))
+      res->reply_proto = field.as_bytes();
+    return true;
+  });
+}
+
+bool DecodeRequestError(protozero::ConstBytes msg,
+                        FrameView::RequestError* res) {
+  *res = FrameView::RequestError();
+  return ForEachField(msg, [res](const protozero::Field& field) {
+    if (field.id() == kRequestErrorError && IsLengthDelimited(field))
+      res->error = ToStringView(field);
+    return true;
+  });
+}
+
 }  // namespace
 
+bool FrameView::ParseFromArray(const void* data, size_t size) {
+  *this = FrameView();
+  protozero::ConstBytes msg{static_cast<const uint8_t*>(data), size};
+  return ForEachField(msg, [this](const protozero::Field& field) {
+    if (field.id() == kFrameRequestId && IsVarInt(field)) {
+      request_id = field.as_uint64();
+      return true;
+    }
+    if (!IsLengthDelimited(field))
+      return true;
+
+    // As for any oneof, if more than one member is set the last one wins.
+    switch (field.id()) {
+      case Frame::kMsgBindService:
+        msg_case = field.id();
+        return DecodeBindService(field.as_bytes(), &msg_bind_service);
+      case Frame::kMsgBindServiceReply:
+        msg_case = field.id();
+        return DecodeBindServiceReply(field.as_bytes(),
+                                      &msg_bind_service_reply);
+      case Frame::kMsgInvokeMethod:
+        msg_case = field.id();
+        return DecodeInvokeMethod(field.as_bytes(), &msg_invoke_method);
+      case Frame::kMsgInvokeMethodReply:
+        msg_case = field.id();
+        return DecodeInvokeMethodReply(field.as_bytes(),
+                                       &msg_invoke_method_reply);
+      case Frame::kMsgRequestError:
+        msg_case = field.id();
+        return DecodeRequestError(field.as_bytes(), &msg_request_error);
+    }
+    return true;
+  });
+}
+
+void FrameView::BindServiceReply::ForEachMethod(
+    const std::function<void(uint32_t, base::StringView)>& fn) const {
+  ForEachField(encoded, [&fn](const protozero::Field& field) {
+    if (field.id() != kBindServiceReplyMethods || !IsLengthDelimited(field))
+      return true;
+    uint32_t id;
+    base::StringView name;
+    if (DecodeMethodInfo(field.as_bytes(), &id, &name))
+      fn(id, name);
+    return true;
+  });
+}
+
 BufferedFrameDeserializer::BufferedFrameDeserializer(size_t max_capacity)
     : capacity_(max_capacity) {
   PERFETTO_CHECK(max_capacity % base::kPageSize == 0);
@@ -64,7 +246,9 @@ BufferedFrameDeserializer::BeginReceive() {
   return ReceiveBuffer{buf() + size_, capacity_ - size_};
 }
 
-bool BufferedFrameDeserializer::EndReceive(size_t recv_size) {
+template <typename F>
+bool BufferedFrameDeserializer::EndReceiveInternal(size_t recv_size,
+                                                   F on_frame) {
   PERFETTO_CHECK(recv_size + size_ <= capacity_);
   size_ += recv_size;
 
@@ -118,7 +302,7 @@ bool BufferedFrameDeserializer::EndReceive(size_t recv_size) {
     }
 
     // Case C. We got at least one header and whole frame.
-    DecodeFrame(rd_ptr, payload_size);
+    on_frame(rd_ptr, payload_size);
     consumed_size += next_frame_size;
   }
 
@@ -155,6 +339,22 @@ bool BufferedFrameDeserializer::EndReceive(size_t recv_size) {
   return true;
 }
 
+bool BufferedFrameDeserializer::EndReceive(size_t recv_size) {
+  return EndReceiveInternal(recv_size, [this](const char* data, size_t size) {
+    DecodeFrame(data, size);
+  });
+}
+
+bool BufferedFrameDeserializer::EndReceive(size_t recv_size,
+                                           const FrameHandler& handler) {
+  FrameView frame;
+  return EndReceiveInternal(
+      recv_size, [&frame, &handler](const char* data, size_t size) {
+        if (size > 0 && frame.ParseFromArray(data, size))
+          handler(frame);
+      });
+}
+
 std::unique_ptr<Frame> BufferedFrameDeserializer::PopNextFrame() {
   if (decoded_frames_.empty())
     return nullptr;
@@ -18,21 +18,80 @@
 #define SRC_IPC_BUFFERED_FRAME_DESERIALIZER_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <functional>
 #include <list>
 #include <memory>
 
 #include <sys/mman.h>
 
 #include "perfetto/base/paged_memory.h"
+#include "perfetto/base/string_view.h"
 #include "perfetto/base/utils.h"
 #include "perfetto/ipc/basic_types.h"
+#include "perfetto/protozero/field.h"
 
 namespace perfetto {
 namespace ipc {
 
 class Frame;  // Defined in the protobuf autogenerated wire_protocol.pb.h.
 
+// A view of a Frame decoded in place, with protozero, from the buffer of
+// BufferedFrameDeserializer. Only the members of the oneof |msg| identified by
+// |msg_case| are set. Strings and bytes are not copied: they point into the
+// receive buffer (see BufferedFrameDeserializer::FrameHandler).
+struct FrameView {
+  struct BindService {
+    base::StringView service_name;
+  };
+
+  struct BindServiceReply {
+    bool success = false;
+    uint32_t service_id = 0;
+
+    // Invokes |fn| with the id and name of each of the |methods|.
+    void ForEachMethod(
+        const std::function<void(uint32_t, base::StringView)>& fn) const;
+
+    // The encoded message, which |methods| are decoded from on demand.
+    protozero::ConstBytes encoded{};
+  };
+
+  struct InvokeMethod {
+    uint32_t service_id = 0;
+    uint32_t method_id = 0;
+    protozero::ConstBytes args_proto{};
+    bool drop_reply = false;
+  };
+
+  struct InvokeMethodReply {
+    bool success = false;
+    bool has_more = false;
+    protozero::ConstBytes reply_proto{};
+  };
+
+  struct RequestError {
+    base::StringView error;
+  };
+
+  // Decodes the |size| bytes at |data|. Returns false if they are not a valid
+  // Frame.
+  bool ParseFromArray(const void* data, size_t size);
+
+  uint64_t request_id = 0;
+
+  // The field number of the |msg| member which is set, which is the same as
+  // the corresponding Frame::MsgCase value. 0 if none is set.
+  int msg_case = 0;
+
+  BindService msg_bind_service;
+  BindServiceReply msg_bind_service_reply;
+  InvokeMethod msg_invoke_method;
+  InvokeMethodReply msg_invoke_method_reply;
+  RequestError msg_request_error;
+};
+
 // Deserializes incoming frames, taking care of buffering and tokenization.
 // Used by both host and client to decode incoming frames.
 //
@@ -59,10 +118,13 @@ class Frame;  // Defined in the protobuf autogenerated wire_protocol.pb.h.
 //
 // auto buf = rpc_frame_decoder.BeginReceive();
 // size_t rsize = socket.recv(buf.first, buf.second);
-// rpc_frame_decoder.EndReceive(rsize);
-// while (Frame frame = rpc_frame_decoder.PopNextFrame()) {
+// rpc_frame_decoder.EndReceive(rsize, [](const FrameView& frame) {
 //   ... process |frame|
-// }
+// });
+//
+// Alternatively, EndReceive(rsize) decodes the frames into Frame objects,
+// which are retrieved with PopNextFrame(). This is simpler to use but costs a
+// heap allocation per frame and a copy of all its strings and bytes.
 //
 // Design goals:
 // -------------
@@ -83,6 +145,11 @@ class BufferedFrameDeserializer {
     size_t size;
   };
 
+  // Invoked for each frame that has been completely received. The FrameView
+  // and the data it points to are valid only until the handler returns. The
+  // handler must not call back into the BufferedFrameDeserializer.
+  using FrameHandler = std::function<void(const FrameView&)>;
+
   // |max_capacity| is overridable only for tests.
   explicit BufferedFrameDeserializer(size_t max_capacity = kIPCBufferSize);
   ~BufferedFrameDeserializer();
@@ -103,6 +170,12 @@ class BufferedFrameDeserializer {
   // caller is expected to shutdown the socket and terminate the ipc.
   bool EndReceive(size_t recv_size) PERFETTO_WARN_UNUSED_RESULT;
 
+  // Like the above, but rather than decoding the frames for PopNextFrame(),
+  // passes a zero-copy view of each of them to |handler| before returning.
+  // Frames which can't be decoded are skipped.
+  bool EndReceive(size_t recv_size,
+                  const FrameHandler& handler) PERFETTO_WARN_UNUSED_RESULT;
+
   // Decodes and returns the next decoded frame in the buffer if any, nullptr
   // if no further frames have been decoded.
   std::unique_ptr<Frame> PopNextFrame();
@@ -115,6 +188,11 @@ class BufferedFrameDeserializer {
   BufferedFrameDeserializer& operator=(const BufferedFrameDeserializer&) =
       delete;
 
+  // Tokenizes the frames in |buf_| and passes the (data, size) of each of them
+  // to |on_frame|. See EndReceive().
+  template <typename F>
+  bool EndReceiveInternal(size_t recv_size, F on_frame);
+
   // If a valid frame is decoded it is added to |decoded_frames_|.
   void DecodeFrame(const char*, size_t);
 
@@ -18,6 +18,8 @@
 
 #include <algorithm>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "perfetto/base/logging.h"
@@ -379,6 +381,138 @@ TEST(BufferedFrameDeserializerTest, FillCapacity) {
   }
 }
 
+// Checks that the FrameView passed to the handler matches the Frame decoded
+// by libprotobuf, for each type of message of the wire protocol.
+TEST(BufferedFrameDeserializerTest, FrameViews) {
+  std::vector<Frame> frames(5);
+  frames[0].set_request_id(1);
+  frames[0].mutable_msg_bind_service()->set_service_name("svc");
+
+  frames[1].set_request_id(2);
+  auto* bind_reply = frames[1].mutable_msg_bind_service_reply();
+  bind_reply->set_success(true);
+  bind_reply->set_service_id(42);
+  auto* method = bind_reply->add_methods();
+  method->set_id(1);
+  method->set_name("Foo");
+  method = bind_reply->add_methods();
+  method->set_id(2);
+  method->set_name("Bar");
+
+  frames[2].set_request_id(3);
+  auto* invoke = frames[2].mutable_msg_invoke_method();
+  invoke->set_service_id(42);
+  invoke->set_method_id(2);
+  invoke->set_args_proto(std::string("a\0b", 3));
+  invoke->set_drop_reply(true);
+
+  frames[3].set_request_id(1ull << 40);
+  auto* invoke_reply = frames[3].mutable_msg_invoke_method_reply();
+  invoke_reply->set_success(true);
+  invoke_reply->set_has_more(true);
+  invoke_reply->set_reply_proto("reply");
+
+  frames[4].set_request_id(5);
+  frames[4].mutable_msg_request_error()->set_error("error");
+
+  std::string encoded;
+  for (const Frame& frame : frames)
+    encoded += BufferedFrameDeserializer::Serialize(frame);
+
+  BufferedFrameDeserializer bfd;
+  BufferedFrameDeserializer::ReceiveBuffer rbuf = bfd.BeginReceive();
+  ASSERT_GE(rbuf.size, encoded.size());
+  memcpy(rbuf.data, encoded.data(), encoded.size());
+
+  size_t num_frames = 0;
+  auto on_frame = [&num_frames](const FrameView& frame) {
+    switch (num_frames++) {
+      case 0:
+        EXPECT_EQ(1u, frame.request_id);
+        ASSERT_EQ(Frame::kMsgBindService, frame.msg_case);
+        EXPECT_EQ("svc", frame.msg_bind_service.service_name.ToStdString());
+        break;
+      case 1: {
+        EXPECT_EQ(2u, frame.request_id);
+        ASSERT_EQ(Frame::kMsgBindServiceReply, frame.msg_case);
+        const auto& reply = frame.msg_bind_service_reply;
+        EXPECT_TRUE(reply.success);
+        EXPECT_EQ(42u, reply.service_id);
+        std::vector<std::pair<uint32_t, std::string>> methods;
+        reply.ForEachMethod([&methods](uint32_t id, base::StringView name) {
+          methods.emplace_back(id, name.ToStdString());
+        });
+        EXPECT_EQ((std::vector<std::pair<uint32_t, std::string>>{
+                      {1, "Foo"}, {2, "Bar"}}),
+                  methods);
+        break;
+      }
+      case 2: {
+        EXPECT_EQ(3u, frame.request_id);
+        ASSERT_EQ(Frame::kMsgInvokeMethod, frame.msg_case);
+        const auto& req = frame.msg_invoke_method;
+        EXPECT_EQ(42u, req.service_id);
+        EXPECT_EQ(2u, req.method_id);
+        EXPECT_EQ(std::string("a\0b", 3),
+                  std::string(reinterpret_cast<const char*>(req.args_proto.data),
+                              req.args_proto.size));
+        EXPECT_TRUE(req.drop_reply);
+        break;
+      }
+      case 3: {
+        EXPECT_EQ(1ull << 40, frame.request_id);
+        ASSERT_EQ(Frame::kMsgInvokeMethodReply, frame.msg_case);
+        const auto& reply = frame.msg_invoke_method_reply;
+        EXPECT_TRUE(reply.success);
+        EXPECT_TRUE(reply.has_more);
+        EXPECT_EQ("reply", std::string(reinterpret_cast<const char*>(
+                                           reply.reply_proto.data),
+                                       reply.reply_proto.size));
+        break;
+      }
+      case 4:
+        EXPECT_EQ(5u, frame.request_id);
+        ASSERT_EQ(Frame::kMsgRequestError, frame.msg_case);
+        EXPECT_EQ("error", frame.msg_request_error.error.ToStdString());
+        break;
+    }
+  };
+  ASSERT_TRUE(bfd.EndReceive(encoded.size(), on_frame));
+  EXPECT_EQ(frames.size(), num_frames);
+  EXPECT_EQ(0u, bfd.size());
+}
+
+// Frames split across several recv()s and unparsable frames are handled like
+// in the PopNextFrame() case.
+TEST(BufferedFrameDeserializerTest, FrameViewsFragmentedAndUnparsable) {
+  Frame frame;
+  frame.set_request_id(7);
+  frame.mutable_msg_request_error()->set_error(std::string(300, 'e'));
+  std::string encoded = BufferedFrameDeserializer::Serialize(frame);
+  std::vector<char> unparsable = GetSimpleFrame(64);
+  memset(unparsable.data() + kHeaderSize, 0xFF, unparsable.size() - kHeaderSize);
+  encoded = std::string(unparsable.begin(), unparsable.end()) + encoded;
+
+  BufferedFrameDeserializer bfd;
+  size_t num_frames = 0;
+  auto on_frame = [&num_frames](const FrameView& view) {
+    num_frames++;
+    EXPECT_EQ(7u, view.request_id);
+    ASSERT_EQ(Frame::kMsgRequestError, view.msg_case);
+    EXPECT_EQ(std::string(300, 'e'), view.msg_request_error.error.ToStdString());
+  };
+  for (size_t off = 0; off < encoded.size();) {
+    const size_t chunk = std::min<size_t>(13, encoded.size() - off);
+    BufferedFrameDeserializer::ReceiveBuffer rbuf = bfd.BeginReceive();
+    ASSERT_GE(rbuf.size, chunk);
+    memcpy(rbuf.data, encoded.data() + off, chunk);
+    ASSERT_TRUE(bfd.EndReceive(chunk, on_frame));
+    off += chunk;
+    EXPECT_EQ(off < encoded.size() ? 0u : 1u, num_frames);
+  }
+  EXPECT_EQ(0u, bfd.size());
+}
+
 }  // namespace
 }  // namespace ipc
 }  // namespace perfetto
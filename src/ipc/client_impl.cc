@@ -89,7 +89,6 @@ RequestID ClientImpl::BeginInvoke(ServiceID service_id,
                                   bool drop_reply,
                                   base::WeakPtr<ServiceProxy> service_proxy,
                                   int fd) {
-  std::string args_proto;
   RequestID request_id = ++last_request_id_;
   Frame frame;
   frame.set_request_id(request_id);
@@ -97,8 +96,9 @@ RequestID ClientImpl::BeginInvoke(ServiceID service_id,
   req->set_service_id(service_id);
   req->set_method_id(remote_method_id);
   req->set_drop_reply(drop_reply);
-  bool did_serialize = method_args.SerializeToString(&args_proto);
-  req->set_args_proto(args_proto);
+  // Serialize straight into the frame, to avoid copying large arguments (e.g.
+  // CommitData requests).
+  bool did_serialize = method_args.SerializeToString(req->mutable_args_proto());
   if (!did_serialize || !SendFrame(frame, fd)) {
     PERFETTO_DLOG("BeginInvoke() failed while sending the frame");
     return 0;
@@ -154,6 +154,9 @@ void ClientImpl::OnDisconnect(base::UnixSocket*) {
 }
 
 void ClientImpl::OnDataAvailable(base::UnixSocket*) {
+  // The frames are dispatched straight from the receive buffer, before the
+  // next Receive() can overwrite it.
+  auto on_frame = [this](const FrameView& frame) { OnFrameReceived(frame); };
   size_t rsize;
   do {
     auto buf = frame_deserializer_.BeginReceive();
@@ -165,58 +168,56 @@ void ClientImpl::OnDataAvailable(base::UnixSocket*) {
       PERFETTO_DCHECK(res == 0);
       received_fd_ = std::move(fd);
     }
-    if (!frame_deserializer_.EndReceive(rsize)) {
+    if (!frame_deserializer_.EndReceive(rsize, on_frame)) {
       // The endpoint tried to send a frame that is way too large.
       return sock_->Shutdown(true);  // In turn will trigger an OnDisconnect().
       // TODO(fmayer): check this.
     }
   } while (rsize > 0);
-
-  while (std::unique_ptr<Frame> frame = frame_deserializer_.PopNextFrame())
-    OnFrameReceived(*frame);
 }
 
-void ClientImpl::OnFrameReceived(const Frame& frame) {
-  auto queued_requests_it = queued_requests_.find(frame.request_id());
+void ClientImpl::OnFrameReceived(const FrameView& frame) {
+  auto queued_requests_it = queued_requests_.find(frame.request_id);
   if (queued_requests_it == queued_requests_.end()) {
     PERFETTO_DLOG("OnFrameReceived(): got invalid request_id=%" PRIu64,
-                  static_cast<uint64_t>(frame.request_id()));
+                  static_cast<uint64_t>(frame.request_id));
     return;
   }
   QueuedRequest req = std::move(queued_requests_it->second);
   queued_requests_.erase(queued_requests_it);
 
   if (req.type == Frame::kMsgBindService &&
-      frame.msg_case() == Frame::kMsgBindServiceReply) {
-    return OnBindServiceReply(std::move(req), frame.msg_bind_service_reply());
+      frame.msg_case == Frame::kMsgBindServiceReply) {
+    return OnBindServiceReply(std::move(req), frame.msg_bind_service_reply);
   }
   if (req.type == Frame::kMsgInvokeMethod &&
-      frame.msg_case() == Frame::kMsgInvokeMethodReply) {
-    return OnInvokeMethodReply(std::move(req), frame.msg_invoke_method_reply());
+      frame.msg_case == Frame::kMsgInvokeMethodReply) {
+    return OnInvokeMethodReply(std::move(req), frame.msg_invoke_method_reply);
   }
-  if (frame.msg_case() == Frame::kMsgRequestError) {
-    PERFETTO_DLOG("Host error: %s", frame.msg_request_error().error().c_str());
+  if (frame.msg_case == Frame::kMsgRequestError) {
+    PERFETTO_DLOG("Host error: %s",
+                  frame.msg_request_error.error.ToStdString().c_str());
     return;
   }
 
   PERFETTO_DLOG(
       "OnFrameReceived() request msg_type=%d, received msg_type=%d in reply to "
       "request_id=%" PRIu64,
-      req.type, frame.msg_case(), static_cast<uint64_t>(frame.request_id()));
+      req.type, frame.msg_case, static_cast<uint64_t>(frame.request_id));
 }
 
 void ClientImpl::OnBindServiceReply(QueuedRequest req,
-                                    const Frame::BindServiceReply& reply) {
+                                    const FrameView::BindServiceReply& reply) {
   base::WeakPtr<ServiceProxy>& service_proxy = req.service_proxy;
   if (!service_proxy)
     return;
   const char* svc_name = service_proxy->GetDescriptor().service_name;
-  if (!reply.success()) {
+  if (!reply.success) {
     PERFETTO_DLOG("BindService(): unknown service_name=\"%s\"", svc_name);
     return service_proxy->OnConnect(false /* success */);
   }
 
-  auto prev_service = service_bindings_.find(reply.service_id());
+  auto prev_service = service_bindings_.find(reply.service_id);
   if (prev_service != service_bindings_.end() && prev_service->second.get()) {
     PERFETTO_DLOG(
         "BindService(): Trying to bind service \"%s\" but another service "
@@ -227,31 +228,33 @@ void ClientImpl::OnBindServiceReply(QueuedRequest req,
 
   // Build the method [name] -> [remote_id] map.
   std::map<std::string, MethodID> methods;
-  for (const auto& method : reply.methods()) {
-    if (method.name().empty() || method.id() <= 0) {
+  reply.ForEachMethod([&methods](uint32_t id, base::StringView name) {
+    if (name.empty() || id == 0) {
       PERFETTO_DLOG("OnBindServiceReply(): invalid method \"%s\" -> %" PRIu64,
-                    method.name().c_str(), static_cast<uint64_t>(method.id()));
-      continue;
+                    name.ToStdString().c_str(), static_cast<uint64_t>(id));
+      return;
     }
-    methods[method.name()] = method.id();
-  }
+    methods[name.ToStdString()] = id;
+  });
   service_proxy->InitializeBinding(weak_ptr_factory_.GetWeakPtr(),
-                                   reply.service_id(), std::move(methods));
-  service_bindings_[reply.service_id()] = service_proxy;
+                                   reply.service_id, std::move(methods));
+  service_bindings_[reply.service_id] = service_proxy;
   service_proxy->OnConnect(true /* success */);
 }
 
-void ClientImpl::OnInvokeMethodReply(QueuedRequest req,
-                                     const Frame::InvokeMethodReply& reply) {
+void ClientImpl::OnInvokeMethodReply(
+    QueuedRequest req,
+    const FrameView::InvokeMethodReply& reply) {
   base::WeakPtr<ServiceProxy> service_proxy = req.service_proxy;
   if (!service_proxy)
     return;
   std::unique_ptr<ProtoMessage> decoded_reply;
-  if (reply.success()) {
+  if (reply.success) {
     // If this becomes a hotspot, optimize by maintaining a dedicated hashtable.
     for (const auto& method : service_proxy->GetDescriptor().methods) {
       if (req.method_name == method.name) {
-        decoded_reply = method.reply_proto_decoder(reply.reply_proto());
+        decoded_reply = method.reply_proto_decoder(reply.reply_proto.data,
+                                                   reply.reply_proto.size);
         break;
       }
     }
@@ -259,12 +262,12 @@ void ClientImpl::OnInvokeMethodReply(QueuedRequest req,
   const RequestID request_id = req.request_id;
   invoking_method_reply_ = true;
   service_proxy->EndInvoke(request_id, std::move(decoded_reply),
-                           reply.has_more());
+                           reply.has_more);
   invoking_method_reply_ = false;
 
   // If this is a streaming method and future replies will be resolved, put back
   // the |req| with the callback into the set of active requests.
-  if (reply.has_more())
+  if (reply.has_more)
     queued_requests_.emplace(request_id, std::move(req));
 }
 
@@ -77,9 +77,10 @@ class ClientImpl : public Client, public base::UnixSocket::EventListener {
   ClientImpl& operator=(const ClientImpl&) = delete;
 
   bool SendFrame(const Frame&, int fd = -1);
-  void OnFrameReceived(const Frame&);
-  void OnBindServiceReply(QueuedRequest, const Frame::BindServiceReply&);
-  void OnInvokeMethodReply(QueuedRequest, const Frame::InvokeMethodReply&);
+  void OnFrameReceived(const FrameView&);
+  void OnBindServiceReply(QueuedRequest, const FrameView::BindServiceReply&);
+  void OnInvokeMethodReply(QueuedRequest,
+                           const FrameView::InvokeMethodReply&);
 
   bool invoking_method_reply_ = false;
   std::unique_ptr<base::UnixSocket> sock_;
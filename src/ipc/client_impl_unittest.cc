@@ -54,9 +54,9 @@ class FakeProxy : public ServiceProxy {
       : ServiceProxy(el), service_name_(service_name) {}
 
   const ServiceDescriptor& GetDescriptor() override {
-    auto reply_decoder = [](const std::string& proto) {
+    auto reply_decoder = [](const uint8_t* data, size_t size) {
       std::unique_ptr<ProtoMessage> reply(new ReplyProto());
-      EXPECT_TRUE(reply->ParseFromString(proto));
+      EXPECT_TRUE(reply->ParseFromArray(data, static_cast<int>(size)));
       return reply;
     };
     if (!descriptor_.service_name) {
@@ -101,6 +101,11 @@ void HostImpl::OnDataAvailable(base::UnixSocket* sock) {
   ClientConnection* client = it->second;
   BufferedFrameDeserializer& frame_deserializer = client->frame_deserializer;
 
+  // The frames are dispatched straight from the receive buffer, before the
+  // next Receive() can overwrite it.
+  auto on_frame = [this, client](const FrameView& frame) {
+    OnReceivedFrame(client, frame);
+  };
   size_t rsize;
   do {
     auto buf = frame_deserializer.BeginReceive();
@@ -110,41 +115,36 @@ void HostImpl::OnDataAvailable(base::UnixSocket* sock) {
       PERFETTO_DCHECK(!client->received_fd);
       client->received_fd = std::move(fd);
     }
-    if (!frame_deserializer.EndReceive(rsize))
+    if (!frame_deserializer.EndReceive(rsize, on_frame))
       return OnDisconnect(client->sock.get());
   } while (rsize > 0);
-
-  for (;;) {
-    std::unique_ptr<Frame> frame = frame_deserializer.PopNextFrame();
-    if (!frame)
-      break;
-    OnReceivedFrame(client, *frame);
-  }
 }
 
 void HostImpl::OnReceivedFrame(ClientConnection* client,
-                               const Frame& req_frame) {
-  if (req_frame.msg_case() == Frame::kMsgBindService)
+                               const FrameView& req_frame) {
+  if (req_frame.msg_case == Frame::kMsgBindService)
     return OnBindService(client, req_frame);
-  if (req_frame.msg_case() == Frame::kMsgInvokeMethod)
+  if (req_frame.msg_case == Frame::kMsgInvokeMethod)
     return OnInvokeMethod(client, req_frame);
 
-  PERFETTO_DLOG("Received invalid RPC frame %u from client %" PRIu64,
-                req_frame.msg_case(), client->id);
+  PERFETTO_DLOG("Received invalid RPC frame %d from client %" PRIu64,
+                req_frame.msg_case, client->id);
   Frame reply_frame;
-  reply_frame.set_request_id(req_frame.request_id());
+  reply_frame.set_request_id(req_frame.request_id);
   reply_frame.mutable_msg_request_error()->set_error("unknown request");
   SendFrame(client, reply_frame);
 }
 
-void HostImpl::OnBindService(ClientConnection* client, const Frame& req_frame) {
+void HostImpl::OnBindService(ClientConnection* client,
+                             const FrameView& req_frame) {
   // Binding a service doesn't do anything major. It just returns back the
   // service id and its method map.
-  const Frame::BindService& req = req_frame.msg_bind_service();
+  const FrameView::BindService& req = req_frame.msg_bind_service;
   Frame reply_frame;
-  reply_frame.set_request_id(req_frame.request_id());
+  reply_frame.set_request_id(req_frame.request_id);
   auto* reply = reply_frame.mutable_msg_bind_service_reply();
-  const ExposedService* service = GetServiceByName(req.service_name());
+  const ExposedService* service =
+      GetServiceByName(req.service_name.ToStdString());
   if (service) {
     reply->set_success(true);
     reply->set_service_id(service->id);
@@ -159,26 +159,26 @@ void HostImpl::OnBindService(ClientConnection* client, const Frame& req_frame) {
 }
 
 void HostImpl::OnInvokeMethod(ClientConnection* client,
-                              const Frame& req_frame) {
-  const Frame::InvokeMethod& req = req_frame.msg_invoke_method();
+                              const FrameView& req_frame) {
+  const FrameView::InvokeMethod& req = req_frame.msg_invoke_method;
   Frame reply_frame;
-  RequestID request_id = req_frame.request_id();
+  RequestID request_id = req_frame.request_id;
   reply_frame.set_request_id(request_id);
   reply_frame.mutable_msg_invoke_method_reply()->set_success(false);
-  auto svc_it = services_.find(req.service_id());
+  auto svc_it = services_.find(req.service_id);
   if (svc_it == services_.end())
     return SendFrame(client, reply_frame);  // |success| == false by default.
 
   Service* service = svc_it->second.instance.get();
   const ServiceDescriptor& svc = service->GetDescriptor();
   const auto& methods = svc.methods;
-  const uint32_t method_id = req.method_id();
+  const uint32_t method_id = req.method_id;
   if (method_id == 0 || method_id > methods.size())
     return SendFrame(client, reply_frame);
 
   const ServiceDescriptor::Method& method = methods[method_id - 1];
-  std::unique_ptr<ProtoMessage> decoded_req_args(
-      method.request_proto_decoder(req.args_proto()));
+  std::unique_ptr<ProtoMessage> decoded_req_args(method.request_proto_decoder(
+      req.args_proto.data, req.args_proto.size));
   if (!decoded_req_args)
     return SendFrame(client, reply_frame);
 
@@ -186,7 +186,7 @@ void HostImpl::OnInvokeMethod(ClientConnection* client,
   base::WeakPtr<HostImpl> host_weak_ptr = weak_ptr_factory_.GetWeakPtr();
   ClientID client_id = client->id;
 
-  if (!req.drop_reply()) {
+  if (!req.drop_reply) {
     deferred_reply.Bind([host_weak_ptr, client_id,
                          request_id](AsyncResult<ProtoMessage> reply) {
       if (!host_weak_ptr)
@@ -220,11 +220,11 @@ void HostImpl::ReplyToMethodInvocation(ClientID client_id,
   auto* reply_frame_data = reply_frame.mutable_msg_invoke_method_reply();
   reply_frame_data->set_has_more(reply.has_more());
   if (reply.success()) {
-    std::string reply_proto;
-    if (reply->SerializeToString(&reply_proto)) {
-      reply_frame_data->set_reply_proto(reply_proto);
+    // Serialize straight into the frame, to avoid copying large replies.
+    if (reply->SerializeToString(reply_frame_data->mutable_reply_proto()))
       reply_frame_data->set_success(true);
-    }
+    else
+      reply_frame_data->clear_reply_proto();
   }
   SendFrame(client, reply_frame, reply.fd());
 }
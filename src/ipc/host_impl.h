@@ -75,9 +75,9 @@ class HostImpl : public Host, public base::UnixSocket::EventListener {
   HostImpl& operator=(const HostImpl&) = delete;
 
   bool Initialize(const char* socket_name);
-  void OnReceivedFrame(ClientConnection*, const Frame&);
-  void OnBindService(ClientConnection*, const Frame&);
-  void OnInvokeMethod(ClientConnection*, const Frame&);
+  void OnReceivedFrame(ClientConnection*, const FrameView&);
+  void OnBindService(ClientConnection*, const FrameView&);
+  void OnInvokeMethod(ClientConnection*, const FrameView&);
   void ReplyToMethodInvocation(ClientID, RequestID, AsyncResult<ProtoMessage>);
   const ExposedService* GetServiceByName(const std::string&);
 
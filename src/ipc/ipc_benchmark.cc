@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <memory>
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+#include "perfetto/base/logging.h"
+#include "perfetto/base/unix_task_runner.h"
+#include "perfetto/ipc/client.h"
+#include "perfetto/ipc/host.h"
+#include "src/ipc/buffered_frame_deserializer.h"
+#include "src/ipc/test/test_socket.h"
+
+#include "src/ipc/test/greeter_service.ipc.h"
+#include "src/ipc/test/greeter_service.pb.h"
+#include "src/ipc/wire_protocol.pb.h"
+
+namespace {
+
+using ::perfetto::ipc::AsyncResult;
+using ::perfetto::ipc::BufferedFrameDeserializer;
+using ::perfetto::ipc::Deferred;
+using ::perfetto::ipc::Frame;
+using ::perfetto::ipc::FrameView;
+
+constexpr char kSockName[] = TEST_SOCK_NAME("ipc_benchmark");
+
+// Number of frames in each recv() of BM_IpcDeserialize*, and of requests in
+// flight in each iteration of BM_IpcRoundTrip.
+constexpr size_t kBatchSize = 16;
+
+// Returns |kBatchSize| serialized InvokeMethod frames, whose arguments are
+// |args_size| bytes long, as the host would receive them in one recv().
+std::string MakeInvokeMethodFrames(size_t args_size) {
+  std::string frames;
+  for (size_t i = 0; i < kBatchSize; i++) {
+    Frame frame;
+    frame.set_request_id(i + 1);
+    Frame::InvokeMethod* req = frame.mutable_msg_invoke_method();
+    req->set_service_id(1);
+    req->set_method_id(2);
+    req->set_args_proto(std::string(args_size, 'x'));
+    frames += BufferedFrameDeserializer::Serialize(frame);
+  }
+  return frames;
+}
+
+void BM_IpcDeserializeFrames(benchmark::State& state) {
+  const std::string frames =
+      MakeInvokeMethodFrames(static_cast<size_t>(state.range(0)));
+  BufferedFrameDeserializer bfd;
+  for (auto _ : state) {
+    auto rbuf = bfd.BeginReceive();
+    PERFETTO_CHECK(rbuf.size >= frames.size());
+    memcpy(rbuf.data, frames.data(), frames.size());
+    PERFETTO_CHECK(bfd.EndReceive(frames.size()));
+    while (std::unique_ptr<Frame> frame = bfd.PopNextFrame())
+      benchmark::DoNotOptimize(frame->msg_invoke_method().args_proto().size());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(frames.size()));
+}
+
+void BM_IpcDeserializeFrameViews(benchmark::State& state) {
+  const std::string frames =
+      MakeInvokeMethodFrames(static_cast<size_t>(state.range(0)));
+  BufferedFrameDeserializer bfd;
+  auto on_frame = [](const FrameView& frame) {
+    benchmark::DoNotOptimize(frame.msg_invoke_method.args_proto.size);
+  };
+  for (auto _ : state) {
+    auto rbuf = bfd.BeginReceive();
+    PERFETTO_CHECK(rbuf.size >= frames.size());
+    memcpy(rbuf.data, frames.data(), frames.size());
+    PERFETTO_CHECK(bfd.EndReceive(frames.size(), on_frame));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(frames.size()));
+}
+
+class EchoService : public ipc_test::Greeter {
+ public:
+  void SayHello(const ipc_test::GreeterRequestMsg& request,
+                DeferredGreeterReplyMsg reply) override {
+    auto result = AsyncResult<ipc_test::GreeterReplyMsg>::Create();
+    result->set_message(request.name());
+    reply.Resolve(std::move(result));
+  }
+
+  void WaveGoodbye(const ipc_test::GreeterRequestMsg&,
+                   DeferredGreeterReplyMsg) override {}
+};
+
+class QuitOnConnect : public ::perfetto::ipc::ServiceProxy::EventListener {
+ public:
+  explicit QuitOnConnect(perfetto::base::UnixTaskRunner* task_runner)
+      : task_runner_(task_runner) {}
+  void OnConnect() override { task_runner_->Quit(); }
+  void OnDisconnect() override {}
+
+ private:
+  perfetto::base::UnixTaskRunner* const task_runner_;
+};
+
+// Measures the throughput of a client and a host, on the same thread, sending
+// each other requests and replies of state.range(0) bytes over the socket.
+void BM_IpcRoundTrip(benchmark::State& state) {
+  unlink(kSockName);
+  perfetto::base::UnixTaskRunner task_runner;
+  std::unique_ptr<perfetto::ipc::Host> host =
+      perfetto::ipc::Host::CreateInstance(kSockName, &task_runner);
+  PERFETTO_CHECK(host);
+  PERFETTO_CHECK(host->ExposeService(
+      std::unique_ptr<perfetto::ipc::Service>(new EchoService())));
+
+  QuitOnConnect event_listener(&task_runner);
+  std::unique_ptr<perfetto::ipc::Client> client =
+      perfetto::ipc::Client::CreateInstance(kSockName, &task_runner);
+  ipc_test::GreeterProxy proxy(&event_listener);
+  client->BindService(proxy.GetWeakPtr());
+  task_runner.Run();
+
+  ipc_test::GreeterRequestMsg req;
+  req.set_name(std::string(static_cast<size_t>(state.range(0)), 'x'));
+  size_t pending_replies = 0;
+  for (auto _ : state) {
+    pending_replies = kBatchSize;
+    for (size_t i = 0; i < kBatchSize; i++) {
+      Deferred<ipc_test::GreeterReplyMsg> reply(
+          [&task_runner,
+           &pending_replies](AsyncResult<ipc_test::GreeterReplyMsg> result) {
+            PERFETTO_CHECK(result.success());
+            if (--pending_replies == 0)
+              task_runner.Quit();
+          });
+      proxy.SayHello(req, std::move(reply));
+    }
+    task_runner.Run();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(kBatchSize) * 2 *
+                          state.range(0));
+  unlink(kSockName);
+}
+
+}  // namespace
+
+BENCHMARK(BM_IpcDeserializeFrames)->RangeMultiplier(8)->Range(64, 4096);
+BENCHMARK(BM_IpcDeserializeFrameViews)->RangeMultiplier(8)->Range(64, 4096);
+BENCHMARK(BM_IpcRoundTrip)->RangeMultiplier(8)->Range(64, 4096);
@@ -61,6 +61,16 @@ namespace {
 
 perfetto::PerfettoCmd* g_consumer_cmd;
 
+// Size of the shared memory buffer used to pull the trace buffers from the
+// service. On Android the sepolicy doesn't allow passing memfds from traced to
+// the perfetto cmdline client yet, so the trace is pulled through the IPC
+// replies.
+#if PERFETTO_BUILDFLAG(PERFETTO_ANDROID_BUILD)
+constexpr size_t kReadBuffersShmSize = 0;
+#else
+constexpr size_t kReadBuffersShmSize = 8 * 1024 * 1024;
+#endif
+
 class LoggingErrorReporter : public ErrorReporter {
  public:
   LoggingErrorReporter(std::string file_name, const char* config)
@@ -491,7 +501,8 @@ int PerfettoCmd::Main(int argc, char** argv) {
     return 1;
 
   consumer_endpoint_ =
-      ConsumerIPCClient::Connect(GetConsumerSocket(), this, &task_runner_);
+      ConsumerIPCClient::Connect(GetConsumerSocket(), this, &task_runner_,
+                                 kReadBuffersShmSize);
   SetupCtrlCSignalHandler();
   task_runner_.Run();
 
@@ -21,6 +21,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
+
 #include "perfetto/base/file_utils.h"
 #include "perfetto/base/logging.h"
 #include "perfetto/base/scoped_file.h"
@@ -37,10 +39,11 @@ uint32_t kPacketSizeThreshold = 400000;
 }
 
 GlobalCallstackTrie::Node* GlobalCallstackTrie::Node::GetOrCreateChild(
-    const Interned<Frame>& loc) {
+    const Interned<Frame>& loc,
+    uint64_t* next_id) {
   Node* child = children_.Get(loc);
   if (!child)
-    child = children_.Emplace(loc, this);
+    child = children_.Emplace(loc, this, (*next_id)++);
   return child;
 }
 
@@ -48,9 +51,9 @@ void HeapTracker::RecordMalloc(const std::vector<FrameData>& callstack,
                                uint64_t address,
                                uint64_t size,
                                uint64_t sequence_number) {
-  auto it = allocations_.find(address);
-  if (it != allocations_.end()) {
-    Allocation& alloc = it->second;
+  Allocation* existing_alloc = allocations_.Find(address);
+  if (existing_alloc) {
+    Allocation& alloc = *existing_alloc;
     PERFETTO_DCHECK(alloc.sequence_number != sequence_number);
     if (alloc.sequence_number < sequence_number) {
       // As we are overwriting the previous allocation, the previous allocation
@@ -75,9 +78,9 @@ void HeapTracker::RecordMalloc(const std::vector<FrameData>& callstack,
     }
   } else {
     GlobalCallstackTrie::Node* node = callsites_->CreateCallsite(callstack);
-    allocations_.emplace(address,
-                         Allocation(size, sequence_number,
-                                    MaybeCreateCallstackAllocations(node)));
+    allocations_.Insert(address,
+                        Allocation(size, sequence_number,
+                                   MaybeCreateCallstackAllocations(node)));
   }
 
   RecordOperation(sequence_number, address);
@@ -85,7 +88,7 @@ void HeapTracker::RecordMalloc(const std::vector<FrameData>& callstack,
 
 void HeapTracker::RecordOperation(uint64_t sequence_number, uint64_t address) {
   if (sequence_number != committed_sequence_number_ + 1) {
-    pending_operations_.emplace(sequence_number, address);
+    pending_operations_.Insert(sequence_number, address);
     return;
   }
 
@@ -93,11 +96,14 @@ void HeapTracker::RecordOperation(uint64_t sequence_number, uint64_t address) {
 
   // At this point some other pending operations might be eligible to be
   // committed.
-  auto it = pending_operations_.begin();
-  while (it != pending_operations_.end() &&
-         it->first == committed_sequence_number_ + 1) {
-    CommitOperation(it->first, it->second);
-    it = pending_operations_.erase(it);
+  for (;;) {
+    const uint64_t next_seq_id = committed_sequence_number_ + 1;
+    const uint64_t* next_address = pending_operations_.Find(next_seq_id);
+    if (!next_address)
+      break;
+    const uint64_t pending_address = *next_address;
+    pending_operations_.Erase(next_seq_id);
+    CommitOperation(next_seq_id, pending_address);
   }
 }
 
@@ -105,16 +111,16 @@ void HeapTracker::CommitOperation(uint64_t sequence_number, uint64_t address) {
   committed_sequence_number_++;
 
   // We will see many frees for addresses we do not know about.
-  auto leaf_it = allocations_.find(address);
-  if (leaf_it == allocations_.end())
+  Allocation* leaf = allocations_.Find(address);
+  if (!leaf)
     return;
 
-  Allocation& value = leaf_it->second;
+  Allocation& value = *leaf;
   if (value.sequence_number == sequence_number) {
     value.AddToCallstackAllocations();
   } else if (value.sequence_number < sequence_number) {
     value.SubtractFromCallstackAllocations();
-    allocations_.erase(leaf_it);
+    allocations_.Erase(address);
   }
   // else (value.sequence_number > sequence_number:
   //  This allocation has been replaced by a newer one in RecordMalloc.
@@ -132,30 +138,53 @@ void HeapTracker::Dump(
   // * We need to remove them after the callstacks were dumped, which currently
   //   happens after the allocations are dumped.
   // * This way, we do not destroy and recreate callstacks as frequently.
-  for (auto it_and_alloc : dead_callstack_allocations_) {
-    auto& it = it_and_alloc.first;
-    uint64_t allocated = it_and_alloc.second;
-    const CallstackAllocations& alloc = it->second;
+  for (const auto& node_and_alloc : dead_callstack_allocations_) {
+    GlobalCallstackTrie::Node* node = node_and_alloc.first;
+    uint64_t allocated = node_and_alloc.second;
+    const CallstackAllocations& alloc = **callstack_allocations_.Find(node);
     if (alloc.allocs == 0 && alloc.allocation_count == allocated)
-      callstack_allocations_.erase(it);
+      callstack_allocations_.Erase(node);
   }
   dead_callstack_allocations_.clear();
 
+  // Write the samples in node id order. The table iterates in an unspecified
+  // order, and the std::map it replaced was ordered by Node address, so this
+  // is also the first time the order doesn't depend on the allocator.
+  std::vector<CallstackAllocations*> sorted_allocations;
+  sorted_allocations.reserve(callstack_allocations_.size());
+  for (auto it = callstack_allocations_.GetIterator(); it; ++it)
+    sorted_allocations.emplace_back(it.value().get());
+  std::sort(sorted_allocations.begin(), sorted_allocations.end(),
+            [](const CallstackAllocations* a, const CallstackAllocations* b) {
+              return *a < *b;
+            });
+
   if (dump_state->currently_written() > kPacketSizeThreshold)
     dump_state->NewProfilePacket();
 
   ProfilePacket::ProcessHeapSamples* proto =
       dump_state->current_profile_packet->add_process_dumps();
   fill_process_header(proto);
-  for (auto it = callstack_allocations_.begin();
-       it != callstack_allocations_.end(); ++it) {
+  for (CallstackAllocations* alloc_ptr : sorted_allocations) {
+    CallstackAllocations& alloc = *alloc_ptr;
+    if (alloc.allocs == 0)
+      dead_callstack_allocations_.emplace_back(alloc.node,
+                                               alloc.allocation_count);
+
+    if (dump_state->incremental &&
+        alloc.allocation_count == alloc.dumped_allocation_count &&
+        alloc.free_count == alloc.dumped_free_count) {
+      continue;
+    }
+    alloc.dumped_allocation_count = alloc.allocation_count;
+    alloc.dumped_free_count = alloc.free_count;
+
     if (dump_state->currently_written() > kPacketSizeThreshold) {
       dump_state->NewProfilePacket();
       proto = dump_state->current_profile_packet->add_process_dumps();
       fill_process_header(proto);
     }
 
-    const CallstackAllocations& alloc = it->second;
     dump_state->callstacks_to_dump.emplace(alloc.node);
     ProfilePacket::HeapSample* sample = proto->add_samples();
     sample->set_callstack_id(alloc.node->id());
@@ -163,9 +192,6 @@ void HeapTracker::Dump(
     sample->set_self_freed(alloc.freed);
     sample->set_alloc_count(alloc.allocation_count);
     sample->set_free_count(alloc.free_count);
-
-    if (alloc.allocs == 0)
-      dead_callstack_allocations_.emplace_back(it, alloc.allocation_count);
   }
 }
 
@@ -175,11 +201,11 @@ uint64_t HeapTracker::GetSizeForTesting(const std::vector<FrameData>& stack) {
   // This is only good because this is used for testing only.
   GlobalCallstackTrie::IncrementNode(node);
   GlobalCallstackTrie::DecrementNode(node);
-  auto it = callstack_allocations_.find(node);
-  if (it == callstack_allocations_.end()) {
+  std::unique_ptr<CallstackAllocations>* it =
+      callstack_allocations_.Find(node);
+  if (!it)
     return 0;
-  }
-  const CallstackAllocations& alloc = it->second;
+  const CallstackAllocations& alloc = **it;
   return alloc.allocated - alloc.freed;
 }
 
@@ -197,7 +223,7 @@ GlobalCallstackTrie::Node* GlobalCallstackTrie::CreateCallsite(
     const std::vector<FrameData>& callstack) {
   Node* node = &root_;
   for (const FrameData& loc : callstack) {
-    node = node->GetOrCreateChild(InternCodeLocation(loc));
+    node = node->GetOrCreateChild(InternCodeLocation(loc), &next_node_id_);
   }
   return node;
 }
@@ -251,7 +277,7 @@ Interned<Frame> GlobalCallstackTrie::MakeRootFrame() {
 }
 
 void DumpState::WriteMap(const Interned<Mapping> map) {
-  auto map_it_and_inserted = dumped_mappings.emplace(map.id());
+  auto map_it_and_inserted = dumped_ids->mappings.emplace(map.id());
   if (map_it_and_inserted.second) {
     for (const Interned<std::string>& str : map->path_components)
       WriteString(str);
@@ -277,7 +303,7 @@ void DumpState::WriteFrame(Interned<Frame> frame) {
   WriteMap(frame->mapping);
   WriteString(frame->function_name);
   bool inserted;
-  std::tie(std::ignore, inserted) = dumped_frames.emplace(frame.id());
+  std::tie(std::ignore, inserted) = dumped_ids->frames.emplace(frame.id());
   if (inserted) {
     if (currently_written() > kPacketSizeThreshold)
       NewProfilePacket();
@@ -292,7 +318,7 @@ void DumpState::WriteFrame(Interned<Frame> frame) {
 
 void DumpState::WriteString(const Interned<std::string>& str) {
   bool inserted;
-  std::tie(std::ignore, inserted) = dumped_strings.emplace(str.id());
+  std::tie(std::ignore, inserted) = dumped_ids->strings.emplace(str.id());
   if (inserted) {
     if (currently_written() > kPacketSizeThreshold)
       NewProfilePacket();
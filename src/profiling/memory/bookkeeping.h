@@ -18,9 +18,11 @@
 #define SRC_PROFILING_MEMORY_BOOKKEEPING_H_
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "perfetto/base/flat_hash_map.h"
 #include "perfetto/base/lookup_set.h"
 #include "perfetto/base/string_splitter.h"
 #include "perfetto/trace/profiling/profile_packet.pbzero.h"
@@ -154,16 +156,20 @@ class GlobalCallstackTrie {
     // This is opaque except to GlobalCallstackTrie.
     friend class GlobalCallstackTrie;
 
-    Node(Interned<Frame> frame) : Node(std::move(frame), nullptr) {}
-    Node(Interned<Frame> frame, Node* parent)
-        : parent_(parent), location_(std::move(frame)) {}
+    Node(Interned<Frame> frame) : Node(std::move(frame), nullptr, 0) {}
+    Node(Interned<Frame> frame, Node* parent, uint64_t id)
+        : id_(id), parent_(parent), location_(std::move(frame)) {}
 
-    uintptr_t id() const { return reinterpret_cast<uintptr_t>(this); }
+    // Unique for the lifetime of the GlobalCallstackTrie, unlike the address
+    // of the node, so that a callstack written by a previous incremental dump
+    // can be referred to by its id.
+    uint64_t id() const { return id_; }
 
    private:
-    Node* GetOrCreateChild(const Interned<Frame>& loc);
+    Node* GetOrCreateChild(const Interned<Frame>& loc, uint64_t* next_id);
 
     uint64_t ref_count_ = 0;
+    const uint64_t id_;
     Node* const parent_;
     const Interned<Frame> location_;
     base::LookupSet<Node, const Interned<Frame>, &Node::location_> children_;
@@ -187,25 +193,45 @@ class GlobalCallstackTrie {
   Interner<Mapping> mapping_interner_;
   Interner<Frame> frame_interner_;
 
+  uint64_t next_node_id_ = 1;
   Node root_{MakeRootFrame()};
 };
 
+// Ids of the interned data and of the callstacks written to the trace.
+struct DumpedIds {
+  std::set<InternID> strings;
+  std::set<InternID> frames;
+  std::set<InternID> mappings;
+  std::set<uint64_t> callstacks;
+};
+
 struct DumpState {
-  DumpState(TraceWriter* tw, uint64_t* ni) : trace_writer(tw), next_index(ni) {
+  DumpState(TraceWriter* tw, uint64_t* ni) : DumpState(tw, ni, nullptr) {}
+
+  // If |incremental_ids| is set, this is an incremental dump: only the samples
+  // that changed since the previous dump are written, and only the interned
+  // data and callstacks not in |incremental_ids|, which is shared by all the
+  // dumps of a data source.
+  DumpState(TraceWriter* tw, uint64_t* ni, DumpedIds* incremental_ids)
+      : trace_writer(tw), next_index(ni) {
+    incremental = incremental_ids != nullptr;
+    dumped_ids = incremental ? incremental_ids : &own_dumped_ids;
     last_written = trace_writer->written();
 
     current_trace_packet = trace_writer->NewTracePacket();
     current_profile_packet = current_trace_packet->set_profile_packet();
     current_profile_packet->set_index((*next_index)++);
+    if (incremental)
+      current_profile_packet->set_incremental(true);
   }
 
   void WriteMap(const Interned<Mapping> map);
   void WriteFrame(const Interned<Frame> frame);
   void WriteString(const Interned<std::string>& str);
 
-  std::set<InternID> dumped_strings;
-  std::set<InternID> dumped_frames;
-  std::set<InternID> dumped_mappings;
+  bool incremental = false;
+  DumpedIds* dumped_ids = nullptr;
+  DumpedIds own_dumped_ids;
 
   std::set<GlobalCallstackTrie::Node*> callstacks_to_dump;
 
@@ -227,6 +253,8 @@ struct DumpState {
     current_trace_packet = trace_writer->NewTracePacket();
     current_profile_packet = current_trace_packet->set_profile_packet();
     current_profile_packet->set_index((*next_index)++);
+    if (incremental)
+      current_profile_packet->set_incremental(true);
   }
 
   uint64_t currently_written() {
@@ -268,12 +296,17 @@ class HeapTracker {
     uint64_t allocation_count = 0;
     uint64_t free_count = 0;
 
+    // Counts as of the last dump. Incremental dumps skip the callstacks whose
+    // counts did not change.
+    uint64_t dumped_allocation_count = 0;
+    uint64_t dumped_free_count = 0;
+
     GlobalCallstackTrie::Node* const node;
 
     ~CallstackAllocations() { GlobalCallstackTrie::DecrementNode(node); }
 
     bool operator<(const CallstackAllocations& other) const {
-      return node < other.node;
+      return node->id() < other.node->id();
     }
   };
 
@@ -314,15 +347,17 @@ class HeapTracker {
 
   CallstackAllocations* MaybeCreateCallstackAllocations(
       GlobalCallstackTrie::Node* node) {
-    auto callstack_allocations_it = callstack_allocations_.find(node);
-    if (callstack_allocations_it == callstack_allocations_.end()) {
+    std::unique_ptr<CallstackAllocations>* callstack_allocations =
+        callstack_allocations_.Find(node);
+    if (!callstack_allocations) {
       GlobalCallstackTrie::IncrementNode(node);
       bool inserted;
-      std::tie(callstack_allocations_it, inserted) =
-          callstack_allocations_.emplace(node, node);
+      std::tie(callstack_allocations, inserted) = callstack_allocations_.Insert(
+          node, std::unique_ptr<CallstackAllocations>(
+                    new CallstackAllocations(node)));
       PERFETTO_DCHECK(inserted);
     }
-    return &callstack_allocations_it->second;
+    return callstack_allocations->get();
   }
 
   void RecordOperation(uint64_t sequence_number, uint64_t address);
@@ -340,13 +375,17 @@ class HeapTracker {
   // We cannot use an interner here, because after the last allocation goes
   // away, we still need to keep the CallstackAllocations around until the next
   // dump.
-  std::map<GlobalCallstackTrie::Node*, CallstackAllocations>
+  // The CallstackAllocations are heap allocated because the Allocations point
+  // to them, while the table moves its values when it grows. Dump() sorts them
+  // by node id, as the iteration order of the table is unspecified.
+  base::FlatHashMap<GlobalCallstackTrie::Node*,
+                    std::unique_ptr<CallstackAllocations>>
       callstack_allocations_;
 
-  std::vector<std::pair<decltype(callstack_allocations_)::iterator, uint64_t>>
+  std::vector<std::pair<GlobalCallstackTrie::Node*, uint64_t>>
       dead_callstack_allocations_;
 
-  std::map<uint64_t /* allocation address */, Allocation> allocations_;
+  base::FlatHashMap<uint64_t /* allocation address */, Allocation> allocations_;
 
   // An operation is either a commit of an allocation or freeing of an
   // allocation. An operation is a free if its seq_id is larger than
@@ -355,7 +394,7 @@ class HeapTracker {
   //
   // If its seq_id is less than the sequence_number of the corresponding
   // allocation it could be either, but is ignored either way.
-  std::map<uint64_t /* seq_id */, uint64_t /* allocation address */>
+  base::FlatHashMap<uint64_t /* seq_id */, uint64_t /* allocation address */>
       pending_operations_;
 
   // The sequence number all mallocs and frees have been handled up to.
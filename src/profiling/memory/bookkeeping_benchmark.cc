@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "src/profiling/memory/bookkeeping.h"
+#include "src/tracing/core/null_trace_writer.h"
+
+namespace {
+
+using perfetto::NullTraceWriter;
+using perfetto::profiling::DumpState;
+using perfetto::profiling::FrameData;
+using perfetto::profiling::GlobalCallstackTrie;
+using perfetto::profiling::HeapTracker;
+
+constexpr size_t kNumCallstacks = 256;
+constexpr size_t kMaxCallstackDepth = 32;
+constexpr size_t kNumOperations = 1 << 20;
+
+std::vector<std::vector<FrameData>> MakeCallstacks(std::minstd_rand0* rnd) {
+  std::uniform_int_distribution<size_t> depth_dist(1, kMaxCallstackDepth);
+  std::uniform_int_distribution<size_t> fn_dist(0, 1023);
+  std::vector<std::vector<FrameData>> callstacks(kNumCallstacks);
+  for (std::vector<FrameData>& callstack : callstacks) {
+    size_t depth = depth_dist(*rnd);
+    for (size_t i = 0; i < depth; i++) {
+      unwindstack::FrameData frame{};
+      frame.function_name = "fn" + std::to_string(fn_dist(*rnd));
+      frame.map_name = "/system/lib64/libfoo.so";
+      frame.rel_pc = i;
+      callstack.emplace_back(std::move(frame), "dummy_buildid");
+    }
+  }
+  return callstacks;
+}
+
+struct Operation {
+  bool is_malloc;
+  uint64_t address;
+  uint64_t size;
+  size_t callstack;
+};
+
+// Returns a malloc / free stream that keeps |num_live| allocations alive,
+// after the first |num_live| mallocs.
+std::vector<Operation> MakeOperations(std::minstd_rand0* rnd,
+                                      size_t num_live) {
+  std::uniform_int_distribution<uint64_t> size_dist(1, 4096);
+  std::uniform_int_distribution<size_t> callstack_dist(0, kNumCallstacks - 1);
+  std::vector<uint64_t> live;
+  std::vector<Operation> ops;
+  ops.reserve(num_live + kNumOperations);
+  uint64_t next_address = 0x7000000000;
+  auto add_malloc = [&] {
+    // Addresses are 16 bytes aligned, like the ones returned by malloc.
+    next_address += 16 * (1 + size_dist(*rnd) / 16);
+    live.push_back(next_address);
+    ops.push_back({true, next_address, size_dist(*rnd), callstack_dist(*rnd)});
+  };
+  for (size_t i = 0; i < num_live; i++)
+    add_malloc();
+  for (size_t i = 0; i < kNumOperations / 2; i++) {
+    std::uniform_int_distribution<size_t> live_dist(0, live.size() - 1);
+    size_t idx = live_dist(*rnd);
+    ops.push_back({false, live[idx], 0, 0});
+    live[idx] = live.back();
+    live.pop_back();
+    add_malloc();
+  }
+  return ops;
+}
+
+void Replay(HeapTracker* tracker,
+            const std::vector<std::vector<FrameData>>& callstacks,
+            const Operation& op,
+            uint64_t* sequence_number) {
+  if (op.is_malloc) {
+    tracker->RecordMalloc(callstacks[op.callstack], op.address, op.size,
+                          (*sequence_number)++);
+  } else {
+    tracker->RecordFree(op.address, (*sequence_number)++);
+  }
+}
+
+// Replays a synthetic malloc / free stream with state.range(0) live
+// allocations.
+void BM_HeapTracker_MallocFree(benchmark::State& state) {
+  std::minstd_rand0 rnd(0);
+  const auto callstacks = MakeCallstacks(&rnd);
+  const size_t num_live = static_cast<size_t>(state.range(0));
+  const auto ops = MakeOperations(&rnd, num_live);
+
+  GlobalCallstackTrie callsites;
+  HeapTracker tracker(&callsites);
+  uint64_t sequence_number = 1;
+  for (size_t i = 0; i < num_live; i++)
+    Replay(&tracker, callstacks, ops[i], &sequence_number);
+
+  size_t i = num_live;
+  for (auto _ : state) {
+    Replay(&tracker, callstacks, ops[i], &sequence_number);
+    // The frees of the first iteration of the stream are repeated as frees
+    // of unknown addresses, the mallocs overwrite the existing allocations.
+    if (++i == ops.size())
+      i = num_live;
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+// Dumps a heap with state.range(0) live allocations.
+void BM_HeapTracker_Dump(benchmark::State& state) {
+  std::minstd_rand0 rnd(0);
+  const auto callstacks = MakeCallstacks(&rnd);
+  const size_t num_live = static_cast<size_t>(state.range(0));
+  const auto ops = MakeOperations(&rnd, num_live);
+
+  GlobalCallstackTrie callsites;
+  HeapTracker tracker(&callsites);
+  uint64_t sequence_number = 1;
+  for (size_t i = 0; i < num_live; i++)
+    Replay(&tracker, callstacks, ops[i], &sequence_number);
+
+  NullTraceWriter trace_writer;
+  uint64_t next_index = 0;
+  for (auto _ : state) {
+    DumpState dump_state(&trace_writer, &next_index);
+    tracker.Dump([](perfetto::protos::pbzero::ProfilePacket::
+                        ProcessHeapSamples*) {},
+                 &dump_state);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_HeapTracker_MallocFree)->RangeMultiplier(16)->Range(1024, 1 << 20);
+BENCHMARK(BM_HeapTracker_Dump)->RangeMultiplier(16)->Range(1024, 1 << 20);
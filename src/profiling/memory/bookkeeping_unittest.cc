@@ -18,6 +18,7 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "src/tracing/core/null_trace_writer.h"
 
 namespace perfetto {
 namespace profiling {
@@ -172,6 +173,44 @@ TEST(BookkeepingTest, ArbitraryOrder) {
   } while (std::next_permutation(std::begin(operations), std::end(operations)));
 }
 
+TEST(BookkeepingTest, IncrementalDump) {
+  GlobalCallstackTrie c;
+  HeapTracker hd(&c);
+  NullTraceWriter trace_writer;
+  uint64_t next_index = 0;
+  DumpedIds dumped_ids;
+  auto fill_header = [](protos::pbzero::ProfilePacket::ProcessHeapSamples*) {};
+
+  hd.RecordMalloc(stack(), 1, 5, 1);
+  hd.RecordMalloc(stack2(), 2, 2, 2);
+  {
+    DumpState dump_state(&trace_writer, &next_index, &dumped_ids);
+    hd.Dump(fill_header, &dump_state);
+    EXPECT_EQ(dump_state.callstacks_to_dump.size(), 2u);
+  }
+
+  // Only the callstack of the freed allocation changed.
+  hd.RecordFree(2, 3);
+  {
+    DumpState dump_state(&trace_writer, &next_index, &dumped_ids);
+    hd.Dump(fill_header, &dump_state);
+    EXPECT_EQ(dump_state.callstacks_to_dump.size(), 1u);
+  }
+
+  {
+    DumpState dump_state(&trace_writer, &next_index, &dumped_ids);
+    hd.Dump(fill_header, &dump_state);
+    EXPECT_EQ(dump_state.callstacks_to_dump.size(), 0u);
+  }
+
+  // Full dumps always contain all the callstacks that are still alive.
+  {
+    DumpState dump_state(&trace_writer, &next_index);
+    hd.Dump(fill_header, &dump_state);
+    EXPECT_EQ(dump_state.callstacks_to_dump.size(), 1u);
+  }
+}
+
 }  // namespace
 }  // namespace profiling
 }  // namespace perfetto
@@ -202,6 +202,9 @@ std::string FormatStats(const protos::ProfilePacket_ProcessStats& stats) {
          std::to_string(stats.unwinding_errors()) + "\n" +
          "heap_samples: " + std::to_string(stats.heap_samples()) + "\n" +
          "map_reparses: " + std::to_string(stats.map_reparses()) + "\n" +
+         "buffer_overflows: " + std::to_string(stats.buffer_overflows()) +
+         "\n" + "unwinding_cache_hits: " +
+         std::to_string(stats.unwinding_cache_hits()) + "\n" +
          "unwinding_time_us: " + FormatHistogram(stats.unwinding_time_us());
 }
 
@@ -22,6 +22,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <thread>
+
 #include "perfetto/base/file_utils.h"
 #include "perfetto/base/string_utils.h"
 #include "perfetto/base/thread_task_runner.h"
@@ -36,7 +39,7 @@ namespace {
 using ::perfetto::protos::pbzero::ProfilePacket;
 
 constexpr char kHeapprofdDataSource[] = "android.heapprofd";
-constexpr size_t kUnwinderThreads = 5;
+constexpr size_t kMaxUnwinderThreads = 16;
 constexpr int kHeapprofdSignal = 36;
 
 constexpr uint32_t kInitialConnectionBackoffMs = 100;
@@ -51,13 +54,12 @@ ClientConfiguration MakeClientConfiguration(const DataSourceConfig& cfg) {
   return client_config;
 }
 
-std::vector<UnwindingWorker> MakeUnwindingWorkers(HeapprofdProducer* delegate,
-                                                  size_t n) {
-  std::vector<UnwindingWorker> ret;
-  for (size_t i = 0; i < n; ++i) {
-    ret.emplace_back(delegate, base::ThreadTaskRunner::CreateAndStart());
-  }
-  return ret;
+// One unwinding thread per core, as unwinding is CPU bound.
+size_t NumUnwinderThreads() {
+  size_t cores = std::thread::hardware_concurrency();
+  if (cores == 0)
+    return 1;
+  return std::min(cores, kMaxUnwinderThreads);
 }
 
 // Return largest n such that pow(2, n) < value.
@@ -96,14 +98,14 @@ size_t LogHistogram::GetBucket(uint64_t value) {
   return hibit;
 }
 
-// We create kUnwinderThreads unwinding threads. Bookkeeping is done on the main
-// thread.
+// We create one unwinding thread per core, up to kMaxUnwinderThreads.
+// Bookkeeping is done on the main thread.
 // TODO(fmayer): Summarize threading document here.
 HeapprofdProducer::HeapprofdProducer(HeapprofdMode mode,
                                      base::TaskRunner* task_runner)
     : mode_(mode),
       task_runner_(task_runner),
-      unwinding_workers_(MakeUnwindingWorkers(this, kUnwinderThreads)),
+      unwinding_workers_(this, NumUnwinderThreads()),
       socket_delegate_(this),
       weak_factory_(this) {
   if (mode == HeapprofdMode::kCentral) {
@@ -376,8 +378,11 @@ bool HeapprofdProducer::Dump(DataSourceInstanceID id,
   }
   DataSource& data_source = it->second;
 
+  const bool incremental =
+      data_source.config.continuous_dump_config().incremental();
   DumpState dump_state(data_source.trace_writer.get(),
-                       &data_source.next_index_);
+                       &data_source.next_index_,
+                       incremental ? &data_source.dumped_ids : nullptr);
 
   for (pid_t rejected_pid : data_source.rejected_pids) {
     ProfilePacket::ProcessHeapSamples* proto =
@@ -386,6 +391,16 @@ bool HeapprofdProducer::Dump(DataSourceInstanceID id,
     proto->set_rejected_concurrent(true);
   }
 
+  for (const UnwindingWorker::Stats& worker_stats :
+       unwinding_workers_.GetStats()) {
+    ProfilePacket::UnwinderStats* proto =
+        dump_state.current_profile_packet->add_unwinder_stats();
+    proto->set_busy_time_us(worker_stats.busy_time_us);
+    proto->set_wall_time_us(worker_stats.wall_time_us);
+    proto->set_buffers_handled(worker_stats.buffers_handled);
+    proto->set_stolen_drains(worker_stats.stolen_drains);
+  }
+
   for (std::pair<const pid_t, ProcessState>& pid_and_process_state :
        data_source.process_states) {
     pid_t pid = pid_and_process_state.first;
@@ -402,6 +417,8 @@ bool HeapprofdProducer::Dump(DataSourceInstanceID id,
       stats->set_unwinding_errors(process_state.unwinding_errors);
       stats->set_heap_samples(process_state.heap_samples);
       stats->set_map_reparses(process_state.map_reparses);
+      stats->set_buffer_overflows(process_state.buffer_overflows);
+      stats->set_unwinding_cache_hits(process_state.unwinding_cache_hits);
       auto* unwinding_hist = stats->set_unwinding_time_us();
       for (const auto& p : process_state.unwinding_time_us.GetData()) {
         auto* bucket = unwinding_hist->add_buckets();
@@ -416,6 +433,8 @@ bool HeapprofdProducer::Dump(DataSourceInstanceID id,
   }
 
   for (GlobalCallstackTrie::Node* node : dump_state.callstacks_to_dump) {
+    if (!dump_state.dumped_ids->callstacks.emplace(node->id()).second)
+      continue;
     // There need to be two separate loops over built_callstack because
     // protozero cannot interleave different messages.
     auto built_callstack = callsites_.BuildCallstack(node);
@@ -573,7 +592,7 @@ void HeapprofdProducer::SocketDelegate::OnNewIncomingConnection(
 }
 
 UnwindingWorker& HeapprofdProducer::UnwinderForPID(pid_t pid) {
-  return unwinding_workers_[static_cast<uint64_t>(pid) % kUnwinderThreads];
+  return unwinding_workers_.WorkerForPID(pid);
 }
 
 void HeapprofdProducer::SocketDelegate::OnDataAvailable(
@@ -734,6 +753,16 @@ void HeapprofdProducer::PostSocketDisconnected(DataSourceInstanceID ds_id,
   });
 }
 
+void HeapprofdProducer::PostBufferOverflows(DataSourceInstanceID ds_id,
+                                            pid_t pid,
+                                            uint64_t num_writes_overflow) {
+  auto weak_this = weak_factory_.GetWeakPtr();
+  task_runner_->PostTask([weak_this, ds_id, pid, num_writes_overflow] {
+    if (weak_this)
+      weak_this->HandleBufferOverflows(ds_id, pid, num_writes_overflow);
+  });
+}
+
 void HeapprofdProducer::HandleAllocRecord(AllocRecord alloc_rec) {
   const AllocMetadata& alloc_metadata = alloc_rec.alloc_metadata;
   auto it = data_sources_.find(alloc_rec.data_source_instance_id);
@@ -769,6 +798,8 @@ void HeapprofdProducer::HandleAllocRecord(AllocRecord alloc_rec) {
     process_state.unwinding_errors++;
   if (alloc_rec.reparsed_map)
     process_state.map_reparses++;
+  if (alloc_rec.unwinding_cache_hit)
+    process_state.unwinding_cache_hits++;
   process_state.heap_samples++;
   process_state.unwinding_time_us.Add(alloc_rec.unwinding_time_us);
 
@@ -825,5 +856,19 @@ void HeapprofdProducer::HandleSocketDisconnected(DataSourceInstanceID id,
   // after the process disconnected.
 }
 
+void HeapprofdProducer::HandleBufferOverflows(DataSourceInstanceID id,
+                                              pid_t pid,
+                                              uint64_t num_writes_overflow) {
+  auto it = data_sources_.find(id);
+  if (it == data_sources_.end())
+    return;
+  DataSource& ds = it->second;
+
+  auto process_state_it = ds.process_states.find(pid);
+  if (process_state_it == ds.process_states.end())
+    return;
+  process_state_it->second.buffer_overflows = num_writes_overflow;
+}
+
 }  // namespace profiling
 }  // namespace perfetto
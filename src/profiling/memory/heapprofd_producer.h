@@ -106,10 +106,16 @@ class HeapprofdProducer : public Producer, public UnwindingWorker::Delegate {
   void PostAllocRecord(AllocRecord) override;
   void PostFreeRecord(FreeRecord) override;
   void PostSocketDisconnected(DataSourceInstanceID, pid_t) override;
+  void PostBufferOverflows(DataSourceInstanceID,
+                           pid_t,
+                           uint64_t num_writes_overflow) override;
 
   void HandleAllocRecord(AllocRecord);
   void HandleFreeRecord(FreeRecord);
   void HandleSocketDisconnected(DataSourceInstanceID, pid_t);
+  void HandleBufferOverflows(DataSourceInstanceID,
+                             pid_t,
+                             uint64_t num_writes_overflow);
 
   // Valid only if mode_ == kChild.
   void SetTargetProcess(pid_t target_pid,
@@ -162,6 +168,8 @@ class HeapprofdProducer : public Producer, public UnwindingWorker::Delegate {
     uint64_t heap_samples = 0;
     uint64_t map_reparses = 0;
     uint64_t unwinding_errors = 0;
+    uint64_t buffer_overflows = 0;
+    uint64_t unwinding_cache_hits = 0;
 
     LogHistogram unwinding_time_us;
     HeapTracker heap_tracker;
@@ -177,6 +185,9 @@ class HeapprofdProducer : public Producer, public UnwindingWorker::Delegate {
     std::set<pid_t> rejected_pids;
     std::map<pid_t, ProcessState> process_states;
     uint64_t next_index_ = 0;
+    // Interned data and callstacks written by the previous dumps, if
+    // incremental dumps are enabled.
+    DumpedIds dumped_ids;
   };
 
   struct PendingProcess {
@@ -200,7 +211,7 @@ class HeapprofdProducer : public Producer, public UnwindingWorker::Delegate {
   std::unique_ptr<TracingService::ProducerEndpoint> endpoint_;
 
   GlobalCallstackTrie callsites_;
-  std::vector<UnwindingWorker> unwinding_workers_;
+  UnwindingWorkerPool unwinding_workers_;
 
   // state specific to mode_ == kCentral
   std::unique_ptr<base::UnixSocket> listening_socket_;
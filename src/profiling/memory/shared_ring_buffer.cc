@@ -21,6 +21,7 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -28,7 +29,6 @@
 #include "perfetto/base/build_config.h"
 #include "perfetto/base/scoped_file.h"
 #include "perfetto/base/temp_file.h"
-#include "src/profiling/memory/scoped_spinlock.h"
 
 #if PERFETTO_BUILDFLAG(PERFETTO_OS_ANDROID)
 #include <linux/memfd.h>
@@ -160,39 +160,47 @@ void SharedRingBuffer::Initialize(base::ScopedFile mem_fd) {
   mem_fd_ = std::move(mem_fd);
 }
 
-SharedRingBuffer::Buffer SharedRingBuffer::BeginWrite(
-    const ScopedSpinlock& spinlock,
-    size_t size) {
-  PERFETTO_DCHECK(spinlock.locked());
+SharedRingBuffer::Buffer SharedRingBuffer::BeginWrite(size_t size) {
   Buffer result;
 
-  base::Optional<PointerPositions> opt_pos = GetPointerPositions(spinlock);
-  if (!opt_pos) {
-    meta_->stats.num_writes_corrupt++;
-    errno = EBADF;
-    return result;
-  }
-  auto pos = opt_pos.value();
-
   const uint64_t size_with_header =
       base::AlignUp<kAlignment>(size + kHeaderSize);
-  if (size_with_header > write_avail(pos)) {
-    meta_->stats.num_writes_overflow++;
-    errno = EAGAIN;
-    return result;
+  PointerPositions pos;
+  for (;;) {
+    base::Optional<PointerPositions> opt_pos = GetPointerPositions();
+    if (!opt_pos) {
+      meta_->num_writes_corrupt.fetch_add(1, std::memory_order_relaxed);
+      errno = EBADF;
+      return result;
+    }
+    pos = opt_pos.value();
+
+    if (size_with_header > write_avail(pos)) {
+      meta_->num_writes_overflow.fetch_add(1, std::memory_order_relaxed);
+      errno = EAGAIN;
+      return result;
+    }
+
+    // A compare-and-swap rather than a fetch-add, so a write that does not
+    // fit never moves write_pos past the reader.
+    if (meta_->write_pos.compare_exchange_weak(
+            pos.write_pos, pos.write_pos + size_with_header,
+            std::memory_order_acq_rel, std::memory_order_relaxed)) {
+      break;
+    }
+    meta_->num_write_retries.fetch_add(1, std::memory_order_relaxed);
   }
 
   uint8_t* wr_ptr = at(pos.write_pos);
 
   result.size = size;
   result.data = wr_ptr + kHeaderSize;
-  meta_->write_pos += size_with_header;
-  meta_->stats.bytes_written += size;
-  meta_->stats.num_writes_succeeded++;
-  // By making this a release store, we can save grabbing the spinlock in
-  // EndWrite.
+  meta_->bytes_written.fetch_add(size, std::memory_order_relaxed);
+  meta_->num_writes_succeeded.fetch_add(1, std::memory_order_relaxed);
+  // The reader zeroes the records it consumes, so this is only needed if the
+  // other end scribbled over the buffer.
   reinterpret_cast<std::atomic<uint32_t>*>(wr_ptr)->store(
-      0, std::memory_order_release);
+      0, std::memory_order_relaxed);
   return result;
 }
 
@@ -206,33 +214,34 @@ void SharedRingBuffer::EndWrite(Buffer buf) {
 }
 
 SharedRingBuffer::Buffer SharedRingBuffer::BeginRead() {
-  ScopedSpinlock spinlock(&meta_->spinlock, ScopedSpinlock::Mode::Blocking);
-
-  base::Optional<PointerPositions> opt_pos = GetPointerPositions(spinlock);
-  if (!opt_pos) {
-    meta_->stats.num_reads_corrupt++;
+  // Only the reader advances read_pos, so it cannot change under our feet.
+  const uint64_t read_pos = meta_->read_pos.load(std::memory_order_relaxed);
+  if (read_pos % kAlignment) {
+    meta_->num_reads_corrupt++;
     errno = EBADF;
     return Buffer();
   }
-  auto pos = opt_pos.value();
-
-  size_t avail_read = read_avail(pos);
 
-  if (avail_read < kHeaderSize) {
-    meta_->stats.num_reads_nodata++;
-    errno = EAGAIN;
-    return Buffer();  // No data
-  }
-
-  uint8_t* rd_ptr = at(pos.read_pos);
-  PERFETTO_DCHECK(reinterpret_cast<uintptr_t>(rd_ptr) % kAlignment == 0);
+  uint8_t* rd_ptr = at(read_pos);
   const size_t size = reinterpret_cast<std::atomic<uint32_t>*>(rd_ptr)->load(
       std::memory_order_acquire);
   if (size == 0) {
-    meta_->stats.num_reads_nodata++;
+    meta_->num_reads_nodata++;
     errno = EAGAIN;
     return Buffer();
   }
+
+  // Only load write_pos after the header: the record was reserved before it
+  // was committed, so it must now be within [read_pos, write_pos).
+  base::Optional<PointerPositions> opt_pos = GetPointerPositions();
+  if (!opt_pos) {
+    meta_->num_reads_corrupt++;
+    errno = EBADF;
+    return Buffer();
+  }
+  auto pos = opt_pos.value();
+
+  size_t avail_read = read_avail(pos);
   const size_t size_with_header = base::AlignUp<kAlignment>(size + kHeaderSize);
 
   if (size_with_header > avail_read) {
@@ -240,7 +249,7 @@ SharedRingBuffer::Buffer SharedRingBuffer::BeginRead() {
         "Corrupted header detected, size=%zu"
         ", read_avail=%zu, rd=%" PRIu64 ", wr=%" PRIu64,
         size, avail_read, pos.read_pos, pos.write_pos);
-    meta_->stats.num_reads_corrupt++;
+    meta_->num_reads_corrupt++;
     errno = EBADF;
     return Buffer();
   }
@@ -253,10 +262,29 @@ SharedRingBuffer::Buffer SharedRingBuffer::BeginRead() {
 void SharedRingBuffer::EndRead(Buffer buf) {
   if (!buf)
     return;
-  ScopedSpinlock spinlock(&meta_->spinlock, ScopedSpinlock::Mode::Blocking);
   size_t size_with_header = base::AlignUp<kAlignment>(buf.size + kHeaderSize);
-  meta_->read_pos += size_with_header;
-  meta_->stats.num_reads_succeeded++;
+  // Writers reserve space at arbitrary record boundaries, so the whole record
+  // needs to be zeroed for a stale payload not to look like a committed header.
+  memset(buf.data - kHeaderSize, 0, size_with_header);
+  meta_->read_pos.fetch_add(size_with_header, std::memory_order_release);
+  meta_->num_reads_succeeded++;
+}
+
+SharedRingBuffer::Stats SharedRingBuffer::GetStats() {
+  Stats stats;
+  stats.bytes_written = meta_->bytes_written.load(std::memory_order_relaxed);
+  stats.num_writes_succeeded =
+      meta_->num_writes_succeeded.load(std::memory_order_relaxed);
+  stats.num_writes_corrupt =
+      meta_->num_writes_corrupt.load(std::memory_order_relaxed);
+  stats.num_writes_overflow =
+      meta_->num_writes_overflow.load(std::memory_order_relaxed);
+  stats.num_write_retries =
+      meta_->num_write_retries.load(std::memory_order_relaxed);
+  stats.num_reads_succeeded = meta_->num_reads_succeeded;
+  stats.num_reads_corrupt = meta_->num_reads_corrupt;
+  stats.num_reads_nodata = meta_->num_reads_nodata;
+  return stats;
 }
 
 bool SharedRingBuffer::IsCorrupt(const PointerPositions& pos) {
@@ -20,7 +20,6 @@
 #include "perfetto/base/optional.h"
 #include "perfetto/base/unix_socket.h"
 #include "perfetto/base/utils.h"
-#include "src/profiling/memory/scoped_spinlock.h"
 
 #include <atomic>
 #include <map>
@@ -41,16 +40,18 @@ namespace profiling {
 // - Reads are atomic, no fragmentation.
 // - The reader sees writes in write order (% discarding).
 //
+// Writers do not take a lock. BeginWrite reserves space by advancing write_pos
+// with a compare-and-swap, and EndWrite commits the record by storing its size
+// in its header. Until then the header is zero and the reader stops at it, so
+// records are still read in reservation order. The reader zeroes the records
+// it consumed before giving the space back to the writers.
+//
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 // *IMPORTANT*: The ring buffer must be written under the assumption that the
-// other end modifies arbitrary shared memory without holding the spin-lock.
-// This means we must make local copies of read and write pointers for doing
-// bounds checks followed by reads / writes, as they might change in the
-// meantime.
+// other end modifies arbitrary shared memory at any time. This means we must
+// make local copies of read and write pointers for doing bounds checks
+// followed by reads / writes, as they might change in the meantime.
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-//
-// TODO:
-// - Write a benchmark.
 class SharedRingBuffer {
  public:
   class Buffer {
@@ -75,13 +76,13 @@ class SharedRingBuffer {
     uint64_t num_writes_succeeded;
     uint64_t num_writes_corrupt;
     uint64_t num_writes_overflow;
+    // Number of times a writer had to retry its reservation because another
+    // writer reserved space concurrently.
+    uint64_t num_write_retries;
 
     uint64_t num_reads_succeeded;
     uint64_t num_reads_corrupt;
     uint64_t num_reads_nodata;
-
-    // Fields below get set by GetStats as copies of atomics in MetadataPage.
-    uint64_t failed_spinlocks;
   };
 
   static base::Optional<SharedRingBuffer> Create(size_t);
@@ -97,38 +98,35 @@ class SharedRingBuffer {
   size_t size() const { return size_; }
   int fd() const { return *mem_fd_; }
 
-  Buffer BeginWrite(const ScopedSpinlock& spinlock, size_t size);
+  // Safe to call concurrently from multiple threads.
+  Buffer BeginWrite(size_t size);
   void EndWrite(Buffer buf);
 
+  // Must only be called by a single reader.
   Buffer BeginRead();
   void EndRead(Buffer);
 
-  Stats GetStats(ScopedSpinlock& spinlock) {
-    PERFETTO_DCHECK(spinlock.locked());
-    Stats stats = meta_->stats;
-    stats.failed_spinlocks =
-        meta_->failed_spinlocks.load(std::memory_order_relaxed);
-    return stats;
-  }
-
-  // This is used by the caller to be able to hold the SpinLock after
-  // BeginWrite has returned. This is so that additional bookkeeping can be
-  // done under the lock. This will be used to increment the sequence_number.
-  ScopedSpinlock AcquireLock(ScopedSpinlock::Mode mode) {
-    auto lock = ScopedSpinlock(&meta_->spinlock, mode);
-    if (PERFETTO_UNLIKELY(!lock.locked()))
-      meta_->failed_spinlocks.fetch_add(1, std::memory_order_relaxed);
-    return lock;
-  }
+  Stats GetStats();
 
  private:
-  struct alignas(base::kPageSize) MetadataPage {
-    alignas(uint64_t) std::atomic<bool> spinlock;
-    uint64_t read_pos;
-    uint64_t write_pos;
+  static constexpr size_t kCacheLineSize = 64;
 
-    std::atomic<uint64_t> failed_spinlocks;
-    Stats stats;
+  struct alignas(base::kPageSize) MetadataPage {
+    // Only advanced by the reader.
+    std::atomic<uint64_t> read_pos;
+    // Advanced by all the writers, so it gets its own cache line.
+    alignas(kCacheLineSize) std::atomic<uint64_t> write_pos;
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> bytes_written;
+    std::atomic<uint64_t> num_writes_succeeded;
+    std::atomic<uint64_t> num_writes_corrupt;
+    std::atomic<uint64_t> num_writes_overflow;
+    std::atomic<uint64_t> num_write_retries;
+
+    // Only written by the reader.
+    uint64_t num_reads_succeeded;
+    uint64_t num_reads_corrupt;
+    uint64_t num_reads_nodata;
   };
 
   struct PointerPositions {
@@ -148,13 +146,21 @@ class SharedRingBuffer {
   void Initialize(base::ScopedFile mem_fd);
   bool IsCorrupt(const PointerPositions& pos);
 
-  inline base::Optional<PointerPositions> GetPointerPositions(
-      const ScopedSpinlock& lock) {
-    PERFETTO_DCHECK(lock.locked());
-
+  inline base::Optional<PointerPositions> GetPointerPositions() {
     PointerPositions pos;
-    pos.read_pos = meta_->read_pos;
-    pos.write_pos = meta_->write_pos;
+    // The acquire loads pair with the release stores of the reader and of the
+    // other writers. The writers need to observe the zeroing of the consumed
+    // records before reusing their space.
+    // Both positions move concurrently, so only a read_pos loaded while
+    // write_pos stayed the same is guaranteed to be consistent with it.
+    pos.write_pos = meta_->write_pos.load(std::memory_order_acquire);
+    for (;;) {
+      pos.read_pos = meta_->read_pos.load(std::memory_order_acquire);
+      uint64_t write_pos = meta_->write_pos.load(std::memory_order_acquire);
+      if (write_pos == pos.write_pos)
+        break;
+      pos.write_pos = write_pos;
+    }
 
     base::Optional<PointerPositions> result;
     if (IsCorrupt(pos))
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "benchmark/benchmark.h"
+
+#include "perfetto/base/logging.h"
+#include "perfetto/base/optional.h"
+#include "src/profiling/memory/shared_ring_buffer.h"
+
+namespace {
+
+using perfetto::base::Optional;
+using perfetto::base::ScopedFile;
+using perfetto::profiling::SharedRingBuffer;
+
+constexpr size_t kBufferSize = 8 * 1024 * 1024;
+constexpr size_t kRecordSize = 256;
+
+// Shared by all the benchmark threads. Set up and torn down by thread 0, the
+// benchmark library synchronizes the threads around the timed loop.
+Optional<SharedRingBuffer> g_reader_buf;
+std::thread* g_reader_thread;
+std::atomic<bool> g_reader_done;
+
+void ReaderMain(SharedRingBuffer* buf) {
+  while (!g_reader_done.load(std::memory_order_relaxed)) {
+    SharedRingBuffer::Buffer rd = buf->BeginRead();
+    if (!rd) {
+      std::this_thread::yield();
+      continue;
+    }
+    benchmark::DoNotOptimize(rd.data[0]);
+    buf->EndRead(std::move(rd));
+  }
+}
+
+// Each benchmark thread attaches to the same ring buffer and writes one record
+// per iteration, while a separate thread drains it, like the threads of a
+// profiled process sending samples to heapprofd.
+void BM_SharedRingBuffer_Contention(benchmark::State& state) {
+  if (state.thread_index == 0) {
+    g_reader_buf = SharedRingBuffer::Create(kBufferSize);
+    PERFETTO_CHECK(g_reader_buf);
+    g_reader_done.store(false);
+    g_reader_thread = new std::thread(ReaderMain, &*g_reader_buf);
+  }
+
+  Optional<SharedRingBuffer> wr;
+  uint8_t record[kRecordSize] = {};
+  for (auto _ : state) {
+    // The buffer only exists once all threads reached the loop.
+    if (!wr) {
+      wr = SharedRingBuffer::Attach(ScopedFile(dup(g_reader_buf->fd())));
+      PERFETTO_CHECK(wr);
+    }
+    SharedRingBuffer::Buffer buf = wr->BeginWrite(sizeof(record));
+    if (buf)
+      memcpy(buf.data, record, sizeof(record));
+    wr->EndWrite(std::move(buf));
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(kRecordSize));
+
+  if (state.thread_index == 0) {
+    g_reader_done.store(true);
+    g_reader_thread->join();
+    delete g_reader_thread;
+    SharedRingBuffer::Stats stats = g_reader_buf->GetStats();
+    state.counters["overflows"] = stats.num_writes_overflow;
+    state.counters["retries"] = stats.num_write_retries;
+    g_reader_buf = perfetto::base::nullopt;
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_SharedRingBuffer_Contention)->ThreadRange(1, 32)->UseRealTime();
@@ -16,6 +16,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "perfetto/base/file_utils.h"
 #include "perfetto/base/temp_file.h"
@@ -25,10 +26,10 @@ namespace perfetto {
 namespace profiling {
 namespace {
 
+// Mirrors the beginning of SharedRingBuffer::MetadataPage.
 struct MetadataHeader {
-  alignas(uint64_t) std::atomic<bool> spinlock;
   uint64_t read_pos;
-  uint64_t write_pos;
+  alignas(64) uint64_t write_pos;
 };
 
 size_t RoundToPow2(size_t v) {
@@ -65,11 +66,8 @@ int FuzzRingBuffer(const uint8_t* data, size_t size) {
   // for the metadata.
   size_t total_size_pages = 1 + RoundToPow2(payload_size_pages);
 
-  // Clear spinlock field, as otherwise the read will wait indefinitely (it
-  // defaults to indefinite blocking mode).
   MetadataHeader header = {};
   memcpy(&header, data, sizeof(header));
-  header.spinlock = 0;
 
   PERFETTO_CHECK(ftruncate(*fd, static_cast<off_t>(total_size_pages *
                                                    base::kPageSize)) == 0);
@@ -92,6 +90,28 @@ int FuzzRingBuffer(const uint8_t* data, size_t size) {
     }
     buf->EndRead(std::move(read_buf));
   } while (did_read);
+
+  // Then write into whatever state the reads left behind, using the payload
+  // bytes as record sizes. Writes must either fit in the buffer or fail.
+  // Empty records are never committed, so they are skipped.
+  for (size_t i = 0; i < payload_size; i++) {
+    size_t write_size = static_cast<size_t>(payload[i]) << (i % 8);
+    if (write_size == 0)
+      continue;
+    auto write_buf = buf->BeginWrite(write_size);
+    if (write_buf) {
+      PERFETTO_CHECK(write_buf.size == write_size);
+      memset(write_buf.data, payload[i], write_buf.size);
+    }
+    buf->EndWrite(std::move(write_buf));
+  }
+
+  // And read back what was written.
+  do {
+    auto read_buf = buf->BeginRead();
+    did_read = bool(read_buf);
+    buf->EndRead(std::move(read_buf));
+  } while (did_read);
   return 0;
 }
 
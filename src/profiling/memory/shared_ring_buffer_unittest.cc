@@ -16,11 +16,13 @@
 
 #include "src/profiling/memory/shared_ring_buffer.h"
 
+#include <algorithm>
 #include <array>
 #include <mutex>
 #include <random>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "perfetto/base/optional.h"
@@ -35,13 +37,7 @@ std::string ToString(const SharedRingBuffer::Buffer& buf_and_size) {
 }
 
 bool TryWrite(SharedRingBuffer* wr, const char* src, size_t size) {
-  SharedRingBuffer::Buffer buf;
-  {
-    auto lock = wr->AcquireLock(ScopedSpinlock::Mode::Try);
-    if (!lock.locked())
-      return false;
-    buf = wr->BeginWrite(lock, size);
-  }
+  SharedRingBuffer::Buffer buf = wr->BeginWrite(size);
   if (!buf)
     return false;
   memcpy(buf.data, src, size);
@@ -162,11 +158,7 @@ TEST(SharedRingBufferTest, WriteShutdown) {
   ASSERT_TRUE(rd);
   SharedRingBuffer wr =
       *SharedRingBuffer::Attach(base::ScopedFile(dup(rd->fd())));
-  SharedRingBuffer::Buffer buf;
-  {
-    auto lock = wr.AcquireLock(ScopedSpinlock::Mode::Blocking);
-    buf = wr.BeginWrite(lock, 10);
-  }
+  SharedRingBuffer::Buffer buf = wr.BeginWrite(10);
   rd = base::nullopt;
   memset(buf.data, 0, buf.size);
   wr.EndWrite(std::move(buf));
@@ -255,6 +247,52 @@ TEST(SharedRingBufferTest, MultiThreadingTest) {
   reader_thread.join();
 }
 
+TEST(SharedRingBufferTest, ConcurrentWritersStats) {
+  constexpr auto kBufSize = base::kPageSize * 64;
+  constexpr size_t kNumWriterThreads = 8;
+  constexpr uint64_t kWritesPerThread = 1000;
+  SharedRingBuffer rd = *SharedRingBuffer::Create(kBufSize);
+  SharedRingBuffer wr =
+      *SharedRingBuffer::Attach(base::ScopedFile(dup(rd.fd())));
+
+  // All the writes fit in the buffer, so none of them may be dropped.
+  std::array<std::thread, kNumWriterThreads> writer_threads;
+  for (size_t i = 0; i < kNumWriterThreads; i++) {
+    writer_threads[i] = std::thread([&wr, i] {
+      for (uint64_t j = 0; j < kWritesPerThread; j++) {
+        uint64_t value = i * kWritesPerThread + j;
+        ASSERT_TRUE(TryWrite(&wr, reinterpret_cast<const char*>(&value),
+                             sizeof(value)));
+      }
+    });
+  }
+  for (size_t i = 0; i < kNumWriterThreads; i++)
+    writer_threads[i].join();
+
+  std::vector<bool> seen(kNumWriterThreads * kWritesPerThread);
+  for (;;) {
+    auto buf = rd.BeginRead();
+    if (!buf)
+      break;
+    ASSERT_EQ(buf.size, sizeof(uint64_t));
+    uint64_t value;
+    memcpy(&value, buf.data, sizeof(value));
+    ASSERT_LT(value, seen.size());
+    ASSERT_FALSE(seen[value]);
+    seen[value] = true;
+    rd.EndRead(std::move(buf));
+  }
+  EXPECT_EQ(std::count(seen.begin(), seen.end(), true),
+            static_cast<ptrdiff_t>(seen.size()));
+
+  SharedRingBuffer::Stats stats = wr.GetStats();
+  EXPECT_EQ(stats.num_writes_succeeded, kNumWriterThreads * kWritesPerThread);
+  EXPECT_EQ(stats.bytes_written,
+            kNumWriterThreads * kWritesPerThread * sizeof(uint64_t));
+  EXPECT_EQ(stats.num_writes_overflow, 0u);
+  EXPECT_EQ(stats.num_reads_succeeded, kNumWriterThreads * kWritesPerThread);
+}
+
 }  // namespace
 }  // namespace profiling
 }  // namespace perfetto
@@ -45,6 +45,7 @@
 #include <procinfo/process_map.h>
 
 #include "perfetto/base/file_utils.h"
+#include "perfetto/base/hash.h"
 #include "perfetto/base/logging.h"
 #include "perfetto/base/scoped_file.h"
 #include "perfetto/base/string_utils.h"
@@ -58,6 +59,10 @@ namespace {
 
 size_t kMaxFrames = 1000;
 
+// Bounds the time a worker spends on a single client before giving the other
+// clients, and the events of the sockets it owns, a chance to run.
+constexpr size_t kMaxBuffersPerDrain = 64;
+
 #pragma GCC diagnostic push
 // We do not care about deterministic destructor order.
 #pragma GCC diagnostic ignored "-Wglobal-constructors"
@@ -111,6 +116,42 @@ ssize_t ReadAtOffsetClobberSeekPos(int fd,
 #endif
 }
 
+// Size of the register data of |arch| in AllocMetadata::register_data. The rest
+// of the array is not initialized by the client.
+size_t RegisterDataSize(unwindstack::ArchEnum arch) {
+  switch (arch) {
+    case unwindstack::ARCH_X86:
+      return sizeof(unwindstack::x86_user_regs);
+    case unwindstack::ARCH_X86_64:
+      return sizeof(unwindstack::x86_64_user_regs);
+    case unwindstack::ARCH_ARM:
+      return sizeof(unwindstack::arm_user_regs);
+    case unwindstack::ARCH_ARM64:
+      return sizeof(unwindstack::arm64_user_regs);
+    case unwindstack::ARCH_MIPS:
+      return sizeof(unwindstack::mips_user_regs);
+    case unwindstack::ARCH_MIPS64:
+      return sizeof(unwindstack::mips64_user_regs);
+    case unwindstack::ARCH_UNKNOWN:
+      return 0;
+  }
+  return 0;
+}
+
+// The frames only depend on the registers, the stack (and where it is) and
+// the maps. The maps are covered by clearing the cache in ReparseMaps.
+uint64_t UnwindingCacheKey(const AllocMetadata& alloc_metadata,
+                           const char* stack,
+                           size_t stack_size) {
+  base::Hash hash;
+  hash.Update(static_cast<uint64_t>(alloc_metadata.arch));
+  hash.Update(alloc_metadata.register_data,
+              RegisterDataSize(alloc_metadata.arch));
+  hash.Update(alloc_metadata.stack_pointer);
+  hash.Update(stack, stack_size);
+  return hash.digest();
+}
+
 }  // namespace
 
 StackOverlayMemory::StackOverlayMemory(std::shared_ptr<unwindstack::Memory> mem,
@@ -192,6 +233,31 @@ void UnwindingMetadata::ReparseMaps() {
   maps->Reset();
   maps->Parse();
   unwinder = unwindstack::Unwinder(kMaxFrames, maps.get(), fd_mem);
+  unwinding_cache.Clear();
+}
+
+const std::vector<FrameData>* UnwindingCache::Find(uint64_t key) {
+  std::list<Entry>::iterator* it = index_.Find(key);
+  if (!it)
+    return nullptr;
+  entries_.splice(entries_.begin(), entries_, *it);
+  return &(*it)->frames;
+}
+
+void UnwindingCache::Insert(uint64_t key, std::vector<FrameData> frames) {
+  if (capacity_ == 0 || index_.Find(key))
+    return;
+  if (entries_.size() == capacity_) {
+    index_.Erase(entries_.back().key);
+    entries_.pop_back();
+  }
+  entries_.push_front({key, std::move(frames)});
+  index_.Insert(key, entries_.begin());
+}
+
+void UnwindingCache::Clear() {
+  index_.Clear();
+  entries_.clear();
 }
 
 bool DoUnwind(WireMessage* msg, UnwindingMetadata* metadata, AllocRecord* out) {
@@ -208,6 +274,16 @@ bool DoUnwind(WireMessage* msg, UnwindingMetadata* metadata, AllocRecord* out) {
     out->error = true;
     return false;
   }
+  uint64_t cache_key =
+      UnwindingCacheKey(*alloc_metadata, msg->payload, msg->payload_size);
+  const std::vector<FrameData>* cached_frames =
+      metadata->unwinding_cache.Find(cache_key);
+  if (cached_frames) {
+    out->frames = *cached_frames;
+    out->unwinding_cache_hit = true;
+    return true;
+  }
+
   uint8_t* stack = reinterpret_cast<uint8_t*>(msg->payload);
   metadata->fd_mem->SetStack(alloc_metadata->stack_pointer, stack,
                              msg->payload_size);
@@ -249,24 +325,26 @@ bool DoUnwind(WireMessage* msg, UnwindingMetadata* metadata, AllocRecord* out) {
 
     out->frames.emplace_back(frame_data, "");
     out->error = true;
+  } else {
+    // Failed unwinds are not cached, as they might be caused by maps that
+    // are out of date and succeed once the maps are parsed again.
+    metadata->unwinding_cache.Insert(cache_key, out->frames);
   }
   return true;
 }
 
 void UnwindingWorker::OnDisconnect(base::UnixSocket* self) {
-  // TODO(fmayer): Maybe try to drain shmem one last time.
-  auto it = client_data_.find(self->peer_pid());
+  pid_t peer_pid = self->peer_pid();
+  auto it = client_data_.find(peer_pid);
   if (it == client_data_.end()) {
     PERFETTO_DFATAL("Disconnected unexpecter socket.");
     return;
   }
-  ClientData& client_data = it->second;
-  DataSourceInstanceID ds_id = client_data.data_source_instance_id;
-  pid_t peer_pid = self->peer_pid();
-  client_data_.erase(it);
-  // The erase invalidates the self pointer.
-  self = nullptr;
-  delegate_->PostSocketDisconnected(ds_id, peer_pid);
+  // If a drain of the client is queued or running, it is finished before the
+  // delegate is notified, so that the delegate gets all the records first.
+  // TODO(fmayer): Maybe try to drain shmem one last time otherwise.
+  if (pool_->MarkDisconnected(&it->second, /*notify_delegate=*/true))
+    FinishDisconnect(peer_pid);
 }
 
 void UnwindingWorker::OnDataAvailable(base::UnixSocket* self) {
@@ -279,22 +357,66 @@ void UnwindingWorker::OnDataAvailable(base::UnixSocket* self) {
     PERFETTO_DFATAL("Unexpected data.");
     return;
   }
+  pool_->ScheduleDrain(&it->second);
+}
 
-  ClientData& client_data = it->second;
-  SharedRingBuffer& shmem = client_data.shmem;
-  SharedRingBuffer::Buffer buf;
-
-  for (;;) {
-    // TODO(fmayer): Allow spinlock acquisition to fail and repost Task if it
-    // did.
-    buf = shmem.BeginRead();
+size_t UnwindingWorker::DrainClient(ClientData* client) {
+  SharedRingBuffer& shmem = client->shmem;
+  size_t buffers_handled = 0;
+  while (buffers_handled < kMaxBuffersPerDrain) {
+    SharedRingBuffer::Buffer buf = shmem.BeginRead();
     if (!buf)
       break;
-    HandleBuffer(buf, &client_data.metadata,
-                 client_data.data_source_instance_id,
-                 client_data.sock->peer_pid(), delegate_);
+    HandleBuffer(buf, &client->metadata, client->data_source_instance_id,
+                 client->metadata.pid, delegate_);
     shmem.EndRead(std::move(buf));
+    buffers_handled++;
+  }
+
+  uint64_t num_writes_overflow = shmem.GetStats().num_writes_overflow;
+  if (num_writes_overflow != client->reported_overflows) {
+    client->reported_overflows = num_writes_overflow;
+    delegate_->PostBufferOverflows(client->data_source_instance_id,
+                                   client->metadata.pid, num_writes_overflow);
   }
+  return buffers_handled;
+}
+
+void UnwindingWorker::DrainReadyClients() {
+  ClientData* client = pool_->BeginDrain(this);
+  if (!client)
+    return;
+  auto start_time_us = base::GetWallTimeNs() / 1000;
+  size_t buffers_handled = DrainClient(client);
+  uint64_t busy_time_us = static_cast<uint64_t>(
+      ((base::GetWallTimeNs() / 1000) - start_time_us).count());
+  pool_->EndDrain(this, client, buffers_handled, busy_time_us);
+  // Return to the task runner between two drains, so that the sockets owned
+  // by this worker are not starved by a busy client.
+  PostDrainReadyClients();
+}
+
+void UnwindingWorker::PostDrainReadyClients() {
+  // We do not need to use a WeakPtr here because the task runner will not
+  // outlive its UnwindingWorker.
+  thread_task_runner_.get()->PostTask([this] { DrainReadyClients(); });
+}
+
+void UnwindingWorker::PostFinishDisconnect(pid_t pid) {
+  // We do not need to use a WeakPtr here because the task runner will not
+  // outlive its UnwindingWorker.
+  thread_task_runner_.get()->PostTask([this, pid] { FinishDisconnect(pid); });
+}
+
+void UnwindingWorker::FinishDisconnect(pid_t pid) {
+  auto it = client_data_.find(pid);
+  if (it == client_data_.end())
+    return;
+  DataSourceInstanceID ds_id = it->second.data_source_instance_id;
+  bool notify_disconnect = it->second.notify_disconnect;
+  client_data_.erase(it);
+  if (notify_disconnect)
+    delegate_->PostSocketDisconnected(ds_id, pid);
 }
 
 // static
@@ -352,13 +474,26 @@ void UnwindingWorker::HandleHandoffSocket(HandoffData handoff_data) {
       handoff_data.sock.ReleaseFd(), this, this->thread_task_runner_.get(),
       base::SockType::kStream);
   pid_t peer_pid = sock->peer_pid();
+  if (client_data_.count(peer_pid)) {
+    PERFETTO_ELOG("%d: Previous connection is still being drained.", peer_pid);
+    return;
+  }
 
   UnwindingMetadata metadata(peer_pid,
                              std::move(handoff_data.fds[kHandshakeMaps]),
                              std::move(handoff_data.fds[kHandshakeMem]));
   ClientData client_data{
-      handoff_data.data_source_instance_id, std::move(sock),
-      std::move(metadata), std::move(handoff_data.shmem),
+      handoff_data.data_source_instance_id,
+      std::move(sock),
+      std::move(metadata),
+      std::move(handoff_data.shmem),
+      /*owner=*/this,
+      /*reported_overflows=*/0,
+      /*queued=*/false,
+      /*running=*/false,
+      /*data_pending=*/false,
+      /*disconnected=*/false,
+      /*notify_disconnect=*/false,
   };
   client_data_.emplace(peer_pid, std::move(client_data));
 }
@@ -371,10 +506,149 @@ void UnwindingWorker::PostDisconnectSocket(pid_t pid) {
 }
 
 void UnwindingWorker::HandleDisconnectSocket(pid_t pid) {
-  client_data_.erase(pid);
+  auto it = client_data_.find(pid);
+  if (it == client_data_.end())
+    return;
+  if (pool_->MarkDisconnected(&it->second, /*notify_delegate=*/false))
+    FinishDisconnect(pid);
 }
 
 UnwindingWorker::Delegate::~Delegate() = default;
 
+UnwindingWorkerPool::UnwindingWorkerPool(UnwindingWorker::Delegate* delegate,
+                                         size_t num_workers) {
+  PERFETTO_CHECK(num_workers > 0);
+  for (size_t i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(new UnwindingWorker(
+        delegate, this, base::ThreadTaskRunner::CreateAndStart()));
+  }
+}
+
+UnwindingWorkerPool::~UnwindingWorkerPool() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  shutting_down_ = true;
+  drains_done_.wait(lock, [this] { return running_drains_ == 0; });
+  lock.unlock();
+  // No drain can start anymore, so from now on each worker only accesses its
+  // own clients and the workers can be destroyed one at a time.
+  workers_.clear();
+}
+
+UnwindingWorker& UnwindingWorkerPool::WorkerForPID(pid_t pid) {
+  return *workers_[static_cast<uint64_t>(pid) % workers_.size()];
+}
+
+std::vector<UnwindingWorker::Stats> UnwindingWorkerPool::GetStats() {
+  base::TimeNanos now = base::GetWallTimeNs();
+  std::vector<UnwindingWorker::Stats> stats;
+  stats.reserve(workers_.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const std::unique_ptr<UnwindingWorker>& worker : workers_) {
+    stats.emplace_back(worker->stats_);
+    stats.back().wall_time_us =
+        static_cast<uint64_t>(((now - worker->start_time_) / 1000).count());
+  }
+  return stats;
+}
+
+void UnwindingWorkerPool::ScheduleDrain(ClientData* client) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (shutting_down_ || client->disconnected)
+    return;
+  if (client->running) {
+    client->data_pending = true;
+    return;
+  }
+  if (client->queued)
+    return;
+  client->queued = true;
+  client->owner->ready_clients_.push_back(client);
+  WakeWorkerLocked(client->owner);
+}
+
+bool UnwindingWorkerPool::MarkDisconnected(ClientData* client,
+                                           bool notify_delegate) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (client->disconnected)
+    return false;
+  client->disconnected = true;
+  client->notify_disconnect = notify_delegate;
+  return !client->queued && !client->running;
+}
+
+UnwindingWorker::ClientData* UnwindingWorkerPool::BeginDrain(
+    UnwindingWorker* worker) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ClientData* client = nullptr;
+  if (!shutting_down_ && !worker->ready_clients_.empty()) {
+    client = worker->ready_clients_.front();
+    worker->ready_clients_.pop_front();
+  } else if (!shutting_down_) {
+    // Steal from the back, i.e. the client that was queued last.
+    for (const std::unique_ptr<UnwindingWorker>& victim : workers_) {
+      if (victim->ready_clients_.empty())
+        continue;
+      client = victim->ready_clients_.back();
+      victim->ready_clients_.pop_back();
+      worker->stats_.stolen_drains++;
+      break;
+    }
+  }
+  if (!client) {
+    worker->idle_ = true;
+    return nullptr;
+  }
+  client->queued = false;
+  client->running = true;
+  running_drains_++;
+  return client;
+}
+
+void UnwindingWorkerPool::EndDrain(UnwindingWorker* worker,
+                                   ClientData* client,
+                                   size_t buffers_handled,
+                                   uint64_t busy_time_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  worker->stats_.busy_time_us += busy_time_us;
+  worker->stats_.buffers_handled += buffers_handled;
+  client->running = false;
+  PERFETTO_DCHECK(running_drains_ > 0);
+  if (--running_drains_ == 0 && shutting_down_)
+    drains_done_.notify_all();
+  if (shutting_down_)
+    return;
+
+  if (buffers_handled == kMaxBuffersPerDrain || client->data_pending) {
+    // Requeue on this worker, which has the client's state in its caches. It
+    // can still be stolen by an idle worker.
+    client->data_pending = false;
+    client->queued = true;
+    worker->ready_clients_.push_back(client);
+    return;
+  }
+  if (client->disconnected)
+    client->owner->PostFinishDisconnect(client->metadata.pid);
+}
+
+void UnwindingWorkerPool::WakeWorkerLocked(UnwindingWorker* preferred) {
+  UnwindingWorker* worker = nullptr;
+  if (preferred->idle_) {
+    worker = preferred;
+  } else {
+    for (const std::unique_ptr<UnwindingWorker>& candidate : workers_) {
+      if (candidate->idle_) {
+        worker = candidate.get();
+        break;
+      }
+    }
+  }
+  // If all workers are busy, the client is picked up by the first one that
+  // finishes its current drain.
+  if (!worker)
+    return;
+  worker->idle_ = false;
+  worker->PostDrainReadyClients();
+}
+
 }  // namespace profiling
 }  // namespace perfetto
@@ -22,8 +22,18 @@
 #include <unwindstack/Maps.h>
 #include <unwindstack/Unwinder.h>
 
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "perfetto/base/flat_hash_map.h"
 #include "perfetto/base/scoped_file.h"
 #include "perfetto/base/thread_task_runner.h"
+#include "perfetto/base/time.h"
 #include "perfetto/tracing/core/basic_types.h"
 #include "src/profiling/memory/bookkeeping.h"
 #include "src/profiling/memory/unwound_messages.h"
@@ -93,9 +103,42 @@ class StackOverlayMemory : public unwindstack::Memory {
   uint8_t* stack_ = nullptr;
 };
 
+// LRU cache of unwound callstacks. The key is a hash of the registers and of
+// the stack of the allocation, see DoUnwind. Most allocations of a process
+// come from a few hot call sites, and the same registers and stack always
+// unwind to the same frames, as long as the maps do not change.
+class UnwindingCache {
+ public:
+  static constexpr size_t kDefaultCapacity = 512;
+
+  explicit UnwindingCache(size_t capacity = kDefaultCapacity)
+      : capacity_(capacity) {}
+
+  // Returns nullptr if |key| is not in the cache. The returned pointer is
+  // valid until the next call to Insert or Clear.
+  const std::vector<FrameData>* Find(uint64_t key);
+  void Insert(uint64_t key, std::vector<FrameData> frames);
+  void Clear();
+
+  size_t size() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    uint64_t key;
+    std::vector<FrameData> frames;
+  };
+
+  size_t capacity_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  base::FlatHashMap<uint64_t, std::list<Entry>::iterator> index_;
+};
+
 struct UnwindingMetadata {
   UnwindingMetadata(pid_t p, base::ScopedFile maps_fd, base::ScopedFile mem);
 
+  // Also clears the unwinding_cache, as the cached frames might not be valid
+  // for the new maps.
   void ReparseMaps();
 
   pid_t pid;
@@ -103,10 +146,13 @@ struct UnwindingMetadata {
   // The API of libunwindstack expects shared_ptr for Memory.
   std::shared_ptr<StackOverlayMemory> fd_mem;
   unwindstack::Unwinder unwinder;
+  UnwindingCache unwinding_cache;
 };
 
 bool DoUnwind(WireMessage*, UnwindingMetadata* metadata, AllocRecord* out);
 
+class UnwindingWorkerPool;
+
 class UnwindingWorker : public base::UnixSocket::EventListener {
  public:
   class Delegate {
@@ -114,6 +160,11 @@ class UnwindingWorker : public base::UnixSocket::EventListener {
     virtual void PostAllocRecord(AllocRecord) = 0;
     virtual void PostFreeRecord(FreeRecord) = 0;
     virtual void PostSocketDisconnected(DataSourceInstanceID, pid_t pid) = 0;
+    // Called when the number of writes the client failed to do because its
+    // shared memory buffer was full has changed.
+    virtual void PostBufferOverflows(DataSourceInstanceID,
+                                     pid_t pid,
+                                     uint64_t num_writes_overflow) = 0;
     virtual ~Delegate();
   };
 
@@ -124,8 +175,22 @@ class UnwindingWorker : public base::UnixSocket::EventListener {
     SharedRingBuffer shmem;
   };
 
-  UnwindingWorker(Delegate* delegate, base::ThreadTaskRunner thread_task_runner)
+  struct Stats {
+    // Time spent draining shared memory buffers.
+    uint64_t busy_time_us;
+    // Time since the worker was created.
+    uint64_t wall_time_us;
+    uint64_t buffers_handled;
+    // Number of drains of clients taken from another worker's queue.
+    uint64_t stolen_drains;
+  };
+
+  UnwindingWorker(Delegate* delegate,
+                  UnwindingWorkerPool* pool,
+                  base::ThreadTaskRunner thread_task_runner)
       : delegate_(delegate),
+        pool_(pool),
+        start_time_(base::GetWallTimeNs()),
         thread_task_runner_(std::move(thread_task_runner)) {}
 
   // Public API safe to call from other threads.
@@ -150,6 +215,8 @@ class UnwindingWorker : public base::UnixSocket::EventListener {
                            Delegate* delegate);
 
  private:
+  friend class UnwindingWorkerPool;
+
   void HandleHandoffSocket(HandoffData data);
   void HandleDisconnectSocket(pid_t pid);
 
@@ -158,14 +225,98 @@ class UnwindingWorker : public base::UnixSocket::EventListener {
     std::unique_ptr<base::UnixSocket> sock;
     UnwindingMetadata metadata;
     SharedRingBuffer shmem;
+    // The worker owning the socket, which is the only one adding or removing
+    // entries of its |client_data_|.
+    UnwindingWorker* owner;
+    // Only accessed by the worker draining the client.
+    uint64_t reported_overflows;
+
+    // Guarded by the pool's mutex.
+    bool queued;
+    bool running;
+    bool data_pending;
+    bool disconnected;
+    bool notify_disconnect;
   };
 
+  // Handles at most kMaxBuffersPerDrain buffers of the client. Returns the
+  // number of buffers handled.
+  size_t DrainClient(ClientData* client);
+  void DrainReadyClients();
+  void PostDrainReadyClients();
+  void PostFinishDisconnect(pid_t pid);
+  void FinishDisconnect(pid_t pid);
+
   std::map<pid_t, ClientData> client_data_;
   Delegate* delegate_;
+  UnwindingWorkerPool* pool_;
+  const base::TimeNanos start_time_;
+
+  // Guarded by the pool's mutex.
+  std::deque<ClientData*> ready_clients_;
+  // True if no DrainReadyClients task is pending or running.
+  bool idle_ = true;
+  Stats stats_{};
+
   // Task runner with a dedicated thread.
   base::ThreadTaskRunner thread_task_runner_;
 };
 
+// Owns the unwinding workers. Each client socket is owned by one worker,
+// chosen by pid, which receives its notifications. Draining the client's
+// shared memory buffer is scheduled separately: the client is queued on the
+// worker that last drained it (or on its owner) and idle workers steal from
+// the queues of busy ones. This way a process producing a lot of samples does
+// not delay other processes that happen to share its worker. A client is
+// drained by only one worker at a time, which keeps its records in order.
+class UnwindingWorkerPool {
+ public:
+  UnwindingWorkerPool(UnwindingWorker::Delegate* delegate, size_t num_workers);
+  ~UnwindingWorkerPool();
+
+  UnwindingWorkerPool(const UnwindingWorkerPool&) = delete;
+  UnwindingWorkerPool& operator=(const UnwindingWorkerPool&) = delete;
+
+  // Returns the worker owning the socket of the process.
+  UnwindingWorker& WorkerForPID(pid_t pid);
+
+  // Safe to call from other threads.
+  std::vector<UnwindingWorker::Stats> GetStats();
+
+  size_t size() const { return workers_.size(); }
+
+ private:
+  friend class UnwindingWorker;
+  using ClientData = UnwindingWorker::ClientData;
+
+  // Queues the client for draining, unless it is already queued. If it is
+  // being drained, the running drain will requeue it.
+  void ScheduleDrain(ClientData* client);
+
+  // Returns true if the owner can destroy the client right away. Otherwise
+  // the owner is asked to by the last drain of the client, through
+  // PostFinishDisconnect.
+  bool MarkDisconnected(ClientData* client, bool notify_delegate);
+
+  // Returns the next client for |worker| to drain, from its own queue or
+  // stolen from another worker's. Returns nullptr and marks |worker| idle if
+  // there is none.
+  ClientData* BeginDrain(UnwindingWorker* worker);
+  void EndDrain(UnwindingWorker* worker,
+                ClientData* client,
+                size_t buffers_handled,
+                uint64_t busy_time_us);
+
+  // Requires mutex_ to be held.
+  void WakeWorkerLocked(UnwindingWorker* preferred);
+
+  std::mutex mutex_;
+  bool shutting_down_ = false;
+  size_t running_drains_ = 0;
+  std::condition_variable drains_done_;
+  std::vector<std::unique_ptr<UnwindingWorker>> workers_;
+};
+
 }  // namespace profiling
 }  // namespace perfetto
 
@@ -31,6 +31,7 @@ class NopDelegate : public UnwindingWorker::Delegate {
   void PostAllocRecord(AllocRecord) override {}
   void PostFreeRecord(FreeRecord) override {}
   void PostSocketDisconnected(DataSourceInstanceID, pid_t) override {}
+  void PostBufferOverflows(DataSourceInstanceID, pid_t, uint64_t) override {}
 };
 
 int FuzzUnwinding(const uint8_t* data, size_t size) {
@@ -16,6 +16,8 @@
 
 #include "src/profiling/memory/unwinding.h"
 #include "perfetto/base/scoped_file.h"
+#include "perfetto/base/unix_socket.h"
+#include "src/base/test/test_task_runner.h"
 #include "src/profiling/memory/client.h"
 #include "src/profiling/memory/wire_protocol.h"
 
@@ -26,6 +28,9 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+
+#include <numeric>
 
 #include <unwindstack/RegsGetLocal.h>
 
@@ -120,8 +125,10 @@ RecordMemory __attribute__((noinline)) GetRecord(WireMessage* msg) {
 // TODO(rsavitski): Investigate TSAN unwinding.
 #if defined(THREAD_SANITIZER)
 #define MAYBE_DoUnwind DISABLED_DoUnwind
+#define MAYBE_DoUnwindCached DISABLED_DoUnwindCached
 #else
 #define MAYBE_DoUnwind DoUnwind
+#define MAYBE_DoUnwindCached DoUnwindCached
 #endif
 
 TEST(UnwindingTest, MAYBE_DoUnwind) {
@@ -143,6 +150,138 @@ TEST(UnwindingTest, MAYBE_DoUnwind) {
                "namespace)::GetRecord(perfetto::profiling::WireMessage*)");
 }
 
+TEST(UnwindingTest, MAYBE_DoUnwindCached) {
+  base::ScopedFile proc_maps(base::OpenFile("/proc/self/maps", O_RDONLY));
+  base::ScopedFile proc_mem(base::OpenFile("/proc/self/mem", O_RDONLY));
+  UnwindingMetadata metadata(getpid(), std::move(proc_maps),
+                             std::move(proc_mem));
+  WireMessage msg;
+  auto record = GetRecord(&msg);
+  AllocRecord first;
+  ASSERT_TRUE(DoUnwind(&msg, &metadata, &first));
+  ASSERT_FALSE(first.error);
+  EXPECT_FALSE(first.unwinding_cache_hit);
+
+  AllocRecord second;
+  ASSERT_TRUE(DoUnwind(&msg, &metadata, &second));
+  EXPECT_TRUE(second.unwinding_cache_hit);
+  ASSERT_EQ(second.frames.size(), first.frames.size());
+  for (size_t i = 0; i < first.frames.size(); ++i) {
+    EXPECT_EQ(second.frames[i].frame.pc, first.frames[i].frame.pc);
+    EXPECT_EQ(second.frames[i].frame.function_name,
+              first.frames[i].frame.function_name);
+    EXPECT_EQ(second.frames[i].build_id, first.frames[i].build_id);
+  }
+
+  // Parsing the maps again invalidates the cache.
+  metadata.ReparseMaps();
+  AllocRecord third;
+  ASSERT_TRUE(DoUnwind(&msg, &metadata, &third));
+  EXPECT_FALSE(third.unwinding_cache_hit);
+}
+
+FrameData MakeFrame(const char* function_name) {
+  unwindstack::FrameData frame{};
+  frame.function_name = function_name;
+  return FrameData(frame, "");
+}
+
+TEST(UnwindingCacheTest, EvictsLeastRecentlyUsed) {
+  UnwindingCache cache(2);
+  cache.Insert(1, {MakeFrame("one")});
+  cache.Insert(2, {MakeFrame("two")});
+  // Makes 1 the most recently used entry.
+  ASSERT_NE(cache.Find(1), nullptr);
+  cache.Insert(3, {MakeFrame("three")});
+
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.Find(2), nullptr);
+  const std::vector<FrameData>* frames = cache.Find(1);
+  ASSERT_NE(frames, nullptr);
+  ASSERT_EQ(frames->size(), 1u);
+  EXPECT_EQ((*frames)[0].frame.function_name, "one");
+  EXPECT_NE(cache.Find(3), nullptr);
+
+  cache.Clear();
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_EQ(cache.Find(1), nullptr);
+}
+
+class FreeRecordDelegate : public UnwindingWorker::Delegate {
+ public:
+  FreeRecordDelegate(base::TestTaskRunner* task_runner,
+                     std::function<void()> on_disconnect)
+      : task_runner_(task_runner), on_disconnect_(std::move(on_disconnect)) {}
+
+  // Called on the unwinding threads.
+  void PostAllocRecord(AllocRecord) override {}
+  void PostFreeRecord(FreeRecord rec) override {
+    uint64_t sequence_number = rec.free_batch.entries[0].sequence_number;
+    task_runner_->PostTask([this, sequence_number] {
+      sequence_numbers.emplace_back(sequence_number);
+    });
+  }
+  void PostSocketDisconnected(DataSourceInstanceID, pid_t) override {
+    task_runner_->PostTask(on_disconnect_);
+  }
+  void PostBufferOverflows(DataSourceInstanceID, pid_t, uint64_t) override {}
+
+  std::vector<uint64_t> sequence_numbers;
+
+ private:
+  base::TestTaskRunner* task_runner_;
+  std::function<void()> on_disconnect_;
+};
+
+TEST(UnwindingWorkerPoolTest, DrainsClientInOrder) {
+  constexpr uint64_t kNumRecords = 256;
+  base::TestTaskRunner task_runner;
+  FreeRecordDelegate delegate(&task_runner,
+                              task_runner.CreateCheckpoint("disconnected"));
+  UnwindingWorkerPool pool(&delegate, 4);
+
+  auto shmem = SharedRingBuffer::Create(8 * 1048576);
+  ASSERT_TRUE(shmem);
+  auto client_shmem =
+      SharedRingBuffer::Attach(base::ScopedFile(dup(shmem->fd())));
+  ASSERT_TRUE(client_shmem);
+  auto sock_pair = base::UnixSocketRaw::CreatePair(base::SockType::kStream);
+
+  UnwindingWorker::HandoffData handoff_data;
+  handoff_data.data_source_instance_id = 1;
+  handoff_data.sock = std::move(sock_pair.second);
+  handoff_data.fds[kHandshakeMaps] =
+      base::OpenFile("/proc/self/maps", O_RDONLY);
+  handoff_data.fds[kHandshakeMem] = base::OpenFile("/proc/self/mem", O_RDONLY);
+  handoff_data.shmem = std::move(*shmem);
+  pool.WorkerForPID(getpid()).PostHandoffSocket(std::move(handoff_data));
+
+  // More records than a single drain handles, so that the client is requeued
+  // and can move between workers.
+  std::unique_ptr<FreeBatch> free_batch(new FreeBatch());
+  free_batch->num_entries = 1;
+  for (uint64_t i = 1; i <= kNumRecords; ++i) {
+    free_batch->entries[0] = {i, 0x10};
+    WireMessage msg = {};
+    msg.record_type = RecordType::Free;
+    msg.free_header = free_batch.get();
+    ASSERT_TRUE(SendWireMessage(&client_shmem.value(), msg));
+    ASSERT_EQ(sock_pair.first.Send("1", 1), 1);
+  }
+  sock_pair.first.Shutdown();
+
+  // The disconnection is only reported after all the records.
+  task_runner.RunUntilCheckpoint("disconnected");
+  std::vector<uint64_t> expected(kNumRecords);
+  std::iota(expected.begin(), expected.end(), 1);
+  EXPECT_EQ(delegate.sequence_numbers, expected);
+
+  uint64_t buffers_handled = 0;
+  for (const UnwindingWorker::Stats& stats : pool.GetStats())
+    buffers_handled += stats.buffers_handled;
+  EXPECT_EQ(buffers_handled, kNumRecords);
+}
+
 }  // namespace
 }  // namespace profiling
 }  // namespace perfetto
@@ -232,5 +232,18 @@ TEST(ProtoDecoderTest, FixedData) {
   EXPECT_DOUBLE_EQ(decoder.Get(2).as_double(), -1000.25);
 }
 
+TEST(ProtoDecoderTest, FindField) {
+  uint8_t buf[] = {0x08, 0x00};  // A single varint field with id 1.
+  ProtoDecoder decoder(buf, sizeof(buf));
+
+  Field field = decoder.FindField(1);
+  ASSERT_TRUE(field.valid());
+  ASSERT_EQ(field.as_uint32(), 0u);
+
+  // Missing fields must be reported as not valid.
+  ASSERT_FALSE(decoder.FindField(2).valid());
+  ASSERT_EQ(decoder.bytes_left(), sizeof(buf));
+}
+
 }  // namespace
 }  // namespace protozero
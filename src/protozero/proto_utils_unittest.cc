@@ -16,6 +16,8 @@
 
 #include "perfetto/protozero/proto_utils.h"
 
+#include <string.h>
+
 #include <limits>
 
 #include "gtest/gtest.h"
@@ -196,6 +198,16 @@ TEST(ProtoUtilsTest, VarIntDecodingOutOfBounds) {
   }
 }
 
+TEST(ProtoUtilsTest, VarIntDecodingTooLong) {
+  uint8_t buf[12];
+  memset(buf, 0xff, sizeof(buf));
+  buf[sizeof(buf) - 1] = 0x01;
+  uint64_t value = static_cast<uint64_t>(-1);
+  const uint8_t* res = ParseVarInt(buf, buf + sizeof(buf), &value);
+  EXPECT_EQ(&buf[0], res);
+  EXPECT_EQ(0u, value);
+}
+
 }  // namespace
 }  // namespace proto_utils
 }  // namespace protozero
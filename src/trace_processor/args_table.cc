@@ -16,6 +16,8 @@
 
 #include "src/trace_processor/args_table.h"
 
+#include <numeric>
+
 #include "src/trace_processor/sqlite_utils.h"
 
 namespace perfetto {
@@ -29,11 +31,10 @@ void ArgsTable::RegisterTable(sqlite3* db, const TraceStorage* storage) {
 }
 
 StorageSchema ArgsTable::CreateStorageSchema() {
-  const auto& args = storage_->args();
   return StorageSchema::Builder()
-      .AddNumericColumn("arg_set_id", &args.set_ids())
-      .AddStringColumn("flat_key", &args.flat_keys(), &storage_->string_pool())
-      .AddStringColumn("key", &args.keys(), &storage_->string_pool())
+      .AddGenericNumericColumn("arg_set_id", ArgSetIdAccessor(storage_))
+      .AddColumn<KeyColumn>("flat_key", true /* flat */, storage_)
+      .AddColumn<KeyColumn>("key", false /* flat */, storage_)
       .AddColumn<ValueColumn>("int_value", VariadicType::kInt, storage_)
       .AddColumn<ValueColumn>("string_value", VariadicType::kString, storage_)
       .AddColumn<ValueColumn>("real_value", VariadicType::kReal, storage_)
@@ -60,6 +61,53 @@ int ArgsTable::BestIndex(const QueryConstraints& qc, BestIndexInfo* info) {
   return SQLITE_OK;
 }
 
+ArgsTable::ArgSetIdAccessor::ArgSetIdAccessor(const TraceStorage* storage)
+    : storage_(storage) {}
+
+ArgsTable::ArgSetIdAccessor::~ArgSetIdAccessor() = default;
+
+std::vector<uint32_t> ArgsTable::ArgSetIdAccessor::EqualIndices(
+    ArgSetId id) const {
+  auto rows = storage_->args().FindArgSetRows(id);
+  std::vector<uint32_t> indices(rows.second - rows.first);
+  std::iota(indices.begin(), indices.end(), rows.first);
+  return indices;
+}
+
+ArgsTable::KeyColumn::KeyColumn(std::string col_name,
+                                bool flat,
+                                const TraceStorage* storage)
+    : StorageColumn(col_name, false /* hidden */),
+      flat_(flat),
+      storage_(storage) {}
+
+void ArgsTable::KeyColumn::ReportResult(sqlite3_context* ctx,
+                                        uint32_t row) const {
+  NullTermStringView str = GetKey(row);
+  if (str.empty()) {
+    sqlite3_result_null(ctx);
+  } else {
+    sqlite3_result_text(ctx, str.c_str(), -1, sqlite_utils::kSqliteStatic);
+  }
+}
+
+ArgsTable::KeyColumn::Comparator ArgsTable::KeyColumn::Sort(
+    const QueryConstraints::OrderBy& ob) const {
+  if (ob.desc) {
+    return [this](uint32_t f, uint32_t s) {
+      return sqlite_utils::CompareValuesDesc(GetKey(f), GetKey(s));
+    };
+  }
+  return [this](uint32_t f, uint32_t s) {
+    return sqlite_utils::CompareValuesAsc(GetKey(f), GetKey(s));
+  };
+}
+
+NullTermStringView ArgsTable::KeyColumn::GetKey(uint32_t row) const {
+  auto arg = storage_->args().GetArg(row);
+  return storage_->GetString(flat_ ? arg.flat_key : arg.key);
+}
+
 ArgsTable::ValueColumn::ValueColumn(std::string col_name,
                                     VariadicType type,
                                     const TraceStorage* storage)
@@ -69,7 +117,7 @@ ArgsTable::ValueColumn::ValueColumn(std::string col_name,
 
 void ArgsTable::ValueColumn::ReportResult(sqlite3_context* ctx,
                                           uint32_t row) const {
-  const auto& value = storage_->args().arg_values()[row];
+  const auto value = storage_->args().GetArg(row).value;
   if (value.type != type_) {
     sqlite3_result_null(ctx);
     return;
@@ -105,7 +153,7 @@ void ArgsTable::ValueColumn::Filter(int op,
       auto predicate = sqlite_utils::CreateNumericPredicate<int64_t>(op, value);
       index->FilterRows(
           [this, predicate, op_is_null](uint32_t row) PERFETTO_ALWAYS_INLINE {
-            const auto& arg = storage_->args().arg_values()[row];
+            const auto arg = storage_->args().GetArg(row).value;
             return arg.type == type_ ? predicate(arg.int_value) : op_is_null;
           });
       break;
@@ -115,7 +163,7 @@ void ArgsTable::ValueColumn::Filter(int op,
       auto predicate = sqlite_utils::CreateNumericPredicate<double>(op, value);
       index->FilterRows(
           [this, predicate, op_is_null](uint32_t row) PERFETTO_ALWAYS_INLINE {
-            const auto& arg = storage_->args().arg_values()[row];
+            const auto arg = storage_->args().GetArg(row).value;
             return arg.type == type_ ? predicate(arg.real_value) : op_is_null;
           });
       break;
@@ -124,7 +172,7 @@ void ArgsTable::ValueColumn::Filter(int op,
       auto predicate = sqlite_utils::CreateStringPredicate(op, value);
       index->FilterRows([this,
                          &predicate](uint32_t row) PERFETTO_ALWAYS_INLINE {
-        const auto& arg = storage_->args().arg_values()[row];
+        const auto arg = storage_->args().GetArg(row).value;
         return arg.type == type_
                    ? predicate(storage_->GetString(arg.string_value).c_str())
                    : predicate(nullptr);
@@ -143,8 +191,8 @@ ArgsTable::ValueColumn::Comparator ArgsTable::ValueColumn::Sort(
 }
 
 int ArgsTable::ValueColumn::CompareRefsAsc(uint32_t f, uint32_t s) const {
-  const auto& arg_f = storage_->args().arg_values()[f];
-  const auto& arg_s = storage_->args().arg_values()[s];
+  const auto arg_f = storage_->args().GetArg(f).value;
+  const auto arg_s = storage_->args().GetArg(s).value;
 
   if (arg_f.type == type_ && arg_s.type == type_) {
     switch (type_) {
@@ -154,8 +202,8 @@ int ArgsTable::ValueColumn::CompareRefsAsc(uint32_t f, uint32_t s) const {
         return sqlite_utils::CompareValuesAsc(arg_f.real_value,
                                               arg_s.real_value);
       case VariadicType::kString: {
-        const auto& f_str = storage_->GetString(arg_f.string_value);
-        const auto& s_str = storage_->GetString(arg_s.string_value);
+        NullTermStringView f_str = storage_->GetString(arg_f.string_value);
+        NullTermStringView s_str = storage_->GetString(arg_s.string_value);
         return sqlite_utils::CompareValuesAsc(f_str, s_str);
       }
     }
@@ -37,6 +37,49 @@ class ArgsTable : public StorageTable {
   int BestIndex(const QueryConstraints&, BestIndexInfo*) override;
 
  private:
+  // Reads the set ids through TraceStorage::Args::GetSetId() so that lazy arg
+  // sets don't need to be decoded to filter on their id.
+  class ArgSetIdAccessor final : public NumericAccessor<ArgSetId> {
+   public:
+    explicit ArgSetIdAccessor(const TraceStorage* storage);
+    ~ArgSetIdAccessor() override;
+
+    uint32_t Size() const override { return storage_->args().args_count(); }
+
+    ArgSetId Get(uint32_t idx) const override {
+      return storage_->args().GetSetId(idx);
+    }
+
+    bool CanFindEqualIndices() const override { return true; }
+
+    std::vector<uint32_t> EqualIndices(ArgSetId id) const override;
+
+   private:
+    const TraceStorage* storage_ = nullptr;
+  };
+
+  class KeyColumn final : public StorageColumn {
+   public:
+    KeyColumn(std::string col_name, bool flat, const TraceStorage* storage);
+
+    void ReportResult(sqlite3_context* ctx, uint32_t row) const override;
+
+    // Filtering is left to SQLite.
+    void Filter(int, sqlite3_value*, FilteredRowIndex*) const override {}
+
+    Comparator Sort(const QueryConstraints::OrderBy& ob) const override;
+
+    Table::ColumnType GetType() const override {
+      return Table::ColumnType::kString;
+    }
+
+   private:
+    NullTermStringView GetKey(uint32_t row) const;
+
+    bool flat_ = false;
+    const TraceStorage* storage_ = nullptr;
+  };
+
   class ValueColumn final : public StorageColumn {
    public:
     ValueColumn(std::string col_name,
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/bit_vector.h"
+
+#include <utility>
+
+namespace perfetto {
+namespace trace_processor {
+
+namespace {
+
+uint32_t PopCount(uint64_t word) {
+  return static_cast<uint32_t>(__builtin_popcountll(word));
+}
+
+}  // namespace
+
+BitVector::BitVector() = default;
+
+BitVector::BitVector(uint32_t size, bool value)
+    : words_(WordCount(size), value ? ~0ull : 0ull), size_(size) {
+  // Keep the bits past |size_| cleared.
+  if (value && size % kBitsInWord != 0)
+    words_.back() &= (1ull << (size % kBitsInWord)) - 1;
+}
+
+BitVector::~BitVector() = default;
+
+BitVector::BitVector(BitVector&& other) noexcept
+    : words_(std::move(other.words_)), size_(other.size_) {
+  other.size_ = 0;
+}
+
+BitVector& BitVector::operator=(BitVector&& other) {
+  words_ = std::move(other.words_);
+  size_ = other.size_;
+  other.words_.clear();
+  other.size_ = 0;
+  return *this;
+}
+
+BitVector BitVector::Copy() const {
+  BitVector copy;
+  copy.words_ = words_;
+  copy.size_ = size_;
+  return copy;
+}
+
+void BitVector::ClearRange(uint32_t start, uint32_t end) {
+  PERFETTO_DCHECK(start <= end && end <= size_);
+  if (start == end)
+    return;
+
+  uint32_t start_word = WordIdx(start);
+  uint32_t last_word = WordIdx(end - 1);
+  uint64_t start_mask = ~0ull << BitIdx(start);
+  uint64_t last_mask = ~0ull >> (kBitsInWord - 1 - BitIdx(end - 1));
+  if (start_word == last_word) {
+    words_[start_word] &= ~(start_mask & last_mask);
+    return;
+  }
+  words_[start_word] &= ~start_mask;
+  for (uint32_t i = start_word + 1; i < last_word; i++)
+    words_[i] = 0;
+  words_[last_word] &= ~last_mask;
+}
+
+void BitVector::And(const BitVector& other) {
+  PERFETTO_DCHECK(size_ == other.size_);
+  for (size_t i = 0; i < words_.size(); i++)
+    words_[i] &= other.words_[i];
+}
+
+void BitVector::Or(const BitVector& other) {
+  PERFETTO_DCHECK(size_ == other.size_);
+  for (size_t i = 0; i < words_.size(); i++)
+    words_[i] |= other.words_[i];
+}
+
+uint32_t BitVector::GetNumBitsSet(uint32_t end) const {
+  PERFETTO_DCHECK(end <= size_);
+  uint32_t count = 0;
+  uint32_t full_words = WordIdx(end);
+  for (uint32_t i = 0; i < full_words; i++)
+    count += PopCount(words_[i]);
+  if (BitIdx(end) != 0)
+    count += PopCount(words_[full_words] & ((1ull << BitIdx(end)) - 1));
+  return count;
+}
+
+uint32_t BitVector::IndexOfNthSet(uint32_t n) const {
+  // Skip whole words using popcount and then find the bit inside the word
+  // containing it by repeatedly clearing the lowest set bit.
+  for (uint32_t i = 0; i < words_.size(); i++) {
+    uint64_t word = words_[i];
+    uint32_t count = PopCount(word);
+    if (n >= count) {
+      n -= count;
+      continue;
+    }
+    for (; n > 0; n--)
+      word &= word - 1;
+    return i * kBitsInWord + static_cast<uint32_t>(__builtin_ctzll(word));
+  }
+  PERFETTO_FATAL("IndexOfNthSet called with n >= number of set bits");
+}
+
+}  // namespace trace_processor
+}  // namespace perfetto
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACE_PROCESSOR_BIT_VECTOR_H_
+#define SRC_TRACE_PROCESSOR_BIT_VECTOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "perfetto/base/logging.h"
+
+namespace perfetto {
+namespace trace_processor {
+
+// A fixed-size vector of bits packed into 64-bit words, used to represent the
+// set of rows retained by a filter.
+//
+// Unlike std::vector<bool>, all the bulk operations (AND/OR, counting and
+// finding set bits) work a word at a time using popcount and count trailing
+// (or leading) zeros.
+//
+// Invariant: the bits past size() in the last word are always zero.
+class BitVector {
+ public:
+  static constexpr uint32_t kBitsInWord = 64;
+
+  BitVector();
+  explicit BitVector(uint32_t size, bool value = false);
+  ~BitVector();
+
+  BitVector(BitVector&&) noexcept;
+  BitVector& operator=(BitVector&&);
+
+  // Copying is explicit to avoid accidental copies of large vectors.
+  BitVector Copy() const;
+
+  uint32_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  bool IsSet(uint32_t idx) const {
+    PERFETTO_DCHECK(idx < size_);
+    return (words_[WordIdx(idx)] >> BitIdx(idx)) & 1;
+  }
+
+  void Set(uint32_t idx) {
+    PERFETTO_DCHECK(idx < size_);
+    words_[WordIdx(idx)] |= 1ull << BitIdx(idx);
+  }
+
+  void Clear(uint32_t idx) {
+    PERFETTO_DCHECK(idx < size_);
+    words_[WordIdx(idx)] &= ~(1ull << BitIdx(idx));
+  }
+
+  // Clears all the bits in the range [start, end).
+  void ClearRange(uint32_t start, uint32_t end);
+
+  // Intersects (and unions) this vector with |other| in place. |other| must
+  // have the same size as this vector.
+  void And(const BitVector& other);
+  void Or(const BitVector& other);
+
+  // Returns the number of set bits.
+  uint32_t GetNumBitsSet() const { return GetNumBitsSet(size_); }
+
+  // Returns the number of set bits in the range [0, end) (a.k.a. rank).
+  uint32_t GetNumBitsSet(uint32_t end) const;
+
+  // Returns the index of the n-th set bit (zero-based, a.k.a. select). |n|
+  // must be less than GetNumBitsSet().
+  uint32_t IndexOfNthSet(uint32_t n) const;
+
+  // Returns the index of the first set bit >= |idx| or size() if there is no
+  // such bit.
+  uint32_t NextSet(uint32_t idx) const {
+    if (idx >= size_)
+      return size_;
+    uint32_t word_idx = WordIdx(idx);
+    uint64_t word = words_[word_idx] & (~0ull << BitIdx(idx));
+    while (word == 0) {
+      if (++word_idx == words_.size())
+        return size_;
+      word = words_[word_idx];
+    }
+    return word_idx * kBitsInWord +
+           static_cast<uint32_t>(__builtin_ctzll(word));
+  }
+
+  // Returns the index of the last set bit < |end| or size() if there is no
+  // such bit.
+  uint32_t PrevSet(uint32_t end) const {
+    if (end == 0)
+      return size_;
+    PERFETTO_DCHECK(end <= size_);
+    uint32_t idx = end - 1;
+    uint32_t word_idx = WordIdx(idx);
+    uint64_t word =
+        words_[word_idx] & (~0ull >> (kBitsInWord - 1 - BitIdx(idx)));
+    while (word == 0) {
+      if (word_idx-- == 0)
+        return size_;
+      word = words_[word_idx];
+    }
+    return word_idx * kBitsInWord + kBitsInWord - 1 -
+           static_cast<uint32_t>(__builtin_clzll(word));
+  }
+
+  // Calls |fn(idx)| for each set bit in increasing order of index. Clearing
+  // bits from |fn| is allowed.
+  template <typename Fn /* (uint32_t) -> void */>
+  void ForEachSetBit(Fn fn) const {
+    for (uint32_t i = 0; i < words_.size(); i++) {
+      for (uint64_t word = words_[i]; word != 0; word &= word - 1) {
+        fn(i * kBitsInWord + static_cast<uint32_t>(__builtin_ctzll(word)));
+      }
+    }
+  }
+
+  // Returns the packed words backing this vector. Bit i is stored in bit
+  // (i % 64) of word (i / 64). Writers must preserve the invariant that the
+  // bits past size() are zero.
+  uint64_t* mutable_words() { return words_.data(); }
+  const uint64_t* words() const { return words_.data(); }
+  size_t num_words() const { return words_.size(); }
+
+ private:
+  BitVector(const BitVector&) = delete;
+  BitVector& operator=(const BitVector&) = delete;
+
+  static uint32_t WordIdx(uint32_t idx) { return idx / kBitsInWord; }
+  static uint32_t BitIdx(uint32_t idx) { return idx % kBitsInWord; }
+  static uint32_t WordCount(uint32_t size) {
+    return (size + kBitsInWord - 1) / kBitsInWord;
+  }
+
+  std::vector<uint64_t> words_;
+  uint32_t size_ = 0;
+};
+
+}  // namespace trace_processor
+}  // namespace perfetto
+
+#endif  // SRC_TRACE_PROCESSOR_BIT_VECTOR_H_
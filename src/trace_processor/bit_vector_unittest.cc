@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/bit_vector.h"
+
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace perfetto {
+namespace trace_processor {
+namespace {
+
+using ::testing::ElementsAre;
+
+std::vector<uint32_t> SetBits(const BitVector& bv) {
+  std::vector<uint32_t> bits;
+  bv.ForEachSetBit([&bits](uint32_t idx) { bits.push_back(idx); });
+  return bits;
+}
+
+TEST(BitVectorUnittest, SetAndClear) {
+  BitVector bv(130);
+  ASSERT_EQ(bv.size(), 130u);
+  ASSERT_EQ(bv.GetNumBitsSet(), 0u);
+
+  bv.Set(0);
+  bv.Set(64);
+  bv.Set(129);
+  ASSERT_TRUE(bv.IsSet(0));
+  ASSERT_FALSE(bv.IsSet(1));
+  ASSERT_TRUE(bv.IsSet(64));
+  ASSERT_TRUE(bv.IsSet(129));
+  ASSERT_THAT(SetBits(bv), ElementsAre(0, 64, 129));
+
+  bv.Clear(64);
+  ASSERT_THAT(SetBits(bv), ElementsAre(0, 129));
+}
+
+TEST(BitVectorUnittest, ConstructAllSet) {
+  BitVector bv(70, true);
+  ASSERT_EQ(bv.GetNumBitsSet(), 70u);
+  // The bits past the end must stay cleared.
+  ASSERT_EQ(bv.words()[1], (1ull << 6) - 1);
+}
+
+TEST(BitVectorUnittest, AndOr) {
+  BitVector a(100);
+  BitVector b(100);
+  a.Set(1);
+  a.Set(70);
+  b.Set(70);
+  b.Set(99);
+
+  BitVector or_bv = a.Copy();
+  or_bv.Or(b);
+  ASSERT_THAT(SetBits(or_bv), ElementsAre(1, 70, 99));
+
+  a.And(b);
+  ASSERT_THAT(SetBits(a), ElementsAre(70));
+}
+
+TEST(BitVectorUnittest, ClearRange) {
+  BitVector bv(200, true);
+  bv.ClearRange(3, 5);
+  bv.ClearRange(60, 140);
+  bv.ClearRange(190, 200);
+  for (uint32_t i = 0; i < 200; i++) {
+    bool cleared = (i >= 3 && i < 5) || (i >= 60 && i < 140) || i >= 190;
+    ASSERT_EQ(bv.IsSet(i), !cleared) << i;
+  }
+}
+
+TEST(BitVectorUnittest, NextAndPrevSet) {
+  BitVector bv(300);
+  bv.Set(5);
+  bv.Set(64);
+  bv.Set(250);
+
+  ASSERT_EQ(bv.NextSet(0), 5u);
+  ASSERT_EQ(bv.NextSet(5), 5u);
+  ASSERT_EQ(bv.NextSet(6), 64u);
+  ASSERT_EQ(bv.NextSet(65), 250u);
+  ASSERT_EQ(bv.NextSet(251), 300u);
+  ASSERT_EQ(bv.NextSet(300), 300u);
+
+  ASSERT_EQ(bv.PrevSet(300), 250u);
+  ASSERT_EQ(bv.PrevSet(250), 64u);
+  ASSERT_EQ(bv.PrevSet(65), 64u);
+  ASSERT_EQ(bv.PrevSet(64), 5u);
+  ASSERT_EQ(bv.PrevSet(5), 300u);
+  ASSERT_EQ(bv.PrevSet(0), 300u);
+}
+
+TEST(BitVectorUnittest, RankAndSelect) {
+  std::minstd_rand0 rnd(0);
+  BitVector bv(1000);
+  std::vector<uint32_t> set;
+  for (uint32_t i = 0; i < 1000; i++) {
+    if (rnd() % 3 == 0) {
+      bv.Set(i);
+      set.push_back(i);
+    }
+  }
+
+  ASSERT_EQ(bv.GetNumBitsSet(), set.size());
+  for (uint32_t n = 0; n < set.size(); n++) {
+    ASSERT_EQ(bv.IndexOfNthSet(n), set[n]);
+    ASSERT_EQ(bv.GetNumBitsSet(set[n]), n);
+    ASSERT_EQ(bv.GetNumBitsSet(set[n] + 1), n + 1);
+  }
+}
+
+TEST(BitVectorUnittest, ClearWhileIterating) {
+  BitVector bv(128, true);
+  bv.ForEachSetBit([&bv](uint32_t idx) {
+    if (idx % 2)
+      bv.Clear(idx);
+  });
+  ASSERT_EQ(bv.GetNumBitsSet(), 64u);
+  ASSERT_EQ(bv.NextSet(1), 2u);
+}
+
+TEST(BitVectorUnittest, Move) {
+  BitVector a(10);
+  a.Set(3);
+  BitVector b = std::move(a);
+  ASSERT_EQ(b.size(), 10u);
+  ASSERT_TRUE(b.IsSet(3));
+}
+
+}  // namespace
+}  // namespace trace_processor
+}  // namespace perfetto
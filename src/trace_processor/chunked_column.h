@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACE_PROCESSOR_CHUNKED_COLUMN_H_
+#define SRC_TRACE_PROCESSOR_CHUNKED_COLUMN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "perfetto/base/logging.h"
+#include "perfetto/base/utils.h"
+
+namespace perfetto {
+namespace trace_processor {
+
+// Append-only storage for a single column of a table in TraceStorage.
+//
+// Rows are stored in fixed-size chunks of kChunkSize elements. Each chunk is a
+// contiguous, cache-line aligned block of memory. Compared to std::deque (which
+// uses 512 byte blocks) this keeps scans over a column sequential, lets the
+// hardware prefetcher do its job and allows filters and sorts to work on raw
+// spans of memory (see ForEachSpan()).
+//
+// Appending never moves existing rows so row indices, and pointers obtained
+// from ForEachSpan(), stay valid until the column is destroyed or reassigned.
+// Existing rows can be modified in place but never removed.
+//
+// Only trivially copyable types can be stored: chunks are copied with memcpy
+// and elements are never destroyed.
+template <typename T>
+class ChunkedColumn {
+ public:
+  static_assert(PERFETTO_IS_TRIVIALLY_COPYABLE(T),
+                "ChunkedColumn only supports trivially copyable types");
+
+  static constexpr size_t kChunkShift = 12;
+  static constexpr size_t kChunkSize = 1 << kChunkShift;  // In elements.
+  static constexpr size_t kChunkMask = kChunkSize - 1;
+  static constexpr size_t kAlignment = 64;  // Cache line size.
+
+  // Random access iterator over the rows of the column. Needed to support
+  // standard algorithms (e.g. std::lower_bound) over the whole column.
+  class ConstIterator {
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    ConstIterator() = default;
+    ConstIterator(const ChunkedColumn* column, size_t row)
+        : column_(column), row_(row) {}
+
+    reference operator*() const { return (*column_)[row_]; }
+    pointer operator->() const { return &(*column_)[row_]; }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    ConstIterator& operator++() {
+      row_++;
+      return *this;
+    }
+    ConstIterator operator++(int) {
+      ConstIterator it = *this;
+      row_++;
+      return it;
+    }
+    ConstIterator& operator--() {
+      row_--;
+      return *this;
+    }
+    ConstIterator operator--(int) {
+      ConstIterator it = *this;
+      row_--;
+      return it;
+    }
+    ConstIterator& operator+=(difference_type n) {
+      row_ = static_cast<size_t>(static_cast<difference_type>(row_) + n);
+      return *this;
+    }
+    ConstIterator& operator-=(difference_type n) { return *this += -n; }
+
+    friend ConstIterator operator+(ConstIterator it, difference_type n) {
+      return it += n;
+    }
+    friend ConstIterator operator+(difference_type n, ConstIterator it) {
+      return it += n;
+    }
+    friend ConstIterator operator-(ConstIterator it, difference_type n) {
+      return it -= n;
+    }
+    friend difference_type operator-(const ConstIterator& a,
+                                     const ConstIterator& b) {
+      return static_cast<difference_type>(a.row_) -
+             static_cast<difference_type>(b.row_);
+    }
+
+    friend bool operator==(const ConstIterator& a, const ConstIterator& b) {
+      return a.row_ == b.row_;
+    }
+    friend bool operator!=(const ConstIterator& a, const ConstIterator& b) {
+      return a.row_ != b.row_;
+    }
+    friend bool operator<(const ConstIterator& a, const ConstIterator& b) {
+      return a.row_ < b.row_;
+    }
+    friend bool operator>(const ConstIterator& a, const ConstIterator& b) {
+      return a.row_ > b.row_;
+    }
+    friend bool operator<=(const ConstIterator& a, const ConstIterator& b) {
+      return a.row_ <= b.row_;
+    }
+    friend bool operator>=(const ConstIterator& a, const ConstIterator& b) {
+      return a.row_ >= b.row_;
+    }
+
+   private:
+    const ChunkedColumn* column_ = nullptr;
+    size_t row_ = 0;
+  };
+
+  ChunkedColumn() = default;
+  ~ChunkedColumn() = default;
+
+  // Allow std::move().
+  ChunkedColumn(ChunkedColumn&&) noexcept = default;
+  ChunkedColumn& operator=(ChunkedColumn&&) = default;
+
+  // Copying is allowed but is expensive as it deep copies all the chunks.
+  ChunkedColumn(const ChunkedColumn& other) { *this = other; }
+  ChunkedColumn& operator=(const ChunkedColumn& other) {
+    if (this == &other)
+      return *this;
+    chunks_.clear();
+    size_ = 0;
+    for (const Chunk& chunk : other.chunks_) {
+      chunks_.emplace_back();
+      memcpy(chunks_.back().data(), chunk.data(), sizeof(T) * kChunkSize);
+    }
+    size_ = other.size_;
+    return *this;
+  }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    if (PERFETTO_UNLIKELY((size_ & kChunkMask) == 0))
+      chunks_.emplace_back();
+    new (&chunks_.back().data()[size_ & kChunkMask])
+        T(std::forward<Args>(args)...);
+    size_++;
+  }
+
+  void push_back(const T& value) { emplace_back(value); }
+
+  T& operator[](size_t row) {
+    PERFETTO_DCHECK(row < size_);
+    return chunks_[row >> kChunkShift].data()[row & kChunkMask];
+  }
+
+  const T& operator[](size_t row) const {
+    PERFETTO_DCHECK(row < size_);
+    return chunks_[row >> kChunkShift].data()[row & kChunkMask];
+  }
+
+  const T& at(size_t row) const {
+    PERFETTO_CHECK(row < size_);
+    return (*this)[row];
+  }
+
+  const T& front() const { return (*this)[0]; }
+  const T& back() const { return (*this)[size_ - 1]; }
+  T& back() { return (*this)[size_ - 1]; }
+
+  ConstIterator begin() const { return ConstIterator(this, 0); }
+  ConstIterator end() const { return ConstIterator(this, size_); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Calls |fn(const T* data, size_t count, uint32_t first_row)| for each
+  // contiguous run of rows in the range [start_row, end_row). |first_row| is
+  // the row index of data[0].
+  template <typename Fn /* (const T*, size_t, uint32_t) -> void */>
+  void ForEachSpan(uint32_t start_row, uint32_t end_row, Fn fn) const {
+    PERFETTO_DCHECK(start_row <= end_row && end_row <= size_);
+    uint32_t row = start_row;
+    while (row < end_row) {
+      const size_t chunk_idx = row >> kChunkShift;
+      const size_t offset = row & kChunkMask;
+      const size_t count =
+          std::min(kChunkSize - offset, static_cast<size_t>(end_row - row));
+      fn(&chunks_[chunk_idx].data()[offset], count, row);
+      row += static_cast<uint32_t>(count);
+    }
+  }
+
+ private:
+  // A block of kChunkSize elements. The backing allocation is over-sized by
+  // kAlignment bytes so that the start of the data can be cache line aligned
+  // without requiring C++17 aligned new.
+  class Chunk {
+   public:
+    Chunk()
+        : storage_(new uint8_t[sizeof(T) * kChunkSize + kAlignment]),
+          data_(reinterpret_cast<T*>(base::AlignUp<kAlignment>(
+              reinterpret_cast<uintptr_t>(storage_.get())))) {}
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+
+   private:
+    std::unique_ptr<uint8_t[]> storage_;
+    T* data_ = nullptr;
+  };
+
+  std::vector<Chunk> chunks_;
+  size_t size_ = 0;
+};
+
+}  // namespace trace_processor
+}  // namespace perfetto
+
+#endif  // SRC_TRACE_PROCESSOR_CHUNKED_COLUMN_H_
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/chunked_column.h"
+
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+namespace perfetto {
+namespace trace_processor {
+namespace {
+
+using Column = ChunkedColumn<int64_t>;
+
+TEST(ChunkedColumnTest, Empty) {
+  Column column;
+  ASSERT_TRUE(column.empty());
+  ASSERT_EQ(column.size(), 0u);
+  ASSERT_EQ(column.begin(), column.end());
+}
+
+TEST(ChunkedColumnTest, AppendAndRetrieve) {
+  Column column;
+  const size_t kRows = Column::kChunkSize * 3 + 7;
+  for (size_t i = 0; i < kRows; i++)
+    column.emplace_back(static_cast<int64_t>(i * 2));
+
+  ASSERT_EQ(column.size(), kRows);
+  ASSERT_EQ(column.front(), 0);
+  ASSERT_EQ(column.back(), static_cast<int64_t>((kRows - 1) * 2));
+  for (size_t i = 0; i < kRows; i++)
+    ASSERT_EQ(column[i], static_cast<int64_t>(i * 2));
+}
+
+TEST(ChunkedColumnTest, RowsAreStable) {
+  Column column;
+  column.emplace_back(42);
+  const int64_t* first = &column[0];
+  for (size_t i = 0; i < Column::kChunkSize * 4; i++)
+    column.emplace_back(0);
+  ASSERT_EQ(first, &column[0]);
+  ASSERT_EQ(*first, 42);
+}
+
+TEST(ChunkedColumnTest, ChunksAreAligned) {
+  ChunkedColumn<uint8_t> column;
+  for (size_t i = 0; i < ChunkedColumn<uint8_t>::kChunkSize * 2; i++)
+    column.emplace_back(static_cast<uint8_t>(i));
+  column.ForEachSpan(0, static_cast<uint32_t>(column.size()),
+                     [](const uint8_t* data, size_t, uint32_t) {
+                       ASSERT_EQ(reinterpret_cast<uintptr_t>(data) %
+                                     ChunkedColumn<uint8_t>::kAlignment,
+                                 0u);
+                     });
+}
+
+TEST(ChunkedColumnTest, ModifyInPlace) {
+  Column column;
+  column.emplace_back(1);
+  column.emplace_back(2);
+  column[0] = 10;
+  column.back() = 20;
+  ASSERT_EQ(column[0], 10);
+  ASSERT_EQ(column[1], 20);
+}
+
+TEST(ChunkedColumnTest, ForEachSpan) {
+  Column column;
+  const uint32_t kRows = Column::kChunkSize * 2 + 100;
+  for (uint32_t i = 0; i < kRows; i++)
+    column.emplace_back(i);
+
+  // Start and end in the middle of a chunk and check that every row in range
+  // is visited exactly once and in order.
+  const uint32_t kStart = 10;
+  const uint32_t kEnd = kRows - 10;
+  uint32_t next_row = kStart;
+  size_t spans = 0;
+  column.ForEachSpan(kStart, kEnd,
+                     [&](const int64_t* data, size_t count, uint32_t row) {
+                       ASSERT_EQ(row, next_row);
+                       for (size_t i = 0; i < count; i++)
+                         ASSERT_EQ(data[i], row + i);
+                       next_row += static_cast<uint32_t>(count);
+                       spans++;
+                     });
+  ASSERT_EQ(next_row, kEnd);
+  ASSERT_EQ(spans, 3u);
+}
+
+TEST(ChunkedColumnTest, SortedSearch) {
+  Column column;
+  const size_t kRows = Column::kChunkSize * 2 + 3;
+  for (size_t i = 0; i < kRows; i++)
+    column.emplace_back(static_cast<int64_t>(i / 2));
+
+  auto it = std::lower_bound(column.begin(), column.end(), 1000);
+  ASSERT_EQ(std::distance(column.begin(), it), 2000);
+  it = std::upper_bound(column.begin(), column.end(), 1000);
+  ASSERT_EQ(std::distance(column.begin(), it), 2002);
+
+  auto minmax = std::minmax_element(column.begin(), column.end());
+  ASSERT_EQ(*minmax.first, 0);
+  ASSERT_EQ(*minmax.second, static_cast<int64_t>((kRows - 1) / 2));
+}
+
+TEST(ChunkedColumnTest, Copy) {
+  Column column;
+  for (size_t i = 0; i < Column::kChunkSize + 1; i++)
+    column.emplace_back(static_cast<int64_t>(i));
+
+  Column copy;
+  copy.emplace_back(-1);
+  copy = column;
+  column[0] = 100;
+  ASSERT_EQ(copy.size(), column.size());
+  ASSERT_EQ(copy[0], 0);
+  ASSERT_EQ(copy.back(), static_cast<int64_t>(Column::kChunkSize));
+
+  copy = Column();
+  ASSERT_TRUE(copy.empty());
+}
+
+}  // namespace
+}  // namespace trace_processor
+}  // namespace perfetto
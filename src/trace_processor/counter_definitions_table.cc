@@ -88,10 +88,11 @@ uint32_t CounterDefinitionsTable::EstimateCost(const QueryConstraints& qc) {
   return RowCount();
 }
 
-CounterDefinitionsTable::RefColumn::RefColumn(std::string col_name,
-                                              const std::deque<int64_t>* refs,
-                                              const std::deque<RefType>* types,
-                                              const TraceStorage* storage)
+CounterDefinitionsTable::RefColumn::RefColumn(
+    std::string col_name,
+    const ChunkedColumn<int64_t>* refs,
+    const ChunkedColumn<RefType>* types,
+    const TraceStorage* storage)
     : StorageColumn(col_name, false /* hidden */),
       refs_(refs),
       types_(types),
@@ -17,7 +17,6 @@
 #ifndef SRC_TRACE_PROCESSOR_COUNTER_DEFINITIONS_TABLE_H_
 #define SRC_TRACE_PROCESSOR_COUNTER_DEFINITIONS_TABLE_H_
 
-#include <deque>
 #include <memory>
 #include <string>
 #include <vector>
@@ -41,8 +40,8 @@ class CounterDefinitionsTable : public StorageTable {
   class RefColumn final : public StorageColumn {
    public:
     RefColumn(std::string col_name,
-              const std::deque<int64_t>* refs,
-              const std::deque<RefType>* types,
+              const ChunkedColumn<int64_t>* refs,
+              const ChunkedColumn<RefType>* types,
               const TraceStorage* storage);
 
     void ReportResult(sqlite3_context* ctx, uint32_t row) const override;
@@ -62,8 +61,8 @@ class CounterDefinitionsTable : public StorageTable {
    private:
     int CompareRefsAsc(uint32_t f, uint32_t s) const;
 
-    const std::deque<int64_t>* refs_;
-    const std::deque<RefType>* types_;
+    const ChunkedColumn<int64_t>* refs_;
+    const ChunkedColumn<RefType>* types_;
     const TraceStorage* storage_ = nullptr;
   };
 
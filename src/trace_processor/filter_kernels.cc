@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/filter_kernels.h"
+
+#include "perfetto/base/build_config.h"
+
+// The SIMD kernels are compiled with per-function target attributes (so that
+// the rest of the binary doesn't require SSE4.2/AVX2) and selected at runtime.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__)) &&  \
+    !PERFETTO_BUILDFLAG(PERFETTO_OS_WASM)
+#define PERFETTO_TP_X86_FILTER_KERNELS() 1
+#include <immintrin.h>
+#else
+#define PERFETTO_TP_X86_FILTER_KERNELS() 0
+#endif
+
+namespace perfetto {
+namespace trace_processor {
+namespace filter_kernels {
+
+namespace {
+
+Isa g_max_isa = Isa::kAvx2;
+
+Isa DetectIsa() {
+#if PERFETTO_TP_X86_FILTER_KERNELS()
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return Isa::kAvx2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return Isa::kSse42;
+#endif
+  return Isa::kScalar;
+}
+
+Isa SelectedIsa() {
+  Isa supported = GetSupportedIsa();
+  return static_cast<int>(supported) < static_cast<int>(g_max_isa) ? supported
+                                                                    : g_max_isa;
+}
+
+// Runs |Kernel| on each full block of 64 values and the scalar kernel on the
+// trailing partial block, if any.
+template <typename Kernel, CompareOp kOp, typename T>
+void CompareBlocks(const T* data,
+                   size_t count,
+                   T value,
+                   uint64_t* words,
+                   size_t bit_offset) {
+  size_t i = 0;
+  for (; i + 64 <= count; i += 64) {
+    uint64_t mask = Kernel::template Block<kOp>(data + i, value);
+    internal::OrBits(words, bit_offset + i, mask);
+  }
+  if (i < count) {
+    uint64_t mask =
+        internal::CompareBlockScalar(kOp, data + i, count - i, value);
+    internal::OrBits(words, bit_offset + i, mask);
+  }
+}
+
+template <typename Kernel, typename T>
+void RunKernel(CompareOp op,
+               const T* data,
+               size_t count,
+               T value,
+               uint64_t* words,
+               size_t bit_offset) {
+  switch (op) {
+    case CompareOp::kEq:
+      return CompareBlocks<Kernel, CompareOp::kEq>(data, count, value, words,
+                                                   bit_offset);
+    case CompareOp::kNe:
+      return CompareBlocks<Kernel, CompareOp::kNe>(data, count, value, words,
+                                                   bit_offset);
+    case CompareOp::kLt:
+      return CompareBlocks<Kernel, CompareOp::kLt>(data, count, value, words,
+                                                   bit_offset);
+    case CompareOp::kLe:
+      return CompareBlocks<Kernel, CompareOp::kLe>(data, count, value, words,
+                                                   bit_offset);
+    case CompareOp::kGt:
+      return CompareBlocks<Kernel, CompareOp::kGt>(data, count, value, words,
+                                                   bit_offset);
+    case CompareOp::kGe:
+      return CompareBlocks<Kernel, CompareOp::kGe>(data, count, value, words,
+                                                   bit_offset);
+  }
+}
+
+// Integer SIMD instructions only provide == and >. The other comparisons are
+// computed by swapping the operands (<) and/or negating the result (!=, <=
+// and >=).
+constexpr bool IsNegatedOp(CompareOp op) {
+  return op == CompareOp::kNe || op == CompareOp::kLe || op == CompareOp::kGe;
+}
+
+constexpr bool IsEqualityOp(CompareOp op) {
+  return op == CompareOp::kEq || op == CompareOp::kNe;
+}
+
+constexpr bool IsGreaterOp(CompareOp op) {
+  return op == CompareOp::kGt || op == CompareOp::kLe;
+}
+
+#if PERFETTO_TP_X86_FILTER_KERNELS()
+
+constexpr int AvxCmpPredicate(CompareOp op) {
+  return op == CompareOp::kEq
+             ? _CMP_EQ_OQ
+             : op == CompareOp::kNe
+                   ? _CMP_NEQ_UQ
+                   : op == CompareOp::kLt
+                         ? _CMP_LT_OQ
+                         : op == CompareOp::kLe
+                               ? _CMP_LE_OQ
+                               : op == CompareOp::kGt ? _CMP_GT_OQ
+                                                      : _CMP_GE_OQ;
+}
+
+struct Int64Avx2 {
+  template <CompareOp kOp>
+  __attribute__((target("avx2"))) static uint64_t Block(const int64_t* data,
+                                                        int64_t value) {
+    const __m256i v = _mm256_set1_epi64x(value);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; i += 4) {
+      __m256i d =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+      __m256i res = IsEqualityOp(kOp)
+                        ? _mm256_cmpeq_epi64(d, v)
+                        : IsGreaterOp(kOp) ? _mm256_cmpgt_epi64(d, v)
+                                           : _mm256_cmpgt_epi64(v, d);
+      auto bits = _mm256_movemask_pd(_mm256_castsi256_pd(res));
+      mask |= static_cast<uint64_t>(bits) << i;
+    }
+    return IsNegatedOp(kOp) ? ~mask : mask;
+  }
+};
+
+struct Uint32Avx2 {
+  template <CompareOp kOp>
+  __attribute__((target("avx2"))) static uint64_t Block(const uint32_t* data,
+                                                        uint32_t value) {
+    // There is no unsigned comparison: flipping the sign bit of both operands
+    // maps the unsigned ordering onto the signed one.
+    const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+    const __m256i v = _mm256_xor_si256(
+        _mm256_set1_epi32(static_cast<int32_t>(value)), bias);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; i += 8) {
+      __m256i d = _mm256_xor_si256(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)),
+          bias);
+      __m256i res = IsEqualityOp(kOp)
+                        ? _mm256_cmpeq_epi32(d, v)
+                        : IsGreaterOp(kOp) ? _mm256_cmpgt_epi32(d, v)
+                                           : _mm256_cmpgt_epi32(v, d);
+      auto bits = _mm256_movemask_ps(_mm256_castsi256_ps(res));
+      mask |= static_cast<uint64_t>(bits) << i;
+    }
+    return IsNegatedOp(kOp) ? ~mask : mask;
+  }
+};
+
+struct DoubleAvx2 {
+  // Floating point comparisons are done directly (rather than negated) so
+  // that NaNs behave exactly as in the scalar version.
+  template <CompareOp kOp>
+  __attribute__((target("avx2"))) static uint64_t Block(const double* data,
+                                                        double value) {
+    const __m256d v = _mm256_set1_pd(value);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; i += 4) {
+      __m256d d = _mm256_loadu_pd(data + i);
+      __m256d res = _mm256_cmp_pd(d, v, AvxCmpPredicate(kOp));
+      mask |= static_cast<uint64_t>(_mm256_movemask_pd(res)) << i;
+    }
+    return mask;
+  }
+};
+
+struct Int64Sse42 {
+  template <CompareOp kOp>
+  __attribute__((target("sse4.2"))) static uint64_t Block(const int64_t* data,
+                                                          int64_t value) {
+    const __m128i v = _mm_set1_epi64x(value);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; i += 2) {
+      __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+      __m128i res = IsEqualityOp(kOp)
+                        ? _mm_cmpeq_epi64(d, v)
+                        : IsGreaterOp(kOp) ? _mm_cmpgt_epi64(d, v)
+                                           : _mm_cmpgt_epi64(v, d);
+      auto bits = _mm_movemask_pd(_mm_castsi128_pd(res));
+      mask |= static_cast<uint64_t>(bits) << i;
+    }
+    return IsNegatedOp(kOp) ? ~mask : mask;
+  }
+};
+
+struct Uint32Sse42 {
+  template <CompareOp kOp>
+  __attribute__((target("sse4.2"))) static uint64_t Block(const uint32_t* data,
+                                                          uint32_t value) {
+    // See Uint32Avx2 for the reason of the bias.
+    const __m128i bias = _mm_set1_epi32(INT32_MIN);
+    const __m128i v =
+        _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(value)), bias);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; i += 4) {
+      __m128i d = _mm_xor_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), bias);
+      __m128i res = IsEqualityOp(kOp)
+                        ? _mm_cmpeq_epi32(d, v)
+                        : IsGreaterOp(kOp) ? _mm_cmpgt_epi32(d, v)
+                                           : _mm_cmpgt_epi32(v, d);
+      auto bits = _mm_movemask_ps(_mm_castsi128_ps(res));
+      mask |= static_cast<uint64_t>(bits) << i;
+    }
+    return IsNegatedOp(kOp) ? ~mask : mask;
+  }
+};
+
+struct DoubleSse42 {
+  template <CompareOp kOp>
+  __attribute__((target("sse4.2"))) static __m128d Compare(__m128d d,
+                                                           __m128d v) {
+    switch (kOp) {
+      case CompareOp::kEq:
+        return _mm_cmpeq_pd(d, v);
+      case CompareOp::kNe:
+        return _mm_cmpneq_pd(d, v);
+      case CompareOp::kLt:
+        return _mm_cmplt_pd(d, v);
+      case CompareOp::kLe:
+        return _mm_cmple_pd(d, v);
+      case CompareOp::kGt:
+        return _mm_cmpgt_pd(d, v);
+      case CompareOp::kGe:
+        return _mm_cmpge_pd(d, v);
+    }
+    return _mm_setzero_pd();
+  }
+
+  template <CompareOp kOp>
+  __attribute__((target("sse4.2"))) static uint64_t Block(const double* data,
+                                                          double value) {
+    const __m128d v = _mm_set1_pd(value);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; i += 2) {
+      __m128d res = Compare<kOp>(_mm_loadu_pd(data + i), v);
+      mask |= static_cast<uint64_t>(_mm_movemask_pd(res)) << i;
+    }
+    return mask;
+  }
+};
+
+#endif  // PERFETTO_TP_X86_FILTER_KERNELS()
+
+}  // namespace
+
+Isa GetSupportedIsa() {
+  static const Isa isa = DetectIsa();
+  return isa;
+}
+
+void SetMaxIsaForTesting(Isa isa) {
+  g_max_isa = isa;
+}
+
+void CompareInto(CompareOp op,
+                 const int64_t* data,
+                 size_t count,
+                 int64_t value,
+                 uint64_t* words,
+                 size_t bit_offset) {
+#if PERFETTO_TP_X86_FILTER_KERNELS()
+  switch (SelectedIsa()) {
+    case Isa::kAvx2:
+      return RunKernel<Int64Avx2>(op, data, count, value, words, bit_offset);
+    case Isa::kSse42:
+      return RunKernel<Int64Sse42>(op, data, count, value, words, bit_offset);
+    case Isa::kScalar:
+      break;
+  }
+#endif
+  CompareInto<int64_t>(op, data, count, value, words, bit_offset);
+}
+
+void CompareInto(CompareOp op,
+                 const uint32_t* data,
+                 size_t count,
+                 uint32_t value,
+                 uint64_t* words,
+                 size_t bit_offset) {
+#if PERFETTO_TP_X86_FILTER_KERNELS()
+  switch (SelectedIsa()) {
+    case Isa::kAvx2:
+      return RunKernel<Uint32Avx2>(op, data, count, value, words, bit_offset);
+    case Isa::kSse42:
+      return RunKernel<Uint32Sse42>(op, data, count, value, words, bit_offset);
+    case Isa::kScalar:
+      break;
+  }
+#endif
+  CompareInto<uint32_t>(op, data, count, value, words, bit_offset);
+}
+
+void CompareInto(CompareOp op,
+                 const double* data,
+                 size_t count,
+                 double value,
+                 uint64_t* words,
+                 size_t bit_offset) {
+#if PERFETTO_TP_X86_FILTER_KERNELS()
+  switch (SelectedIsa()) {
+    case Isa::kAvx2:
+      return RunKernel<DoubleAvx2>(op, data, count, value, words, bit_offset);
+    case Isa::kSse42:
+      return RunKernel<DoubleSse42>(op, data, count, value, words, bit_offset);
+    case Isa::kScalar:
+      break;
+  }
+#endif
+  CompareInto<double>(op, data, count, value, words, bit_offset);
+}
+
+}  // namespace filter_kernels
+}  // namespace trace_processor
+}  // namespace perfetto
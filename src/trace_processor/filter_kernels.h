@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACE_PROCESSOR_FILTER_KERNELS_H_
+#define SRC_TRACE_PROCESSOR_FILTER_KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+namespace perfetto {
+namespace trace_processor {
+namespace filter_kernels {
+
+// Comparison kernels used to filter numeric columns. Each kernel compares a
+// contiguous span of values against a constant and produces a packed bitmap
+// (bit i of the bitmap is stored in bit (i % 64) of word (i / 64)) rather than
+// evaluating a predicate row by row.
+//
+// Kernels for int64_t, uint32_t and double have SSE4.2 and AVX2 versions which
+// are selected at runtime based on the CPU. All the other types (and CPUs
+// without those extensions) use a portable, branch-free scalar version.
+
+enum class CompareOp { kEq, kNe, kLt, kLe, kGt, kGe };
+
+// The instruction sets the kernels can be implemented with, in increasing
+// order of preference.
+enum class Isa { kScalar = 0, kSse42 = 1, kAvx2 = 2 };
+
+// Returns the best instruction set supported by this CPU.
+Isa GetSupportedIsa();
+
+// Restricts the instruction sets used by the kernels to |isa| or lower. Used by
+// tests and benchmarks to compare the different implementations.
+void SetMaxIsaForTesting(Isa isa);
+
+namespace internal {
+
+// ORs the |mask| (a block of up to 64 results) into the bitmap at
+// |bit_offset|. |bit_offset| doesn't need to be a multiple of 64.
+inline void OrBits(uint64_t* words, size_t bit_offset, uint64_t mask) {
+  const size_t word = bit_offset / 64;
+  const size_t shift = bit_offset % 64;
+  words[word] |= mask << shift;
+  if (shift != 0 && (mask >> (64 - shift)) != 0)
+    words[word + 1] |= mask >> (64 - shift);
+}
+
+template <typename T, typename Comparator>
+inline uint64_t CompareBlock(const T* data, size_t count, Comparator cmp) {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < count; i++)
+    mask |= static_cast<uint64_t>(cmp(data[i])) << i;
+  return mask;
+}
+
+// Compares up to 64 values and returns the results as a bitmask.
+template <typename T>
+uint64_t CompareBlockScalar(CompareOp op,
+                            const T* data,
+                            size_t count,
+                            T value) {
+  switch (op) {
+    case CompareOp::kEq:
+      return CompareBlock(data, count, [value](T v) { return v == value; });
+    case CompareOp::kNe:
+      return CompareBlock(data, count, [value](T v) { return v != value; });
+    case CompareOp::kLt:
+      return CompareBlock(data, count, [value](T v) { return v < value; });
+    case CompareOp::kLe:
+      return CompareBlock(data, count, [value](T v) { return v <= value; });
+    case CompareOp::kGt:
+      return CompareBlock(data, count, [value](T v) { return v > value; });
+    case CompareOp::kGe:
+      return CompareBlock(data, count, [value](T v) { return v >= value; });
+  }
+  return 0;
+}
+
+}  // namespace internal
+
+// Compares the |count| values starting at |data| with |value| and sets the bit
+// |bit_offset| + i in |words| for each data[i] which satisfies |op|. Bits of
+// values not satisfying |op| are left untouched so |words| should be zeroed by
+// the caller.
+void CompareInto(CompareOp op,
+                 const int64_t* data,
+                 size_t count,
+                 int64_t value,
+                 uint64_t* words,
+                 size_t bit_offset);
+void CompareInto(CompareOp op,
+                 const uint32_t* data,
+                 size_t count,
+                 uint32_t value,
+                 uint64_t* words,
+                 size_t bit_offset);
+void CompareInto(CompareOp op,
+                 const double* data,
+                 size_t count,
+                 double value,
+                 uint64_t* words,
+                 size_t bit_offset);
+
+// Portable version for the types without a specialized kernel.
+template <typename T>
+void CompareInto(CompareOp op,
+                 const T* data,
+                 size_t count,
+                 T value,
+                 uint64_t* words,
+                 size_t bit_offset) {
+  for (size_t i = 0; i < count; i += 64) {
+    size_t block_size = std::min<size_t>(64, count - i);
+    uint64_t mask =
+        internal::CompareBlockScalar(op, data + i, block_size, value);
+    internal::OrBits(words, bit_offset + i, mask);
+  }
+}
+
+}  // namespace filter_kernels
+}  // namespace trace_processor
+}  // namespace perfetto
+
+#endif  // SRC_TRACE_PROCESSOR_FILTER_KERNELS_H_
@@ -0,0 +1,100 @@
+// Copyright (C) 2019 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "src/trace_processor/chunked_column.h"
+#include "src/trace_processor/filter_kernels.h"
+#include "src/trace_processor/filtered_row_index.h"
+#include "src/trace_processor/sqlite_utils.h"
+
+namespace {
+
+using perfetto::trace_processor::ChunkedColumn;
+using perfetto::trace_processor::FilteredRowIndex;
+namespace filter_kernels = perfetto::trace_processor::filter_kernels;
+
+constexpr uint32_t kRows = 1024 * 1024;
+
+template <typename T>
+ChunkedColumn<T> CreateColumn() {
+  std::minstd_rand0 rnd(0);
+  ChunkedColumn<T> column;
+  for (uint32_t i = 0; i < kRows; i++)
+    column.emplace_back(static_cast<T>(rnd() % 1000));
+  return column;
+}
+
+// The row-by-row path used by NumericColumn before the kernels: a
+// NumericPredicate called through FilteredRowIndex::FilterRows().
+template <typename T, typename UpcastT>
+void BM_FilterPredicate(benchmark::State& state) {
+  ChunkedColumn<T> column = CreateColumn<T>();
+  perfetto::trace_processor::sqlite_utils::NumericPredicate<UpcastT> predicate(
+      SQLITE_INDEX_CONSTRAINT_LT, 500);
+
+  for (auto _ : state) {
+    FilteredRowIndex index(0, kRows);
+    index.FilterRows([&column, &predicate](uint32_t row) {
+      return predicate(static_cast<UpcastT>(column[row]));
+    });
+    benchmark::DoNotOptimize(index);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * kRows);
+}
+
+// The kernels writing into a bitmap, state.range(0) is the filter_kernels::Isa
+// to use.
+template <typename T>
+void BM_FilterKernel(benchmark::State& state) {
+  auto isa = static_cast<filter_kernels::Isa>(state.range(0));
+  if (state.range(0) > static_cast<int>(filter_kernels::GetSupportedIsa())) {
+    state.SkipWithError("Instruction set not supported");
+    return;
+  }
+  filter_kernels::SetMaxIsaForTesting(isa);
+
+  ChunkedColumn<T> column = CreateColumn<T>();
+  std::vector<uint64_t> words(kRows / 64);
+  for (auto _ : state) {
+    std::fill(words.begin(), words.end(), 0);
+    column.ForEachSpan(0, kRows,
+                       [&words](const T* data, size_t count, uint32_t row) {
+                         filter_kernels::CompareInto(
+                             filter_kernels::CompareOp::kLt, data, count,
+                             static_cast<T>(500), words.data(), row);
+                       });
+    benchmark::DoNotOptimize(words.data());
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * kRows);
+  filter_kernels::SetMaxIsaForTesting(filter_kernels::Isa::kAvx2);
+}
+
+void IsaArgs(benchmark::internal::Benchmark* b) {
+  b->Arg(static_cast<int>(filter_kernels::Isa::kScalar));
+  b->Arg(static_cast<int>(filter_kernels::Isa::kSse42));
+  b->Arg(static_cast<int>(filter_kernels::Isa::kAvx2));
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_FilterPredicate, int64_t, int64_t);
+BENCHMARK_TEMPLATE(BM_FilterKernel, int64_t)->Apply(IsaArgs);
+BENCHMARK_TEMPLATE(BM_FilterPredicate, uint32_t, int64_t);
+BENCHMARK_TEMPLATE(BM_FilterKernel, uint32_t)->Apply(IsaArgs);
+BENCHMARK_TEMPLATE(BM_FilterPredicate, double, double);
+BENCHMARK_TEMPLATE(BM_FilterKernel, double)->Apply(IsaArgs);
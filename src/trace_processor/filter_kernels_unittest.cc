@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/filter_kernels.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace perfetto {
+namespace trace_processor {
+namespace filter_kernels {
+namespace {
+
+const CompareOp kAllOps[] = {CompareOp::kEq, CompareOp::kNe, CompareOp::kLt,
+                             CompareOp::kLe, CompareOp::kGt, CompareOp::kGe};
+
+template <typename T>
+bool Reference(CompareOp op, T a, T b) {
+  switch (op) {
+    case CompareOp::kEq:
+      return a == b;
+    case CompareOp::kNe:
+      return a != b;
+    case CompareOp::kLt:
+      return a < b;
+    case CompareOp::kLe:
+      return a <= b;
+    case CompareOp::kGt:
+      return a > b;
+    case CompareOp::kGe:
+      return a >= b;
+  }
+  return false;
+}
+
+// Runs every op against every value in |constants| for a number of offsets
+// and lengths (to cover both the SIMD blocks and the scalar tails) and checks
+// the bitmap against the reference implementation.
+template <typename T>
+void CheckAllOps(const std::vector<T>& data, const std::vector<T>& constants) {
+  for (size_t bit_offset : {0u, 1u, 13u, 63u, 64u, 100u}) {
+    for (size_t count : {0u, 1u, 7u, 63u, 64u, 65u, 200u}) {
+      ASSERT_LE(count, data.size());
+      for (T constant : constants) {
+        for (CompareOp op : kAllOps) {
+          std::vector<uint64_t> words((bit_offset + count + 63) / 64 + 1);
+          CompareInto(op, data.data(), count, constant, words.data(),
+                      bit_offset);
+          for (size_t i = 0; i < words.size() * 64; i++) {
+            bool bit = (words[i / 64] >> (i % 64)) & 1;
+            bool expected = i >= bit_offset && i < bit_offset + count &&
+                            Reference(op, data[i - bit_offset], constant);
+            ASSERT_EQ(bit, expected)
+                << "op " << static_cast<int>(op) << " bit " << i << " count "
+                << count << " offset " << bit_offset;
+          }
+        }
+      }
+    }
+  }
+}
+
+class FilterKernelsTest : public ::testing::TestWithParam<Isa> {
+ public:
+  void SetUp() override {
+    if (static_cast<int>(GetParam()) >
+        static_cast<int>(GetSupportedIsa())) {
+      skip_ = true;
+      return;
+    }
+    SetMaxIsaForTesting(GetParam());
+  }
+  void TearDown() override { SetMaxIsaForTesting(Isa::kAvx2); }
+
+ protected:
+  bool skip_ = false;
+  std::minstd_rand0 rnd_{42};
+};
+
+TEST_P(FilterKernelsTest, Int64) {
+  if (skip_)
+    return;
+  std::vector<int64_t> data;
+  for (size_t i = 0; i < 200; i++)
+    data.push_back(static_cast<int64_t>(rnd_() % 16) - 8);
+  data[5] = std::numeric_limits<int64_t>::min();
+  data[6] = std::numeric_limits<int64_t>::max();
+  CheckAllOps<int64_t>(data, {-8, 0, 3, std::numeric_limits<int64_t>::min(),
+                              std::numeric_limits<int64_t>::max()});
+}
+
+TEST_P(FilterKernelsTest, Uint32) {
+  if (skip_)
+    return;
+  std::vector<uint32_t> data;
+  for (size_t i = 0; i < 200; i++)
+    data.push_back(static_cast<uint32_t>(rnd_() % 16));
+  // Values with the top bit set check that the comparisons are unsigned.
+  data[3] = 0x80000000u;
+  data[4] = std::numeric_limits<uint32_t>::max();
+  CheckAllOps<uint32_t>(data, {0, 7, 0x80000000u, 0xffffffffu});
+}
+
+TEST_P(FilterKernelsTest, Double) {
+  if (skip_)
+    return;
+  std::vector<double> data;
+  for (size_t i = 0; i < 200; i++)
+    data.push_back(static_cast<double>(rnd_() % 16) / 2);
+  data[10] = std::nan("");
+  data[11] = -std::numeric_limits<double>::infinity();
+  data[70] = -0.0;
+  CheckAllOps<double>(data, {0.0, 2.5, 3.25, std::nan("")});
+}
+
+TEST_P(FilterKernelsTest, GenericType) {
+  if (skip_)
+    return;
+  std::vector<int32_t> data;
+  for (size_t i = 0; i < 200; i++)
+    data.push_back(static_cast<int32_t>(rnd_() % 16) - 8);
+  CheckAllOps<int32_t>(data, {-8, 0, 3});
+}
+
+INSTANTIATE_TEST_SUITE_P(AllIsas,
+                         FilterKernelsTest,
+                         ::testing::Values(Isa::kScalar,
+                                           Isa::kSse42,
+                                           Isa::kAvx2));
+
+}  // namespace
+}  // namespace filter_kernels
+}  // namespace trace_processor
+}  // namespace perfetto
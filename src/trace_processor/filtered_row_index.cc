@@ -48,26 +48,25 @@ void FilteredRowIndex::IntersectRows(std::vector<uint32_t> rows) {
     return;
   }
 
-  // Initialise start to the beginning of the vector.
-  auto start = row_filter_.begin();
+  // Build a bitmap of |rows| in range of start and end and intersect it with
+  // the already filtered rows.
+  BitVector keep(end_row_ - start_row_);
+  auto begin = std::lower_bound(rows.begin(), rows.end(), start_row_);
+  for (auto it = begin; it != rows.end() && *it < end_row_; it++)
+    keep.Set(*it - start_row_);
+  row_filter_.And(keep);
+}
 
-  // Skip directly to the rows in range of start and end.
-  size_t i = 0;
-  for (; i < rows.size() && rows[i] < start_row_; i++) {
-  }
-  for (; i < rows.size() && rows[i] < end_row_; i++) {
-    // Unset all bits between the start iterator and the iterator pointing
-    // to the current row. That is, this loop sets all elements not pointed
-    // to by rows to false. It does not touch the rows themselves which
-    // means if they were already false (i.e. not returned) then they won't
-    // be returned now and if they were true (i.e. returned) they will still
-    // be returned.
-    auto row = rows[i];
-    auto end = row_filter_.begin() + static_cast<ptrdiff_t>(row - start_row_);
-    std::fill(start, end, false);
-    start = end + 1;
+void FilteredRowIndex::ApplyBitmap(BitVector bitmap) {
+  PERFETTO_DCHECK(mode_ == Mode::kAllRows || mode_ == Mode::kBitVector);
+  PERFETTO_DCHECK(bitmap.size() == end_row_ - start_row_);
+
+  if (mode_ == Mode::kAllRows) {
+    mode_ = Mode::kBitVector;
+    row_filter_ = std::move(bitmap);
+    return;
   }
-  std::fill(start, row_filter_.end(), false);
+  row_filter_.And(bitmap);
 }
 
 std::vector<uint32_t> FilteredRowIndex::ToRowVector() {
@@ -94,14 +93,11 @@ void FilteredRowIndex::ConvertBitVectorToRowVector() {
 
   mode_ = Mode::kRowVector;
 
-  auto b = row_filter_.begin();
-  auto e = row_filter_.end();
-  using std::find;
-  for (auto it = find(b, e, true); it != e; it = find(it + 1, e, true)) {
-    auto filter_idx = static_cast<uint32_t>(std::distance(b, it));
+  rows_.reserve(row_filter_.GetNumBitsSet());
+  row_filter_.ForEachSetBit([this](uint32_t filter_idx) {
     rows_.emplace_back(filter_idx + start_row_);
-  }
-  row_filter_.clear();
+  });
+  row_filter_ = BitVector();
 }
 
 std::unique_ptr<RowIterator> FilteredRowIndex::ToRowIterator(bool desc) {
@@ -136,12 +132,11 @@ std::vector<uint32_t> FilteredRowIndex::TakeRowVector() {
   return vector;
 }
 
-std::vector<bool> FilteredRowIndex::TakeBitVector() {
+BitVector FilteredRowIndex::TakeBitVector() {
   PERFETTO_DCHECK(error_.empty());
 
   PERFETTO_DCHECK(mode_ == Mode::kBitVector);
   auto filter = std::move(row_filter_);
-  row_filter_.clear();
   mode_ = Mode::kAllRows;
   return filter;
 }
@@ -24,6 +24,7 @@
 #include <vector>
 
 #include "perfetto/base/logging.h"
+#include "src/trace_processor/bit_vector.h"
 #include "src/trace_processor/row_iterators.h"
 
 namespace perfetto {
@@ -71,6 +72,26 @@ class FilteredRowIndex {
     }
   }
 
+  // Like FilterRows() but for filters which can compute their result for a
+  // contiguous range of rows at once (e.g. using the kernels in
+  // filter_kernels.h). |bitmap_fn(start_row, end_row, words)| should set bit
+  // (row - start_row) of the zeroed |words| for each row in
+  // [start_row, end_row) to be retained. |fn| is only used when the index
+  // has already been reduced to a sparse set of rows.
+  template <typename RowPredicate /* (uint32_t) -> bool */,
+            typename BitmapFn /* (uint32_t, uint32_t, uint64_t*) -> void */>
+  void FilterRowsWithBitmap(RowPredicate fn, BitmapFn bitmap_fn) {
+    PERFETTO_DCHECK(error_.empty());
+
+    if (mode_ == Mode::kRowVector) {
+      FilterRowVector(fn);
+      return;
+    }
+    BitVector bitmap(end_row_ - start_row_);
+    bitmap_fn(start_row_, end_row_, bitmap.mutable_words());
+    ApplyBitmap(std::move(bitmap));
+  }
+
   // Called when there is some error in the filter operation requested. The
   // error string is used by the coordinator to report the error to SQLite.
   void set_error(std::string error) { error_ = std::move(error); }
@@ -99,25 +120,20 @@ class FilteredRowIndex {
   template <typename Predicate>
   void FilterAllRows(Predicate fn) {
     mode_ = Mode::kBitVector;
-    row_filter_.resize(end_row_ - start_row_, false);
+    row_filter_ = BitVector(end_row_ - start_row_);
 
     for (auto i = start_row_; i < end_row_; i++) {
       if (fn(i))
-        row_filter_[i - start_row_] = true;
+        row_filter_.Set(i - start_row_);
     }
   }
 
   template <typename Predicate>
   void FilterBitVector(Predicate fn) {
-    auto b = row_filter_.begin();
-    auto e = row_filter_.end();
-
-    using std::find;
-    for (auto it = find(b, e, true); it != e; it = find(it + 1, e, true)) {
-      auto filter_idx = static_cast<uint32_t>(std::distance(b, it));
-      auto value_it = start_row_ + filter_idx;
-      *it = fn(value_it);
-    }
+    row_filter_.ForEachSetBit([this, &fn](uint32_t filter_idx) {
+      if (!fn(start_row_ + filter_idx))
+        row_filter_.Clear(filter_idx);
+    });
   }
 
   template <typename Predicate>
@@ -134,18 +150,22 @@ class FilteredRowIndex {
     rows_.resize(rows_size);
   }
 
+  // Intersects the rows in [start_row_, end_row_) with the set bits of
+  // |bitmap|.
+  void ApplyBitmap(BitVector bitmap);
+
   void ConvertBitVectorToRowVector();
 
   std::vector<uint32_t> TakeRowVector();
 
-  std::vector<bool> TakeBitVector();
+  BitVector TakeBitVector();
 
   Mode mode_;
   uint32_t start_row_;
   uint32_t end_row_;
 
   // Only non-empty when |mode_| == Mode::kBitVector.
-  std::vector<bool> row_filter_;
+  BitVector row_filter_;
 
   // Only non-empty when |mode_| == Mode::kRowVector.
   // This vector is sorted.
@@ -52,6 +52,30 @@ TEST(FilteredRowIndexUnittest, FilterRowsTwice) {
   ASSERT_THAT(index.ToRowVector(), ElementsAre(2));
 }
 
+TEST(FilteredRowIndexUnittest, FilterRowsWithBitmap) {
+  FilteredRowIndex index(1, 5);
+  auto bitmap_fn = [](uint32_t start, uint32_t end, uint64_t* words) {
+    ASSERT_EQ(start, 1u);
+    ASSERT_EQ(end, 5u);
+    words[0] = 0x6;  // Rows 2 and 3.
+  };
+  index.FilterRowsWithBitmap([](uint32_t) { return false; }, bitmap_fn);
+  ASSERT_THAT(index.ToRowVector(), ElementsAre(2, 3));
+}
+
+TEST(FilteredRowIndexUnittest, FilterRowsWithBitmapAfterIntersect) {
+  FilteredRowIndex index(1, 5);
+  index.IntersectRows({2, 3, 4});
+  bool bitmap_called = false;
+  index.FilterRowsWithBitmap(
+      [](uint32_t row) { return row != 3; },
+      [&bitmap_called](uint32_t, uint32_t, uint64_t*) {
+        bitmap_called = true;
+      });
+  ASSERT_FALSE(bitmap_called);
+  ASSERT_THAT(index.ToRowVector(), ElementsAre(2, 4));
+}
+
 TEST(FilteredRowIndexUnittest, FilterThenIntersect) {
   FilteredRowIndex index(1, 5);
   index.FilterRows([](uint32_t row) { return row == 2 || row == 3; });
@@ -91,6 +115,34 @@ TEST(FilteredRowIndexUnittest, ToIterator) {
   ASSERT_TRUE(iterator->IsEnd());
 }
 
+TEST(FilteredRowIndexUnittest, FilterThenToIterator) {
+  FilteredRowIndex index(1, 200);
+  index.FilterRows([](uint32_t row) { return row == 2 || row >= 150; });
+  index.FilterRows([](uint32_t row) { return row % 2 == 0; });
+  auto iterator = index.ToRowIterator(false);
+
+  std::vector<uint32_t> rows;
+  for (; !iterator->IsEnd(); iterator->NextRow())
+    rows.push_back(iterator->Row());
+  ASSERT_EQ(rows.size(), 26u);
+  ASSERT_EQ(rows.front(), 2u);
+  ASSERT_EQ(rows[1], 150u);
+  ASSERT_EQ(rows.back(), 198u);
+}
+
+TEST(FilteredRowIndexUnittest, FilterThenToIteratorDesc) {
+  FilteredRowIndex index(1, 200);
+  index.FilterRows([](uint32_t row) { return row == 2 || row == 64; });
+  index.IntersectRows({2, 64, 199});
+  auto iterator = index.ToRowIterator(true);
+
+  ASSERT_THAT(iterator->Row(), 64);
+  iterator->NextRow();
+  ASSERT_THAT(iterator->Row(), 2);
+  iterator->NextRow();
+  ASSERT_TRUE(iterator->IsEnd());
+}
+
 }  // namespace
 }  // namespace trace_processor
 }  // namespace perfetto
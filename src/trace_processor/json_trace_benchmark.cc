@@ -0,0 +1,115 @@
+// Copyright (C) 2019 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <json/reader.h>
+#include <json/value.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+#include "src/trace_processor/json_trace_utils.h"
+
+namespace {
+
+namespace json_trace_utils = perfetto::trace_processor::json_trace_utils;
+
+constexpr uint32_t kNumEvents = 64 * 1024;
+
+// Creates the body of the traceEvents array of a Chrome JSON trace, with
+// events similar to the ones of a real trace.
+std::string CreateTrace() {
+  static const char* const kNames[] = {
+      "ThreadControllerImpl::RunTask", "MessageLoop::RunTask",
+      "SequenceManager::DoIdleWork", "LayerTreeHost::UpdateLayers"};
+  static const char kPhases[] = {'B', 'E', 'X'};
+  std::minstd_rand0 rnd(0);
+  std::string trace;
+  double ts = 1000;
+  for (uint32_t i = 0; i < kNumEvents; i++) {
+    ts += (rnd() % 10000) / 1000.0;
+    trace += "{\"pid\":" + std::to_string(1000 + rnd() % 8) +
+             ",\"tid\":" + std::to_string(2000 + rnd() % 32) +
+             ",\"ts\":" + std::to_string(ts) + ",\"ph\":\"" +
+             kPhases[rnd() % 3] + "\",\"cat\":\"toplevel\",\"name\":\"" +
+             kNames[rnd() % 4] + "\",\"dur\":" + std::to_string(rnd() % 1000) +
+             ",\"args\":{\"src_file\":\"../../base/task/post_task.cc\","
+             "\"src_func\":\"PostTask\"}},\n";
+  }
+  return trace;
+}
+
+// Reads the fields of each event like the jsoncpp based importer did: a
+// Json::Value DOM is built for each event and then looked up by key.
+void BM_JsonTraceJsoncpp(benchmark::State& state) {
+  std::string trace = CreateTrace();
+  for (auto _ : state) {
+    const char* s = trace.data();
+    const char* end = s + trace.size();
+    while (s < end) {
+      const char* dict_end = strstr(s, "}},") + 2;
+      Json::Value value;
+      Json::Reader reader;
+      reader.parse(s, dict_end, value, /*collectComments=*/false);
+      benchmark::DoNotOptimize(value["ts"].asDouble());
+      benchmark::DoNotOptimize(value["dur"].asInt64());
+      benchmark::DoNotOptimize(value["pid"].asUInt());
+      benchmark::DoNotOptimize(value["tid"].asUInt());
+      benchmark::DoNotOptimize(*value["ph"].asCString());
+      benchmark::DoNotOptimize(value["cat"].asCString());
+      benchmark::DoNotOptimize(value["name"].asCString());
+      s = dict_end + 2;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(trace.size()));
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kNumEvents);
+}
+
+// Same as above, with the streaming scanner used by the JSON importer.
+void BM_JsonTraceScanner(benchmark::State& state) {
+  std::string trace = CreateTrace();
+  std::string scratch;
+  for (auto _ : state) {
+    const char* s = trace.data();
+    const char* end = s + trace.size();
+    json_trace_utils::JsonEvent event;
+    perfetto::base::StringView dict;
+    while (json_trace_utils::ReadOneJsonDict(s, end, &event, &dict, &s) ==
+           json_trace_utils::kFoundDict) {
+      benchmark::DoNotOptimize(json_trace_utils::CoerceToNs(event.ts));
+      benchmark::DoNotOptimize(json_trace_utils::CoerceToNs(event.dur));
+      benchmark::DoNotOptimize(json_trace_utils::CoerceToUint32(event.pid));
+      benchmark::DoNotOptimize(json_trace_utils::CoerceToUint32(event.tid));
+      benchmark::DoNotOptimize(
+          json_trace_utils::ReadString(event.ph, &scratch));
+      benchmark::DoNotOptimize(
+          json_trace_utils::ReadString(event.cat, &scratch));
+      benchmark::DoNotOptimize(
+          json_trace_utils::ReadString(event.name, &scratch));
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(trace.size()));
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kNumEvents);
+}
+
+}  // namespace
+
+BENCHMARK(BM_JsonTraceJsoncpp);
+BENCHMARK(BM_JsonTraceScanner);
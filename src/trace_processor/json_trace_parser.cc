@@ -17,8 +17,7 @@
 #include "src/trace_processor/json_trace_parser.h"
 
 #include <inttypes.h>
-#include <json/reader.h>
-#include <json/value.h>
+#include <string.h>
 
 #include <limits>
 #include <string>
@@ -52,37 +51,41 @@ void JsonTraceParser::ParseFtracePacket(uint32_t,
 
 void JsonTraceParser::ParseTracePacket(int64_t timestamp,
                                        TraceSorter::TimestampedTracePiece ttp) {
-  PERFETTO_DCHECK(ttp.json_value != nullptr);
-  const Json::Value& value = *(ttp.json_value);
+  using json_trace_utils::ReadString;
+
+  const char* begin = reinterpret_cast<const char*>(ttp.blob_view.data());
+  const char* end = begin + ttp.blob_view.length();
+  json_trace_utils::JsonEvent event;
+  base::StringView dict;
+  const char* next = nullptr;
+  if (json_trace_utils::ReadOneJsonDict(begin, end, &event, &dict, &next) !=
+      json_trace_utils::kFoundDict) {
+    PERFETTO_DFATAL("The tokenizer should have checked the event");
+    return;
+  }
 
   ProcessTracker* procs = context_->process_tracker.get();
   TraceStorage* storage = context_->storage.get();
   SliceTracker* slice_tracker = context_->slice_tracker.get();
 
-  auto& ph = value["ph"];
-  if (!ph.isString())
+  base::Optional<base::StringView> ph = ReadString(event.ph, &str_buf_);
+  if (!ph.has_value() || ph->empty())
     return;
-  char phase = *ph.asCString();
+  char phase = ph->at(0);
 
-  base::Optional<uint32_t> opt_pid;
-  base::Optional<uint32_t> opt_tid;
-
-  if (value.isMember("pid"))
-    opt_pid = json_trace_utils::CoerceToUint32(value["pid"]);
-  if (value.isMember("tid"))
-    opt_tid = json_trace_utils::CoerceToUint32(value["tid"]);
+  base::Optional<uint32_t> opt_pid =
+      json_trace_utils::CoerceToUint32(event.pid);
+  base::Optional<uint32_t> opt_tid =
+      json_trace_utils::CoerceToUint32(event.tid);
 
   uint32_t pid = opt_pid.value_or(0);
   uint32_t tid = opt_tid.value_or(pid);
 
-  base::StringView cat = value.isMember("cat")
-                             ? base::StringView(value["cat"].asCString())
-                             : base::StringView();
-  base::StringView name = value.isMember("name")
-                              ? base::StringView(value["name"].asCString())
-                              : base::StringView();
-
+  base::StringView cat =
+      ReadString(event.cat, &str_buf_).value_or(base::StringView());
   StringId cat_id = storage->InternString(cat);
+  base::StringView name =
+      ReadString(event.name, &name_buf_).value_or(base::StringView());
   StringId name_id = storage->InternString(name);
   UniqueTid utid = procs->UpdateThread(tid, pid);
 
@@ -97,22 +100,25 @@ void JsonTraceParser::ParseTracePacket(int64_t timestamp,
     }
     case 'X': {  // TRACE_EVENT (scoped event).
       base::Optional<int64_t> opt_dur =
-          json_trace_utils::CoerceToNs(value["dur"]);
+          json_trace_utils::CoerceToNs(event.dur);
       if (!opt_dur.has_value())
         return;
       slice_tracker->Scoped(timestamp, utid, cat_id, name_id, opt_dur.value());
       break;
     }
     case 'M': {  // Metadata events (process and thread names).
-      if (strcmp(value["name"].asCString(), "thread_name") == 0) {
-        const char* thread_name = value["args"]["name"].asCString();
-        auto thrad_name_id = context_->storage->InternString(thread_name);
+      // The args are only decoded here, and only the key we need.
+      base::StringView arg_name =
+          ReadString(json_trace_utils::FindDictValue(event.args, "name"),
+                     &str_buf_)
+              .value_or(base::StringView());
+      if (name == "thread_name") {
+        auto thrad_name_id = context_->storage->InternString(arg_name);
         procs->UpdateThread(timestamp, tid, thrad_name_id);
         break;
       }
-      if (strcmp(value["name"].asCString(), "process_name") == 0) {
-        const char* proc_name = value["args"]["name"].asCString();
-        procs->UpdateProcess(pid, base::nullopt, proc_name);
+      if (name == "process_name") {
+        procs->UpdateProcess(pid, base::nullopt, arg_name);
         break;
       }
     }
@@ -19,26 +19,17 @@
 
 #include <stdint.h>
 
-#include <memory>
-#include <tuple>
-#include <unordered_map>
+#include <string>
 
 #include "src/trace_processor/trace_parser.h"
 #include "src/trace_processor/trace_sorter.h"
 #include "src/trace_processor/trace_storage.h"
 
-namespace Json {
-class Value;
-}
-
 namespace perfetto {
 namespace trace_processor {
 
 class TraceProcessorContext;
 
-base::Optional<int64_t> CoerceToInt64(const Json::Value& value);
-base::Optional<uint32_t> CoerceToUint32(const Json::Value& value);
-
 // Parses legacy chrome JSON traces. The support for now is extremely rough
 // and supports only explicit TRACE_EVENT_BEGIN/END events.
 class JsonTraceParser : public TraceParser {
@@ -55,6 +46,10 @@ class JsonTraceParser : public TraceParser {
 
  private:
   TraceProcessorContext* const context_;
+
+  // Buffers for the strings of an event which contain escape sequences.
+  std::string name_buf_;
+  std::string str_buf_;
 };
 
 }  // namespace trace_processor
@@ -16,8 +16,7 @@
 
 #include "src/trace_processor/json_trace_tokenizer.h"
 
-#include <json/reader.h>
-#include <json/value.h>
+#include <string.h>
 
 #include "src/trace_processor/json_trace_utils.h"
 #include "src/trace_processor/trace_blob_view.h"
@@ -26,76 +25,27 @@
 namespace perfetto {
 namespace trace_processor {
 
-namespace {
-
-enum ReadDictRes { kFoundDict, kNeedsMoreData, kEndOfTrace, kFatalError };
-
-// Parses at most one JSON dictionary and returns a pointer to the end of it,
-// or nullptr if no dict could be detected.
-// This is to avoid decoding the full trace in memory and reduce heap traffic.
-// E.g.  input:  { a:1 b:{ c:2, d:{ e:3 } } } , { a:4, ... },
-//       output: [   only this is parsed    ] ^return value points here.
-ReadDictRes ReadOneJsonDict(const char* start,
-                            const char* end,
-                            Json::Value* value,
-                            const char** next) {
-  int braces = 0;
-  int square_brackets = 0;
-  const char* dict_begin = nullptr;
-  for (const char* s = start; s < end; s++) {
-    if (isspace(*s) || *s == ',')
-      continue;
-    if (*s == '{') {
-      if (braces == 0)
-        dict_begin = s;
-      braces++;
-      continue;
-    }
-    if (*s == '}') {
-      if (braces <= 0)
-        return kEndOfTrace;
-      if (--braces > 0)
-        continue;
-      Json::Reader reader;
-      if (!reader.parse(dict_begin, s + 1, *value, /*collectComments=*/false)) {
-        PERFETTO_ELOG("JSON error: %s",
-                      reader.getFormattedErrorMessages().c_str());
-        return kFatalError;
-      }
-      *next = s + 1;
-      return kFoundDict;
-    }
-    if (*s == '[') {
-      square_brackets++;
-      continue;
-    }
-    if (*s == ']') {
-      if (square_brackets == 0) {
-        // We've reached the end of [traceEvents] array.
-        // There might be other top level keys in the json (e.g. metadata)
-        // after.
-        // TODO(dproy): Handle trace metadata importing.
-        return kEndOfTrace;
-      }
-      square_brackets--;
-    }
-
-    // TODO(primiano): skip braces in quoted strings, e.g.: {"foo": "ba{z" }
-  }
-  return kNeedsMoreData;
-}
-
-}  // namespace
-
 JsonTraceTokenizer::JsonTraceTokenizer(TraceProcessorContext* ctx)
     : context_(ctx) {}
 JsonTraceTokenizer::~JsonTraceTokenizer() = default;
 
-bool JsonTraceTokenizer::Parse(std::unique_ptr<uint8_t[]> data, size_t size) {
-  buffer_.insert(buffer_.end(), data.get(), data.get() + size);
-  const char* buf = buffer_.data();
+bool JsonTraceTokenizer::Parse(TraceBlobView blob) {
+  // The events are passed to the sorter as slices of the chunk they were read
+  // from. If the last event of the previous chunk was incomplete, glue it
+  // together with the new chunk.
+  size_t size = blob.length();
+  if (!buffer_.empty()) {
+    std::unique_ptr<uint8_t[]> glued(new uint8_t[buffer_.size() + size]);
+    memcpy(glued.get(), buffer_.data(), buffer_.size());
+    memcpy(glued.get() + buffer_.size(), blob.data(), size);
+    size += buffer_.size();
+    blob = TraceBlobView(std::move(glued), 0, size);
+    buffer_.clear();
+  }
+
+  const char* buf = reinterpret_cast<const char*>(blob.data());
   const char* next = buf;
-  const char* end = buf + buffer_.size();
+  const char* end = buf + size;
 
   if (offset_ == 0) {
     // Trace could begin in any of these ways:
@@ -116,23 +66,26 @@ bool JsonTraceTokenizer::Parse(std::unique_ptr<uint8_t[]> data, size_t size) {
   auto* trace_sorter = context_->sorter.get();
 
   while (next < end) {
-    std::unique_ptr<Json::Value> value(new Json::Value());
-    const auto res = ReadOneJsonDict(next, end, value.get(), &next);
-    if (res == kFatalError)
+    json_trace_utils::JsonEvent event;
+    base::StringView dict;
+    const auto res =
+        json_trace_utils::ReadOneJsonDict(next, end, &event, &dict, &next);
+    if (res == json_trace_utils::kFatalError)
       return false;
-    if (res == kEndOfTrace || res == kNeedsMoreData)
+    if (res == json_trace_utils::kEndOfTrace ||
+        res == json_trace_utils::kNeedsMoreData)
       break;
 
-    base::Optional<int64_t> opt_ts =
-        json_trace_utils::CoerceToNs((*value)["ts"]);
+    base::Optional<int64_t> opt_ts = json_trace_utils::CoerceToNs(event.ts);
     PERFETTO_CHECK(opt_ts.has_value());
     int64_t ts = opt_ts.value();
 
-    trace_sorter->PushJsonValue(ts, std::move(value));
+    size_t dict_off = blob.offset() + static_cast<size_t>(dict.data() - buf);
+    trace_sorter->PushJsonEvent(ts, blob.slice(dict_off, dict.size()));
   }
 
   offset_ += static_cast<uint64_t>(next - buf);
-  buffer_.erase(buffer_.begin(), buffer_.begin() + (next - buf));
+  buffer_.assign(next, end);
   return true;
 }
 
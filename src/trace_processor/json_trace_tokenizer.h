@@ -23,30 +23,29 @@
 #include "src/trace_processor/trace_sorter.h"
 #include "src/trace_processor/trace_storage.h"
 
-namespace Json {
-class Value;
-}
-
 namespace perfetto {
 namespace trace_processor {
 
 class TraceProcessorContext;
 
-// Reads a JSON trace in chunks and extracts top level json objects.
+// Reads a JSON trace in chunks and extracts top level json objects, which are
+// passed as they are to the sorter. The objects are only scanned to find
+// their end and timestamp, see json_trace_utils::ReadOneJsonDict().
 class JsonTraceTokenizer : public ChunkedTraceReader {
  public:
   explicit JsonTraceTokenizer(TraceProcessorContext*);
   ~JsonTraceTokenizer() override;
 
   // ChunkedTraceReader implementation.
-  bool Parse(std::unique_ptr<uint8_t[]>, size_t) override;
+  bool Parse(TraceBlobView) override;
 
  private:
   TraceProcessorContext* const context_;
 
   uint64_t offset_ = 0;
-  // Used to glue together JSON objects that span across two (or more)
-  // Parse boundaries.
+  // The incomplete JSON object at the end of the last chunk, if any. Used to
+  // glue together JSON objects that span across two (or more) Parse
+  // boundaries.
   std::vector<char> buffer_;
 };
 
@@ -16,9 +16,14 @@
 
 #include "src/trace_processor/json_trace_utils.h"
 
-#include <json/value.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <limits>
 
+#include "perfetto/base/build_config.h"
+#include "perfetto/base/logging.h"
+
 #if !PERFETTO_BUILDFLAG(PERFETTO_STANDALONE_BUILD)
 #error The JSON trace parser is supported only in the standalone build for now.
 #endif
@@ -27,48 +32,394 @@ namespace perfetto {
 namespace trace_processor {
 namespace json_trace_utils {
 
-// Json trace event timestamps are in us.
-// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU/edit#heading=h.nso4gcezn7n1
-base::Optional<int64_t> CoerceToNs(const Json::Value& value) {
-  switch (static_cast<size_t>(value.type())) {
-    case Json::realValue:
-      return static_cast<int64_t>(value.asDouble() * 1000);
-    case Json::uintValue:
-    case Json::intValue:
-      return value.asInt64() * 1000;
-    case Json::stringValue: {
-      std::string s = value.asString();
-      char* end;
-      int64_t n = strtoll(s.c_str(), &end, 10);
-      if (end != s.data() + s.size())
-        return base::nullopt;
-      return n * 1000;
+namespace {
+
+enum ScanRes { kOk, kIncomplete, kInvalid };
+
+// Large enough for any number we care about, e.g. -1.2345678901234567e+308.
+constexpr size_t kMaxNumberSize = 64;
+
+inline bool IsWhitespace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline const char* SkipWhitespace(const char* s, const char* end) {
+  while (s < end && IsWhitespace(*s))
+    s++;
+  return s;
+}
+
+// Skips the string whose opening quote is at |s|.
+ScanRes SkipString(const char* s, const char* end, const char** next) {
+  PERFETTO_DCHECK(*s == '"');
+  for (s++; s < end; s++) {
+    if (*s == '\\') {
+      if (++s == end)
+        break;
+      continue;
     }
-    default:
-      return base::nullopt;
+    if (*s == '"') {
+      *next = s + 1;
+      return kOk;
+    }
+  }
+  return kIncomplete;
+}
+
+// Skips the value starting at |s|, which must not be whitespace.
+ScanRes SkipValue(const char* s, const char* end, const char** next) {
+  if (s == end)
+    return kIncomplete;
+  if (*s == '"')
+    return SkipString(s, end, next);
+
+  if (*s == '{' || *s == '[') {
+    uint32_t depth = 0;
+    while (s < end) {
+      const char c = *s;
+      if (c == '"') {
+        ScanRes res = SkipString(s, end, &s);
+        if (res != kOk)
+          return res;
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        if (--depth == 0) {
+          *next = s + 1;
+          return kOk;
+        }
+      }
+      s++;
+    }
+    return kIncomplete;
   }
+
+  // Numbers, true, false and null: a number at the end of the buffer might
+  // continue in the next chunk, so it's only complete once a delimiter is
+  // found.
+  const char* begin = s;
+  while (s < end && !IsWhitespace(*s) && *s != ',' && *s != '}' && *s != ']')
+    s++;
+  if (s == end)
+    return kIncomplete;
+  if (s == begin)
+    return kInvalid;
+  *next = s;
+  return kOk;
+}
+
+// Scans the dictionary whose opening brace is at |start| and calls
+// |fn(key, value)| for each of its entries, with |key| still escaped, until
+// |fn| returns false.
+template <typename Fn>
+ScanRes ScanDict(const char* start, const char* end, Fn fn, const char** next) {
+  PERFETTO_DCHECK(*start == '{');
+  const char* s = SkipWhitespace(start + 1, end);
+  if (s == end)
+    return kIncomplete;
+  if (*s == '}') {
+    *next = s + 1;
+    return kOk;
+  }
+  for (;;) {
+    if (*s != '"')
+      return kInvalid;
+    const char* key_begin = s;
+    ScanRes res = SkipString(s, end, &s);
+    if (res != kOk)
+      return res;
+    base::StringView key(key_begin + 1, static_cast<size_t>(s - key_begin) - 2);
+
+    s = SkipWhitespace(s, end);
+    if (s == end)
+      return kIncomplete;
+    if (*s != ':')
+      return kInvalid;
+    s = SkipWhitespace(s + 1, end);
+
+    const char* value_begin = s;
+    res = SkipValue(s, end, &s);
+    if (res != kOk)
+      return res;
+    if (!fn(key, base::StringView(value_begin,
+                                  static_cast<size_t>(s - value_begin)))) {
+      *next = s;
+      return kOk;
+    }
+
+    s = SkipWhitespace(s, end);
+    if (s == end)
+      return kIncomplete;
+    if (*s == '}') {
+      *next = s + 1;
+      return kOk;
+    }
+    if (*s != ',')
+      return kInvalid;
+    s = SkipWhitespace(s + 1, end);
+    if (s == end)
+      return kIncomplete;
+  }
+}
+
+// Copies the number |value| into |buf| as a null terminated string, as
+// strtoll() and strtod() need one.
+bool CopyNumber(base::StringView value, char (&buf)[kMaxNumberSize]) {
+  if (value.empty() || value.size() >= kMaxNumberSize)
+    return false;
+  memcpy(buf, value.data(), value.size());
+  buf[value.size()] = '\0';
+  return true;
+}
+
+base::Optional<int64_t> ParseInt(base::StringView value) {
+  char buf[kMaxNumberSize];
+  if (!CopyNumber(value, buf))
+    return base::nullopt;
+  char* end;
+  int64_t n = strtoll(buf, &end, 10);
+  if (end != buf + value.size())
+    return base::nullopt;
+  return n;
+}
+
+base::Optional<double> ParseDouble(base::StringView value) {
+  char buf[kMaxNumberSize];
+  if (!CopyNumber(value, buf))
+    return base::nullopt;
+  char* end;
+  double n = strtod(buf, &end);
+  if (end != buf + value.size())
+    return base::nullopt;
+  return n;
 }
 
-base::Optional<int64_t> CoerceToInt64(const Json::Value& value) {
-  switch (static_cast<size_t>(value.type())) {
-    case Json::realValue:
-    case Json::uintValue:
-    case Json::intValue:
-      return value.asInt64();
-    case Json::stringValue: {
-      std::string s = value.asString();
-      char* end;
-      int64_t n = strtoll(s.c_str(), &end, 10);
-      if (end != s.data() + s.size())
+bool IsString(base::StringView value) {
+  return value.size() >= 2 && value.at(0) == '"' &&
+         value.at(value.size() - 1) == '"';
+}
+
+bool IsReal(base::StringView value) {
+  for (size_t i = 0; i < value.size(); i++) {
+    const char c = value.at(i);
+    if (c == '.' || c == 'e' || c == 'E')
+      return true;
+  }
+  return false;
+}
+
+bool ParseHex4(base::StringView str, size_t pos, uint32_t* code_point) {
+  if (pos + 4 > str.size())
+    return false;
+  *code_point = 0;
+  for (size_t i = pos; i < pos + 4; i++) {
+    const char c = str.at(i);
+    uint32_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = static_cast<uint32_t>(c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      digit = static_cast<uint32_t>(c - 'a' + 10);
+    } else if (c >= 'A' && c <= 'F') {
+      digit = static_cast<uint32_t>(c - 'A' + 10);
+    } else {
+      return false;
+    }
+    *code_point = (*code_point << 4) | digit;
+  }
+  return true;
+}
+
+void AppendUtf8(uint32_t cp, std::string* out) {
+  if (cp < 0x80) {
+    out->push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+
+}  // namespace
+
+ReadDictRes ReadOneJsonDict(const char* start,
+                            const char* end,
+                            JsonEvent* event,
+                            base::StringView* dict,
+                            const char** next) {
+  for (const char* s = start; s < end; s++) {
+    if (IsWhitespace(*s) || *s == ',')
+      continue;
+    if (*s == ']' || *s == '}') {
+      // We've reached the end of [traceEvents] array.
+      // There might be other top level keys in the json (e.g. metadata)
+      // after.
+      // TODO(dproy): Handle trace metadata importing.
+      return kEndOfTrace;
+    }
+    if (*s != '{')
+      continue;
+
+    *event = JsonEvent();
+    auto fill_event = [event](base::StringView key, base::StringView value) {
+      if (key == "ph") {
+        event->ph = value;
+      } else if (key == "ts") {
+        event->ts = value;
+      } else if (key == "dur") {
+        event->dur = value;
+      } else if (key == "pid") {
+        event->pid = value;
+      } else if (key == "tid") {
+        event->tid = value;
+      } else if (key == "cat") {
+        event->cat = value;
+      } else if (key == "name") {
+        event->name = value;
+      } else if (key == "args") {
+        event->args = value;
+      }
+      return true;
+    };
+    const char* dict_end = nullptr;
+    switch (ScanDict(s, end, fill_event, &dict_end)) {
+      case kOk:
+        *dict = base::StringView(s, static_cast<size_t>(dict_end - s));
+        *next = dict_end;
+        return kFoundDict;
+      case kIncomplete:
+        return kNeedsMoreData;
+      case kInvalid:
+        PERFETTO_ELOG("JSON error: malformed trace event");
+        return kFatalError;
+    }
+  }
+  return kNeedsMoreData;
+}
+
+base::StringView FindDictValue(base::StringView dict, base::StringView key) {
+  const char* end = dict.data() + dict.size();
+  const char* s = SkipWhitespace(dict.data(), end);
+  if (s == end || *s != '{')
+    return base::StringView();
+
+  base::StringView found;
+  auto match_key = [&found, &key](base::StringView k, base::StringView value) {
+    if (k != key)
+      return true;
+    found = value;
+    return false;
+  };
+  const char* next = nullptr;
+  ScanDict(s, end, match_key, &next);
+  return found;
+}
+
+base::Optional<base::StringView> ReadString(base::StringView value,
+                                            std::string* scratch) {
+  if (!IsString(value))
+    return base::nullopt;
+  base::StringView contents = value.substr(1, value.size() - 2);
+  if (contents.find('\\') == base::StringView::npos)
+    return contents;
+
+  scratch->clear();
+  for (size_t i = 0; i < contents.size(); i++) {
+    char c = contents.at(i);
+    if (c != '\\') {
+      scratch->push_back(c);
+      continue;
+    }
+    if (++i == contents.size())
+      return base::nullopt;
+    switch (contents.at(i)) {
+      case '"':
+      case '\\':
+      case '/':
+        scratch->push_back(contents.at(i));
+        break;
+      case 'b':
+        scratch->push_back('\b');
+        break;
+      case 'f':
+        scratch->push_back('\f');
+        break;
+      case 'n':
+        scratch->push_back('\n');
+        break;
+      case 'r':
+        scratch->push_back('\r');
+        break;
+      case 't':
+        scratch->push_back('\t');
+        break;
+      case 'u': {
+        uint32_t cp = 0;
+        if (!ParseHex4(contents, i + 1, &cp))
+          return base::nullopt;
+        i += 4;
+        // Characters outside the BMP are encoded as a surrogate pair.
+        uint32_t low = 0;
+        if (cp >= 0xD800 && cp < 0xDC00 && i + 2 < contents.size() &&
+            contents.at(i + 1) == '\\' && contents.at(i + 2) == 'u' &&
+            ParseHex4(contents, i + 3, &low) && low >= 0xDC00 &&
+            low < 0xE000) {
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          i += 6;
+        }
+        AppendUtf8(cp, scratch);
+        break;
+      }
+      default:
         return base::nullopt;
-      return n;
     }
-    default:
+  }
+  return base::StringView(*scratch);
+}
+
+// Json trace event timestamps are in us.
+// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU/edit#heading=h.nso4gcezn7n1
+base::Optional<int64_t> CoerceToNs(base::StringView value) {
+  if (IsString(value)) {
+    base::Optional<int64_t> n = ParseInt(value.substr(1, value.size() - 2));
+    if (!n.has_value())
+      return base::nullopt;
+    return n.value() * 1000;
+  }
+  if (IsReal(value)) {
+    base::Optional<double> n = ParseDouble(value);
+    if (!n.has_value())
+      return base::nullopt;
+    return static_cast<int64_t>(n.value() * 1000);
+  }
+  base::Optional<int64_t> n = ParseInt(value);
+  if (!n.has_value())
+    return base::nullopt;
+  return n.value() * 1000;
+}
+
+base::Optional<int64_t> CoerceToInt64(base::StringView value) {
+  if (IsString(value))
+    return ParseInt(value.substr(1, value.size() - 2));
+  if (IsReal(value)) {
+    base::Optional<double> n = ParseDouble(value);
+    if (!n.has_value())
       return base::nullopt;
+    return static_cast<int64_t>(n.value());
   }
+  return ParseInt(value);
 }
 
-base::Optional<uint32_t> CoerceToUint32(const Json::Value& value) {
+base::Optional<uint32_t> CoerceToUint32(base::StringView value) {
   base::Optional<int64_t> result = CoerceToInt64(value);
   if (!result.has_value())
     return base::nullopt;
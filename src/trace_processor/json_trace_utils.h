@@ -19,22 +19,61 @@
 
 #include <stdint.h>
 
-#include "perfetto/base/optional.h"
+#include <string>
 
-namespace Json {
-class Value;
-}
+#include "perfetto/base/optional.h"
+#include "perfetto/base/string_view.h"
 
 namespace perfetto {
 namespace trace_processor {
+namespace json_trace_utils {
 
-class TraceProcessorContext;
+// The keys of a trace event which are understood by the JsonTraceParser.
+// Each one holds the raw text of its value as it appears in the trace (e.g.
+// |"foo\n"| or |12.5|), and is empty if the key is missing. The views point
+// into the text of the event, so nothing is copied or allocated.
+struct JsonEvent {
+  base::StringView ph;
+  base::StringView ts;
+  base::StringView dur;
+  base::StringView pid;
+  base::StringView tid;
+  base::StringView cat;
+  base::StringView name;
+  // The whole args dictionary, braces included. Its values are looked up
+  // lazily with FindDictValue().
+  base::StringView args;
+};
 
-namespace json_trace_utils {
+enum ReadDictRes { kFoundDict, kNeedsMoreData, kEndOfTrace, kFatalError };
+
+// Scans at most one JSON dictionary of the array of trace events starting at
+// |start|, skipping separators. On kFoundDict, fills |event|, sets |dict| to
+// the text of the dictionary and |next| to the first byte after it.
+// This is a streaming scanner: values of unknown keys are skipped without
+// being decoded, and nothing is allocated.
+ReadDictRes ReadOneJsonDict(const char* start,
+                            const char* end,
+                            JsonEvent* event,
+                            base::StringView* dict,
+                            const char** next);
+
+// Returns the raw value of |key| in the JSON dictionary |dict|, or an empty
+// view if there is no such key or |dict| is not a dictionary.
+base::StringView FindDictValue(base::StringView dict, base::StringView key);
+
+// Returns the contents of the JSON string |value|. If the string contains
+// escape sequences, it is unescaped into |scratch| and the returned view
+// points to it. Returns nullopt if |value| is not a valid string.
+base::Optional<base::StringView> ReadString(base::StringView value,
+                                            std::string* scratch);
 
-base::Optional<int64_t> CoerceToNs(const Json::Value& value);
-base::Optional<int64_t> CoerceToInt64(const Json::Value& value);
-base::Optional<uint32_t> CoerceToUint32(const Json::Value& value);
+// The functions below coerce a raw JSON value, which can be either a number
+// or a string containing an integer, to a number. They return nullopt for
+// missing values and values of other types.
+base::Optional<int64_t> CoerceToNs(base::StringView value);
+base::Optional<int64_t> CoerceToInt64(base::StringView value);
+base::Optional<uint32_t> CoerceToUint32(base::StringView value);
 
 }  // namespace json_trace_utils
 }  // namespace trace_processor
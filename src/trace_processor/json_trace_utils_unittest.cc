@@ -16,7 +16,7 @@
 
 #include "src/trace_processor/json_trace_utils.h"
 
-#include <json/value.h>
+#include <string>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -27,25 +27,82 @@ namespace json_trace_utils {
 namespace {
 
 TEST(JsonTraceUtilsTest, CoerceToUint32) {
-  ASSERT_EQ(CoerceToUint32(Json::Value(42)).value_or(0), 42);
-  ASSERT_EQ(CoerceToUint32(Json::Value("42")).value_or(0), 42);
-  ASSERT_EQ(CoerceToInt64(Json::Value(42.1)).value_or(-1), 42);
+  ASSERT_EQ(CoerceToUint32("42").value_or(0), 42);
+  ASSERT_EQ(CoerceToUint32("\"42\"").value_or(0), 42);
+  ASSERT_EQ(CoerceToInt64("42.1").value_or(-1), 42);
+  ASSERT_FALSE(CoerceToUint32("-1").has_value());
+  ASSERT_FALSE(CoerceToUint32("").has_value());
 }
 
 TEST(JsonTraceUtilsTest, CoerceToInt64) {
-  ASSERT_EQ(CoerceToInt64(Json::Value(42)).value_or(-1), 42);
-  ASSERT_EQ(CoerceToInt64(Json::Value("42")).value_or(-1), 42);
-  ASSERT_EQ(CoerceToInt64(Json::Value(42.1)).value_or(-1), 42);
-  ASSERT_FALSE(CoerceToInt64(Json::Value("foo")).has_value());
-  ASSERT_FALSE(CoerceToInt64(Json::Value("1234!")).has_value());
+  ASSERT_EQ(CoerceToInt64("42").value_or(-1), 42);
+  ASSERT_EQ(CoerceToInt64("\"42\"").value_or(-1), 42);
+  ASSERT_EQ(CoerceToInt64("42.1").value_or(-1), 42);
+  ASSERT_FALSE(CoerceToInt64("\"foo\"").has_value());
+  ASSERT_FALSE(CoerceToInt64("\"1234!\"").has_value());
+  ASSERT_FALSE(CoerceToInt64("null").has_value());
+  ASSERT_FALSE(CoerceToInt64("{}").has_value());
 }
 
 TEST(JsonTraceUtilsTest, CoerceToNs) {
-  ASSERT_EQ(CoerceToNs(Json::Value(42)).value_or(-1), 42000);
-  ASSERT_EQ(CoerceToNs(Json::Value("42")).value_or(-1), 42000);
-  ASSERT_EQ(CoerceToNs(Json::Value(42.1)).value_or(-1), 42100);
-  ASSERT_FALSE(CoerceToNs(Json::Value("foo")).has_value());
-  ASSERT_FALSE(CoerceToNs(Json::Value("1234!")).has_value());
+  ASSERT_EQ(CoerceToNs("42").value_or(-1), 42000);
+  ASSERT_EQ(CoerceToNs("\"42\"").value_or(-1), 42000);
+  ASSERT_EQ(CoerceToNs("42.1").value_or(-1), 42100);
+  ASSERT_EQ(CoerceToNs("1e3").value_or(-1), 1000000);
+  ASSERT_FALSE(CoerceToNs("\"foo\"").has_value());
+  ASSERT_FALSE(CoerceToNs("\"1234!\"").has_value());
+}
+
+TEST(JsonTraceUtilsTest, ReadString) {
+  std::string scratch;
+  ASSERT_EQ(ReadString("\"foo\"", &scratch).value(), "foo");
+  ASSERT_EQ(ReadString("\"\"", &scratch).value(), "");
+  ASSERT_EQ(ReadString(R"("a\"b\\c\nd")", &scratch).value(), "a\"b\\c\nd");
+  ASSERT_EQ(ReadString(R"("\u00e9\ud83d\ude00")", &scratch).value(),
+            "\xc3\xa9\xf0\x9f\x98\x80");
+  ASSERT_FALSE(ReadString("42", &scratch).has_value());
+  ASSERT_FALSE(ReadString(R"("\x")", &scratch).has_value());
+}
+
+TEST(JsonTraceUtilsTest, ReadOneJsonDict) {
+  const std::string trace =
+      R"(, {"name": "a}{\"", "ph":"X", "ts": 1.5, "dur" :2,)"
+      R"( "args": {"x": [1, {"y": "]"}], "name": "foo"}, "pid": 3, "tid": 4,)"
+      R"( "cat": "c", "id": "0x1", "s": true}
+         ,{"ph": "B", "ts": 12)";
+  const char* begin = trace.data();
+  const char* end = begin + trace.size();
+
+  JsonEvent event;
+  base::StringView dict;
+  const char* next = nullptr;
+  ASSERT_EQ(ReadOneJsonDict(begin, end, &event, &dict, &next), kFoundDict);
+  ASSERT_EQ(dict.data(), begin + 2);
+  ASSERT_EQ(dict.data() + dict.size(), next);
+  ASSERT_EQ(*(next - 1), '}');
+  ASSERT_EQ(event.name, R"("a}{\"")");
+  ASSERT_EQ(event.ph, "\"X\"");
+  ASSERT_EQ(event.ts, "1.5");
+  ASSERT_EQ(event.dur, "2");
+  ASSERT_EQ(event.pid, "3");
+  ASSERT_EQ(event.tid, "4");
+  ASSERT_EQ(event.cat, "\"c\"");
+  ASSERT_EQ(event.args, R"({"x": [1, {"y": "]"}], "name": "foo"})");
+  ASSERT_EQ(FindDictValue(event.args, "name"), "\"foo\"");
+  ASSERT_EQ(FindDictValue(event.args, "y"), "");
+
+  // The second event is cut in the middle of its timestamp.
+  ASSERT_EQ(ReadOneJsonDict(next, end, &event, &dict, &next), kNeedsMoreData);
+
+  const std::string tail = "  ]}";
+  ASSERT_EQ(ReadOneJsonDict(tail.data(), tail.data() + tail.size(), &event,
+                            &dict, &next),
+            kEndOfTrace);
+
+  const std::string bad = R"({"ph": "B" "ts": 1})";
+  ASSERT_EQ(ReadOneJsonDict(bad.data(), bad.data() + bad.size(), &event,
+                            &dict, &next),
+            kFatalError);
 }
 
 }  // namespace
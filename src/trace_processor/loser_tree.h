@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACE_PROCESSOR_LOSER_TREE_H_
+#define SRC_TRACE_PROCESSOR_LOSER_TREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "perfetto/base/logging.h"
+
+namespace perfetto {
+namespace trace_processor {
+
+// A tournament tree used to repeatedly find the smallest of k keys (e.g. the
+// timestamps at the head of k sorted queues) for a k-way merge.
+//
+// Each internal node remembers the leaf which lost the match played at that
+// node, while the overall winner is stored separately. When the key of the
+// winning leaf changes (e.g. because events have been popped from the front
+// of its queue), only the log2(k) matches on the path from that leaf to the
+// root need to be replayed. Changing the key of any other leaf requires a
+// Rebuild().
+//
+// Ties are broken in favour of the leaf with the lowest index.
+class LoserTree {
+ public:
+  static constexpr int64_t kMaxKey = std::numeric_limits<int64_t>::max();
+
+  // Resizes the tree to |num_leaves| leaves, all with key kMaxKey. Rebuild()
+  // must be called after setting the keys of the leaves.
+  void Reset(uint32_t num_leaves) {
+    num_leaves_ = num_leaves;
+    capacity_ = 1;
+    while (capacity_ < num_leaves)
+      capacity_ *= 2;
+    keys_.assign(capacity_, std::numeric_limits<int64_t>::max());
+    losers_.assign(capacity_, 0);
+    winner_ = 0;
+  }
+
+  void SetKey(uint32_t leaf, int64_t key) {
+    PERFETTO_DCHECK(leaf < num_leaves_);
+    keys_[leaf] = key;
+  }
+
+  // Replays all the matches of the tournament. O(k).
+  void Rebuild() {
+    // |winners_| is laid out like a binary heap: node i has children 2i and
+    // 2i + 1 and the leaves are stored at [capacity_, 2 * capacity_).
+    winners_.resize(2 * capacity_);
+    for (uint32_t i = 0; i < capacity_; i++)
+      winners_[capacity_ + i] = i;
+    for (uint32_t node = capacity_ - 1; node >= 1; node--) {
+      uint32_t left = winners_[2 * node];
+      uint32_t right = winners_[2 * node + 1];
+      bool left_wins = Beats(left, right);
+      winners_[node] = left_wins ? left : right;
+      losers_[node] = left_wins ? right : left;
+    }
+    winner_ = capacity_ == 1 ? 0 : winners_[1];
+  }
+
+  // Changes the key of the current winner and replays the matches on its path
+  // to the root. O(log k).
+  void UpdateWinner(int64_t key) {
+    keys_[winner_] = key;
+    uint32_t current = winner_;
+    for (uint32_t node = (capacity_ + winner_) / 2; node >= 1; node /= 2) {
+      if (Beats(losers_[node], current))
+        std::swap(losers_[node], current);
+    }
+    winner_ = current;
+  }
+
+  // The leaf with the smallest key.
+  uint32_t winner() const { return winner_; }
+  int64_t winner_key() const { return keys_[winner_]; }
+
+  // Returns the second smallest key (or kMaxKey if there is only one leaf).
+  // The runner-up can only have lost directly against the winner, so it is
+  // one of the losers on the path from the winner to the root. O(log k).
+  int64_t RunnerUpKey() const {
+    int64_t key = kMaxKey;
+    for (uint32_t node = (capacity_ + winner_) / 2; node >= 1; node /= 2)
+      key = std::min(key, keys_[losers_[node]]);
+    return key;
+  }
+
+  uint32_t num_leaves() const { return num_leaves_; }
+
+ private:
+  bool Beats(uint32_t a, uint32_t b) const {
+    return keys_[a] < keys_[b] || (keys_[a] == keys_[b] && a < b);
+  }
+
+  uint32_t num_leaves_ = 0;
+
+  // The number of leaves rounded up to a power of two. The padding leaves
+  // have key kMaxKey and never win against a real leaf.
+  uint32_t capacity_ = 0;
+
+  std::vector<int64_t> keys_;
+
+  // losers_[i] is the leaf which lost the match at internal node i. The root
+  // is node 1, losers_[0] is unused.
+  std::vector<uint32_t> losers_;
+
+  // Scratch space for Rebuild(), kept around to avoid reallocating it.
+  std::vector<uint32_t> winners_;
+
+  uint32_t winner_ = 0;
+};
+
+}  // namespace trace_processor
+}  // namespace perfetto
+
+#endif  // SRC_TRACE_PROCESSOR_LOSER_TREE_H_
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/loser_tree.h"
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace perfetto {
+namespace trace_processor {
+namespace {
+
+// Copied to avoid ODR-using LoserTree::kMaxKey in the gtest macros.
+constexpr int64_t kMaxKey = LoserTree::kMaxKey;
+
+TEST(LoserTreeUnittest, SingleLeaf) {
+  LoserTree tree;
+  tree.Reset(1);
+  tree.SetKey(0, 10);
+  tree.Rebuild();
+  ASSERT_EQ(tree.winner(), 0u);
+  ASSERT_EQ(tree.winner_key(), 10);
+  ASSERT_EQ(tree.RunnerUpKey(), kMaxKey);
+
+  tree.UpdateWinner(20);
+  ASSERT_EQ(tree.winner(), 0u);
+  ASSERT_EQ(tree.winner_key(), 20);
+}
+
+TEST(LoserTreeUnittest, TiesGoToLowestIndex) {
+  LoserTree tree;
+  tree.Reset(3);
+  tree.SetKey(0, 5);
+  tree.SetKey(1, 3);
+  tree.SetKey(2, 3);
+  tree.Rebuild();
+  ASSERT_EQ(tree.winner(), 1u);
+  ASSERT_EQ(tree.RunnerUpKey(), 3);
+
+  tree.UpdateWinner(5);
+  ASSERT_EQ(tree.winner(), 2u);
+  ASSERT_EQ(tree.RunnerUpKey(), 5);
+
+  tree.UpdateWinner(kMaxKey);
+  ASSERT_EQ(tree.winner(), 0u);
+  ASSERT_EQ(tree.RunnerUpKey(), 5);
+}
+
+// Merges random sorted lists and checks the winner and runner-up against a
+// linear scan at every step.
+TEST(LoserTreeUnittest, MergeMatchesLinearScan) {
+  std::minstd_rand0 rnd(0);
+  for (uint32_t num_lists : {2u, 3u, 8u, 13u, 64u, 100u}) {
+    std::vector<std::vector<int64_t>> lists(num_lists);
+    std::vector<size_t> pos(num_lists);
+    LoserTree tree;
+    tree.Reset(num_lists);
+    for (uint32_t i = 0; i < num_lists; i++) {
+      int64_t ts = 0;
+      for (uint32_t j = rnd() % 50; j > 0; j--) {
+        ts += rnd() % 10;
+        lists[i].push_back(ts);
+      }
+      tree.SetKey(i, lists[i].empty() ? kMaxKey : lists[i][0]);
+    }
+    tree.Rebuild();
+
+    for (;;) {
+      uint32_t min_idx = 0;
+      int64_t min_keys[2]{kMaxKey, kMaxKey};
+      for (uint32_t i = 0; i < num_lists; i++) {
+        if (pos[i] == lists[i].size())
+          continue;
+        int64_t key = lists[i][pos[i]];
+        if (key < min_keys[0]) {
+          min_keys[1] = min_keys[0];
+          min_keys[0] = key;
+          min_idx = i;
+        } else if (key < min_keys[1]) {
+          min_keys[1] = key;
+        }
+      }
+      if (min_keys[0] == kMaxKey) {
+        ASSERT_EQ(tree.winner_key(), kMaxKey);
+        break;
+      }
+      ASSERT_EQ(tree.winner(), min_idx);
+      ASSERT_EQ(tree.winner_key(), min_keys[0]);
+      ASSERT_EQ(tree.RunnerUpKey(), min_keys[1]);
+
+      size_t next = ++pos[min_idx];
+      tree.UpdateWinner(next == lists[min_idx].size() ? kMaxKey
+                                                      : lists[min_idx][next]);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace trace_processor
+}  // namespace perfetto
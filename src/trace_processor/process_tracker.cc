@@ -27,8 +27,8 @@ namespace trace_processor {
 ProcessTracker::ProcessTracker(TraceProcessorContext* context)
     : context_(context) {
   // Create a mapping from (t|p)id 0 -> u(t|p)id 0 for the idle process.
-  tids_.emplace(0, 0);
-  pids_.emplace(0, 0);
+  tids_[0].emplace_back(0);
+  pids_.Insert(0, 0);
 }
 
 ProcessTracker::~ProcessTracker() = default;
@@ -40,18 +40,18 @@ UniqueTid ProcessTracker::StartNewThread(int64_t timestamp,
   TraceStorage::Thread* thread = context_->storage->GetMutableThread(new_utid);
   thread->name_id = thread_name_id;
   thread->start_ns = timestamp;
-  tids_.emplace(tid, new_utid);
+  tids_[tid].emplace_back(new_utid);
   return new_utid;
 }
 
 UniqueTid ProcessTracker::UpdateThread(int64_t timestamp,
                                        uint32_t tid,
                                        StringId thread_name_id) {
-  auto pair_it = tids_.equal_range(tid);
+  const std::vector<UniqueTid>* utids = tids_.Find(tid);
 
   // If a utid exists for the tid, find it and update the name.
-  if (pair_it.first != pair_it.second) {
-    auto prev_utid = std::prev(pair_it.second)->second;
+  if (utids && !utids->empty()) {
+    auto prev_utid = utids->back();
     TraceStorage::Thread* thread =
         context_->storage->GetMutableThread(prev_utid);
     if (thread_name_id)
@@ -64,13 +64,13 @@ UniqueTid ProcessTracker::UpdateThread(int64_t timestamp,
 }
 
 UniqueTid ProcessTracker::UpdateThread(uint32_t tid, uint32_t pid) {
-  auto tids_pair = tids_.equal_range(tid);
+  const std::vector<UniqueTid>* utids = tids_.Find(tid);
 
   // Try looking for a thread that matches both tid and thread group id (pid).
   TraceStorage::Thread* thread = nullptr;
   UniqueTid utid = 0;
-  for (auto it = tids_pair.first; it != tids_pair.second; it++) {
-    UniqueTid iter_utid = it->second;
+  for (size_t i = 0; utids && i < utids->size(); i++) {
+    UniqueTid iter_utid = (*utids)[i];
     auto* iter_thread = context_->storage->GetMutableThread(iter_utid);
     if (!iter_thread->upid.has_value()) {
       // We haven't discovered the parent process for the thread. Assign it
@@ -92,7 +92,7 @@ UniqueTid ProcessTracker::UpdateThread(uint32_t tid, uint32_t pid) {
   // If no matching thread was found, create a new one.
   if (thread == nullptr) {
     utid = context_->storage->AddEmptyThread(tid);
-    tids_.emplace(tid, utid);
+    tids_[tid].emplace_back(utid);
     thread = context_->storage->GetMutableThread(utid);
   }
 
@@ -108,7 +108,7 @@ UniqueTid ProcessTracker::UpdateThread(uint32_t tid, uint32_t pid) {
 }
 
 UniquePid ProcessTracker::StartNewProcess(int64_t timestamp, uint32_t pid) {
-  pids_.erase(pid);
+  pids_.Erase(pid);
 
   // Create a new UTID for the main thread, so we don't end up reusing an old
   // entry in case of TID recycling.
@@ -145,12 +145,12 @@ std::pair<UniquePid, TraceStorage::Process*> ProcessTracker::GetOrCreateProcess(
     uint32_t pid,
     int64_t start_ns) {
   UniquePid upid;
-  auto it = pids_.find(pid);
-  if (it != pids_.end()) {
-    upid = it->second;
+  UniquePid* existing_upid = pids_.Find(pid);
+  if (existing_upid) {
+    upid = *existing_upid;
   } else {
     upid = context_->storage->AddEmptyProcess(pid);
-    pids_.emplace(pid, upid);
+    pids_.Insert(pid, upid);
 
     // Create an entry for the main thread.
     // We cannot call StartNewThread() here, because threads for this process
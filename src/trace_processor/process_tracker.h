@@ -18,7 +18,10 @@
 #define SRC_TRACE_PROCESSOR_PROCESS_TRACKER_H_
 
 #include <tuple>
+#include <vector>
 
+#include "perfetto/base/flat_hash_map.h"
+#include "perfetto/base/optional.h"
 #include "perfetto/base/string_view.h"
 #include "src/trace_processor/trace_processor_context.h"
 #include "src/trace_processor/trace_storage.h"
@@ -33,16 +36,6 @@ class ProcessTracker {
   ProcessTracker& operator=(const ProcessTracker&) = delete;
   virtual ~ProcessTracker();
 
-  using UniqueProcessIterator =
-      std::multimap<uint32_t, UniquePid>::const_iterator;
-  using UniqueProcessBounds =
-      std::pair<UniqueProcessIterator, UniqueProcessIterator>;
-
-  using UniqueThreadIterator =
-      std::multimap<uint32_t, UniqueTid>::const_iterator;
-  using UniqueThreadBounds =
-      std::pair<UniqueThreadIterator, UniqueThreadIterator>;
-
   // TODO(b/110409911): Invalidation of process and threads is yet to be
   // implemented. This will include passing timestamps into the below methods
   // to ensure the correct upid/utid is found.
@@ -80,16 +73,17 @@ class ProcessTracker {
   // Virtual for testing.
   virtual UniquePid UpdateProcess(uint32_t pid, int64_t start_ns = 0);
 
-  // Returns the bounds of a range that includes all UniquePids that have the
-  // requested pid.
-  UniqueProcessBounds UpidsForPid(uint32_t pid) {
-    return pids_.equal_range(pid);
+  // Returns the UniquePid currently assigned to the requested pid, if any.
+  base::Optional<UniquePid> UpidForPid(uint32_t pid) const {
+    const UniquePid* upid = pids_.Find(pid);
+    return upid ? base::make_optional(*upid) : base::nullopt;
   }
 
-  // Returns the bounds of a range that includes all UniqueTids that have the
-  // requested tid.
-  UniqueThreadBounds UtidsForTid(uint32_t tid) {
-    return tids_.equal_range(tid);
+  // Returns all the UniqueTids that have been assigned to the requested tid,
+  // in the order they were created.
+  std::vector<UniqueTid> UtidsForTid(uint32_t tid) const {
+    const std::vector<UniqueTid>* utids = tids_.Find(tid);
+    return utids ? *utids : std::vector<UniqueTid>();
   }
 
   // Marks the two threads as belonging to the same process, even if we don't
@@ -111,12 +105,12 @@ class ProcessTracker {
   TraceProcessorContext* const context_;
 
   // Each tid can have multiple UniqueTid entries, a new UniqueTid is assigned
-  // each time a thread is seen in the trace.
-  std::multimap<uint32_t /* tid */, UniqueTid> tids_;
+  // each time a thread is seen in the trace. The last one is the current one.
+  base::FlatHashMap<uint32_t /* tid */, std::vector<UniqueTid>> tids_;
 
   // Each pid can have multiple UniquePid entries, a new UniquePid is assigned
-  // each time a process is seen in the trace.
-  std::map<uint32_t /* pid (aka tgid) */, UniquePid> pids_;
+  // each time a process is seen in the trace. Only the current one is kept.
+  base::FlatHashMap<uint32_t /* pid (aka tgid) */, UniquePid> pids_;
 
   // Pending thread associations. The meaning of a pair<ThreadA, ThreadB> in
   // this vector is: we know that A and B belong to the same process, but we
@@ -46,25 +46,21 @@ class ProcessTrackerTest : public ::testing::Test {
 TEST_F(ProcessTrackerTest, PushProcess) {
   TraceStorage storage;
   context.process_tracker->UpdateProcess(1, base::nullopt, "test");
-  auto pair_it = context.process_tracker->UpidsForPid(1);
-  ASSERT_EQ(pair_it.first->second, 1);
+  ASSERT_EQ(context.process_tracker->UpidForPid(1), base::make_optional(1u));
 }
 
 TEST_F(ProcessTrackerTest, PushTwoProcessEntries_SamePidAndName) {
   context.process_tracker->UpdateProcess(1, base::nullopt, "test");
   context.process_tracker->UpdateProcess(1, base::nullopt, "test");
-  auto pair_it = context.process_tracker->UpidsForPid(1);
-  ASSERT_EQ(pair_it.first->second, 1);
-  ASSERT_EQ(++pair_it.first, pair_it.second);
+  ASSERT_EQ(context.process_tracker->UpidForPid(1), base::make_optional(1u));
+  ASSERT_EQ(context.storage->process_count(), 2u);
 }
 
 TEST_F(ProcessTrackerTest, PushTwoProcessEntries_DifferentPid) {
   context.process_tracker->UpdateProcess(1, base::nullopt, "test");
   context.process_tracker->UpdateProcess(3, base::nullopt, "test");
-  auto pair_it = context.process_tracker->UpidsForPid(1);
-  ASSERT_EQ(pair_it.first->second, 1);
-  auto second_pair_it = context.process_tracker->UpidsForPid(3);
-  ASSERT_EQ(second_pair_it.first->second, 2);
+  ASSERT_EQ(context.process_tracker->UpidForPid(1), base::make_optional(1u));
+  ASSERT_EQ(context.process_tracker->UpidForPid(3), base::make_optional(2u));
 }
 
 TEST_F(ProcessTrackerTest, AddProcessEntry_CorrectName) {
@@ -108,11 +104,9 @@ TEST_F(ProcessTrackerTest, UpdateThreadCreate) {
   // We expect 3 threads: Invalid thread, main thread for pid, tid 12.
   ASSERT_EQ(context.storage->thread_count(), 3);
 
-  auto tid_it = context.process_tracker->UtidsForTid(12);
-  ASSERT_NE(tid_it.first, tid_it.second);
+  ASSERT_EQ(context.process_tracker->UtidsForTid(12).size(), 1u);
   ASSERT_EQ(thread.upid.value(), 1);
-  auto pid_it = context.process_tracker->UpidsForPid(2);
-  ASSERT_NE(pid_it.first, pid_it.second);
+  ASSERT_TRUE(context.process_tracker->UpidForPid(2).has_value());
   ASSERT_EQ(context.storage->process_count(), 2);
 }
 
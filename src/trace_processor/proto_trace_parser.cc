@@ -147,7 +147,8 @@ bool ParseSystraceTracePoint(base::StringView str, SystraceTracePoint* out) {
   }
 }
 
-ProtoTraceParser::ProtoTraceParser(TraceProcessorContext* context)
+ProtoTraceParser::ProtoTraceParser(TraceProcessorContext* context,
+                                   bool lazy_raw_args)
     : context_(context),
       utid_name_id_(context->storage->InternString("utid")),
       sched_wakeup_name_id_(context->storage->InternString("sched_wakeup")),
@@ -184,7 +185,8 @@ ProtoTraceParser::ProtoTraceParser(TraceProcessorContext* context)
       oom_score_adj_id_(context->storage->InternString("oom_score_adj")),
       ion_total_unknown_id_(context->storage->InternString("mem.ion.unknown")),
       ion_change_unknown_id_(
-          context->storage->InternString("mem.ion_change.unknown")) {
+          context->storage->InternString("mem.ion_change.unknown")),
+      lazy_raw_args_(lazy_raw_args) {
   for (const auto& name : BuildMeminfoCounterNames()) {
     meminfo_strs_id_.emplace_back(context->storage->InternString(name));
   }
@@ -988,6 +990,20 @@ void ProtoTraceParser::ParseTypedFtraceToRaw(uint32_t ftrace_id,
   UniqueTid utid = context_->process_tracker->UpdateThread(ts, tid, 0);
   RowId raw_event_id = context_->storage->mutable_raw_events()->AddRawEvent(
       ts, message_strings.message_name_id, cpu, utid);
+
+  // In lazy mode, the args are re-encoded into |lazy_args_blob_| and added as
+  // a single lazy set instead of going through the ArgsTracker.
+  uint32_t lazy_arg_count = 0;
+  lazy_args_blob_.clear();
+  auto add_arg = [this, raw_event_id, &lazy_arg_count](StringId name_id,
+                                                       Variadic value) {
+    if (lazy_raw_args_) {
+      TraceStorage::Args::AppendLazyArg(name_id, value, &lazy_args_blob_);
+      lazy_arg_count++;
+      return;
+    }
+    context_->args_tracker->AddArg(raw_event_id, name_id, name_id, value);
+  };
   for (auto fld = decoder.ReadField(); fld.valid(); fld = decoder.ReadField()) {
     if (PERFETTO_UNLIKELY(fld.id() >= kMaxFtraceEventFields)) {
       PERFETTO_DLOG(
@@ -1010,26 +1026,21 @@ void ProtoTraceParser::ParseTypedFtraceToRaw(uint32_t ftrace_id,
       case ProtoSchemaType::kSint64:
       case ProtoSchemaType::kBool:
       case ProtoSchemaType::kEnum: {
-        context_->args_tracker->AddArg(raw_event_id, name_id, name_id,
-                                       Variadic::Integer(fld.as_int64()));
+        add_arg(name_id, Variadic::Integer(fld.as_int64()));
         break;
       }
       case ProtoSchemaType::kString:
       case ProtoSchemaType::kBytes: {
         StringId value = context_->storage->InternString(fld.as_string());
-        context_->args_tracker->AddArg(raw_event_id, name_id, name_id,
-                                       Variadic::String(value));
+        add_arg(name_id, Variadic::String(value));
         break;
       }
       case ProtoSchemaType::kDouble: {
-        context_->args_tracker->AddArg(raw_event_id, name_id, name_id,
-                                       Variadic::Real(fld.as_double()));
+        add_arg(name_id, Variadic::Real(fld.as_double()));
         break;
       }
       case ProtoSchemaType::kFloat: {
-        context_->args_tracker->AddArg(
-            raw_event_id, name_id, name_id,
-            Variadic::Real(static_cast<double>(fld.as_float())));
+        add_arg(name_id, Variadic::Real(static_cast<double>(fld.as_float())));
         break;
       }
       case ProtoSchemaType::kUnknown:
@@ -1040,6 +1051,13 @@ void ProtoTraceParser::ParseTypedFtraceToRaw(uint32_t ftrace_id,
         break;
     }
   }
+
+  if (lazy_raw_args_ && lazy_arg_count > 0) {
+    auto* args = context_->storage->mutable_args();
+    ArgSetId set_id = args->AddLazyArgSet(lazy_args_blob_, lazy_arg_count);
+    context_->storage->mutable_raw_events()->set_arg_set_id(
+        TraceStorage::ParseRowId(raw_event_id).second, set_id);
+  }
 }
 
 void ProtoTraceParser::ParseClockSnapshot(ConstBytes blob) {
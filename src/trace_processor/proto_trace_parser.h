@@ -56,7 +56,10 @@ bool ParseSystraceTracePoint(base::StringView, SystraceTracePoint* out);
 class ProtoTraceParser : public TraceParser {
  public:
   using ConstBytes = protozero::ConstBytes;
-  explicit ProtoTraceParser(TraceProcessorContext*);
+  // If |lazy_raw_args| is true, the args of the raw events are added with
+  // TraceStorage::Args::AddLazyArgSet() (see Config::lazy_raw_args).
+  explicit ProtoTraceParser(TraceProcessorContext*,
+                            bool lazy_raw_args = false);
   virtual ~ProtoTraceParser();
 
   // TraceParser implementation.
@@ -147,6 +150,11 @@ class ProtoTraceParser : public TraceParser {
   };
   std::vector<FtraceMessageStrings> ftrace_message_strings_;
 
+  const bool lazy_raw_args_;
+
+  // Scratch buffer for the encoding of the lazy args of a raw event.
+  std::vector<uint8_t> lazy_args_blob_;
+
   // Maps a proto field number for memcounters in ProcessStats::Process to
   // their StringId. Keep kProcStatsProcessSize equal to 1 + max proto field
   // id of ProcessStats::Process.
@@ -16,14 +16,18 @@
 
 #include "src/trace_processor/proto_trace_tokenizer.h"
 
+#include <zlib.h>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "perfetto/base/string_view.h"
+#include "perfetto/protozero/proto_utils.h"
 #include "perfetto/protozero/scattered_heap_buffer.h"
 #include "src/trace_processor/args_tracker.h"
 #include "src/trace_processor/event_tracker.h"
 #include "src/trace_processor/process_tracker.h"
 #include "src/trace_processor/proto_trace_parser.h"
+#include "src/trace_processor/thread_pool.h"
 #include "src/trace_processor/trace_sorter.h"
 
 #include "perfetto/common/sys_stats_counters.pbzero.h"
@@ -48,6 +52,7 @@ using ::testing::Args;
 using ::testing::AtLeast;
 using ::testing::ElementsAreArray;
 using ::testing::Eq;
+using ::testing::Invoke;
 using ::testing::Pointwise;
 using ::testing::NiceMock;
 
@@ -139,7 +144,9 @@ class ProtoTraceParserTest : public ::testing::Test {
     std::unique_ptr<uint8_t[]> raw_trace(new uint8_t[trace_bytes.size()]);
     memcpy(raw_trace.get(), trace_bytes.data(), trace_bytes.size());
     ProtoTraceTokenizer tokenizer(&context_);
-    tokenizer.Parse(std::move(raw_trace), trace_bytes.size());
+    size_t size = trace_bytes.size();
+    tokenizer.Parse(TraceBlobView(std::move(raw_trace), 0, size));
+    tokenizer.NotifyEndOfFile();
 
     ResetTraceBuffers();
   }
@@ -181,6 +188,106 @@ TEST_F(ProtoTraceParserTest, LoadSingleEvent) {
   Tokenize();
 }
 
+TEST_F(ProtoTraceParserTest, LoadCompactSched) {
+  auto* bundle = trace_.add_packet()->set_ftrace_events();
+  bundle->set_cpu(10);
+
+  static const char kProc1Name[] = "proc1";
+  static const char kProc2Name[] = "proc2";
+  auto* compact = bundle->set_compact_sched();
+  compact->add_intern_table(kProc1Name);
+  compact->add_intern_table(kProc2Name);
+
+  auto set_column = [](std::initializer_list<int64_t> values,
+                       void (protos::pbzero::FtraceEventBundle::CompactSched::*
+                                 setter)(const uint8_t*, size_t),
+                       protos::pbzero::FtraceEventBundle::CompactSched* msg) {
+    std::vector<uint8_t> column(values.size() * 10);
+    uint8_t* ptr = column.data();
+    for (int64_t value : values)
+      ptr = protozero::proto_utils::WriteVarInt(value, ptr);
+    (msg->*setter)(column.data(), static_cast<size_t>(ptr - column.data()));
+  };
+  using CS = protos::pbzero::FtraceEventBundle::CompactSched;
+  // Timestamps are deltas: the events are at 1000 and 1001.
+  set_column({1000, 1}, &CS::set_switch_timestamp, compact);
+  set_column({1, 0}, &CS::set_switch_prev_comm_index, compact);
+  set_column({10, 100}, &CS::set_switch_prev_pid, compact);
+  set_column({256, 1024}, &CS::set_switch_prev_prio, compact);
+  set_column({32, -1}, &CS::set_switch_prev_state, compact);
+  set_column({0, 1}, &CS::set_switch_next_comm_index, compact);
+  set_column({100, 10}, &CS::set_switch_next_pid, compact);
+  set_column({1024, 256}, &CS::set_switch_next_prio, compact);
+
+  EXPECT_CALL(*event_,
+              PushSchedSwitch(10, 1000, 10, base::StringView(kProc2Name), 256,
+                              32, 100, base::StringView(kProc1Name), 1024));
+  EXPECT_CALL(*event_,
+              PushSchedSwitch(10, 1001, 100, base::StringView(kProc1Name),
+                              1024, -1, 10, base::StringView(kProc2Name), 256));
+  Tokenize();
+}
+
+TEST_F(ProtoTraceParserTest, LoadCompactSchedWaking) {
+  InitStorage();
+
+  auto* bundle = trace_.add_packet()->set_ftrace_events();
+  bundle->set_cpu(10);
+
+  static const char kProc1Name[] = "proc1";
+  static const char kProc2Name[] = "proc2";
+  auto* compact = bundle->set_compact_sched();
+  compact->add_intern_table(kProc1Name);
+  compact->add_intern_table(kProc2Name);
+
+  auto set_column = [](std::initializer_list<int64_t> values,
+                       void (protos::pbzero::FtraceEventBundle::CompactSched::*
+                                 setter)(const uint8_t*, size_t),
+                       protos::pbzero::FtraceEventBundle::CompactSched* msg) {
+    std::vector<uint8_t> column(values.size() * 10);
+    uint8_t* ptr = column.data();
+    for (int64_t value : values)
+      ptr = protozero::proto_utils::WriteVarInt(value, ptr);
+    (msg->*setter)(column.data(), static_cast<size_t>(ptr - column.data()));
+  };
+  using CS = protos::pbzero::FtraceEventBundle::CompactSched;
+  // Timestamps are deltas: the events are at 1000 and 1001.
+  set_column({1000, 1}, &CS::set_waking_timestamp, compact);
+  set_column({12, 100}, &CS::set_waking_common_pid, compact);
+  set_column({1, 0}, &CS::set_waking_comm_index, compact);
+  set_column({10, 20}, &CS::set_waking_pid, compact);
+  set_column({120, 98}, &CS::set_waking_prio, compact);
+  set_column({1, 1}, &CS::set_waking_success, compact);
+  set_column({3, 0}, &CS::set_waking_target_cpu, compact);
+
+  // sched_waking has no specific parsing logic and only appears in the raw
+  // events table, with one arg per field.
+  EXPECT_CALL(*storage_, InternString(base::StringView(kProc1Name)))
+      .Times(AtLeast(1));
+  EXPECT_CALL(*storage_, InternString(base::StringView(kProc2Name)))
+      .Times(AtLeast(1));
+
+  Tokenize();
+  const auto& raw = context_.storage->raw_events();
+  ASSERT_EQ(raw.raw_event_count(), 2u);
+  EXPECT_EQ(raw.timestamps()[0], 1000);
+  EXPECT_EQ(raw.timestamps()[1], 1001);
+  EXPECT_EQ(raw.cpus()[0], 10u);
+  EXPECT_EQ(raw.cpus()[1], 10u);
+
+  const auto& args = context_.storage->args();
+  ASSERT_EQ(args.args_count(), 10);
+  // comm, pid, prio, success and target_cpu of each event.
+  EXPECT_EQ(args.arg_values()[1].int_value, 10);
+  EXPECT_EQ(args.arg_values()[2].int_value, 120);
+  EXPECT_EQ(args.arg_values()[3].int_value, 1);
+  EXPECT_EQ(args.arg_values()[4].int_value, 3);
+  EXPECT_EQ(args.arg_values()[6].int_value, 20);
+  EXPECT_EQ(args.arg_values()[7].int_value, 98);
+  EXPECT_EQ(args.arg_values()[8].int_value, 1);
+  EXPECT_EQ(args.arg_values()[9].int_value, 0);
+}
+
 TEST_F(ProtoTraceParserTest, LoadEventsIntoRaw) {
   InitStorage();
 
@@ -230,6 +337,70 @@ TEST_F(ProtoTraceParserTest, LoadEventsIntoRaw) {
   // and test here.
 }
 
+TEST_F(ProtoTraceParserTest, LoadEventsIntoRawLazyArgs) {
+  InitStorage();
+  context_.parser.reset(
+      new ProtoTraceParser(&context_, true /* lazy_raw_args */));
+
+  auto* bundle = trace_.add_packet()->set_ftrace_events();
+  bundle->set_cpu(10);
+
+  auto* event = bundle->add_event();
+  event->set_timestamp(1000);
+  event->set_pid(12);
+  auto* task = event->set_task_newtask();
+  task->set_pid(123);
+  static const char task_newtask[] = "task_newtask";
+  task->set_comm(task_newtask);
+  task->set_clone_flags(12);
+  task->set_oom_score_adj(-15);
+
+  // The two print events have the same args, which should be stored once.
+  static const char buf_value[] = "This is a print event";
+  for (int64_t ts = 1001; ts <= 1002; ts++) {
+    event = bundle->add_event();
+    event->set_timestamp(ts);
+    event->set_pid(12);
+    auto* print = event->set_print();
+    print->set_ip(20);
+    print->set_buf(buf_value);
+  }
+
+  EXPECT_CALL(*storage_, InternString(base::StringView(task_newtask)))
+      .Times(AtLeast(1));
+  EXPECT_CALL(*storage_, InternString(base::StringView(buf_value)))
+      .Times(AtLeast(1));
+  EXPECT_CALL(*process_, UpdateThread(123, 123));
+
+  Tokenize();
+  const auto& raw = context_.storage->raw_events();
+  ASSERT_EQ(raw.raw_event_count(), 3);
+  ASSERT_EQ(raw.arg_set_ids()[1], raw.arg_set_ids()[2]);
+
+  const auto& args = context_.storage->args();
+  ASSERT_EQ(args.set_ids().size(), 0u);
+  ASSERT_EQ(args.args_count(), 6u);
+
+  auto rows = args.FindArgSetRows(raw.arg_set_ids()[0]);
+  ASSERT_EQ(rows, std::make_pair(0u, 4u));
+  ASSERT_EQ(args.GetSetId(3), raw.arg_set_ids()[0]);
+  ASSERT_EQ(args.GetArg(0).value.int_value, 123);
+  ASSERT_EQ(args.GetArg(1).value.type,
+            TraceStorage::Args::Variadic::Type::kString);
+  ASSERT_EQ(args.GetArg(2).value.int_value, 12);
+  ASSERT_EQ(args.GetArg(3).value.int_value, -15);
+
+  rows = args.FindArgSetRows(raw.arg_set_ids()[1]);
+  ASSERT_EQ(rows, std::make_pair(4u, 6u));
+  ASSERT_EQ(args.GetSetId(4), raw.arg_set_ids()[1]);
+  ASSERT_EQ(args.GetArg(4).value.int_value, 20);
+  ASSERT_EQ(args.GetArg(5).value.type,
+            TraceStorage::Args::Variadic::Type::kString);
+
+  // Reading the rows out of order goes through the decode cache.
+  ASSERT_EQ(args.GetArg(2).value.int_value, 12);
+}
+
 TEST_F(ProtoTraceParserTest, LoadGenericFtrace) {
   InitStorage();
   auto* packet = trace_.add_packet();
@@ -329,6 +500,51 @@ TEST_F(ProtoTraceParserTest, LoadMultipleEvents) {
   Tokenize();
 }
 
+TEST_F(ProtoTraceParserTest, LoadEventsMultiThreaded) {
+  context_.thread_pool.reset(new ThreadPool(4));
+  context_.sorter->set_window_ns_for_testing(
+      std::numeric_limits<int64_t>::max());
+
+  // Enough bundles for the tokenizer to split them into several batches.
+  // Events of different CPUs interleave and the events of each bundle are in
+  // reverse order, so that all the queues of the sorter need sorting.
+  const uint32_t kBundles = 400;
+  const uint32_t kEventsPerBundle = 50;
+  for (uint32_t i = 0; i < kBundles; i++) {
+    auto* bundle = trace_.add_packet()->set_ftrace_events();
+    uint32_t cpu = i % 2;
+    bundle->set_cpu(cpu);
+    for (uint32_t j = 0; j < kEventsPerBundle; j++) {
+      auto* event = bundle->add_event();
+      uint32_t ts = (i / 2) * kEventsPerBundle * 2 +
+                    (kEventsPerBundle - j - 1) * 2 + cpu;
+      event->set_timestamp(ts);
+      event->set_pid(12);
+
+      auto* sched_switch = event->set_sched_switch();
+      sched_switch->set_prev_pid(10);
+      sched_switch->set_prev_comm("proc1");
+      sched_switch->set_next_pid(100);
+      sched_switch->set_next_comm("proc2");
+    }
+  }
+
+  std::vector<int64_t> timestamps;
+  EXPECT_CALL(*event_, PushSchedSwitch(_, _, 10, _, _, _, 100, _, _))
+      .WillRepeatedly(Invoke([&timestamps](uint32_t, int64_t ts, uint32_t,
+                                           base::StringView, int32_t,
+                                           int64_t, uint32_t,
+                                           base::StringView, int32_t) {
+        timestamps.push_back(ts);
+      }));
+
+  Tokenize();
+  context_.sorter->ExtractEventsForced();
+
+  ASSERT_EQ(timestamps.size(), kBundles * kEventsPerBundle);
+  ASSERT_TRUE(std::is_sorted(timestamps.begin(), timestamps.end()));
+}
+
 TEST_F(ProtoTraceParserTest, LoadMultiplePackets) {
   auto* bundle = trace_.add_packet()->set_ftrace_events();
   bundle->set_cpu(10);
@@ -374,6 +590,46 @@ TEST_F(ProtoTraceParserTest, LoadMultiplePackets) {
   Tokenize();
 }
 
+TEST_F(ProtoTraceParserTest, LoadCompressedPackets) {
+  protozero::ScatteredHeapBuffer inner_buf;
+  protozero::ScatteredStreamWriter inner_writer(&inner_buf);
+  inner_buf.set_writer(&inner_writer);
+  protos::pbzero::Trace inner_trace;
+  inner_trace.Reset(&inner_writer);
+  for (uint32_t i = 0; i < 2; i++) {
+    auto* bundle = inner_trace.add_packet()->set_ftrace_events();
+    bundle->set_cpu(10);
+    auto* event = bundle->add_event();
+    event->set_timestamp(1000 + i);
+    event->set_pid(12);
+    auto* sched_switch = event->set_sched_switch();
+    sched_switch->set_prev_pid(10);
+    sched_switch->set_prev_comm("proc1");
+    sched_switch->set_next_pid(100);
+    sched_switch->set_next_comm("proc2");
+  }
+  inner_trace.Finalize();
+  std::vector<uint8_t> inner_bytes = inner_buf.StitchSlices();
+
+  uLongf compressed_size = compressBound(inner_bytes.size());
+  std::unique_ptr<uint8_t[]> compressed(new uint8_t[compressed_size]);
+  ASSERT_EQ(compress(compressed.get(), &compressed_size, inner_bytes.data(),
+                     inner_bytes.size()),
+            Z_OK);
+  trace_.add_packet()->set_compressed_packets(compressed.get(),
+                                              compressed_size);
+
+  // A truncated zlib stream is dropped and reported in the stats.
+  trace_.add_packet()->set_compressed_packets(compressed.get(),
+                                              compressed_size / 2);
+
+  EXPECT_CALL(*event_, PushSchedSwitch(10, 1000, 10, _, _, _, 100, _, _));
+  EXPECT_CALL(*event_, PushSchedSwitch(10, 1001, 10, _, _, _, 100, _, _));
+  Tokenize();
+  EXPECT_EQ(
+      context_.storage->stats()[stats::compressed_packets_invalid].value, 1);
+}
+
 TEST_F(ProtoTraceParserTest, RepeatedLoadSinglePacket) {
   auto* bundle = trace_.add_packet()->set_ftrace_events();
   bundle->set_cpu(10);
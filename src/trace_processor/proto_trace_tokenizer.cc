@@ -16,6 +16,8 @@
 
 #include "src/trace_processor/proto_trace_tokenizer.h"
 
+#include <string.h>
+
 #include <string>
 
 #include "perfetto/base/logging.h"
@@ -25,12 +27,15 @@
 #include "src/trace_processor/event_tracker.h"
 #include "src/trace_processor/process_tracker.h"
 #include "src/trace_processor/stats.h"
+#include "src/trace_processor/thread_pool.h"
 #include "src/trace_processor/trace_blob_view.h"
 #include "src/trace_processor/trace_sorter.h"
 #include "src/trace_processor/trace_storage.h"
+#include "src/trace_processor/zlib_utils.h"
 
 #include "perfetto/trace/ftrace/ftrace_event.pbzero.h"
 #include "perfetto/trace/ftrace/ftrace_event_bundle.pbzero.h"
+#include "perfetto/trace/ftrace/sched.pbzero.h"
 #include "perfetto/trace/trace.pbzero.h"
 #include "perfetto/trace/trace_packet.pbzero.h"
 
@@ -41,14 +46,261 @@ using protozero::ProtoDecoder;
 using protozero::proto_utils::MakeTagLengthDelimited;
 using protozero::proto_utils::MakeTagVarInt;
 using protozero::proto_utils::ParseVarInt;
+using protozero::proto_utils::WriteVarInt;
+
+namespace {
+
+// Push the batches to the workers once they reach this size.
+constexpr size_t kBatchSizeBytes = 128 * 1024;
+
+// Max number of batches which can be in flight at any time, per worker thread.
+constexpr size_t kMaxPendingBatchesPerThread = 4;
+
+template <typename Sink>
+PERFETTO_ALWAYS_INLINE void TokenizeFtraceEvent(uint32_t cpu,
+                                                const uint8_t* data,
+                                                size_t length,
+                                                Sink* sink) {
+  constexpr auto kTimestampFieldNumber =
+      protos::pbzero::FtraceEvent::kTimestampFieldNumber;
+  ProtoDecoder decoder(data, length);
+  uint64_t raw_timestamp = 0;
+  bool timestamp_found = false;
+
+  // Speculate on the fact that the timestamp is often the 1st field of the
+  // event.
+  constexpr auto timestampFieldTag = MakeTagVarInt(kTimestampFieldNumber);
+  if (PERFETTO_LIKELY(length > 10 && data[0] == timestampFieldTag)) {
+    // Fastpath.
+    const uint8_t* next = ParseVarInt(data + 1, data + 11, &raw_timestamp);
+    timestamp_found = next != data + 1;
+    decoder.Reset(next);
+  } else {
+    // Slowpath.
+    if (auto ts_field = decoder.FindField(kTimestampFieldNumber)) {
+      timestamp_found = true;
+      raw_timestamp = ts_field.as_uint64();
+    }
+  }
+
+  if (PERFETTO_UNLIKELY(!timestamp_found)) {
+    PERFETTO_ELOG("Timestamp field not found in FtraceEvent");
+    sink->OnFtraceError();
+    return;
+  }
+
+  sink->OnFtraceEvent(cpu, static_cast<int64_t>(raw_timestamp), data, length);
+}
+
+template <typename Sink>
+PERFETTO_ALWAYS_INLINE void TokenizeFtraceBundle(const uint8_t* data,
+                                                 size_t length,
+                                                 Sink* sink) {
+  protos::pbzero::FtraceEventBundle::Decoder decoder(data, length);
+
+  if (PERFETTO_UNLIKELY(!decoder.has_cpu())) {
+    PERFETTO_ELOG("CPU field not found in FtraceEventBundle");
+    sink->OnFtraceError();
+    return;
+  }
+
+  uint32_t cpu = decoder.cpu();
+  if (PERFETTO_UNLIKELY(cpu > base::kMaxCpus)) {
+    PERFETTO_ELOG("CPU larger than kMaxCpus (%u > %zu)", cpu, base::kMaxCpus);
+    return;
+  }
+
+  for (auto it = decoder.event(); it; ++it)
+    TokenizeFtraceEvent(cpu, it->data(), it->size(), sink);
+  if (decoder.has_compact_sched()) {
+    auto compact_sched = decoder.compact_sched();
+    sink->OnFtraceCompactSched(cpu, compact_sched.data, compact_sched.size);
+  }
+  sink->OnFtraceBundleEnd(cpu);
+}
+
+// Decodes the TracePacket in [data, data + length) and reports it (or the
+// ftrace events it contains) to |sink|. This doesn't access any state other
+// than the packet itself, so it is safe to run on a worker thread as long as
+// |sink| is.
+template <typename Sink>
+void TokenizePacket(const uint8_t* data, size_t length, Sink* sink) {
+  protos::pbzero::TracePacket::Decoder decoder(data, length);
+
+  bool has_timestamp = decoder.has_timestamp();
+  auto timestamp =
+      has_timestamp ? static_cast<int64_t>(decoder.timestamp()) : 0;
+
+  if (decoder.has_compressed_packets()) {
+    auto field = decoder.compressed_packets();
+    sink->OnCompressedPackets(field.data, field.size);
+    return;
+  }
+
+  if (decoder.has_ftrace_events()) {
+    if (has_timestamp)
+      sink->OnTimestamp(timestamp);
+    auto ftrace_field = decoder.ftrace_events();
+    TokenizeFtraceBundle(ftrace_field.data, ftrace_field.size, sink);
+    return;
+  }
+
+  sink->OnPacket(has_timestamp, timestamp, data, length);
+  PERFETTO_DCHECK(!decoder.bytes_left());
+}
+
+// Reads one varint at a time from a column of a CompactSched bundle.
+class CompactSchedColumn {
+ public:
+  explicit CompactSchedColumn(protozero::ConstBytes bytes)
+      : ptr_(bytes.data), end_(bytes.data + bytes.size) {}
+
+  // Returns false if the column has no more entries.
+  template <typename T>
+  bool Read(T* value) {
+    uint64_t raw = 0;
+    const uint8_t* next = ParseVarInt(ptr_, end_, &raw);
+    if (next == ptr_)
+      return false;
+    ptr_ = next;
+    *value = static_cast<T>(raw);
+    return true;
+  }
+
+ private:
+  const uint8_t* ptr_;
+  const uint8_t* end_;
+};
+
+// Appends proto fields to a growing buffer. Used to turn the compact
+// sched_switch and sched_waking events back into FtraceEvent messages.
+class ProtoAppender {
+ public:
+  explicit ProtoAppender(std::vector<uint8_t>* buf) : buf_(buf) {}
+
+  template <typename T>
+  void AppendVarInt(uint32_t field_id, T value) {
+    AppendRawVarInt(MakeTagVarInt(field_id));
+    AppendRawVarInt(value);
+  }
+
+  void AppendBytes(uint32_t field_id, const void* data, size_t size) {
+    AppendRawVarInt(MakeTagLengthDelimited(field_id));
+    AppendRawVarInt(size);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buf_->insert(buf_->end(), bytes, bytes + size);
+  }
+
+ private:
+  template <typename T>
+  void AppendRawVarInt(T value) {
+    uint8_t tmp[10];
+    uint8_t* end = WriteVarInt(value, tmp);
+    buf_->insert(buf_->end(), tmp, end);
+  }
+
+  std::vector<uint8_t>* const buf_;
+};
+
+}  // namespace
+
+// Forwards the tokenized data straight to the ProtoTraceTokenizer. Used in the
+// single-threaded mode.
+class ProtoTraceTokenizer::DirectSink {
+ public:
+  DirectSink(ProtoTraceTokenizer* tokenizer, TraceBlobView* buf)
+      : tokenizer_(tokenizer), buf_(buf) {}
+
+  void OnPacket(bool has_ts, int64_t ts, const uint8_t* data, size_t size) {
+    tokenizer_->HandlePacket(has_ts, ts, Slice(data, size));
+  }
+  void OnTimestamp(int64_t ts) { tokenizer_->HandleTimestamp(ts); }
+  void OnFtraceEvent(uint32_t cpu,
+                     int64_t ts,
+                     const uint8_t* data,
+                     size_t size) {
+    tokenizer_->HandleFtraceEvent(cpu, ts, Slice(data, size));
+  }
+  void OnFtraceCompactSched(uint32_t cpu, const uint8_t* data, size_t size) {
+    tokenizer_->HandleFtraceCompactSched(cpu, Slice(data, size));
+  }
+  void OnFtraceBundleEnd(uint32_t cpu) {
+    tokenizer_->HandleFtraceBundleEnd(cpu);
+  }
+  void OnFtraceError() { tokenizer_->HandleFtraceError(); }
+  void OnCompressedPackets(const uint8_t* data, size_t size) {
+    tokenizer_->HandleCompressedPackets(Slice(data, size));
+  }
+
+ private:
+  TraceBlobView Slice(const uint8_t* data, size_t size) {
+    return buf_->slice(buf_->offset_of(data), size);
+  }
+
+  ProtoTraceTokenizer* const tokenizer_;
+  TraceBlobView* const buf_;
+};
+
+// Records the tokenized data into a Batch. Used on the worker threads.
+class ProtoTraceTokenizer::BatchSink {
+ public:
+  explicit BatchSink(Batch* batch) : batch_(batch) {}
+
+  void OnPacket(bool has_ts, int64_t ts, const uint8_t* data, size_t size) {
+    Add(Token::kPacket, has_ts, 0, ts, data, size);
+  }
+  void OnTimestamp(int64_t ts) {
+    Add(Token::kTimestamp, true, 0, ts, batch_->data, 0);
+  }
+  void OnFtraceEvent(uint32_t cpu,
+                     int64_t ts,
+                     const uint8_t* data,
+                     size_t size) {
+    Add(Token::kFtraceEvent, true, cpu, ts, data, size);
+  }
+  void OnFtraceCompactSched(uint32_t cpu, const uint8_t* data, size_t size) {
+    Add(Token::kFtraceCompactSched, false, cpu, 0, data, size);
+  }
+  void OnFtraceBundleEnd(uint32_t cpu) {
+    Add(Token::kFtraceBundleEnd, false, cpu, 0, batch_->data, 0);
+  }
+  void OnFtraceError() {
+    Add(Token::kFtraceError, false, 0, 0, batch_->data, 0);
+  }
+  void OnCompressedPackets(const uint8_t* data, size_t size) {
+    Add(Token::kCompressedPackets, false, 0, 0, data, size);
+  }
+
+ private:
+  void Add(Token::Type type,
+           bool has_ts,
+           uint32_t cpu,
+           int64_t ts,
+           const uint8_t* data,
+           size_t size) {
+    auto offset = static_cast<uint32_t>(data - batch_->data);
+    batch_->tokens.emplace_back(
+        Token{type, has_ts, cpu, ts, offset, static_cast<uint32_t>(size)});
+  }
+
+  Batch* const batch_;
+};
 
 ProtoTraceTokenizer::ProtoTraceTokenizer(TraceProcessorContext* ctx)
     : context_(ctx) {}
-ProtoTraceTokenizer::~ProtoTraceTokenizer() = default;
 
-bool ProtoTraceTokenizer::Parse(std::unique_ptr<uint8_t[]> owned_buf,
-                                size_t size) {
-  uint8_t* data = &owned_buf[0];
+ProtoTraceTokenizer::~ProtoTraceTokenizer() {
+  // The workers might still be referencing the pending batches.
+  std::unique_lock<std::mutex> lock(batch_mutex_);
+  for (const auto& batch : pending_batches_) {
+    Batch* raw_batch = batch.get();
+    batch_cv_.wait(lock, [raw_batch] { return raw_batch->done; });
+  }
+}
+
+bool ProtoTraceTokenizer::Parse(TraceBlobView blob) {
+  const uint8_t* data = blob.data();
+  size_t size = blob.length();
   if (!partial_buf_.empty()) {
     // It takes ~5 bytes for a proto preamble + the varint size.
     const size_t kHeaderBytes = 5;
@@ -99,29 +351,42 @@ bool ProtoTraceTokenizer::Parse(std::unique_ptr<uint8_t[]> owned_buf,
       data += size_missing;
       size -= size_missing;
       partial_buf_.clear();
-      uint8_t* buf_start = &buf[0];  // Note that buf is std::moved below.
-      ParseInternal(std::move(buf), buf_start, size_incl_header);
+      ParseInternal(TraceBlobView(std::move(buf), 0, size_incl_header));
     } else {
       partial_buf_.insert(partial_buf_.end(), data, &data[size]);
       return true;
     }
   }
-  ParseInternal(std::move(owned_buf), data, size);
+  ParseInternal(blob.slice(blob.offset_of(data), size));
   return true;
 }
 
-void ProtoTraceTokenizer::ParseInternal(std::unique_ptr<uint8_t[]> owned_buf,
-                                        uint8_t* data,
-                                        size_t size) {
-  PERFETTO_DCHECK(data >= &owned_buf[0]);
-  const uint8_t* start = &owned_buf[0];
-  const size_t data_off = static_cast<size_t>(data - start);
-  TraceBlobView whole_buf(std::move(owned_buf), data_off, size);
+void ProtoTraceTokenizer::ParseInternal(TraceBlobView whole_buf) {
+  const uint8_t* data = whole_buf.data();
+  const size_t data_off = whole_buf.offset();
+  const size_t size = whole_buf.length();
 
   protos::pbzero::Trace::Decoder decoder(data, size);
-  for (auto it = decoder.packet(); it; ++it) {
-    size_t field_offset = whole_buf.offset_of(it->data());
-    ParsePacket(whole_buf.slice(field_offset, it->size()));
+  if (!context_->thread_pool) {
+    DirectSink sink(this, &whole_buf);
+    for (auto it = decoder.packet(); it; ++it)
+      TokenizePacket(it->data(), it->size(), &sink);
+  } else {
+    std::unique_ptr<Batch> batch;
+    size_t batch_bytes = 0;
+    for (auto it = decoder.packet(); it; ++it) {
+      if (!batch) {
+        batch.reset(new Batch(whole_buf.slice(data_off, size)));
+        batch_bytes = 0;
+      }
+      auto offset = static_cast<uint32_t>(it->data() - batch->data);
+      batch->packets.emplace_back(offset, static_cast<uint32_t>(it->size()));
+      batch_bytes += it->size();
+      if (batch_bytes >= kBatchSizeBytes)
+        SubmitBatch(std::move(batch));
+    }
+    if (batch)
+      SubmitBatch(std::move(batch));
   }
 
   const size_t bytes_left = decoder.bytes_left();
@@ -132,89 +397,278 @@ void ProtoTraceTokenizer::ParseInternal(std::unique_ptr<uint8_t[]> owned_buf,
   }
 }
 
-void ProtoTraceTokenizer::ParsePacket(TraceBlobView packet) {
-  protos::pbzero::TracePacket::Decoder decoder(packet.data(), packet.length());
+void ProtoTraceTokenizer::NotifyEndOfFile() {
+  ApplyBatches(0);
+}
 
-  auto timestamp = decoder.has_timestamp()
-                       ? static_cast<int64_t>(decoder.timestamp())
-                       : latest_timestamp_;
-  latest_timestamp_ = std::max(timestamp, latest_timestamp_);
+void ProtoTraceTokenizer::SubmitBatch(std::unique_ptr<Batch> batch) {
+  Batch* raw_batch = batch.get();
+  pending_batches_.emplace_back(std::move(batch));
+  context_->thread_pool->PostTask([this, raw_batch] {
+    TokenizeBatch(raw_batch);
+  });
 
-  if (decoder.has_ftrace_events()) {
-    auto ftrace_field = decoder.ftrace_events();
-    const size_t fld_off = packet.offset_of(ftrace_field.data);
-    ParseFtraceBundle(packet.slice(fld_off, ftrace_field.size));
-    return;
+  // Push the batches which are already decoded to the sorter (and hence to the
+  // parser) while the workers are busy with the later ones. Limit the number
+  // of batches in flight to bound the memory used.
+  ApplyBatches(kMaxPendingBatchesPerThread *
+               context_->thread_pool->num_threads());
+}
+
+void ProtoTraceTokenizer::TokenizeBatch(Batch* batch) {
+  BatchSink sink(batch);
+  for (const auto& packet : batch->packets)
+    TokenizePacket(batch->data + packet.first, packet.second, &sink);
+
+  std::lock_guard<std::mutex> lock(batch_mutex_);
+  batch->done = true;
+  batch_cv_.notify_all();
+}
+
+void ProtoTraceTokenizer::ApplyBatches(size_t max_pending) {
+  while (!pending_batches_.empty()) {
+    Batch* batch = pending_batches_.front().get();
+    {
+      std::unique_lock<std::mutex> lock(batch_mutex_);
+      if (!batch->done && pending_batches_.size() <= max_pending)
+        return;
+      batch_cv_.wait(lock, [batch] { return batch->done; });
+    }
+
+    const size_t buf_off = batch->buf.offset();
+    for (const Token& token : batch->tokens) {
+      switch (token.type) {
+        case Token::kPacket:
+          HandlePacket(token.has_timestamp, token.timestamp,
+                       batch->buf.slice(buf_off + token.offset, token.size));
+          break;
+        case Token::kTimestamp:
+          HandleTimestamp(token.timestamp);
+          break;
+        case Token::kFtraceEvent:
+          HandleFtraceEvent(
+              token.cpu, token.timestamp,
+              batch->buf.slice(buf_off + token.offset, token.size));
+          break;
+        case Token::kFtraceCompactSched:
+          HandleFtraceCompactSched(
+              token.cpu, batch->buf.slice(buf_off + token.offset, token.size));
+          break;
+        case Token::kFtraceBundleEnd:
+          HandleFtraceBundleEnd(token.cpu);
+          break;
+        case Token::kFtraceError:
+          HandleFtraceError();
+          break;
+        case Token::kCompressedPackets:
+          HandleCompressedPackets(
+              batch->buf.slice(buf_off + token.offset, token.size));
+          break;
+      }
+    }
+    pending_batches_.pop_front();
   }
+}
+
+void ProtoTraceTokenizer::HandlePacket(bool has_timestamp,
+                                       int64_t timestamp,
+                                       TraceBlobView packet) {
+  if (!has_timestamp)
+    timestamp = latest_timestamp_;
+  latest_timestamp_ = std::max(timestamp, latest_timestamp_);
 
   // Use parent data and length because we want to parse this again
   // later to get the exact type of the packet.
   context_->sorter->PushTracePacket(timestamp, std::move(packet));
-  PERFETTO_DCHECK(!decoder.bytes_left());
 }
 
-PERFETTO_ALWAYS_INLINE
-void ProtoTraceTokenizer::ParseFtraceBundle(TraceBlobView bundle) {
-  protos::pbzero::FtraceEventBundle::Decoder decoder(bundle.data(),
-                                                     bundle.length());
+void ProtoTraceTokenizer::HandleTimestamp(int64_t timestamp) {
+  latest_timestamp_ = std::max(timestamp, latest_timestamp_);
+}
 
-  if (PERFETTO_UNLIKELY(!decoder.has_cpu())) {
-    PERFETTO_ELOG("CPU field not found in FtraceEventBundle");
-    context_->storage->IncrementStats(stats::ftrace_bundle_tokenizer_errors);
-    return;
+void ProtoTraceTokenizer::HandleFtraceEvent(uint32_t cpu,
+                                            int64_t timestamp,
+                                            TraceBlobView event) {
+  latest_timestamp_ = std::max(timestamp, latest_timestamp_);
+
+  // We don't need to parse this packet, just push it to be sorted with
+  // the timestamp.
+  context_->sorter->PushFtraceEvent(cpu, timestamp, std::move(event));
+}
+
+void ProtoTraceTokenizer::HandleFtraceCompactSched(uint32_t cpu,
+                                                   TraceBlobView blob) {
+  using protos::pbzero::FtraceEvent;
+  using protos::pbzero::SchedSwitchFtraceEvent;
+  using protos::pbzero::SchedWakingFtraceEvent;
+  protos::pbzero::FtraceEventBundle::CompactSched::Decoder compact(
+      blob.data(), blob.length());
+
+  std::vector<protozero::ConstChars> intern_table;
+  for (auto it = compact.intern_table(); it; ++it)
+    intern_table.emplace_back(it->as_string());
+
+  // The events are turned back into FtraceEvent messages, which are all
+  // written in the same buffer and then pushed to the sorter as slices of it.
+  // This keeps the sorter and the parser unaware of the compact format.
+  std::vector<uint8_t> buf;
+  std::vector<uint8_t> nested_buf;
+  struct ExpandedEvent {
+    int64_t timestamp;
+    size_t offset;
+    size_t size;
+  };
+  std::vector<ExpandedEvent> events;
+  bool valid = true;
+
+  auto comm_at = [&intern_table, &valid](uint32_t index) {
+    if (index >= intern_table.size()) {
+      valid = false;
+      return protozero::ConstChars{nullptr, 0};
+    }
+    return intern_table[index];
+  };
+
+  auto append_event = [&buf, &nested_buf, &events](uint64_t ts, int32_t pid,
+                                                   uint32_t field_id) {
+    size_t offset = buf.size();
+    ProtoAppender event(&buf);
+    event.AppendVarInt(FtraceEvent::kTimestampFieldNumber, ts);
+    event.AppendVarInt(FtraceEvent::kPidFieldNumber, pid);
+    event.AppendBytes(field_id, nested_buf.data(), nested_buf.size());
+    events.emplace_back(
+        ExpandedEvent{static_cast<int64_t>(ts), offset, buf.size() - offset});
+  };
+
+  {
+    using SS = SchedSwitchFtraceEvent;
+    CompactSchedColumn timestamp(compact.switch_timestamp());
+    CompactSchedColumn prev_comm_index(compact.switch_prev_comm_index());
+    CompactSchedColumn prev_pid(compact.switch_prev_pid());
+    CompactSchedColumn prev_prio(compact.switch_prev_prio());
+    CompactSchedColumn prev_state(compact.switch_prev_state());
+    CompactSchedColumn next_comm_index(compact.switch_next_comm_index());
+    CompactSchedColumn next_pid(compact.switch_next_pid());
+    CompactSchedColumn next_prio(compact.switch_next_prio());
+
+    uint64_t ts = 0;
+    for (uint64_t delta = 0; valid && timestamp.Read(&delta);) {
+      ts += delta;
+      uint32_t prev_comm = 0;
+      uint32_t next_comm = 0;
+      int32_t prev_pid_value = 0;
+      int32_t prev_prio_value = 0;
+      int64_t prev_state_value = 0;
+      int32_t next_pid_value = 0;
+      int32_t next_prio_value = 0;
+      valid = prev_comm_index.Read(&prev_comm) &&
+              prev_pid.Read(&prev_pid_value) &&
+              prev_prio.Read(&prev_prio_value) &&
+              prev_state.Read(&prev_state_value) &&
+              next_comm_index.Read(&next_comm) &&
+              next_pid.Read(&next_pid_value) &&
+              next_prio.Read(&next_prio_value);
+      if (!valid)
+        break;
+
+      nested_buf.clear();
+      ProtoAppender ss(&nested_buf);
+      auto prev_comm_str = comm_at(prev_comm);
+      auto next_comm_str = comm_at(next_comm);
+      ss.AppendBytes(SS::kPrevCommFieldNumber, prev_comm_str.data,
+                     prev_comm_str.size);
+      ss.AppendVarInt(SS::kPrevPidFieldNumber, prev_pid_value);
+      ss.AppendVarInt(SS::kPrevPrioFieldNumber, prev_prio_value);
+      ss.AppendVarInt(SS::kPrevStateFieldNumber, prev_state_value);
+      ss.AppendBytes(SS::kNextCommFieldNumber, next_comm_str.data,
+                     next_comm_str.size);
+      ss.AppendVarInt(SS::kNextPidFieldNumber, next_pid_value);
+      ss.AppendVarInt(SS::kNextPrioFieldNumber, next_prio_value);
+      append_event(ts, prev_pid_value, FtraceEvent::kSchedSwitchFieldNumber);
+    }
   }
 
-  uint32_t cpu = decoder.cpu();
-  if (PERFETTO_UNLIKELY(cpu > base::kMaxCpus)) {
-    PERFETTO_ELOG("CPU larger than kMaxCpus (%u > %zu)", cpu, base::kMaxCpus);
+  {
+    using SW = SchedWakingFtraceEvent;
+    CompactSchedColumn timestamp(compact.waking_timestamp());
+    CompactSchedColumn common_pid(compact.waking_common_pid());
+    CompactSchedColumn comm_index(compact.waking_comm_index());
+    CompactSchedColumn pid(compact.waking_pid());
+    CompactSchedColumn prio(compact.waking_prio());
+    CompactSchedColumn success(compact.waking_success());
+    CompactSchedColumn target_cpu(compact.waking_target_cpu());
+
+    uint64_t ts = 0;
+    for (uint64_t delta = 0; valid && timestamp.Read(&delta);) {
+      ts += delta;
+      int32_t common_pid_value = 0;
+      uint32_t comm = 0;
+      int32_t pid_value = 0;
+      int32_t prio_value = 0;
+      int32_t success_value = 0;
+      int32_t target_cpu_value = 0;
+      valid = common_pid.Read(&common_pid_value) && comm_index.Read(&comm) &&
+              pid.Read(&pid_value) && prio.Read(&prio_value) &&
+              success.Read(&success_value) &&
+              target_cpu.Read(&target_cpu_value);
+      if (!valid)
+        break;
+
+      nested_buf.clear();
+      ProtoAppender sw(&nested_buf);
+      auto comm_str = comm_at(comm);
+      sw.AppendBytes(SW::kCommFieldNumber, comm_str.data, comm_str.size);
+      sw.AppendVarInt(SW::kPidFieldNumber, pid_value);
+      sw.AppendVarInt(SW::kPrioFieldNumber, prio_value);
+      sw.AppendVarInt(SW::kSuccessFieldNumber, success_value);
+      sw.AppendVarInt(SW::kTargetCpuFieldNumber, target_cpu_value);
+      append_event(ts, common_pid_value, FtraceEvent::kSchedWakingFieldNumber);
+    }
+  }
+
+  if (!valid) {
+    PERFETTO_ELOG("Invalid CompactSched in FtraceEventBundle");
+    HandleFtraceError();
     return;
   }
+  if (events.empty())
+    return;
 
-  for (auto it = decoder.event(); it; ++it) {
-    size_t off = bundle.offset_of(it->data());
-    ParseFtraceEvent(cpu, bundle.slice(off, it->size()));
+  std::unique_ptr<uint8_t[]> owned_buf(new uint8_t[buf.size()]);
+  memcpy(owned_buf.get(), buf.data(), buf.size());
+  TraceBlobView whole_buf(std::move(owned_buf), 0, buf.size());
+  for (const ExpandedEvent& event : events) {
+    HandleFtraceEvent(cpu, event.timestamp,
+                      whole_buf.slice(event.offset, event.size));
   }
-  context_->sorter->FinalizeFtraceEventBatch(cpu);
 }
 
-PERFETTO_ALWAYS_INLINE
-void ProtoTraceTokenizer::ParseFtraceEvent(uint32_t cpu, TraceBlobView event) {
-  constexpr auto kTimestampFieldNumber =
-      protos::pbzero::FtraceEvent::kTimestampFieldNumber;
-  const uint8_t* data = event.data();
-  const size_t length = event.length();
-  ProtoDecoder decoder(data, length);
-  uint64_t raw_timestamp = 0;
-  bool timestamp_found = false;
+void ProtoTraceTokenizer::HandleFtraceBundleEnd(uint32_t cpu) {
+  context_->sorter->FinalizeFtraceEventBatch(cpu);
+}
 
-  // Speculate on the fact that the timestamp is often the 1st field of the
-  // event.
-  constexpr auto timestampFieldTag = MakeTagVarInt(kTimestampFieldNumber);
-  if (PERFETTO_LIKELY(length > 10 && data[0] == timestampFieldTag)) {
-    // Fastpath.
-    const uint8_t* next = ParseVarInt(data + 1, data + 11, &raw_timestamp);
-    timestamp_found = next != data + 1;
-    decoder.Reset(next);
-  } else {
-    // Slowpath.
-    if (auto ts_field = decoder.FindField(kTimestampFieldNumber)) {
-      timestamp_found = true;
-      raw_timestamp = ts_field.as_uint64();
-    }
-  }
+void ProtoTraceTokenizer::HandleFtraceError() {
+  context_->storage->IncrementStats(stats::ftrace_bundle_tokenizer_errors);
+}
 
-  if (PERFETTO_UNLIKELY(!timestamp_found)) {
-    PERFETTO_ELOG("Timestamp field not found in FtraceEvent");
-    context_->storage->IncrementStats(stats::ftrace_bundle_tokenizer_errors);
+void ProtoTraceTokenizer::HandleCompressedPackets(TraceBlobView packets) {
+  std::unique_ptr<uint8_t[]> buf;
+  size_t size = 0;
+  if (!ZlibInflate(packets.data(), packets.length(), &buf, &size)) {
+    context_->storage->IncrementStats(stats::compressed_packets_invalid);
     return;
   }
 
-  int64_t timestamp = static_cast<int64_t>(raw_timestamp);
-  latest_timestamp_ = std::max(timestamp, latest_timestamp_);
-
-  // We don't need to parse this packet, just push it to be sorted with
-  // the timestamp.
-  context_->sorter->PushFtraceEvent(cpu, timestamp, std::move(event));
+  // The compressed payload is a sequence of whole TracePackets, encoded as a
+  // Trace proto. Unlike the outer trace, they can't span across chunks so they
+  // are tokenized in one go, on this thread, to keep the order of the packets.
+  TraceBlobView inflated(std::move(buf), 0, size);
+  DirectSink sink(this, &inflated);
+  protos::pbzero::Trace::Decoder decoder(inflated.data(), size);
+  for (auto it = decoder.packet(); it; ++it)
+    TokenizePacket(it->data(), it->size(), &sink);
+  if (decoder.bytes_left() > 0)
+    context_->storage->IncrementStats(stats::compressed_packets_invalid);
 }
 
 }  // namespace trace_processor
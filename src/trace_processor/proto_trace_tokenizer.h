@@ -19,21 +19,29 @@
 
 #include <stdint.h>
 
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "src/trace_processor/chunked_trace_reader.h"
+#include "src/trace_processor/trace_blob_view.h"
 
 namespace perfetto {
 namespace trace_processor {
 
 class TraceProcessorContext;
-class TraceBlobView;
 class TraceSorter;
 class TraceStorage;
 
 // Reads a protobuf trace in chunks and extracts boundaries of trace packets
 // (or subfields, for the case of ftrace) with their timestamps.
+//
+// When the context has a ThreadPool, the packets of each chunk are split in
+// batches which are decoded on the worker threads. The results of the batches
+// are then pushed to the sorter in order, on the thread calling Parse(), so
+// that the output is identical to the single-threaded mode.
 class ProtoTraceTokenizer : public ChunkedTraceReader {
  public:
   // |reader| is the abstract method of getting chunks of size |chunk_size_b|
@@ -42,18 +50,81 @@ class ProtoTraceTokenizer : public ChunkedTraceReader {
   ~ProtoTraceTokenizer() override;
 
   // ChunkedTraceReader implementation.
-  bool Parse(std::unique_ptr<uint8_t[]>, size_t size) override;
+  bool Parse(TraceBlobView) override;
+  void NotifyEndOfFile() override;
 
  private:
-  void ParseInternal(std::unique_ptr<uint8_t[]> owned_buf,
-                     uint8_t* data,
-                     size_t size);
-  void ParsePacket(TraceBlobView);
-  void ParseFtraceBundle(TraceBlobView);
-  void ParseFtraceEvent(uint32_t cpu, TraceBlobView);
+  class DirectSink;
+  class BatchSink;
+
+  // The result of decoding a packet on a worker thread. Data is referenced by
+  // offset from Batch::buf rather than by TraceBlobView as the refcount of the
+  // latter is not thread-safe.
+  struct Token {
+    enum Type : uint8_t {
+      kPacket,
+      kTimestamp,
+      kFtraceEvent,
+      kFtraceCompactSched,
+      kFtraceBundleEnd,
+      kFtraceError,
+      kCompressedPackets,
+    };
+    Type type;
+    bool has_timestamp;
+    uint32_t cpu;
+    int64_t timestamp;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  // A run of consecutive packets from the same chunk, decoded as a unit on a
+  // worker thread.
+  struct Batch {
+    explicit Batch(TraceBlobView b) : buf(std::move(b)), data(buf.data()) {}
+
+    TraceBlobView buf;    // Only accessed on the parsing thread.
+    const uint8_t* data;  // == buf.data().
+
+    // (offset, size) of each packet, relative to |data|.
+    std::vector<std::pair<uint32_t, uint32_t>> packets;
+
+    // Written by the worker thread.
+    std::vector<Token> tokens;
+
+    bool done = false;  // Guarded by |batch_mutex_|.
+  };
+
+  void ParseInternal(TraceBlobView);
+
+  // Sink functions. These are always called on the parsing thread, either
+  // directly while tokenizing or when applying a Batch.
+  void HandlePacket(bool has_timestamp, int64_t timestamp, TraceBlobView);
+  void HandleTimestamp(int64_t timestamp);
+  void HandleFtraceEvent(uint32_t cpu, int64_t timestamp, TraceBlobView);
+  // Pushes the events in the compact_sched field of a FtraceEventBundle.
+  void HandleFtraceCompactSched(uint32_t cpu, TraceBlobView);
+  void HandleFtraceBundleEnd(uint32_t cpu);
+  void HandleFtraceError();
+  void HandleCompressedPackets(TraceBlobView);
+
+  // Functions used in the multi-threaded mode.
+  void SubmitBatch(std::unique_ptr<Batch>);
+  void TokenizeBatch(Batch*);  // Called on a worker thread.
+
+  // Pushes the results of the decoded batches to the sorter, in order, until
+  // at most |max_pending| batches are left. Blocks waiting for the workers if
+  // more batches are pending.
+  void ApplyBatches(size_t max_pending);
 
   TraceProcessorContext* context_;
 
+  // Batches submitted to the worker threads in order of submission. Only
+  // accessed on the parsing thread.
+  std::deque<std::unique_ptr<Batch>> pending_batches_;
+  std::mutex batch_mutex_;
+  std::condition_variable batch_cv_;
+
   // Used to glue together trace packets that span across two (or more)
   // Parse() boundaries.
   std::vector<uint8_t> partial_buf_;
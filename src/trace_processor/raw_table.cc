@@ -74,14 +74,12 @@ int RawTable::BestIndex(const QueryConstraints& qc, BestIndexInfo* info) {
   return SQLITE_OK;
 }
 
-void RawTable::FormatSystraceArgs(const std::string& event_name,
+void RawTable::FormatSystraceArgs(NullTermStringView event_name,
                                   ArgSetId arg_set_id,
                                   base::StringWriter* writer) {
-  const auto& set_ids = storage_->args().set_ids();
-  auto lb = std::lower_bound(set_ids.begin(), set_ids.end(), arg_set_id);
-  auto ub = std::find(lb, set_ids.end(), arg_set_id + 1);
-
-  auto start_row = static_cast<uint32_t>(std::distance(set_ids.begin(), lb));
+  const auto& args = storage_->args();
+  auto rows = args.FindArgSetRows(arg_set_id);
+  uint32_t start_row = rows.first;
 
   using Variadic = TraceStorage::Args::Variadic;
   using ValueWriter = std::function<void(const Variadic&)>;
@@ -94,26 +92,24 @@ void RawTable::FormatSystraceArgs(const std::string& event_name,
         writer->AppendDouble(value.real_value);
         break;
       case TraceStorage::Args::Variadic::kString: {
-        const auto& str = storage_->GetString(value.string_value);
+        NullTermStringView str = storage_->GetString(value.string_value);
         writer->AppendString(str.c_str(), str.size());
       }
     }
   };
-  auto write_value_at_index = [this, start_row](uint32_t arg_idx,
-                                                ValueWriter value_fn) {
-    value_fn(storage_->args().arg_values()[start_row + arg_idx]);
+  auto write_value_at_index = [&args, start_row](uint32_t arg_idx,
+                                                 ValueWriter value_fn) {
+    value_fn(args.GetArg(start_row + arg_idx).value);
   };
-  auto write_arg = [this, writer, start_row](uint32_t arg_idx,
-                                             ValueWriter value_fn) {
-    uint32_t arg_row = start_row + arg_idx;
-    const auto& args = storage_->args();
-    const auto& key = storage_->GetString(args.keys()[arg_row]);
-    const auto& value = args.arg_values()[arg_row];
+  auto write_arg = [this, &args, writer, start_row](uint32_t arg_idx,
+                                                    ValueWriter value_fn) {
+    auto arg = args.GetArg(start_row + arg_idx);
+    NullTermStringView key = storage_->GetString(arg.key);
 
     writer->AppendChar(' ');
-    writer->AppendString(key.c_str(), key.length());
+    writer->AppendString(key.c_str(), key.size());
     writer->AppendChar('=');
-    value_fn(value);
+    value_fn(arg.value);
   };
 
   if (event_name == "sched_switch") {
@@ -195,11 +191,10 @@ void RawTable::FormatSystraceArgs(const std::string& event_name,
     using P = protos::pbzero::PrintFtraceEvent;
 
     uint32_t arg_row = start_row + P::kBufFieldNumber - 1;
-    const auto& args = storage_->args();
-    const auto& value = args.arg_values()[arg_row];
-    const auto& str = storage_->GetString(value.string_value);
+    const auto value = args.GetArg(arg_row).value;
+    NullTermStringView str = storage_->GetString(value.string_value);
     // If the last character is a newline in a print, just drop it.
-    auto chars_to_print = !str.empty() && str[str.size() - 1] == '\n'
+    auto chars_to_print = !str.empty() && str.at(str.size() - 1) == '\n'
                               ? str.size() - 1
                               : str.size();
     writer->AppendChar(' ');
@@ -207,9 +202,8 @@ void RawTable::FormatSystraceArgs(const std::string& event_name,
     return;
   }
 
-  uint32_t arg = 0;
-  for (auto it = lb; it != ub; it++) {
-    write_arg(arg++, write_value);
+  for (uint32_t arg = 0; arg < rows.second - rows.first; arg++) {
+    write_arg(arg, write_value);
   }
 }
 
@@ -233,7 +227,7 @@ void RawTable::ToSystrace(sqlite3_context* ctx,
   if (thread.upid.has_value()) {
     tgid = storage_->GetProcess(thread.upid.value()).pid;
   }
-  const auto& name = storage_->GetString(thread.name_id);
+  NullTermStringView name = storage_->GetString(thread.name_id);
 
   char line[4096];
   base::StringWriter writer(line, sizeof(line));
@@ -242,7 +236,8 @@ void RawTable::ToSystrace(sqlite3_context* ctx,
                                      raw_evts.cpus()[row], thread.tid, tgid,
                                      base::StringView(name), &writer);
 
-  const auto& event_name = storage_->GetString(raw_evts.name_ids()[row]);
+  NullTermStringView event_name =
+      storage_->GetString(raw_evts.name_ids()[row]);
   writer.AppendChar(' ');
   if (event_name == "print") {
     writer.AppendString("tracing_mark_write");
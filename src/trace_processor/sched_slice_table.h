@@ -42,7 +42,7 @@ class SchedSliceTable : public StorageTable {
   class EndStateColumn : public StorageColumn {
    public:
     EndStateColumn(std::string col_name,
-                   const std::deque<ftrace_utils::TaskState>* deque);
+                   const ChunkedColumn<ftrace_utils::TaskState>* column);
     ~EndStateColumn() override;
 
     void ReportResult(sqlite3_context*, uint32_t row) const override;
@@ -63,7 +63,7 @@ class SchedSliceTable : public StorageTable {
                        sqlite3_value* value,
                        FilteredRowIndex* index) const;
 
-    const std::deque<ftrace_utils::TaskState>* deque_ = nullptr;
+    const ChunkedColumn<ftrace_utils::TaskState>* column_ = nullptr;
   };
 
   const TraceStorage* const storage_;
@@ -83,13 +83,13 @@ void SliceTracker::StartSlice(int64_t timestamp,
 void SliceTracker::EndAndroid(int64_t timestamp,
                               uint32_t ftrace_tid,
                               uint32_t atrace_tgid) {
-  auto actual_tgid_it = ftrace_to_atrace_tgid_.find(ftrace_tid);
-  if (actual_tgid_it == ftrace_to_atrace_tgid_.end()) {
+  const uint32_t* actual_tgid_ptr = ftrace_to_atrace_tgid_.Find(ftrace_tid);
+  if (!actual_tgid_ptr) {
     // This is possible if we start tracing after a begin slice.
     PERFETTO_DLOG("Unknown tgid for ftrace tid %u", ftrace_tid);
     return;
   }
-  uint32_t actual_tgid = actual_tgid_it->second;
+  uint32_t actual_tgid = *actual_tgid_ptr;
   // atrace_tgid can be 0 in older android versions where the end event would
   // not contain the value.
   if (atrace_tgid != 0 && atrace_tgid != actual_tgid) {
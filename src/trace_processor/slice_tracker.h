@@ -19,6 +19,9 @@
 
 #include <stdint.h>
 
+#include <vector>
+
+#include "perfetto/base/flat_hash_map.h"
 #include "src/trace_processor/trace_storage.h"
 
 namespace perfetto {
@@ -71,8 +74,8 @@ class SliceTracker {
   int64_t GetStackHash(const SlicesStack&);
 
   TraceProcessorContext* const context_;
-  std::unordered_map<UniqueTid, SlicesStack> threads_;
-  std::unordered_map<uint32_t, uint32_t> ftrace_to_atrace_tgid_;
+  base::FlatHashMap<UniqueTid, SlicesStack> threads_;
+  base::FlatHashMap<uint32_t, uint32_t> ftrace_to_atrace_tgid_;
 };
 
 }  // namespace trace_processor
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/spill_file.h"
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "perfetto/base/file_utils.h"
+#include "perfetto/base/utils.h"
+#include "perfetto/protozero/proto_utils.h"
+
+namespace perfetto {
+namespace trace_processor {
+
+namespace {
+
+using protozero::proto_utils::ParseVarInt;
+using protozero::proto_utils::WriteVarInt;
+
+// Three varints of at most 10 bytes each.
+constexpr size_t kMaxHeaderSize = 30;
+
+// The size of the reads done by SpilledRun.
+constexpr size_t kBlockSize = 64 * 1024;
+
+// The amount of data SpillFile buffers before writing it to the file.
+constexpr size_t kFlushSize = 1024 * 1024;
+
+const uint8_t* ParseVarIntOrDie(const uint8_t* start,
+                                const uint8_t* end,
+                                uint64_t* value) {
+  const uint8_t* next = ParseVarInt(start, end, value);
+  PERFETTO_CHECK(next != start);
+  return next;
+}
+
+}  // namespace
+
+SpillFile::SpillFile() : file_(base::TempFile::CreateUnlinked()) {}
+
+SpillFile::~SpillFile() = default;
+
+void SpillFile::BeginRun(int64_t first_ts) {
+  PERFETTO_DCHECK(!in_run_);
+  in_run_ = true;
+  run_start_ = size();
+  run_first_ts_ = first_ts;
+  last_ts_ = first_ts;
+}
+
+void SpillFile::Append(uint32_t queue_idx,
+                       const TraceSorter::TimestampedTracePiece& ttp) {
+  PERFETTO_DCHECK(in_run_);
+  PERFETTO_DCHECK(ttp.timestamp >= last_ts_);
+
+  const uint8_t* payload = ttp.blob_view.data();
+  size_t payload_size = ttp.blob_view.length();
+
+  uint8_t header[kMaxHeaderSize];
+  uint8_t* wptr = header;
+  wptr = WriteVarInt(static_cast<uint64_t>(ttp.timestamp - last_ts_), wptr);
+  wptr = WriteVarInt(queue_idx, wptr);
+  wptr = WriteVarInt(payload_size, wptr);
+  buffer_.insert(buffer_.end(), header, wptr);
+  buffer_.insert(buffer_.end(), payload, payload + payload_size);
+  last_ts_ = ttp.timestamp;
+
+  if (buffer_.size() >= kFlushSize)
+    Flush();
+}
+
+std::unique_ptr<SpilledRun> SpillFile::EndRun() {
+  PERFETTO_DCHECK(in_run_);
+  in_run_ = false;
+
+  // SpilledRun reads straight from the file.
+  Flush();
+  return std::unique_ptr<SpilledRun>(new SpilledRun(
+      *file_, run_start_, flushed_size_, run_first_ts_, last_ts_));
+}
+
+void SpillFile::Truncate() {
+  PERFETTO_DCHECK(!in_run_);
+  buffer_.clear();
+  flushed_size_ = 0;
+  PERFETTO_CHECK(ftruncate(*file_, 0) == 0);
+  PERFETTO_CHECK(lseek(*file_, 0, SEEK_SET) == 0);
+}
+
+void SpillFile::Flush() {
+  if (buffer_.empty())
+    return;
+  ssize_t written = base::WriteAll(*file_, buffer_.data(), buffer_.size());
+  PERFETTO_CHECK(written == static_cast<ssize_t>(buffer_.size()));
+  flushed_size_ += buffer_.size();
+  buffer_.clear();
+}
+
+SpilledRun::SpilledRun(int fd,
+                       uint64_t start,
+                       uint64_t end,
+                       int64_t first_ts,
+                       int64_t last_ts)
+    : fd_(fd),
+      end_(end),
+      last_ts_(last_ts),
+      block_(nullptr, 0, 0),
+      block_offset_(start),
+      ts_(first_ts) {
+  ReadNext();
+}
+
+SpilledRun::~SpilledRun() = default;
+
+TraceSorter::TimestampedTracePiece SpilledRun::Pop() {
+  PERFETTO_DCHECK(!empty_);
+  TraceSorter::TimestampedTracePiece ttp(
+      ts_, 0, block_.slice(payload_offset_, payload_size_));
+  ReadNext();
+  return ttp;
+}
+
+void SpilledRun::ReadNext() {
+  const uint64_t offset = block_offset_ + pos_;
+  if (offset == end_) {
+    // Release the last block as soon as possible.
+    empty_ = true;
+    block_ = TraceBlobView(nullptr, 0, 0);
+    return;
+  }
+
+  // The header is not guaranteed to be in the block if we are close to its
+  // end, unless the block already extends to the end of the run.
+  if (block_.length() - pos_ < kMaxHeaderSize &&
+      block_offset_ + block_.length() < end_) {
+    ReadBlock(offset, kMaxHeaderSize);
+  }
+
+  const uint8_t* start = block_.data() + pos_;
+  const uint8_t* end = block_.data() + block_.length();
+  uint64_t ts_delta = 0;
+  uint64_t queue_idx = 0;
+  uint64_t payload_size = 0;
+  const uint8_t* rptr = start;
+  rptr = ParseVarIntOrDie(rptr, end, &ts_delta);
+  rptr = ParseVarIntOrDie(rptr, end, &queue_idx);
+  rptr = ParseVarIntOrDie(rptr, end, &payload_size);
+  const size_t header_size = static_cast<size_t>(rptr - start);
+
+  ts_ += static_cast<int64_t>(ts_delta);
+  queue_idx_ = static_cast<uint32_t>(queue_idx);
+  payload_size_ = static_cast<size_t>(payload_size);
+
+  // Events larger than the rest of the block get a block of their own.
+  if (pos_ + header_size + payload_size_ > block_.length())
+    ReadBlock(offset, header_size + payload_size_);
+  payload_offset_ = pos_ + header_size;
+  pos_ = payload_offset_ + payload_size_;
+}
+
+void SpilledRun::ReadBlock(uint64_t offset, size_t min_size) {
+  PERFETTO_DCHECK(offset < end_);
+  const size_t size = static_cast<size_t>(
+      std::min<uint64_t>(std::max(kBlockSize, min_size), end_ - offset));
+  std::unique_ptr<uint8_t[]> buf(new uint8_t[size]);
+  for (size_t done = 0; done < size;) {
+    ssize_t rd = PERFETTO_EINTR(pread(fd_, buf.get() + done, size - done,
+                                      static_cast<off_t>(offset + done)));
+    PERFETTO_CHECK(rd > 0);
+    done += static_cast<size_t>(rd);
+  }
+  block_ = TraceBlobView(std::move(buf), 0, size);
+  block_offset_ = offset;
+  pos_ = 0;
+}
+
+}  // namespace trace_processor
+}  // namespace perfetto
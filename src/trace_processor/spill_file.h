@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACE_PROCESSOR_SPILL_FILE_H_
+#define SRC_TRACE_PROCESSOR_SPILL_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "perfetto/base/temp_file.h"
+#include "src/trace_processor/trace_blob_view.h"
+#include "src/trace_processor/trace_sorter.h"
+
+namespace perfetto {
+namespace trace_processor {
+
+class SpilledRun;
+
+// An unlinked temporary file where the TraceSorter moves its events when they
+// take more memory than its budget. The file is a sequence of runs, each
+// sorted by timestamp, which are read back through SpilledRun.
+//
+// Each event is stored as:
+//   varint: timestamp delta from the previous event of the run.
+//   varint: index of the TraceSorter queue the event was pushed to.
+//   varint: payload size.
+//   payload: the bytes of the TraceBlobView.
+class SpillFile {
+ public:
+  SpillFile();
+  ~SpillFile();
+
+  // Starts a new run. The events of a run must be appended in timestamp
+  // order.
+  void BeginRun(int64_t first_ts);
+  void Append(uint32_t queue_idx,
+              const TraceSorter::TimestampedTracePiece& ttp);
+
+  // Ends the current run and returns the reader for it.
+  std::unique_ptr<SpilledRun> EndRun();
+
+  // Drops the contents of the file. Must be called only when all the
+  // SpilledRuns read from the file have been destroyed.
+  void Truncate();
+
+  // The total number of bytes written to the file since the last Truncate().
+  uint64_t size() const { return flushed_size_ + buffer_.size(); }
+
+ private:
+  SpillFile(const SpillFile&) = delete;
+  SpillFile& operator=(const SpillFile&) = delete;
+
+  void Flush();
+
+  base::TempFile file_;
+  std::vector<uint8_t> buffer_;
+  uint64_t flushed_size_ = 0;
+
+  // The state of the run being written.
+  bool in_run_ = false;
+  uint64_t run_start_ = 0;
+  int64_t run_first_ts_ = 0;
+  int64_t last_ts_ = 0;
+};
+
+// Reads back the events of one run of a SpillFile, in order. The file is read
+// in blocks and the TraceBlobViews of the events share the block they were
+// read from, so the memory of a block is released once all its events have
+// been parsed.
+class SpilledRun {
+ public:
+  SpilledRun(int fd,
+             uint64_t start,
+             uint64_t end,
+             int64_t first_ts,
+             int64_t last_ts);
+  ~SpilledRun();
+
+  bool empty() const { return empty_; }
+
+  // The timestamp and queue of the next event. Must not be called if empty().
+  int64_t timestamp() const {
+    PERFETTO_DCHECK(!empty_);
+    return ts_;
+  }
+  uint32_t queue_idx() const {
+    PERFETTO_DCHECK(!empty_);
+    return queue_idx_;
+  }
+
+  // The timestamp of the last event of the run.
+  int64_t last_ts() const { return last_ts_; }
+
+  // Returns the next event and advances to the one after.
+  TraceSorter::TimestampedTracePiece Pop();
+
+ private:
+  SpilledRun(const SpilledRun&) = delete;
+  SpilledRun& operator=(const SpilledRun&) = delete;
+
+  // Decodes the header of the next event, reading a new block if necessary.
+  void ReadNext();
+
+  // Replaces |block_| with the contents of the file starting at |offset|. The
+  // block is at least |min_size| bytes long unless the run ends before.
+  void ReadBlock(uint64_t offset, size_t min_size);
+
+  const int fd_;
+  const uint64_t end_;
+  const int64_t last_ts_;
+
+  TraceBlobView block_;
+  uint64_t block_offset_ = 0;  // The file offset of the start of |block_|.
+  size_t pos_ = 0;             // The offset of the next header in |block_|.
+
+  // The header of the next event.
+  bool empty_ = false;
+  int64_t ts_ = 0;
+  uint32_t queue_idx_ = 0;
+  size_t payload_offset_ = 0;  // Offset in |block_|.
+  size_t payload_size_ = 0;
+};
+
+}  // namespace trace_processor
+}  // namespace perfetto
+
+#endif  // SRC_TRACE_PROCESSOR_SPILL_FILE_H_
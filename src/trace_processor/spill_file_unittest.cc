@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/spill_file.h"
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace perfetto {
+namespace trace_processor {
+namespace {
+
+using TimestampedTracePiece = TraceSorter::TimestampedTracePiece;
+
+TimestampedTracePiece CreatePiece(int64_t ts, const std::string& data) {
+  std::unique_ptr<uint8_t[]> buf(new uint8_t[data.size()]);
+  memcpy(buf.get(), data.data(), data.size());
+  return TimestampedTracePiece(ts, 0,
+                               TraceBlobView(std::move(buf), 0, data.size()));
+}
+
+std::string ToString(const TimestampedTracePiece& ttp) {
+  return std::string(reinterpret_cast<const char*>(ttp.blob_view.data()),
+                     ttp.blob_view.length());
+}
+
+TEST(SpillFileTest, RoundTrip) {
+  SpillFile file;
+  file.BeginRun(10);
+  file.Append(0, CreatePiece(10, "foo"));
+  file.Append(3, CreatePiece(10, ""));
+  file.Append(1, CreatePiece(1000000000000, "bar"));
+  std::unique_ptr<SpilledRun> run = file.EndRun();
+  ASSERT_EQ(run->last_ts(), 1000000000000);
+
+  ASSERT_FALSE(run->empty());
+  ASSERT_EQ(run->timestamp(), 10);
+  ASSERT_EQ(run->queue_idx(), 0u);
+  ASSERT_EQ(ToString(run->Pop()), "foo");
+
+  ASSERT_EQ(run->timestamp(), 10);
+  ASSERT_EQ(run->queue_idx(), 3u);
+  ASSERT_EQ(ToString(run->Pop()), "");
+
+  ASSERT_EQ(run->timestamp(), 1000000000000);
+  ASSERT_EQ(run->queue_idx(), 1u);
+  TimestampedTracePiece ttp = run->Pop();
+  ASSERT_EQ(ttp.timestamp, 1000000000000);
+  ASSERT_EQ(ToString(ttp), "bar");
+  ASSERT_TRUE(run->empty());
+}
+
+// Writes several runs with events that straddle the read blocks (including
+// events larger than a block) and reads them back interleaved.
+TEST(SpillFileTest, MultipleRunsAndLargeEvents) {
+  SpillFile file;
+  std::vector<std::vector<std::string>> expected(3);
+  std::vector<std::unique_ptr<SpilledRun>> runs;
+  for (size_t r = 0; r < expected.size(); r++) {
+    file.BeginRun(0);
+    for (size_t i = 0; i < 2000; i++) {
+      size_t size = (i % 100 == 99) ? 100000 + i : i % 300;
+      std::string data(size, static_cast<char>('a' + (i + r) % 26));
+      file.Append(static_cast<uint32_t>(r), CreatePiece(int64_t(i), data));
+      expected[r].push_back(data);
+    }
+    runs.emplace_back(file.EndRun());
+  }
+  ASSERT_GT(file.size(), 3u * 1024 * 1024);
+
+  for (size_t i = 0; i < 2000; i++) {
+    for (size_t r = 0; r < runs.size(); r++) {
+      ASSERT_FALSE(runs[r]->empty());
+      ASSERT_EQ(runs[r]->timestamp(), int64_t(i));
+      ASSERT_EQ(runs[r]->queue_idx(), r);
+      ASSERT_EQ(ToString(runs[r]->Pop()), expected[r][i]);
+    }
+  }
+  for (const auto& run : runs)
+    ASSERT_TRUE(run->empty());
+
+  runs.clear();
+  file.Truncate();
+  ASSERT_EQ(file.size(), 0u);
+}
+
+}  // namespace
+}  // namespace trace_processor
+}  // namespace perfetto
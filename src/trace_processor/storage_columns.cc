@@ -23,8 +23,8 @@ StorageColumn::StorageColumn(std::string col_name, bool hidden)
     : col_name_(col_name), hidden_(hidden) {}
 StorageColumn::~StorageColumn() = default;
 
-TsEndAccessor::TsEndAccessor(const std::deque<int64_t>* ts,
-                             const std::deque<int64_t>* dur)
+TsEndAccessor::TsEndAccessor(const ChunkedColumn<int64_t>* ts,
+                             const ChunkedColumn<int64_t>* dur)
     : ts_(ts), dur_(dur) {}
 TsEndAccessor::~TsEndAccessor() = default;
 
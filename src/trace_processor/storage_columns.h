@@ -21,8 +21,11 @@
 #include <string>
 #include <vector>
 
+#include "src/trace_processor/chunked_column.h"
+#include "src/trace_processor/filter_kernels.h"
 #include "src/trace_processor/filtered_row_index.h"
 #include "src/trace_processor/sqlite_utils.h"
+#include "src/trace_processor/string_pool.h"
 #include "src/trace_processor/trace_storage.h"
 
 namespace perfetto {
@@ -72,19 +75,32 @@ class StorageColumn {
   bool hidden_ = false;
 };
 
-template <typename Id>
+// Returns the string with the given id from the backing store of a
+// StringColumn: either the StringPool of the storage or a fixed table of
+// strings indexed by id (e.g. for enums).
+inline NullTermStringView GetStringFromMap(const StringPool& pool,
+                                           StringPool::Id id) {
+  return pool.Get(id);
+}
+
+inline NullTermStringView GetStringFromMap(const std::vector<std::string>& map,
+                                           size_t id) {
+  return NullTermStringView(map[id]);
+}
+
+template <typename Id, typename StringMap>
 class StringColumn final : public StorageColumn {
  public:
   StringColumn(std::string col_name,
-               const std::deque<Id>* deque,
-               const std::vector<std::string>* string_map,
+               const ChunkedColumn<Id>* column,
+               const StringMap* string_map,
                bool hidden = false)
       : StorageColumn(col_name, hidden),
-        deque_(deque),
+        column_(column),
         string_map_(string_map) {}
 
   void ReportResult(sqlite3_context* ctx, uint32_t row) const override {
-    const auto& str = (*string_map_)[(*deque_)[row]];
+    NullTermStringView str = GetString(row);
     if (str.empty()) {
       sqlite3_result_null(ctx);
     } else {
@@ -94,7 +110,7 @@ class StringColumn final : public StorageColumn {
 
   Bounds BoundFilter(int, sqlite3_value*) const override {
     Bounds bounds;
-    bounds.max_idx = static_cast<uint32_t>(deque_->size());
+    bounds.max_idx = static_cast<uint32_t>(column_->size());
     return bounds;
   }
 
@@ -103,14 +119,14 @@ class StringColumn final : public StorageColumn {
   Comparator Sort(const QueryConstraints::OrderBy& ob) const override {
     if (ob.desc) {
       return [this](uint32_t f, uint32_t s) {
-        const std::string& a = (*string_map_)[(*deque_)[f]];
-        const std::string& b = (*string_map_)[(*deque_)[s]];
+        NullTermStringView a = GetString(f);
+        NullTermStringView b = GetString(s);
         return sqlite_utils::CompareValuesDesc(a, b);
       };
     }
     return [this](uint32_t f, uint32_t s) {
-      const std::string& a = (*string_map_)[(*deque_)[f]];
-      const std::string& b = (*string_map_)[(*deque_)[s]];
+      NullTermStringView a = GetString(f);
+      NullTermStringView b = GetString(s);
       return sqlite_utils::CompareValuesAsc(a, b);
     };
   }
@@ -122,8 +138,12 @@ class StringColumn final : public StorageColumn {
   bool HasOrdering() const override { return false; }
 
  private:
-  const std::deque<Id>* deque_ = nullptr;
-  const std::vector<std::string>* string_map_ = nullptr;
+  NullTermStringView GetString(uint32_t row) const {
+    return GetStringFromMap(*string_map_, (*column_)[row]);
+  }
+
+  const ChunkedColumn<Id>* column_ = nullptr;
+  const StringMap* string_map_ = nullptr;
 };
 
 // The implementation of StorageColumn for numeric data types.
@@ -189,6 +209,9 @@ class NumericColumn : public StorageColumn {
       return;
     }
 
+    if (FilterWithKernel(op, value, index))
+      return;
+
     if (kIsIntegralType && (type == SQLITE_INTEGER || type == SQLITE_NULL)) {
       FilterWithCast<int64_t>(op, value, index);
     } else if (type == SQLITE_INTEGER || type == SQLITE_FLOAT ||
@@ -235,6 +258,92 @@ class NumericColumn : public StorageColumn {
   NumericType kTMin = std::numeric_limits<NumericType>::lowest();
   NumericType kTMax = std::numeric_limits<NumericType>::max();
 
+  // Filters the rows of this column using the kernels in filter_kernels.h,
+  // which compare whole spans of the backing ChunkedColumn at once. Returns
+  // false if this is not possible (e.g. the accessor doesn't expose a
+  // ChunkedColumn or the sqlite value is not exactly representable as a
+  // NumericType); the caller should then fall back to FilterWithCast().
+  bool FilterWithKernel(int op,
+                        sqlite3_value* value,
+                        FilteredRowIndex* index) const {
+    const ChunkedColumn<NumericType>* column = accessor_.column();
+    if (!column)
+      return false;
+
+    filter_kernels::CompareOp cmp_op;
+    NumericType constant;
+    if (!ToCompareOp(op, &cmp_op) ||
+        !ExtractExactValue(value, &constant, std::is_integral<NumericType>()))
+      return false;
+
+    sqlite_utils::NumericPredicate<NumericType> predicate(op, constant);
+    auto row_predicate = [column, predicate](uint32_t row) {
+      return predicate((*column)[row]);
+    };
+    auto bitmap_fn = [column, cmp_op, constant](uint32_t start_row,
+                                                uint32_t end_row,
+                                                uint64_t* words) {
+      column->ForEachSpan(
+          start_row, end_row,
+          [&](const NumericType* data, size_t count, uint32_t row) {
+            filter_kernels::CompareInto(cmp_op, data, count, constant, words,
+                                        row - start_row);
+          });
+    };
+    index->FilterRowsWithBitmap(row_predicate, bitmap_fn);
+    return true;
+  }
+
+  static bool ToCompareOp(int op, filter_kernels::CompareOp* cmp_op) {
+    using filter_kernels::CompareOp;
+    switch (op) {
+      case SQLITE_INDEX_CONSTRAINT_EQ:
+        *cmp_op = CompareOp::kEq;
+        return true;
+      case SQLITE_INDEX_CONSTRAINT_NE:
+        *cmp_op = CompareOp::kNe;
+        return true;
+      case SQLITE_INDEX_CONSTRAINT_LT:
+        *cmp_op = CompareOp::kLt;
+        return true;
+      case SQLITE_INDEX_CONSTRAINT_LE:
+        *cmp_op = CompareOp::kLe;
+        return true;
+      case SQLITE_INDEX_CONSTRAINT_GT:
+        *cmp_op = CompareOp::kGt;
+        return true;
+      case SQLITE_INDEX_CONSTRAINT_GE:
+        *cmp_op = CompareOp::kGe;
+        return true;
+    }
+    return false;
+  }
+
+  // Integral columns: only integers in the range of NumericType are exact.
+  static bool ExtractExactValue(sqlite3_value* value,
+                                NumericType* out,
+                                std::true_type /* is_integral */) {
+    if (sqlite3_value_type(value) != SQLITE_INTEGER)
+      return false;
+    int64_t raw = sqlite3_value_int64(value);
+    if (raw < static_cast<int64_t>(std::numeric_limits<NumericType>::min()) ||
+        raw > static_cast<int64_t>(std::numeric_limits<NumericType>::max()))
+      return false;
+    *out = static_cast<NumericType>(raw);
+    return true;
+  }
+
+  // Real columns: matches FilterWithCast<double>().
+  static bool ExtractExactValue(sqlite3_value* value,
+                                NumericType* out,
+                                std::false_type /* is_integral */) {
+    auto type = sqlite3_value_type(value);
+    if (type != SQLITE_INTEGER && type != SQLITE_FLOAT)
+      return false;
+    *out = static_cast<NumericType>(sqlite3_value_double(value));
+    return true;
+  }
+
   // Filters the rows of this column by creating the predicate from the sqlite
   // value using type |UpcastNumericType| and casting data from the column
   // to also be this type.
@@ -262,7 +371,7 @@ class NumericColumn : public StorageColumn {
 
 // Defines an accessor for numeric columns.
 // An accessor is a abstraction over the method to retrieve data in a column. As
-// there are many possible types of backing data (std::vector, std::deque,
+// there are many possible types of backing data (std::vector, ChunkedColumn,
 // creating on the flight etc.), this class hides this complexity behind an
 // interface to let the column implementation focus on actually interfacing
 // with SQLite and rest of trace processor.
@@ -302,37 +411,42 @@ class NumericAccessor {
   virtual std::vector<uint32_t> EqualIndices(NumericType) const {
     PERFETTO_CHECK(false);
   }
+
+  // Returns the ChunkedColumn backing this accessor, if any. When non-null,
+  // |Get(idx)| must be equal to (*column())[idx] and filters can operate
+  // directly on the contiguous spans of the column.
+  virtual const ChunkedColumn<NumericType>* column() const { return nullptr; }
 };
 
-// An accessor implementation for numeric columns which uses a deque as the
-// backing storage with an opitonal index for quick equality filtering.
+// An accessor implementation for numeric columns which uses a ChunkedColumn as
+// the backing storage with an opitonal index for quick equality filtering.
 template <typename NumericType>
-class NumericDequeAccessor : public NumericAccessor<NumericType> {
+class NumericColumnAccessor : public NumericAccessor<NumericType> {
  public:
-  NumericDequeAccessor(const std::deque<NumericType>* deque,
-                       const std::deque<std::vector<uint32_t>>* index,
-                       bool has_ordering)
-      : deque_(deque), index_(index), has_ordering_(has_ordering) {}
-  ~NumericDequeAccessor() override = default;
+  NumericColumnAccessor(const ChunkedColumn<NumericType>* column,
+                        const std::deque<std::vector<uint32_t>>* index,
+                        bool has_ordering)
+      : column_(column), index_(index), has_ordering_(has_ordering) {}
+  ~NumericColumnAccessor() override = default;
 
   uint32_t Size() const override {
-    return static_cast<uint32_t>(deque_->size());
+    return static_cast<uint32_t>(column_->size());
   }
 
-  NumericType Get(uint32_t idx) const override { return (*deque_)[idx]; }
+  NumericType Get(uint32_t idx) const override { return (*column_)[idx]; }
 
   bool HasOrdering() const override { return has_ordering_; }
 
   uint32_t LowerBoundIndex(NumericType value) const override {
     PERFETTO_DCHECK(HasOrdering());
-    auto it = std::lower_bound(deque_->begin(), deque_->end(), value);
-    return static_cast<uint32_t>(std::distance(deque_->begin(), it));
+    auto it = std::lower_bound(column_->begin(), column_->end(), value);
+    return static_cast<uint32_t>(std::distance(column_->begin(), it));
   }
 
   uint32_t UpperBoundIndex(NumericType value) const override {
     PERFETTO_DCHECK(HasOrdering());
-    auto it = std::upper_bound(deque_->begin(), deque_->end(), value);
-    return static_cast<uint32_t>(std::distance(deque_->begin(), it));
+    auto it = std::upper_bound(column_->begin(), column_->end(), value);
+    return static_cast<uint32_t>(std::distance(column_->begin(), it));
   }
 
   bool CanFindEqualIndices() const override {
@@ -346,15 +460,18 @@ class NumericDequeAccessor : public NumericAccessor<NumericType> {
     return (*index_)[static_cast<size_t>(value)];
   }
 
+  const ChunkedColumn<NumericType>* column() const override { return column_; }
+
  private:
-  const std::deque<NumericType>* deque_ = nullptr;
+  const ChunkedColumn<NumericType>* column_ = nullptr;
   const std::deque<std::vector<uint32_t>>* index_ = nullptr;
   bool has_ordering_ = false;
 };
 
 class TsEndAccessor : public NumericAccessor<int64_t> {
  public:
-  TsEndAccessor(const std::deque<int64_t>* ts, const std::deque<int64_t>* dur);
+  TsEndAccessor(const ChunkedColumn<int64_t>* ts,
+                const ChunkedColumn<int64_t>* dur);
   ~TsEndAccessor() override;
 
   uint32_t Size() const override { return static_cast<uint32_t>(ts_->size()); }
@@ -364,8 +481,8 @@ class TsEndAccessor : public NumericAccessor<int64_t> {
   }
 
  private:
-  const std::deque<int64_t>* ts_ = nullptr;
-  const std::deque<int64_t>* dur_ = nullptr;
+  const ChunkedColumn<int64_t>* ts_ = nullptr;
+  const ChunkedColumn<int64_t>* dur_ = nullptr;
 };
 
 class RowIdAccessor : public NumericAccessor<int64_t> {
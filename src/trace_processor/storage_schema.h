@@ -50,18 +50,18 @@ class StorageSchema {
     template <class NumericType>
     Builder& AddNumericColumn(
         std::string column_name,
-        const std::deque<NumericType>* vals,
+        const ChunkedColumn<NumericType>* vals,
         const std::deque<std::vector<uint32_t>>* index = nullptr) {
-      NumericDequeAccessor<NumericType> accessor(vals, index,
-                                                 false /* has_ordering */);
+      NumericColumnAccessor<NumericType> accessor(vals, index,
+                                                  false /* has_ordering */);
       return AddGenericNumericColumn(column_name, accessor);
     }
 
     template <class NumericType>
     Builder& AddOrderedNumericColumn(std::string column_name,
-                                     const std::deque<NumericType>* vals) {
-      NumericDequeAccessor<NumericType> accessor(vals, nullptr,
-                                                 true /* has_ordering */);
+                                     const ChunkedColumn<NumericType>* vals) {
+      NumericColumnAccessor<NumericType> accessor(vals, nullptr,
+                                                  true /* has_ordering */);
       return AddGenericNumericColumn(column_name, accessor);
     }
 
@@ -73,11 +73,12 @@ class StorageSchema {
       return *this;
     }
 
-    template <class Id>
+    template <class Id, class StringMap>
     Builder& AddStringColumn(std::string column_name,
-                             const std::deque<Id>* ids,
-                             const std::vector<std::string>* string_map) {
-      columns_.emplace_back(new StringColumn<Id>(column_name, ids, string_map));
+                             const ChunkedColumn<Id>* ids,
+                             const StringMap* string_map) {
+      columns_.emplace_back(
+          new StringColumn<Id, StringMap>(column_name, ids, string_map));
       return *this;
     }
 
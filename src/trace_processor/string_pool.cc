@@ -21,7 +21,10 @@
 namespace perfetto {
 namespace trace_processor {
 
-StringPool::StringPool() {
+StringPool::StringPool()
+    : index_(kInitialIndexCapacity),
+      index_shift_(64 - static_cast<uint32_t>(
+                            __builtin_ctzll(kInitialIndexCapacity))) {
   blocks_.emplace_back();
 
   // Reserve a slot for the null string.
@@ -33,7 +36,9 @@ StringPool::~StringPool() = default;
 StringPool::StringPool(StringPool&&) noexcept = default;
 StringPool& StringPool::operator=(StringPool&&) = default;
 
-StringPool::Id StringPool::InsertString(base::StringView str, uint64_t hash) {
+StringPool::Id StringPool::InsertString(base::StringView str,
+                                        uint64_t hash,
+                                        size_t slot) {
   // We shouldn't be writing string with more than 2^16 characters to the pool.
   PERFETTO_CHECK(str.size() < std::numeric_limits<uint16_t>::max());
 
@@ -57,10 +62,29 @@ StringPool::Id StringPool::InsertString(base::StringView str, uint64_t hash) {
   // Finish by computing the id of the pointer and adding a mapping from the
   // hash to the string_id.
   Id string_id = PtrToId(ptr);
-  string_index_.emplace(hash, string_id);
+  PERFETTO_DCHECK(string_id != 0 && index_[slot].id == 0);
+  index_[slot] = IndexSlot{hash, string_id};
+  if (++index_size_ * 4 > index_.size() * 3)
+    GrowIndex();
   return string_id;
 }
 
+void StringPool::GrowIndex() {
+  std::vector<IndexSlot> old_index(index_.size() * 2);
+  old_index.swap(index_);
+  index_shift_--;
+
+  const size_t mask = index_.size() - 1;
+  for (const IndexSlot& old_slot : old_index) {
+    if (old_slot.id == 0)
+      continue;
+    size_t i = SlotForHash(old_slot.hash);
+    while (index_[i].id != 0)
+      i = (i + 1) & mask;
+    index_[i] = old_slot;
+  }
+}
+
 uint8_t* StringPool::Block::TryInsert(base::StringView str) {
   auto str_size = str.size();
   auto size = str_size + kMetadataSize;
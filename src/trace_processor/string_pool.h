@@ -20,7 +20,6 @@
 #include "perfetto/base/paged_memory.h"
 #include "src/trace_processor/null_term_string_view.h"
 
-#include <unordered_map>
 #include <vector>
 
 namespace perfetto {
@@ -69,12 +68,16 @@ class StringPool {
       return 0;
 
     auto hash = str.Hash();
-    auto id_it = string_index_.find(hash);
-    if (id_it != string_index_.end()) {
-      PERFETTO_DCHECK(Get(id_it->second) == str);
-      return id_it->second;
+    const size_t mask = index_.size() - 1;
+    for (size_t i = SlotForHash(hash);; i = (i + 1) & mask) {
+      const IndexSlot& slot = index_[i];
+      if (slot.id == 0)
+        return InsertString(str, hash, i);
+      if (slot.hash == hash) {
+        PERFETTO_DCHECK(Get(slot.id) == str);
+        return slot.id;
+      }
     }
-    return InsertString(str, hash);
   }
 
   NullTermStringView Get(Id id) const {
@@ -83,12 +86,20 @@ class StringPool {
     return GetFromPtr(IdToPtr(id));
   }
 
-  Iterator CreateIterator() { return Iterator(this); }
+  Iterator CreateIterator() const { return Iterator(this); }
 
-  size_t size() const { return string_index_.size(); }
+  size_t size() const { return index_size_; }
 
  private:
   using StringHash = uint64_t;
+
+  // A slot of the open-addressing index from string hashes to ids. Slots with
+  // id == 0 are empty as the null string is never added to the index.
+  struct IndexSlot {
+    StringHash hash;
+    Id id;
+  };
+
   struct Block {
     Block() : mem_(base::PagedMemory::Allocate(kBlockSize)) {}
     ~Block() = default;
@@ -129,8 +140,22 @@ class StringPool {
   // Number of bytes to reserve for size and null terminator.
   static constexpr uint8_t kMetadataSize = 3;
 
-  // Inserts the string with the given hash into the pool
-  Id InsertString(base::StringView, uint64_t hash);
+  // The initial number of slots of |index_|. Must be a power of 2.
+  static constexpr size_t kInitialIndexCapacity = 4096;
+
+  // Inserts the string with the given hash into the pool and stores its id in
+  // the (empty) index slot |slot|.
+  Id InsertString(base::StringView, uint64_t hash, size_t slot);
+
+  // Doubles the number of slots of |index_| and rehashes all the entries.
+  void GrowIndex();
+
+  // Returns the first slot to probe for |hash|. Uses Fibonacci hashing so
+  // that the top bits of the product, which depend on all the bits of the
+  // hash, pick the slot.
+  size_t SlotForHash(StringHash hash) const {
+    return static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> index_shift_);
+  }
 
   // |ptr| should point to the start of the string metadata (i.e. the first byte
   // of the size).
@@ -182,10 +207,13 @@ class StringPool {
   // The actual memory storing the strings.
   std::vector<Block> blocks_;
 
-  // Maps hashes of strings to the Id in the string pool.
-  // TODO(lalitm): At some point we should benchmark just using a static
-  // hashtable of 1M elements, we can afford paying a fixed 8MB here
-  std::unordered_map<StringHash, Id> string_index_;
+  // Maps hashes of strings to the Id in the string pool. This is a linear
+  // probing hash table with a power of 2 number of slots which is kept at
+  // most 3/4 full; this avoids the per-entry allocation of a node based map
+  // and keeps the probes for a lookup in one or two cache lines.
+  std::vector<IndexSlot> index_;
+  uint32_t index_shift_ = 0;  // 64 - log2(index_.size()).
+  size_t index_size_ = 0;     // The number of non-empty slots.
 };
 
 }  // namespace trace_processor
@@ -17,6 +17,8 @@
 #include "src/trace_processor/string_pool.h"
 
 #include <random>
+#include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -108,6 +110,27 @@ TEST(StringPoolTest, StressTest) {
   ASSERT_EQ(string_map.size(), 0);
 }
 
+// Interns enough strings to grow the index several times and checks that all
+// of them can still be found after the rehashes.
+TEST(StringPoolTest, IndexGrowth) {
+  constexpr size_t kNumStrings = 100000;
+  StringPool pool;
+  std::vector<std::string> strings;
+  std::vector<StringPool::Id> ids;
+  for (size_t i = 0; i < kNumStrings; i++) {
+    strings.emplace_back("str_" + std::to_string(i));
+    ids.push_back(pool.InternString(base::StringView(strings.back())));
+    ASSERT_NE(ids.back(), 0u);
+  }
+  ASSERT_EQ(pool.size(), kNumStrings);
+
+  for (size_t i = 0; i < kNumStrings; i++) {
+    ASSERT_EQ(pool.InternString(base::StringView(strings[i])), ids[i]);
+    ASSERT_EQ(pool.Get(ids[i]), base::StringView(strings[i]));
+  }
+  ASSERT_EQ(pool.size(), kNumStrings);
+}
+
 }  // namespace
 }  // namespace trace_processor
 }  // namespace perfetto
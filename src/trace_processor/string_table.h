@@ -20,6 +20,7 @@
 #include <limits>
 #include <memory>
 
+#include "src/trace_processor/string_pool.h"
 #include "src/trace_processor/table.h"
 
 namespace perfetto {
@@ -59,8 +60,7 @@ class StringTable : public Table {
     int Column(sqlite3_context*, int N) override;
 
    private:
-    size_t row_ = 0;
-    size_t num_rows_ = 0;
+    StringPool::Iterator it_;
     const TraceStorage* const storage_;
   };
 
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "perfetto/base/logging.h"
+
+namespace perfetto {
+namespace trace_processor {
+
+ThreadPool::ThreadPool(uint32_t num_threads) {
+  PERFETTO_CHECK(num_threads > 0);
+  for (uint32_t i = 0; i < num_threads; i++)
+    workers_.emplace_back(&ThreadPool::RunWorker, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& worker : workers_)
+    worker.join();
+}
+
+void ThreadPool::PostTask(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PERFETTO_DCHECK(!quit_);
+    tasks_.emplace_back(std::move(task));
+  }
+  cv_.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count,
+                             const std::function<void(size_t)>& fn) {
+  if (count == 0)
+    return;
+
+  // The state is shared with the helper tasks, which might be scheduled only
+  // after all the work has been done (e.g. if the workers are busy). In that
+  // case they just find no work left and return.
+  struct State {
+    std::atomic<size_t> next_idx{0};
+    size_t done = 0;  // Guarded by |mutex|.
+    std::mutex mutex;
+    std::condition_variable cv;
+  };
+  auto state = std::make_shared<State>();
+  const std::function<void(size_t)>* fn_ptr = &fn;
+
+  // |fn_ptr| is only dereferenced after claiming an index, which can only
+  // happen before this function returns.
+  auto run = [state, fn_ptr, count] {
+    size_t num_run = 0;
+    for (;;) {
+      size_t idx = state->next_idx.fetch_add(1, std::memory_order_relaxed);
+      if (idx >= count)
+        break;
+      (*fn_ptr)(idx);
+      num_run++;
+    }
+    if (num_run == 0)
+      return;
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->done += num_run;
+    if (state->done == count)
+      state->cv.notify_all();
+  };
+
+  size_t num_helpers = std::min(count - 1, workers_.size());
+  for (size_t i = 0; i < num_helpers; i++)
+    PostTask(run);
+  run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cv.wait(lock, [&state, count] { return state->done == count; });
+}
+
+void ThreadPool::RunWorker() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return quit_ || !tasks_.empty(); });
+      if (tasks_.empty())
+        return;  // |quit_| is set and all the tasks have been run.
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace trace_processor
+}  // namespace perfetto
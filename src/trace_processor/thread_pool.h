@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACE_PROCESSOR_THREAD_POOL_H_
+#define SRC_TRACE_PROCESSOR_THREAD_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace perfetto {
+namespace trace_processor {
+
+// A fixed-size pool of worker threads used to offload the parts of trace
+// ingestion which don't touch TraceStorage (e.g. decoding packets and sorting
+// the TraceSorter queues).
+//
+// Tasks are run in FIFO order but, as there are several workers, there is no
+// guarantee about the order in which they complete. Tasks must not post
+// further tasks and wait for them as this can deadlock the pool.
+class ThreadPool {
+ public:
+  explicit ThreadPool(uint32_t num_threads);
+
+  // Runs all the tasks already posted and joins the workers.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Schedules |task| to run on one of the worker threads.
+  void PostTask(std::function<void()> task);
+
+  // Calls |fn(i)| for each i in [0, count), spreading the calls across the
+  // workers and the calling thread. Returns once all the calls have returned.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+  uint32_t num_threads() const {
+    return static_cast<uint32_t>(workers_.size());
+  }
+
+ private:
+  void RunWorker();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;  // Guarded by |mutex_|.
+  bool quit_ = false;                        // Guarded by |mutex_|.
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace trace_processor
+}  // namespace perfetto
+
+#endif  // SRC_TRACE_PROCESSOR_THREAD_POOL_H_
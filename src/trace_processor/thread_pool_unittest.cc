@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/thread_pool.h"
+
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace perfetto {
+namespace trace_processor {
+namespace {
+
+TEST(ThreadPoolTest, RunsAllTasksBeforeDestruction) {
+  std::atomic<int> count{0};
+  {
+    ThreadPool pool(3);
+    for (int i = 0; i < 100; i++)
+      pool.PostTask([&count] { count++; });
+  }
+  ASSERT_EQ(count.load(), 100);
+}
+
+TEST(ThreadPoolTest, ParallelFor) {
+  ThreadPool pool(4);
+  std::vector<int> values(1000, 0);
+  pool.ParallelFor(values.size(), [&values](size_t i) {
+    values[i] = static_cast<int>(i) * 2;
+  });
+  for (size_t i = 0; i < values.size(); i++)
+    ASSERT_EQ(values[i], static_cast<int>(i) * 2);
+}
+
+TEST(ThreadPoolTest, ParallelForMoreThreadsThanItems) {
+  ThreadPool pool(8);
+  std::atomic<int> count{0};
+  pool.ParallelFor(2, [&count](size_t) { count++; });
+  ASSERT_EQ(count.load(), 2);
+  pool.ParallelFor(0, [&count](size_t) { count++; });
+  ASSERT_EQ(count.load(), 2);
+}
+
+}  // namespace
+}  // namespace trace_processor
+}  // namespace perfetto
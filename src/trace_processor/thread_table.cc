@@ -117,7 +117,7 @@ int ThreadTable::Cursor::Column(sqlite3_context* context, int N) {
       break;
     }
     case Column::kName: {
-      const auto& name = storage_->GetString(thread.name_id);
+      NullTermStringView name = storage_->GetString(thread.name_id);
       sqlite3_result_text(context, name.c_str(), -1, kSqliteStatic);
       break;
     }
@@ -20,6 +20,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <functional>
 #include <limits>
 #include <memory>
 
@@ -43,6 +44,17 @@ class TraceBlobView {
     PERFETTO_DCHECK(length <= std::numeric_limits<uint32_t>::max());
   }
 
+  // Creates a view on memory which is not owned by the view, e.g. a region of
+  // a memory mapped trace file. |release| is invoked once the last
+  // TraceBlobView referring to the memory is destroyed, after which the memory
+  // can be unmapped or its pages reclaimed.
+  static TraceBlobView FromUnownedMemory(const uint8_t* data,
+                                         size_t length,
+                                         std::function<void()> release) {
+    PERFETTO_DCHECK(length <= std::numeric_limits<uint32_t>::max());
+    return TraceBlobView(SharedBuf(data, std::move(release)), 0, length);
+  }
+
   // Allow std::move().
   TraceBlobView(TraceBlobView&&) noexcept = default;
   TraceBlobView& operator=(TraceBlobView&&) = default;
@@ -77,12 +89,17 @@ class TraceBlobView {
   // An equivalent to std::shared_ptr<uint8_t>, with the differnce that:
   // - Supports array types, available for shared_ptr only in C++17.
   // - Is not thread safe, which is not needed for our purposes.
+  // - Can refer to memory it doesn't own, see FromUnownedMemory().
   class SharedBuf {
    public:
     explicit SharedBuf(std::unique_ptr<uint8_t[]> mem) {
       rcbuf_ = new RefCountedBuf(std::move(mem));
     }
 
+    SharedBuf(const uint8_t* data, std::function<void()> release) {
+      rcbuf_ = new RefCountedBuf(data, std::move(release));
+    }
+
     SharedBuf(const SharedBuf& copy) : rcbuf_(copy.rcbuf_) {
       PERFETTO_DCHECK(rcbuf_->refcount > 0);
       rcbuf_->refcount++;
@@ -117,14 +134,22 @@ class TraceBlobView {
 
     bool operator==(const SharedBuf& x) const { return x.rcbuf_ == rcbuf_; }
     bool operator!=(const SharedBuf& x) const { return !(x == *this); }
-    const uint8_t* data() const { return rcbuf_->mem.get(); }
+    const uint8_t* data() const { return rcbuf_->data; }
 
    private:
     struct RefCountedBuf {
       explicit RefCountedBuf(std::unique_ptr<uint8_t[]> buf)
-          : refcount(1), mem(std::move(buf)) {}
+          : refcount(1), data(buf.get()), mem(std::move(buf)) {}
+      RefCountedBuf(const uint8_t* d, std::function<void()> r)
+          : refcount(1), data(d), release(std::move(r)) {}
+      ~RefCountedBuf() {
+        if (release)
+          release();
+      }
       int refcount;
-      std::unique_ptr<uint8_t[]> mem;
+      const uint8_t* data;
+      std::unique_ptr<uint8_t[]> mem;  // Null for unowned memory.
+      std::function<void()> release;   // Only set for unowned memory.
     };
 
     RefCountedBuf* rcbuf_ = nullptr;
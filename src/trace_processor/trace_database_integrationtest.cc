@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
+
 #include <map>
 #include <random>
 #include <string>
@@ -52,6 +54,14 @@ class TraceProcessorIntegrationTest : public ::testing::Test {
     return true;
   }
 
+  bool LoadTraceMapped(const char* name) {
+    base::ScopedFile fd(base::OpenFile(base::GetTestDataPath(name), O_RDONLY));
+    if (!fd || !processor_->ParseMappedFile(*fd))
+      return false;
+    processor_->NotifyEndOfFile();
+    return true;
+  }
+
   void Query(const std::string& query, protos::RawQueryResult* result) {
     protos::RawQueryArgs args;
     args.set_sql_query(query);
@@ -77,6 +87,18 @@ TEST_F(TraceProcessorIntegrationTest, AndroidSchedAndPs) {
   ASSERT_EQ(res.columns(1).long_values(0), 19684308497);
 }
 
+TEST_F(TraceProcessorIntegrationTest, AndroidSchedAndPsMapped) {
+  ASSERT_TRUE(LoadTraceMapped("android_sched_and_ps.pb"));
+  protos::RawQueryResult res;
+  Query(
+      "select count(*), max(ts) - min(ts) from sched "
+      "where dur != 0 and utid != 0",
+      &res);
+  ASSERT_EQ(res.num_records(), 1);
+  ASSERT_EQ(res.columns(0).long_values(0), 139783);
+  ASSERT_EQ(res.columns(1).long_values(0), 19684308497);
+}
+
 TEST_F(TraceProcessorIntegrationTest, Sfgate) {
   ASSERT_TRUE(LoadTrace("sfgate.json", strlen("{\"traceEvents\":[")));
   protos::RawQueryResult res;
@@ -86,6 +108,15 @@ TEST_F(TraceProcessorIntegrationTest, Sfgate) {
   ASSERT_EQ(res.columns(1).long_values(0), 40532506000);
 }
 
+TEST_F(TraceProcessorIntegrationTest, SfgateMapped) {
+  ASSERT_TRUE(LoadTraceMapped("sfgate.json"));
+  protos::RawQueryResult res;
+  Query("select count(*), max(ts) - min(ts) from slices where utid != 0", &res);
+  ASSERT_EQ(res.num_records(), 1);
+  ASSERT_EQ(res.columns(0).long_values(0), 39828);
+  ASSERT_EQ(res.columns(1).long_values(0), 40532506000);
+}
+
 TEST_F(TraceProcessorIntegrationTest, UnsortedTrace) {
   ASSERT_TRUE(LoadTrace("unsorted_trace.json", strlen("{\"traceEvents\":[")));
   protos::RawQueryResult res;
@@ -25,6 +25,7 @@
 #include "src/trace_processor/proto_trace_parser.h"
 #include "src/trace_processor/slice_tracker.h"
 #include "src/trace_processor/syscall_tracker.h"
+#include "src/trace_processor/thread_pool.h"
 #include "src/trace_processor/trace_sorter.h"
 
 namespace perfetto {
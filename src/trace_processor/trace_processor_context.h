@@ -29,6 +29,7 @@ class EventTracker;
 class ProcessTracker;
 class SliceTracker;
 class SyscallTracker;
+class ThreadPool;
 class TraceParser;
 class TraceStorage;
 class TraceSorter;
@@ -38,6 +39,11 @@ class TraceProcessorContext {
   TraceProcessorContext();
   ~TraceProcessorContext();
 
+  // Only set in the multi-threaded ingestion mode (see
+  // Config::ingestion_threads). Declared first as the other members might
+  // have tasks in flight on it.
+  std::unique_ptr<ThreadPool> thread_pool;
+
   std::unique_ptr<ArgsTracker> args_tracker;
   std::unique_ptr<SliceTracker> slice_tracker;
   std::unique_ptr<ProcessTracker> process_tracker;
@@ -20,8 +20,10 @@
 #include <algorithm>
 #include <functional>
 
+#include "perfetto/base/build_config.h"
 #include "perfetto/base/logging.h"
 #include "perfetto/base/time.h"
+#include "perfetto/base/utils.h"
 #include "src/trace_processor/android_logs_table.h"
 #include "src/trace_processor/args_table.h"
 #include "src/trace_processor/args_tracker.h"
@@ -45,6 +47,7 @@
 #include "src/trace_processor/string_table.h"
 #include "src/trace_processor/syscall_tracker.h"
 #include "src/trace_processor/table.h"
+#include "src/trace_processor/thread_pool.h"
 #include "src/trace_processor/thread_table.h"
 #include "src/trace_processor/trace_blob_view.h"
 #include "src/trace_processor/trace_sorter.h"
@@ -58,6 +61,11 @@
 #include "src/trace_processor/json_trace_tokenizer.h"
 #endif
 
+#if !PERFETTO_BUILDFLAG(PERFETTO_OS_WIN)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 // In Android tree builds, we don't have the percentile module.
 // Just don't include it.
 #if !PERFETTO_BUILDFLAG(PERFETTO_ANDROID_BUILD)
@@ -141,6 +149,30 @@ std::string RemoveWhitespace(const std::string& input) {
   return str;
 }
 
+#if !PERFETTO_BUILDFLAG(PERFETTO_OS_WIN)
+// Chunk sizes used by ParseMappedFile(). Both are multiples of the page size,
+// so that each chunk starts on a page boundary.
+constexpr size_t kMappedProtoChunkSize = 32 * 1024 * 1024;
+constexpr size_t kMappedJsonChunkSize = 1024 * 1024 * 1024;
+static_assert(kMappedProtoChunkSize % base::kPageSize == 0, "Unaligned chunk");
+static_assert(kMappedJsonChunkSize % base::kPageSize == 0, "Unaligned chunk");
+
+// A read-only mapping of a trace file. Shared by the chunks of the file pushed
+// into the parsing pipeline and unmapped once the last of them is released.
+class ReadOnlyMapping {
+ public:
+  ReadOnlyMapping(void* start, size_t size) : start_(start), size_(size) {}
+  ~ReadOnlyMapping() { munmap(start_, size_); }
+
+ private:
+  ReadOnlyMapping(const ReadOnlyMapping&) = delete;
+  ReadOnlyMapping& operator=(const ReadOnlyMapping&) = delete;
+
+  void* const start_;
+  const size_t size_;
+};
+#endif
+
 }  // namespace
 
 TraceType GuessTraceType(const uint8_t* data, size_t size) {
@@ -164,6 +196,11 @@ TraceProcessorImpl::TraceProcessorImpl(const Config& cfg) : cfg_(cfg) {
   CreateBuiltinViews(db);
   db_.reset(std::move(db));
 
+#if !PERFETTO_BUILDFLAG(PERFETTO_OS_WASM)
+  if (cfg_.ingestion_threads > 0)
+    context_.thread_pool.reset(new ThreadPool(cfg_.ingestion_threads));
+#endif
+
   context_.storage.reset(new TraceStorage());
   context_.args_tracker.reset(new ArgsTracker(&context_));
   context_.slice_tracker.reset(new SliceTracker(&context_));
@@ -197,20 +234,88 @@ TraceProcessorImpl::~TraceProcessorImpl() {
 bool TraceProcessorImpl::Parse(std::unique_ptr<uint8_t[]> data, size_t size) {
   if (size == 0)
     return true;
+  return ParseBlob(TraceBlobView(std::move(data), 0, size));
+}
+
+bool TraceProcessorImpl::ParseMappedFile(int fd) {
+#if PERFETTO_BUILDFLAG(PERFETTO_OS_WIN)
+  base::ignore_result(fd);
+  PERFETTO_ELOG("Memory mapped traces are not supported on Windows");
+  return false;
+#else
+  struct stat stat_buf {};
+  if (fstat(fd, &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode)) {
+    PERFETTO_ELOG("Only regular files can be memory mapped");
+    return false;
+  }
+  const size_t size = static_cast<size_t>(stat_buf.st_size);
+  if (static_cast<off_t>(size) != stat_buf.st_size) {
+    PERFETTO_ELOG("Trace file too big to be memory mapped");
+    return false;
+  }
+  if (size == 0)
+    return true;
+
+  void* start = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (start == MAP_FAILED) {
+    PERFETTO_PLOG("mmap() of the trace file failed");
+    return false;
+  }
+  std::shared_ptr<ReadOnlyMapping> mapping(new ReadOnlyMapping(start, size));
+  auto* data = static_cast<uint8_t*>(start);
+  madvise(start, size, MADV_SEQUENTIAL);
+
+  // JSON events are only sorted at the end of the trace and the tokenizer
+  // copies the events that span across chunks, so push the whole file at once
+  // (as far as TraceBlobView allows). Proto traces are pushed in chunks, so
+  // that the pages of each chunk can be dropped as soon as the sorter window
+  // has moved past all the packets in it.
+  size_t chunk_size = kMappedProtoChunkSize;
+  if (GuessTraceType(data, size) == kJsonTraceType)
+    chunk_size = kMappedJsonChunkSize;
+
+  for (size_t off = 0; off < size; off += chunk_size) {
+    uint8_t* chunk = data + off;
+    size_t chunk_len = std::min(chunk_size, size - off);
+
+    // Start reading the next chunk from disk while this one is parsed.
+    size_t next_off = off + chunk_len;
+    if (next_off < size) {
+      madvise(data + next_off, std::min(chunk_size, size - next_off),
+              MADV_WILLNEED);
+    }
+
+    // Invoked once all the slices of the chunk held by the tokenizer, sorter
+    // and parser have been destroyed. The mapping is private and never
+    // written, so dropping the pages just discards them from the RSS.
+    auto release = [mapping, chunk, chunk_len] {
+      madvise(chunk, chunk_len, MADV_DONTNEED);
+    };
+    if (!ParseBlob(TraceBlobView::FromUnownedMemory(chunk, chunk_len,
+                                                    std::move(release)))) {
+      return false;
+    }
+  }
+  return true;
+#endif
+}
+
+bool TraceProcessorImpl::ParseBlob(TraceBlobView blob) {
   if (unrecoverable_parse_error_)
     return false;
 
   // If this is the first Parse() call, guess the trace type and create the
   // appropriate parser.
   if (!context_.chunk_reader) {
-    TraceType trace_type = GuessTraceType(data.get(), size);
+    TraceType trace_type = GuessTraceType(blob.data(), blob.length());
     switch (trace_type) {
       case kJsonTraceType:
         PERFETTO_DLOG("Legacy JSON trace detected");
 #if PERFETTO_BUILDFLAG(PERFETTO_STANDALONE_BUILD)
         context_.chunk_reader.reset(new JsonTraceTokenizer(&context_));
         context_.sorter.reset(
-            new TraceSorter(&context_, std::numeric_limits<int64_t>::max()));
+            new TraceSorter(&context_, std::numeric_limits<int64_t>::max(),
+                            cfg_.sorter_memory_budget_bytes));
         context_.parser.reset(new JsonTraceParser(&context_));
 #else
         PERFETTO_FATAL("JSON traces only supported in standalone mode.");
@@ -219,15 +324,17 @@ bool TraceProcessorImpl::Parse(std::unique_ptr<uint8_t[]> data, size_t size) {
       case kProtoTraceType:
         context_.chunk_reader.reset(new ProtoTraceTokenizer(&context_));
         context_.sorter.reset(new TraceSorter(
-            &context_, static_cast<int64_t>(cfg_.window_size_ns)));
-        context_.parser.reset(new ProtoTraceParser(&context_));
+            &context_, static_cast<int64_t>(cfg_.window_size_ns),
+            cfg_.sorter_memory_budget_bytes));
+        context_.parser.reset(
+            new ProtoTraceParser(&context_, cfg_.lazy_raw_args));
         break;
       case kUnknownTraceType:
         return false;
     }
   }
 
-  bool res = context_.chunk_reader->Parse(std::move(data), size);
+  bool res = context_.chunk_reader->Parse(std::move(blob));
   unrecoverable_parse_error_ |= !res;
   return res;
 }
@@ -236,6 +343,7 @@ void TraceProcessorImpl::NotifyEndOfFile() {
   if (unrecoverable_parse_error_ || !context_.chunk_reader)
     return;
 
+  context_.chunk_reader->NotifyEndOfFile();
   context_.sorter->ExtractEventsForced();
   BuildBoundsTable(*db_, context_.storage->GetTraceTimestampBoundsNs());
 }
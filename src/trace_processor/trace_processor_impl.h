@@ -27,6 +27,7 @@
 #include "perfetto/trace_processor/basic_types.h"
 #include "perfetto/trace_processor/trace_processor.h"
 #include "src/trace_processor/scoped_db.h"
+#include "src/trace_processor/trace_blob_view.h"
 #include "src/trace_processor/trace_processor_context.h"
 
 namespace perfetto {
@@ -56,6 +57,8 @@ class TraceProcessorImpl : public TraceProcessor {
 
   bool Parse(std::unique_ptr<uint8_t[]>, size_t) override;
 
+  bool ParseMappedFile(int fd) override;
+
   void NotifyEndOfFile() override;
 
   void ExecuteQuery(
@@ -70,6 +73,9 @@ class TraceProcessorImpl : public TraceProcessor {
   // Needed for iterators to be able to delete themselves from the vector.
   friend class IteratorImpl;
 
+  // Common implementation of Parse() and ParseMappedFile().
+  bool ParseBlob(TraceBlobView);
+
   ScopedDb db_;  // Keep first.
   TraceProcessorContext context_;
   bool unrecoverable_parse_error_ = false;
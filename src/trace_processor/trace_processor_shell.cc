@@ -17,6 +17,7 @@
 #include <aio.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -424,6 +425,59 @@ bool RunQueryAndPrintResult(const std::vector<std::string> queries,
   return !is_query_error;
 }
 
+// Loads the trace in chunks using async IO. Used when the trace can't be memory
+// mapped (e.g. it is read from a pipe). We create a simple pipeline where, at
+// each iteration, we parse the current chunk and asynchronously start reading
+// the next chunk. Returns the number of bytes read.
+uint64_t LoadTraceChunked(TraceProcessor* tp, int fd) {
+  // 1MB chunk size seems the best tradeoff on a MacBook Pro 2013 - i7 2.8 GHz.
+  constexpr size_t kChunkSize = 1024 * 1024;
+  struct aiocb cb {};
+  cb.aio_nbytes = kChunkSize;
+  cb.aio_fildes = fd;
+
+  std::unique_ptr<uint8_t[]> aio_buf(new uint8_t[kChunkSize]);
+#if defined(MEMORY_SANITIZER)
+  // Just initialize the memory to make the memory sanitizer happy as it
+  // cannot track aio calls below.
+  memset(aio_buf.get(), 0, kChunkSize);
+#endif
+  cb.aio_buf = aio_buf.get();
+
+  PERFETTO_CHECK(aio_read(&cb) == 0);
+  struct aiocb* aio_list[1] = {&cb};
+
+  uint64_t file_size = 0;
+  for (int i = 0;; i++) {
+    if (i % 128 == 0)
+      fprintf(stderr, "\rLoading trace: %.2f MB\r", file_size / 1E6);
+
+    // Block waiting for the pending read to complete.
+    PERFETTO_CHECK(aio_suspend(aio_list, 1, nullptr) == 0);
+    auto rsize = aio_return(&cb);
+    if (rsize <= 0)
+      break;
+    file_size += static_cast<uint64_t>(rsize);
+
+    // Take ownership of the completed buffer and enqueue a new async read
+    // with a fresh buffer.
+    std::unique_ptr<uint8_t[]> buf(std::move(aio_buf));
+    aio_buf.reset(new uint8_t[kChunkSize]);
+#if defined(MEMORY_SANITIZER)
+    // Just initialize the memory to make the memory sanitizer happy as it
+    // cannot track aio calls below.
+    memset(aio_buf.get(), 0, kChunkSize);
+#endif
+    cb.aio_buf = aio_buf.get();
+    cb.aio_offset += rsize;
+    PERFETTO_CHECK(aio_read(&cb) == 0);
+
+    // Parse the completed buffer while the async read is in-flight.
+    tp->Parse(std::move(buf), static_cast<size_t>(rsize));
+  }
+  return file_size;
+}
+
 void PrintUsage(char** argv) {
   PERFETTO_ELOG(
       "Interactive trace processor shell.\n"
@@ -434,6 +488,14 @@ void PrintUsage(char** argv) {
       "launching an interactive shell.\n"
       " -q FILE              Read and execute an SQL query from a file.\n"
       " -e FILE              Export the trace into a SQLite database.\n"
+      " -j N                 Use N extra threads to decode and sort the "
+      "trace while loading it.\n"
+      " --sort-memory-mb N   Spill the events waiting to be sorted to a "
+      "temporary file when they take more than N MB.\n"
+      " --lazy-raw-args      Only decode the args of the raw events when "
+      "they are queried.\n"
+      " --no-mmap            Read the trace file in chunks rather than "
+      "memory mapping it.\n"
       " --run-metrics x,y,z   Runs a comma separated list of metrics and "
       "prints the result as a TraceMetrics proto to stdout.\n",
       argv[0]);
@@ -448,6 +510,10 @@ int TraceProcessorMain(int argc, char** argv) {
   const char* query_file_path = nullptr;
   const char* sqlite_file_path = nullptr;
   const char* metric_names = nullptr;
+  uint32_t ingestion_threads = 0;
+  uint64_t sort_memory_mb = 0;
+  bool lazy_raw_args = false;
+  bool use_mmap = true;
   bool launch_shell = true;
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--version") == 0) {
@@ -473,6 +539,26 @@ int TraceProcessorMain(int argc, char** argv) {
       }
       sqlite_file_path = argv[i];
       continue;
+    } else if (strcmp(argv[i], "-j") == 0) {
+      if (++i == argc) {
+        PrintUsage(argv);
+        return 1;
+      }
+      ingestion_threads = static_cast<uint32_t>(atoi(argv[i]));
+      continue;
+    } else if (strcmp(argv[i], "--sort-memory-mb") == 0) {
+      if (++i == argc) {
+        PrintUsage(argv);
+        return 1;
+      }
+      sort_memory_mb = strtoull(argv[i], nullptr, 10);
+      continue;
+    } else if (strcmp(argv[i], "--lazy-raw-args") == 0) {
+      lazy_raw_args = true;
+      continue;
+    } else if (strcmp(argv[i], "--no-mmap") == 0) {
+      use_mmap = false;
+      continue;
     } else if (strcmp(argv[i], "--run-metrics") == 0) {
       if (++i == argc) {
         PrintUsage(argv);
@@ -497,6 +583,9 @@ int TraceProcessorMain(int argc, char** argv) {
 
   // Load the trace file into the trace processor.
   Config config;
+  config.ingestion_threads = ingestion_threads;
+  config.sorter_memory_budget_bytes = sort_memory_mb * 1024 * 1024;
+  config.lazy_raw_args = lazy_raw_args;
   std::unique_ptr<TraceProcessor> tp = TraceProcessor::CreateInstance(config);
   base::ScopedFile fd(base::OpenFile(trace_file_path, O_RDONLY));
   if (!fd) {
@@ -504,55 +593,16 @@ int TraceProcessorMain(int argc, char** argv) {
     return 1;
   }
 
-  // Load the trace in chunks using async IO. We create a simple pipeline where,
-  // at each iteration, we parse the current chunk and asynchronously start
-  // reading the next chunk.
-
-  // 1MB chunk size seems the best tradeoff on a MacBook Pro 2013 - i7 2.8 GHz.
-  constexpr size_t kChunkSize = 1024 * 1024;
-  struct aiocb cb {};
-  cb.aio_nbytes = kChunkSize;
-  cb.aio_fildes = *fd;
-
-  std::unique_ptr<uint8_t[]> aio_buf(new uint8_t[kChunkSize]);
-#if defined(MEMORY_SANITIZER)
-  // Just initialize the memory to make the memory sanitizer happy as it
-  // cannot track aio calls below.
-  memset(aio_buf.get(), 0, kChunkSize);
-#endif
-  cb.aio_buf = aio_buf.get();
-
-  PERFETTO_CHECK(aio_read(&cb) == 0);
-  struct aiocb* aio_list[1] = {&cb};
-
   uint64_t file_size = 0;
   auto t_load_start = base::GetWallTimeMs();
-  for (int i = 0;; i++) {
-    if (i % 128 == 0)
-      fprintf(stderr, "\rLoading trace: %.2f MB\r", file_size / 1E6);
-
-    // Block waiting for the pending read to complete.
-    PERFETTO_CHECK(aio_suspend(aio_list, 1, nullptr) == 0);
-    auto rsize = aio_return(&cb);
-    if (rsize <= 0)
-      break;
-    file_size += static_cast<uint64_t>(rsize);
-
-    // Take ownership of the completed buffer and enqueue a new async read
-    // with a fresh buffer.
-    std::unique_ptr<uint8_t[]> buf(std::move(aio_buf));
-    aio_buf.reset(new uint8_t[kChunkSize]);
-#if defined(MEMORY_SANITIZER)
-    // Just initialize the memory to make the memory sanitizer happy as it
-    // cannot track aio calls below.
-    memset(aio_buf.get(), 0, kChunkSize);
-#endif
-    cb.aio_buf = aio_buf.get();
-    cb.aio_offset += rsize;
-    PERFETTO_CHECK(aio_read(&cb) == 0);
-
-    // Parse the completed buffer while the async read is in-flight.
-    tp->Parse(std::move(buf), static_cast<size_t>(rsize));
+  struct stat stat_buf {};
+  if (use_mmap && fstat(*fd, &stat_buf) == 0 && S_ISREG(stat_buf.st_mode)) {
+    fprintf(stderr, "Loading trace (memory mapped)\n");
+    file_size = static_cast<uint64_t>(stat_buf.st_size);
+    if (!tp->ParseMappedFile(*fd))
+      PERFETTO_ELOG("Failed to load the memory mapped trace");
+  } else {
+    file_size = LoadTraceChunked(tp.get(), *fd);
   }
   tp->NotifyEndOfFile();
   double t_load = (base::GetWallTimeMs() - t_load_start).count() / 1E3;
@@ -18,19 +18,27 @@
 #include <utility>
 
 #include "src/trace_processor/proto_trace_parser.h"
+#include "src/trace_processor/spill_file.h"
+#include "src/trace_processor/thread_pool.h"
 #include "src/trace_processor/trace_sorter.h"
 
 namespace perfetto {
 namespace trace_processor {
 
-TraceSorter::TraceSorter(TraceProcessorContext* context, int64_t window_size_ns)
-    : context_(context), window_size_ns_(window_size_ns) {
+TraceSorter::TraceSorter(TraceProcessorContext* context,
+                         int64_t window_size_ns,
+                         uint64_t memory_budget_bytes)
+    : context_(context),
+      window_size_ns_(window_size_ns),
+      memory_budget_bytes_(memory_budget_bytes) {
   const char* env = getenv("TRACE_PROCESSOR_SORT_ONLY");
   bypass_next_stage_for_testing_ = env && !strcmp(env, "1");
   if (bypass_next_stage_for_testing_)
     PERFETTO_ELOG("TEST MODE: bypassing protobuf parsing stage");
 }
 
+TraceSorter::~TraceSorter() = default;
+
 void TraceSorter::Queue::Sort() {
   PERFETTO_DCHECK(needs_sorting());
   PERFETTO_DCHECK(sort_start_idx_ < events_.size());
@@ -54,123 +62,123 @@ void TraceSorter::Queue::Sort() {
   PERFETTO_DCHECK(std::is_sorted(events_.begin(), events_.end()));
 }
 
+void TraceSorter::SortQueuesInParallel() {
+  std::vector<Queue*> to_sort;
+  for (auto& queue : queues_) {
+    if (queue.needs_sorting())
+      to_sort.push_back(&queue);
+  }
+  // With a single queue there is nothing to gain, let the extraction loop
+  // sort it as usual.
+  if (to_sort.size() < 2)
+    return;
+  context_->thread_pool->ParallelFor(
+      to_sort.size(), [&to_sort](size_t i) { to_sort[i]->Sort(); });
+}
+
 // Removes all the events in |queues_| that are earlier than the given window
 // size and moves them to the next parser stages, respecting global timestamp
-// order. This function is a "extract min from N sorted queues", with some
-// little cleverness: we know that events tend to be bursty, so events are
-// not going to be randomly distributed on the N |queues_|.
-// Upon each iteration this function finds the first two queues (if any) that
-// have the oldest events, and extracts events from the 1st until hitting the
-// min_ts of the 2nd. Imagine the queues are as follows:
+// order. This function is a k-way merge of the (sorted) |queues_| driven by a
+// LoserTree keyed on the earliest timestamp of each queue, with some little
+// cleverness: we know that events tend to be bursty, so events are not going
+// to be randomly distributed on the N |queues_|.
+// Upon each iteration this function takes the queue with the oldest event
+// (the winner of the tree) and the earliest event of all the other queues (the
+// runner-up), and extracts events from the former until hitting the latter.
+// Imagine the queues are as follows:
 //
 //  q0           {min_ts: 10  max_ts: 30}
 //  q1    {min_ts:5              max_ts: 35}
 //  q2              {min_ts: 12    max_ts: 40}
 //
 // We know that we can extract all events from q1 until we hit ts=10 without
-// looking at any other queue. After hitting ts=10, we need to re-look to all of
-// them to figure out the next min-event.
-// There are more suitable data structures to do this (e.g. keeping a min-heap
-// to avoid re-scanning all the queues all the times) but doesn't seem worth it.
-// With Android traces (that have 8 CPUs) this function accounts for ~1-3% cpu
-// time in a profiler.
+// looking at any other queue. After hitting ts=10, only the matches of q1 in
+// the tree need to be replayed to find the next min-event, which costs
+// O(log N) rather than a scan of all the queues. This matters on machines
+// with hundreds of CPUs, where runs tend to be short.
 void TraceSorter::SortAndExtractEventsBeyondWindow(int64_t window_size_ns) {
   DCHECK_ftrace_batch_cpu(kNoBatch);
   constexpr int64_t kTsMax = std::numeric_limits<int64_t>::max();
   const bool was_empty = global_min_ts_ == kTsMax && global_max_ts_ == 0;
   int64_t extract_end_ts = global_max_ts_ - window_size_ns;
-  auto* next_stage = context_->parser.get();
+  if (context_->thread_pool)
+    SortQueuesInParallel();
+
+  // Queues can be pushed to in any order between two extractions, so the tree
+  // is rebuilt every time. Empty queues have min_ts_ == kTsMax. Runs are
+  // never empty here, they are dropped as soon as they have been consumed.
+  const uint32_t num_runs = static_cast<uint32_t>(runs_.size());
+  queue_tree_.Reset(num_runs + static_cast<uint32_t>(queues_.size()));
+  for (uint32_t i = 0; i < num_runs; i++)
+    queue_tree_.SetKey(i, runs_[i]->timestamp());
+  for (uint32_t i = 0; i < queues_.size(); i++)
+    queue_tree_.SetKey(num_runs + i, queues_[i].min_ts_);
+  queue_tree_.Rebuild();
+
+  bool has_emptied_queues = false;
   size_t iterations = 0;
   for (;; iterations++) {
-    size_t min_queue_idx = 0;  // The index of the queue with the min(ts).
-
-    // The top-2 min(ts) among all queues.
-    // queues_[min_queue_idx].events.timestamp == min_queue_ts[0].
-    int64_t min_queue_ts[2]{kTsMax, kTsMax};
-
-    // This loop identifies the queue which starts with the earliest event and
-    // also remembers the earliest event of the 2nd queue (in min_queue_ts[1]).
-    bool has_queues_with_expired_events = false;
-    for (size_t i = 0; i < queues_.size(); i++) {
-      auto& queue = queues_[i];
-      if (queue.events_.empty())
-        continue;
-      PERFETTO_DCHECK(queue.min_ts_ >= global_min_ts_);
-      PERFETTO_DCHECK(queue.max_ts_ <= global_max_ts_);
-      if (queue.min_ts_ < min_queue_ts[0]) {
-        min_queue_ts[1] = min_queue_ts[0];
-        min_queue_ts[0] = queue.min_ts_;
-        min_queue_idx = i;
-        has_queues_with_expired_events = true;
-      } else if (queue.min_ts_ < min_queue_ts[1]) {
-        min_queue_ts[1] = queue.min_ts_;
-      }
-    }
-    if (!has_queues_with_expired_events) {
-      // All the queues have events that start after the window (i.e. they are
-      // too recent and not eligible to be extracted given the current window).
+    if (queue_tree_.winner_key() == kTsMax) {
+      // All the queues are empty.
       break;
     }
 
-    Queue& queue = queues_[min_queue_idx];
-    auto& events = queue.events_;
-    if (queue.needs_sorting())
-      queue.Sort();
-    PERFETTO_DCHECK(queue.min_ts_ == events.front().timestamp);
-    PERFETTO_DCHECK(queue.min_ts_ == global_min_ts_);
-
-    // Now that we identified the min-queue, extract all events from it until
-    // we hit either: (1) the min-ts of the 2nd queue or (2) the window limit,
+    // Extract all events from the queue (or run) with the min(ts) until we
+    // hit either: (1) the min-ts of the 2nd queue or (2) the window limit,
     // whichever comes first.
-    int64_t extract_until_ts = std::min(extract_end_ts, min_queue_ts[1]);
+    const uint32_t leaf = queue_tree_.winner();
+    int64_t extract_until_ts =
+        std::min(extract_end_ts, queue_tree_.RunnerUpKey());
     size_t num_extracted = 0;
-    for (auto& event : events) {
-      int64_t timestamp = event.timestamp;
-      if (timestamp > extract_until_ts)
-        break;
-
-      ++num_extracted;
-      if (bypass_next_stage_for_testing_)
-        continue;
-
-      if (min_queue_idx == 0) {
-        // queues_[0] is for non-ftrace packets.
-        next_stage->ParseTracePacket(timestamp, std::move(event));
-      } else {
-        // Ftrace queues start at offset 1. So queues_[1] = cpu[0] and so on.
-        uint32_t cpu = static_cast<uint32_t>(min_queue_idx - 1);
-        next_stage->ParseFtracePacket(cpu, timestamp, std::move(event));
+    int64_t next_ts;
+    if (leaf < num_runs) {
+      SpilledRun* run = runs_[leaf].get();
+      PERFETTO_DCHECK(run->timestamp() == global_min_ts_);
+      while (!run->empty() && run->timestamp() <= extract_until_ts) {
+        uint32_t queue_idx = run->queue_idx();
+        ParseEvent(queue_idx, run->Pop());
+        ++num_extracted;
       }
-    }  // for (event: events)
+      next_ts = run->empty() ? kTsMax : run->timestamp();
+    } else {
+      Queue& queue = queues_[leaf - num_runs];
+      num_extracted = ExtractFromQueue(leaf - num_runs, extract_until_ts);
+      next_ts = queue.min_ts_;
+    }
 
     if (!num_extracted) {
       // No events can be extracted from any of the queues. This means that
-      // either we hit the window or all queues are empty.
+      // we hit the window.
       break;
     }
 
-    // Now remove the entries from the event buffer and update the queue-local
-    // and global time bounds.
-    events.erase_front(num_extracted);
-
-    // Update the global_{min,max}_ts to reflect the bounds after extraction.
-    if (events.empty()) {
-      queue.min_ts_ = kTsMax;
-      queue.max_ts_ = 0;
-      global_min_ts_ = min_queue_ts[1];
-
-      // If we extraced the max entry from a queue (i.e. we emptied the queue)
-      // we need to recompute the global max, because it might have been the one
-      // just extracted.
-      global_max_ts_ = 0;
-      for (auto& q : queues_)
-        global_max_ts_ = std::max(global_max_ts_, q.max_ts_);
-    } else {
-      queue.min_ts_ = queue.events_.front().timestamp;
-      global_min_ts_ = std::min(queue.min_ts_, min_queue_ts[1]);
-    }
+    has_emptied_queues |= next_ts == kTsMax;
+    queue_tree_.UpdateWinner(next_ts);
+    global_min_ts_ = queue_tree_.winner_key();
   }  // for(;;)
 
+  if (num_runs > 0) {
+    runs_.erase(std::remove_if(runs_.begin(), runs_.end(),
+                               [](const std::unique_ptr<SpilledRun>& run) {
+                                 return run->empty();
+                               }),
+                runs_.end());
+    // Once all the spilled events have been extracted the disk space can be
+    // reclaimed.
+    if (runs_.empty())
+      spill_file_->Truncate();
+  }
+
+  // If we emptied a queue we need to recompute the global max, because it
+  // might have been the one just extracted.
+  if (has_emptied_queues) {
+    global_max_ts_ = 0;
+    for (auto& q : queues_)
+      global_max_ts_ = std::max(global_max_ts_, q.max_ts_);
+    for (const auto& run : runs_)
+      global_max_ts_ = std::max(global_max_ts_, run->last_ts());
+  }
+
   // We decide to extract events only when we know (using the global_{min,max}
   // bounds) that there are eligible events. We should never end up in a
   // situation where we call this function but then realize that there was
@@ -185,10 +193,112 @@ void TraceSorter::SortAndExtractEventsBeyondWindow(int64_t window_size_ns) {
     dbg_min_ts = std::min(dbg_min_ts, q.min_ts_);
     dbg_max_ts = std::max(dbg_max_ts, q.max_ts_);
   }
+  for (const auto& run : runs_) {
+    dbg_min_ts = std::min(dbg_min_ts, run->timestamp());
+    dbg_max_ts = std::max(dbg_max_ts, run->last_ts());
+  }
   PERFETTO_DCHECK(global_min_ts_ == dbg_min_ts);
   PERFETTO_DCHECK(global_max_ts_ == dbg_max_ts);
 #endif
 }
 
+size_t TraceSorter::ExtractFromQueue(size_t queue_idx,
+                                     int64_t extract_until_ts) {
+  Queue& queue = queues_[queue_idx];
+  auto& events = queue.events_;
+  if (queue.needs_sorting())
+    queue.Sort();
+  PERFETTO_DCHECK(queue.min_ts_ == events.front().timestamp);
+  PERFETTO_DCHECK(queue.min_ts_ == global_min_ts_);
+  PERFETTO_DCHECK(queue.max_ts_ <= global_max_ts_);
+
+  size_t num_extracted = 0;
+  for (auto& event : events) {
+    if (event.timestamp > extract_until_ts)
+      break;
+    ++num_extracted;
+    if (memory_budget_bytes_)
+      queued_bytes_ -= EventSize(event);
+    ParseEvent(queue_idx, std::move(event));
+  }
+
+  // Now remove the entries from the event buffer and update the queue-local
+  // time bounds.
+  events.erase_front(num_extracted);
+  if (events.empty()) {
+    queue.min_ts_ = std::numeric_limits<int64_t>::max();
+    queue.max_ts_ = 0;
+  } else {
+    queue.min_ts_ = events.front().timestamp;
+  }
+  return num_extracted;
+}
+
+void TraceSorter::ParseEvent(size_t queue_idx, TimestampedTracePiece ttp) {
+  if (bypass_next_stage_for_testing_)
+    return;
+
+  int64_t timestamp = ttp.timestamp;
+  if (queue_idx == 0) {
+    // queues_[0] is for non-ftrace packets.
+    context_->parser->ParseTracePacket(timestamp, std::move(ttp));
+  } else {
+    // Ftrace queues start at offset 1. So queues_[1] = cpu[0] and so on.
+    uint32_t cpu = static_cast<uint32_t>(queue_idx - 1);
+    context_->parser->ParseFtracePacket(cpu, timestamp, std::move(ttp));
+  }
+}
+
+// Merges all the queues into a single sorted run, in the same way as
+// SortAndExtractEventsBeyondWindow() does but ignoring the window, and writes
+// it to |spill_file_|. The global time bounds don't change as the events are
+// still held by the sorter.
+void TraceSorter::SpillQueues() {
+  DCHECK_ftrace_batch_cpu(kNoBatch);
+  constexpr int64_t kTsMax = std::numeric_limits<int64_t>::max();
+  if (!spill_file_)
+    spill_file_.reset(new SpillFile());
+  if (context_->thread_pool)
+    SortQueuesInParallel();
+
+  queue_tree_.Reset(static_cast<uint32_t>(queues_.size()));
+  for (uint32_t i = 0; i < queues_.size(); i++)
+    queue_tree_.SetKey(i, queues_[i].min_ts_);
+  queue_tree_.Rebuild();
+  if (queue_tree_.winner_key() == kTsMax)
+    return;
+
+  spill_file_->BeginRun(queue_tree_.winner_key());
+  while (queue_tree_.winner_key() != kTsMax) {
+    const uint32_t queue_idx = queue_tree_.winner();
+    Queue& queue = queues_[queue_idx];
+    auto& events = queue.events_;
+    if (queue.needs_sorting())
+      queue.Sort();
+
+    int64_t spill_until_ts = queue_tree_.RunnerUpKey();
+    size_t num_spilled = 0;
+    for (const auto& event : events) {
+      if (event.timestamp > spill_until_ts)
+        break;
+      spill_file_->Append(queue_idx, event);
+      ++num_spilled;
+    }
+    PERFETTO_DCHECK(num_spilled > 0);
+
+    events.erase_front(num_spilled);
+    if (events.empty()) {
+      queue.min_ts_ = kTsMax;
+      queue.max_ts_ = 0;
+    } else {
+      queue.min_ts_ = events.front().timestamp;
+    }
+    queue_tree_.UpdateWinner(queue.min_ts_);
+  }
+  runs_.emplace_back(spill_file_->EndRun());
+  queued_bytes_ = 0;
+  num_spills_++;
+}
+
 }  // namespace trace_processor
 }  // namespace perfetto
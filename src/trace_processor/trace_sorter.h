@@ -17,26 +17,22 @@
 #ifndef SRC_TRACE_PROCESSOR_TRACE_SORTER_H_
 #define SRC_TRACE_PROCESSOR_TRACE_SORTER_H_
 
+#include <memory>
 #include <vector>
 
 #include "perfetto/base/circular_queue.h"
 #include "perfetto/trace_processor/basic_types.h"
+#include "src/trace_processor/loser_tree.h"
 #include "src/trace_processor/trace_blob_view.h"
 #include "src/trace_processor/trace_processor_context.h"
 #include "src/trace_processor/trace_storage.h"
 
-#if PERFETTO_BUILDFLAG(PERFETTO_STANDALONE_BUILD)
-#include <json/value.h>
-#else
-// Json traces are only supported in standalone build.
-namespace Json {
-class Value {};
-}  // namespace Json
-#endif
-
 namespace perfetto {
 namespace trace_processor {
 
+class SpillFile;
+class SpilledRun;
+
 // This class takes care of sorting events parsed from the trace stream in
 // arbitrary order and pushing them to the next pipeline stages (parsing) in
 // order. In order to support streaming use-cases, sorting happens within a
@@ -64,6 +60,11 @@ namespace trace_processor {
 // We use a logarithmic bound search operation to figure out what is the index
 // within the first partition where sorting should start, and sort all events
 // from there to the end.
+//
+// Optionally, the memory used by the events held in the queues can be bounded.
+// When the budget is exceeded, all the queues are merged into a single sorted
+// run which is written to a temporary file (see SpillFile) and the queues are
+// emptied. Extraction then merges the spilled runs together with the queues.
 class TraceSorter {
  public:
   struct TimestampedTracePiece {
@@ -84,37 +85,31 @@ class TraceSorter {
              (timestamp == o.timestamp && packet_idx_ < o.packet_idx_);
     }
 
-    TimestampedTracePiece(int64_t ts,
-                          uint64_t idx,
-                          std::unique_ptr<Json::Value> value)
-        : json_value(std::move(value)),
-          timestamp(ts),
-          packet_idx_(idx),
-          // TODO(dproy): Stop requiring TraceBlobView in TimestampedTracePiece.
-          blob_view(TraceBlobView(nullptr, 0, 0)) {}
-
-    std::unique_ptr<Json::Value> json_value;
-
     int64_t timestamp;
     uint64_t packet_idx_;
     TraceBlobView blob_view;
   };
 
-  TraceSorter(TraceProcessorContext*, int64_t window_size_ns);
+  // If |memory_budget_bytes| is not 0, events are spilled to a temporary file
+  // when the ones held in memory take more than that.
+  TraceSorter(TraceProcessorContext*,
+              int64_t window_size_ns,
+              uint64_t memory_budget_bytes = 0);
+  ~TraceSorter();
 
   inline void PushTracePacket(int64_t timestamp, TraceBlobView packet) {
     DCHECK_ftrace_batch_cpu(kNoBatch);
     auto* queue = GetQueue(0);
-    queue->Append(
-        TimestampedTracePiece(timestamp, packet_idx_++, std::move(packet)));
+    AppendToQueue(queue, TimestampedTracePiece(timestamp, packet_idx_++,
+                                               std::move(packet)));
     MaybeExtractEvents(queue);
   }
 
-  inline void PushJsonValue(int64_t timestamp,
-                            std::unique_ptr<Json::Value> json_value) {
+  // |event| is the text of a single JSON trace event dictionary.
+  inline void PushJsonEvent(int64_t timestamp, TraceBlobView event) {
     auto* queue = GetQueue(0);
-    queue->Append(
-        TimestampedTracePiece(timestamp, packet_idx_++, std::move(json_value)));
+    AppendToQueue(queue, TimestampedTracePiece(timestamp, packet_idx_++,
+                                               std::move(event)));
     MaybeExtractEvents(queue);
   }
 
@@ -122,8 +117,9 @@ class TraceSorter {
                               int64_t timestamp,
                               TraceBlobView event) {
     set_ftrace_batch_cpu_for_DCHECK(cpu);
-    GetQueue(cpu + 1)->Append(
-        TimestampedTracePiece(timestamp, packet_idx_++, std::move(event)));
+    AppendToQueue(GetQueue(cpu + 1),
+                  TimestampedTracePiece(timestamp, packet_idx_++,
+                                        std::move(event)));
 
     // The caller must call FinalizeFtraceEventBatch() after having pushed a
     // batch of ftrace events. This is to amortize the overhead of handling
@@ -146,6 +142,9 @@ class TraceSorter {
     window_size_ns_ = window_size_ns;
   }
 
+  // The number of times the queues have been spilled to disk.
+  uint32_t num_spills() const { return num_spills_; }
+
  private:
   static constexpr uint32_t kNoBatch = std::numeric_limits<uint32_t>::max();
 
@@ -190,6 +189,31 @@ class TraceSorter {
   // parser to be parsed and then stored.
   void SortAndExtractEventsBeyondWindow(int64_t windows_size_ns);
 
+  // Sorts all the queues which need sorting using the context's ThreadPool.
+  // Queues are independent so each one can be sorted on a different thread.
+  void SortQueuesInParallel();
+
+  // Parses the events of queues_[queue_idx] up to |extract_until_ts| and
+  // returns how many events were extracted.
+  size_t ExtractFromQueue(size_t queue_idx, int64_t extract_until_ts);
+
+  // Merges all the queues into a new run in |spill_file_| and empties them.
+  void SpillQueues();
+
+  // Passes the event to the parser for the queue |queue_idx|.
+  void ParseEvent(size_t queue_idx, TimestampedTracePiece ttp);
+
+  // The approximate memory used by |ttp| while in the queues.
+  static inline size_t EventSize(const TimestampedTracePiece& ttp) {
+    return sizeof(TimestampedTracePiece) + ttp.blob_view.length();
+  }
+
+  inline void AppendToQueue(Queue* queue, TimestampedTracePiece ttp) {
+    if (memory_budget_bytes_)
+      queued_bytes_ += EventSize(ttp);
+    queue->Append(std::move(ttp));
+  }
+
   inline Queue* GetQueue(size_t index) {
     if (PERFETTO_UNLIKELY(index >= queues_.size()))
       queues_.resize(index + 1);
@@ -201,10 +225,13 @@ class TraceSorter {
     global_max_ts_ = std::max(global_max_ts_, queue->max_ts_);
     global_min_ts_ = std::min(global_min_ts_, queue->min_ts_);
 
-    if (global_max_ts_ - global_min_ts_ < window_size_ns_)
-      return;
+    if (global_max_ts_ - global_min_ts_ >= window_size_ns_)
+      SortAndExtractEventsBeyondWindow(window_size_ns_);
 
-    SortAndExtractEventsBeyondWindow(window_size_ns_);
+    if (PERFETTO_UNLIKELY(memory_budget_bytes_ &&
+                          queued_bytes_ > memory_budget_bytes_)) {
+      SpillQueues();
+    }
   }
 
   TraceProcessorContext* const context_;
@@ -214,14 +241,36 @@ class TraceSorter {
   // queues_[x] is the ftrace queue for CPU(x - 1).
   std::vector<Queue> queues_;
 
+  // Runs spilled to |spill_file_|, in the order they have been written. Runs
+  // are removed once all their events have been extracted.
+  std::vector<std::unique_ptr<SpilledRun>> runs_;
+
+  // Used to merge |runs_| and |queues_| in SortAndExtractEventsBeyondWindow().
+  // Leaf i is runs_[i] for i < runs_.size() and queues_[i - runs_.size()]
+  // after that, each keyed on the timestamp of its earliest event.
+  LoserTree queue_tree_;
+
+  // Created on the first spill.
+  std::unique_ptr<SpillFile> spill_file_;
+
+  // Sum of EventSize() of all the events in |queues_|. Only kept up to date
+  // if |memory_budget_bytes_| is set.
+  uint64_t queued_bytes_ = 0;
+
+  uint32_t num_spills_ = 0;
+
   // Events are propagated to the next stage only after (max - min) timestamp
   // is larger than this value.
   int64_t window_size_ns_;
 
-  // max(e.timestamp for e in queues_).
+  // Events are spilled to disk when the ones in |queues_| take more than this
+  // amount of memory. 0 if spilling is disabled.
+  const uint64_t memory_budget_bytes_;
+
+  // max(e.timestamp for e in queues_ and runs_).
   int64_t global_max_ts_ = 0;
 
-  // min(e.timestamp for e in queues_).
+  // min(e.timestamp for e in queues_ and runs_).
   int64_t global_min_ts_ = std::numeric_limits<int64_t>::max();
 
   // Monotonic increasing value used to index timestamped trace pieces.
@@ -0,0 +1,100 @@
+// Copyright (C) 2019 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "src/trace_processor/trace_parser.h"
+#include "src/trace_processor/trace_processor_context.h"
+#include "src/trace_processor/trace_sorter.h"
+
+namespace {
+
+using perfetto::trace_processor::TraceBlobView;
+using perfetto::trace_processor::TraceParser;
+using perfetto::trace_processor::TraceProcessorContext;
+using perfetto::trace_processor::TraceSorter;
+
+constexpr uint32_t kEventsPerBatch = 64;
+constexpr uint32_t kTotalEvents = 1024 * 1024;
+constexpr int64_t kWindowNs = 10 * 1000 * 1000;
+
+class NullParser : public TraceParser {
+ public:
+  void ParseTracePacket(int64_t ts,
+                        TraceSorter::TimestampedTracePiece ttp) override {
+    benchmark::DoNotOptimize(ts);
+    benchmark::DoNotOptimize(ttp);
+  }
+  void ParseFtracePacket(uint32_t,
+                         int64_t ts,
+                         TraceSorter::TimestampedTracePiece ttp) override {
+    benchmark::DoNotOptimize(ts);
+    benchmark::DoNotOptimize(ttp);
+  }
+};
+
+// A batch of ftrace events as read from a single per-cpu ftrace buffer.
+struct Batch {
+  uint32_t cpu;
+  std::vector<int64_t> timestamps;
+};
+
+// Emulates the stream of FtraceEventBundles of a trace on a |num_cpus|
+// machine: every round each CPU emits a batch of sorted events, and the
+// batches of the different CPUs interleave in time.
+std::vector<Batch> CreateBatches(uint32_t num_cpus) {
+  std::minstd_rand0 rnd(0);
+  std::vector<Batch> batches;
+  uint32_t num_rounds = kTotalEvents / (num_cpus * kEventsPerBatch);
+  for (uint32_t round = 0; round < num_rounds; round++) {
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+      Batch batch;
+      batch.cpu = cpu;
+      int64_t ts = round * kEventsPerBatch * 1000;
+      for (uint32_t i = 0; i < kEventsPerBatch; i++) {
+        ts += rnd() % 2000;
+        batch.timestamps.push_back(ts);
+      }
+      batches.emplace_back(std::move(batch));
+    }
+  }
+  return batches;
+}
+
+void BM_TraceSorterFtraceBatches(benchmark::State& state) {
+  std::vector<Batch> batches =
+      CreateBatches(static_cast<uint32_t>(state.range(0)));
+
+  for (auto _ : state) {
+    TraceProcessorContext context;
+    context.parser.reset(new NullParser());
+    context.sorter.reset(new TraceSorter(&context, kWindowNs));
+    for (const Batch& batch : batches) {
+      for (int64_t ts : batch.timestamps)
+        context.sorter->PushFtraceEvent(batch.cpu, ts,
+                                        TraceBlobView(nullptr, 0, 0));
+      context.sorter->FinalizeFtraceEventBatch(batch.cpu);
+    }
+    context.sorter->ExtractEventsForced();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kTotalEvents);
+}
+
+}  // namespace
+
+BENCHMARK(BM_TraceSorterFtraceBatches)->Arg(8)->Arg(64)->Arg(256);
@@ -15,6 +15,9 @@
  */
 #include "src/trace_processor/proto_trace_parser.h"
 
+#include <string.h>
+
+#include <algorithm>
 #include <map>
 #include <random>
 #include <vector>
@@ -170,6 +173,88 @@ TEST_F(TraceSorterTest, MultiQueueSorting) {
   EXPECT_TRUE(expectations.empty());
 }
 
+// Pushes batches of slightly out-of-order events for 256 CPUs with a window
+// larger than the jitter and checks that they come out in order, both while
+// pushing and when flushing at the end.
+TEST_F(TraceSorterTest, ManyQueuesWithWindow) {
+  constexpr uint32_t kNumCpus = 256;
+  constexpr int kNumBatches = 2000;
+  std::minstd_rand0 rnd_engine(0);
+  std::vector<int64_t> extracted;
+
+  EXPECT_CALL(*parser_, MOCK_ParseFtracePacket(_, _, _, _))
+      .WillRepeatedly(Invoke(
+          [&extracted](uint32_t, int64_t timestamp, const uint8_t*, size_t) {
+            extracted.push_back(timestamp);
+          }));
+
+  context_.sorter->set_window_ns_for_testing(1000);
+  for (int i = 0; i < kNumBatches; i++) {
+    uint32_t cpu = static_cast<uint32_t>(rnd_engine() % kNumCpus);
+    for (int j = 0; j < 4; j++) {
+      int64_t ts = (i * 4 + j) * 10 + static_cast<int64_t>(rnd_engine() % 50);
+      context_.sorter->PushFtraceEvent(cpu, ts, TraceBlobView(nullptr, 0, 0));
+    }
+    context_.sorter->FinalizeFtraceEventBatch(cpu);
+  }
+  EXPECT_GT(extracted.size(), 0u);
+
+  context_.sorter->ExtractEventsForced();
+  EXPECT_EQ(extracted.size(), static_cast<size_t>(kNumBatches * 4));
+  EXPECT_TRUE(std::is_sorted(extracted.begin(), extracted.end()));
+}
+
+// Pushes random events with a memory budget much smaller than the events and
+// checks that the sorter spills them and still outputs all of them in order,
+// with their payload.
+TEST_F(TraceSorterTest, SpillToDisk) {
+  std::minstd_rand0 rnd_engine(0);
+  context_.sorter.reset(new TraceSorter(&context_, 1000000 /*window_size*/,
+                                        16 * 1024 /*memory_budget_bytes*/));
+
+  std::vector<std::pair<int64_t, uint8_t>> extracted;
+  auto record = [&extracted](int64_t timestamp, const uint8_t* data,
+                             size_t length) {
+    ASSERT_EQ(length, 64u);
+    extracted.emplace_back(timestamp, data[0]);
+  };
+  EXPECT_CALL(*parser_, MOCK_ParseFtracePacket(_, _, _, _))
+      .WillRepeatedly(Invoke([&record](uint32_t, int64_t timestamp,
+                                       const uint8_t* data, size_t length) {
+        record(timestamp, data, length);
+      }));
+  EXPECT_CALL(*parser_, MOCK_ParseTracePacket(_, _, _))
+      .WillRepeatedly(Invoke(record));
+
+  std::vector<std::pair<int64_t, uint8_t>> expected;
+  for (int i = 0; i < 5000; i++) {
+    // Timestamps go backwards within the window so that the events of each
+    // run are interleaved with the ones of the other runs and of the queues.
+    int64_t ts = i * 100 + static_cast<int64_t>(rnd_engine() % 500000);
+    uint8_t value = static_cast<uint8_t>(ts % 251);
+    std::unique_ptr<uint8_t[]> buf(new uint8_t[64]);
+    memset(buf.get(), value, 64);
+    TraceBlobView tbv(std::move(buf), 0, 64);
+    expected.emplace_back(ts, value);
+
+    uint32_t cpu = static_cast<uint32_t>(rnd_engine() % 9);
+    if (cpu == 8) {
+      context_.sorter->PushTracePacket(ts, std::move(tbv));
+    } else {
+      context_.sorter->PushFtraceEvent(cpu, ts, std::move(tbv));
+      context_.sorter->FinalizeFtraceEventBatch(cpu);
+    }
+  }
+  context_.sorter->ExtractEventsForced();
+
+  EXPECT_GT(context_.sorter->num_spills(), 10u);
+  std::stable_sort(
+      expected.begin(), expected.end(),
+      [](const std::pair<int64_t, uint8_t>& a,
+         const std::pair<int64_t, uint8_t>& b) { return a.first < b.first; });
+  ASSERT_EQ(extracted, expected);
+}
+
 }  // namespace
 }  // namespace trace_processor
 }  // namespace perfetto
@@ -20,6 +20,8 @@
 #include <algorithm>
 #include <limits>
 
+#include "perfetto/protozero/proto_utils.h"
+
 namespace {
 template <typename T>
 void MaybeUpdateMinMax(T begin_it,
@@ -42,29 +44,15 @@ TraceStorage::TraceStorage() {
   // Upid/utid 0 is reserved for idle processes/threads.
   unique_processes_.emplace_back(0);
   unique_threads_.emplace_back(0);
-
-  // Reserve string ID 0 for the empty string.
-  InternString("");
 }
 
 TraceStorage::~TraceStorage() {}
 
 StringId TraceStorage::InternString(base::StringView str) {
-  // Temporarily return the empty string's id as the null string.
-  // TODO(lalitm): remove this as part of the usage of StringPool.
-  if (str.data() == nullptr)
+  // Both the null and the empty string map to id 0.
+  if (str.empty())
     return 0;
-
-  auto hash = str.Hash();
-  auto id_it = string_index_.find(hash);
-  if (id_it != string_index_.end()) {
-    PERFETTO_DCHECK(base::StringView(string_pool_[id_it->second]) == str);
-    return id_it->second;
-  }
-  string_pool_.emplace_back(str.ToStdString());
-  StringId string_id = static_cast<uint32_t>(string_pool_.size() - 1);
-  string_index_.emplace(hash, string_id);
-  return string_id;
+  return string_pool_.InternString(str);
 }
 
 void TraceStorage::ResetStorage() {
@@ -92,6 +80,151 @@ void TraceStorage::SqlStats::RecordQueryEnd(int64_t time_ended) {
   times_ended_.back() = time_ended;
 }
 
+std::pair<uint32_t, uint32_t> TraceStorage::Args::FindArgSetRows(
+    ArgSetId id) const {
+  // Both the materialized and the lazy sets are sorted by id, as ids are
+  // handed out in increasing order.
+  auto lb = std::lower_bound(set_ids_.begin(), set_ids_.end(), id);
+  auto ub = std::upper_bound(lb, set_ids_.end(), id);
+  if (lb != ub) {
+    return std::make_pair(
+        static_cast<uint32_t>(std::distance(set_ids_.begin(), lb)),
+        static_cast<uint32_t>(std::distance(set_ids_.begin(), ub)));
+  }
+
+  auto lazy_it =
+      std::lower_bound(lazy_set_ids_.begin(), lazy_set_ids_.end(), id);
+  if (lazy_it == lazy_set_ids_.end() || *lazy_it != id)
+    return std::make_pair(0u, 0u);
+  auto idx =
+      static_cast<uint32_t>(std::distance(lazy_set_ids_.begin(), lazy_it));
+  auto base = static_cast<uint32_t>(set_ids_.size());
+  uint32_t first = lazy_first_rows_[idx];
+  uint32_t last = idx + 1 < lazy_first_rows_.size() ? lazy_first_rows_[idx + 1]
+                                                     : lazy_args_count_;
+  return std::make_pair(base + first, base + last);
+}
+
+// static
+void TraceStorage::Args::AppendLazyArg(StringId key,
+                                       const Variadic& value,
+                                       std::vector<uint8_t>* blob) {
+  using protozero::proto_utils::WriteVarInt;
+  using protozero::proto_utils::ZigZagEncode;
+
+  // Each arg is the varint (key << 2 | type) followed by the value: a zigzag
+  // varint for ints, a varint StringId for strings and 8 raw bytes for reals.
+  uint8_t buf[2 * 10];
+  uint64_t tag =
+      (static_cast<uint64_t>(key) << 2) | static_cast<uint64_t>(value.type);
+  uint8_t* ptr = WriteVarInt(tag, buf);
+  switch (value.type) {
+    case Variadic::Type::kInt:
+      ptr = WriteVarInt(ZigZagEncode(value.int_value), ptr);
+      break;
+    case Variadic::Type::kString:
+      ptr = WriteVarInt(value.string_value, ptr);
+      break;
+    case Variadic::Type::kReal:
+      memcpy(ptr, &value.real_value, sizeof(double));
+      ptr += sizeof(double);
+      break;
+  }
+  blob->insert(blob->end(), buf, ptr);
+}
+
+ArgSetId TraceStorage::Args::AddLazyArgSet(const std::vector<uint8_t>& blob,
+                                           uint32_t arg_count) {
+  base::Hash hash;
+  hash.Update(reinterpret_cast<const char*>(blob.data()), blob.size());
+  ArgSetHash digest = hash.digest();
+  const ArgSetId* existing = lazy_set_for_hash_.Find(digest);
+  if (existing)
+    return *existing;
+
+  ArgSetId id = next_arg_set_id_++;
+  lazy_set_for_hash_.Insert(digest, id);
+  lazy_set_ids_.emplace_back(id);
+  lazy_first_rows_.emplace_back(lazy_args_count_);
+  lazy_offsets_.emplace_back(lazy_blobs_.size());
+  lazy_blobs_.insert(lazy_blobs_.end(), blob.begin(), blob.end());
+  lazy_args_count_ += arg_count;
+  return id;
+}
+
+uint32_t TraceStorage::Args::FindLazySet(uint32_t lazy_row) const {
+  PERFETTO_DCHECK(lazy_row < lazy_args_count_);
+  // Queries mostly walk the rows in order: check the set of the last lookup
+  // and the one after it before falling back to a binary search.
+  uint32_t num_sets = static_cast<uint32_t>(lazy_first_rows_.size());
+  for (uint32_t idx = last_lazy_set_;
+       idx < num_sets && idx <= last_lazy_set_ + 1; idx++) {
+    uint32_t end = idx + 1 < num_sets ? lazy_first_rows_[idx + 1]
+                                      : lazy_args_count_;
+    if (lazy_first_rows_[idx] <= lazy_row && lazy_row < end) {
+      last_lazy_set_ = idx;
+      return idx;
+    }
+  }
+  auto it = std::upper_bound(lazy_first_rows_.begin(), lazy_first_rows_.end(),
+                             lazy_row);
+  last_lazy_set_ =
+      static_cast<uint32_t>(std::distance(lazy_first_rows_.begin(), it)) - 1;
+  return last_lazy_set_;
+}
+
+TraceStorage::Args::Arg TraceStorage::Args::GetLazyArg(
+    uint32_t lazy_row) const {
+  using protozero::proto_utils::ParseVarInt;
+
+  uint32_t idx = FindLazySet(lazy_row);
+  if (decode_cache_.empty())
+    decode_cache_.resize(kLazyDecodeCacheSize);
+  DecodedArgSet* decoded = &decode_cache_[idx % kLazyDecodeCacheSize];
+  if (decoded->lazy_set != idx) {
+    decoded->lazy_set = idx;
+    decoded->args.clear();
+
+    const uint8_t* ptr = lazy_blobs_.data() + lazy_offsets_[idx];
+    const uint8_t* end = lazy_blobs_.data() + (idx + 1 < lazy_offsets_.size()
+                                                   ? lazy_offsets_[idx + 1]
+                                                   : lazy_blobs_.size());
+    while (ptr < end) {
+      uint64_t tag = 0;
+      ptr = ParseVarInt(ptr, end, &tag);
+      Arg arg;
+      arg.key = arg.flat_key = static_cast<StringId>(tag >> 2);
+      switch (static_cast<Variadic::Type>(tag & 3)) {
+        case Variadic::Type::kInt: {
+          uint64_t raw = 0;
+          ptr = ParseVarInt(ptr, end, &raw);
+          arg.value = Variadic::Integer(static_cast<int64_t>(raw >> 1) ^
+                                        -static_cast<int64_t>(raw & 1));
+          break;
+        }
+        case Variadic::Type::kString: {
+          uint64_t raw = 0;
+          ptr = ParseVarInt(ptr, end, &raw);
+          arg.value = Variadic::String(static_cast<StringId>(raw));
+          break;
+        }
+        case Variadic::Type::kReal: {
+          double real = 0;
+          memcpy(&real, ptr, sizeof(double));
+          ptr += sizeof(double);
+          arg.value = Variadic::Real(real);
+          break;
+        }
+      }
+      decoded->args.emplace_back(arg);
+    }
+  }
+
+  uint32_t arg_idx = lazy_row - lazy_first_rows_[idx];
+  PERFETTO_DCHECK(arg_idx < decoded->args.size());
+  return decoded->args[arg_idx];
+}
+
 std::pair<int64_t, int64_t> TraceStorage::GetTraceTimestampBoundsNs() const {
   int64_t start_ns = std::numeric_limits<int64_t>::max();
   int64_t end_ns = std::numeric_limits<int64_t>::min();
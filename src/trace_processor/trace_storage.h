@@ -19,19 +19,23 @@
 
 #include <array>
 #include <deque>
+#include <limits>
 #include <map>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "perfetto/base/flat_hash_map.h"
 #include "perfetto/base/hash.h"
 #include "perfetto/base/logging.h"
 #include "perfetto/base/optional.h"
 #include "perfetto/base/string_view.h"
 #include "perfetto/base/utils.h"
+#include "src/trace_processor/chunked_column.h"
 #include "src/trace_processor/ftrace_utils.h"
+#include "src/trace_processor/null_term_string_view.h"
 #include "src/trace_processor/stats.h"
+#include "src/trace_processor/string_pool.h"
 
 namespace perfetto {
 namespace trace_processor {
@@ -45,8 +49,8 @@ using UniquePid = uint32_t;
 // be reused.
 using UniqueTid = uint32_t;
 
-// StringId is an offset into |string_pool_|.
-using StringId = uint32_t;
+// StringId is an id handed out by |string_pool_|.
+using StringId = StringPool::Id;
 
 // Identifiers for all the tables in the database.
 enum TableId : uint8_t {
@@ -170,14 +174,41 @@ class TraceStorage {
       }
     };
 
-    const std::deque<ArgSetId>& set_ids() const { return set_ids_; }
-    const std::deque<StringId>& flat_keys() const { return flat_keys_; }
-    const std::deque<StringId>& keys() const { return keys_; }
-    const std::deque<Variadic>& arg_values() const { return arg_values_; }
+    // The columns below only hold the args added with AddArgSet(). The args
+    // of lazy sets (see AddLazyArgSet()) come after them and can only be read
+    // through GetArg() and GetSetId().
+    const ChunkedColumn<ArgSetId>& set_ids() const { return set_ids_; }
+    const ChunkedColumn<StringId>& flat_keys() const { return flat_keys_; }
+    const ChunkedColumn<StringId>& keys() const { return keys_; }
+    const ChunkedColumn<Variadic>& arg_values() const { return arg_values_; }
     uint32_t args_count() const {
-      return static_cast<uint32_t>(set_ids_.size());
+      return static_cast<uint32_t>(set_ids_.size()) + lazy_args_count_;
     }
 
+    // Returns the arg at |row|, with |row| < args_count().
+    Arg GetArg(uint32_t row) const {
+      if (PERFETTO_LIKELY(row < set_ids_.size())) {
+        Arg arg;
+        arg.flat_key = flat_keys_[row];
+        arg.key = keys_[row];
+        arg.value = arg_values_[row];
+        return arg;
+      }
+      return GetLazyArg(row - static_cast<uint32_t>(set_ids_.size()));
+    }
+
+    // Returns the id of the set of the arg at |row|. Doesn't decode lazy sets.
+    ArgSetId GetSetId(uint32_t row) const {
+      if (PERFETTO_LIKELY(row < set_ids_.size()))
+        return set_ids_[row];
+      auto lazy_row = row - static_cast<uint32_t>(set_ids_.size());
+      return lazy_set_ids_[FindLazySet(lazy_row)];
+    }
+
+    // Returns the rows [first, second) of the args of the set |id|. Both are
+    // equal if there is no such set.
+    std::pair<uint32_t, uint32_t> FindArgSetRows(ArgSetId id) const;
+
     ArgSetId AddArgSet(const std::vector<Arg>& args,
                        uint32_t begin,
                        uint32_t end) {
@@ -187,14 +218,12 @@ class TraceStorage {
       }
 
       ArgSetHash digest = hash.digest();
-      auto it = arg_row_for_hash_.find(digest);
-      if (it != arg_row_for_hash_.end()) {
-        return set_ids_[it->second];
-      }
+      const uint32_t* row = arg_row_for_hash_.Find(digest);
+      if (row)
+        return set_ids_[*row];
 
-      // The +1 ensures that nothing has an id == kInvalidArgSetId == 0.
-      ArgSetId id = static_cast<uint32_t>(arg_row_for_hash_.size()) + 1;
-      arg_row_for_hash_.emplace(digest, args_count());
+      ArgSetId id = next_arg_set_id_++;
+      arg_row_for_hash_.Insert(digest, static_cast<uint32_t>(set_ids_.size()));
       for (uint32_t i = begin; i < end; i++) {
         const auto& arg = args[i];
         set_ids_.emplace_back(id);
@@ -205,15 +234,58 @@ class TraceStorage {
       return id;
     }
 
+    // Appends the encoding of an arg of a lazy set to |blob|. Lazy args
+    // always have a flat key equal to their key.
+    static void AppendLazyArg(StringId key,
+                              const Variadic& value,
+                              std::vector<uint8_t>* blob);
+
+    // Adds a set of |arg_count| args encoded with AppendLazyArg(). Unlike
+    // AddArgSet(), the args are only decoded when a query reads them, which
+    // keeps args that are never looked at (e.g. the fields of most raw ftrace
+    // events) a few bytes each.
+    ArgSetId AddLazyArgSet(const std::vector<uint8_t>& blob,
+                           uint32_t arg_count);
+
    private:
     using ArgSetHash = uint64_t;
 
-    std::deque<ArgSetId> set_ids_;
-    std::deque<StringId> flat_keys_;
-    std::deque<StringId> keys_;
-    std::deque<Variadic> arg_values_;
+    // Number of decoded lazy sets kept around. Queries usually read all the
+    // args of a set in a row, so a small cache avoids decoding a set for
+    // each of its args.
+    static constexpr uint32_t kLazyDecodeCacheSize = 1024;
 
-    std::unordered_map<ArgSetHash, uint32_t> arg_row_for_hash_;
+    struct DecodedArgSet {
+      uint32_t lazy_set = std::numeric_limits<uint32_t>::max();
+      std::vector<Arg> args;
+    };
+
+    Arg GetLazyArg(uint32_t lazy_row) const;
+
+    // Returns the index of the lazy set containing |lazy_row|.
+    uint32_t FindLazySet(uint32_t lazy_row) const;
+
+    ChunkedColumn<ArgSetId> set_ids_;
+    ChunkedColumn<StringId> flat_keys_;
+    ChunkedColumn<StringId> keys_;
+    ChunkedColumn<Variadic> arg_values_;
+
+    base::FlatHashMap<ArgSetHash, uint32_t> arg_row_for_hash_;
+
+    // Starts at 1 so that nothing has an id == kInvalidArgSetId == 0.
+    ArgSetId next_arg_set_id_ = 1;
+
+    // For each lazy set: its id, the row of its first arg (relative to the
+    // first lazy row) and the offset of its encoding in |lazy_blobs_|.
+    ChunkedColumn<ArgSetId> lazy_set_ids_;
+    ChunkedColumn<uint32_t> lazy_first_rows_;
+    ChunkedColumn<uint64_t> lazy_offsets_;
+    std::vector<uint8_t> lazy_blobs_;
+    uint32_t lazy_args_count_ = 0;
+    base::FlatHashMap<ArgSetHash, ArgSetId> lazy_set_for_hash_;
+
+    mutable std::vector<DecodedArgSet> decode_cache_;
+    mutable uint32_t last_lazy_set_ = 0;
   };
 
   class Slices {
@@ -247,33 +319,33 @@ class TraceStorage {
 
     size_t slice_count() const { return start_ns_.size(); }
 
-    const std::deque<uint32_t>& cpus() const { return cpus_; }
+    const ChunkedColumn<uint32_t>& cpus() const { return cpus_; }
 
-    const std::deque<int64_t>& start_ns() const { return start_ns_; }
+    const ChunkedColumn<int64_t>& start_ns() const { return start_ns_; }
 
-    const std::deque<int64_t>& durations() const { return durations_; }
+    const ChunkedColumn<int64_t>& durations() const { return durations_; }
 
-    const std::deque<UniqueTid>& utids() const { return utids_; }
+    const ChunkedColumn<UniqueTid>& utids() const { return utids_; }
 
-    const std::deque<ftrace_utils::TaskState>& end_state() const {
+    const ChunkedColumn<ftrace_utils::TaskState>& end_state() const {
       return end_states_;
     }
 
-    const std::deque<int32_t>& priorities() const { return priorities_; }
+    const ChunkedColumn<int32_t>& priorities() const { return priorities_; }
 
     const std::deque<std::vector<uint32_t>>& rows_for_utids() const {
       return rows_for_utids_;
     }
 
    private:
-    // Each deque below has the same number of entries (the number of slices
+    // Each column below has the same number of entries (the number of slices
     // in the trace for the CPU).
-    std::deque<uint32_t> cpus_;
-    std::deque<int64_t> start_ns_;
-    std::deque<int64_t> durations_;
-    std::deque<UniqueTid> utids_;
-    std::deque<ftrace_utils::TaskState> end_states_;
-    std::deque<int32_t> priorities_;
+    ChunkedColumn<uint32_t> cpus_;
+    ChunkedColumn<int64_t> start_ns_;
+    ChunkedColumn<int64_t> durations_;
+    ChunkedColumn<UniqueTid> utids_;
+    ChunkedColumn<ftrace_utils::TaskState> end_states_;
+    ChunkedColumn<int32_t> priorities_;
 
     // One row per utid.
     std::deque<std::vector<uint32_t>> rows_for_utids_;
@@ -309,26 +381,26 @@ class TraceStorage {
     }
 
     size_t slice_count() const { return start_ns_.size(); }
-    const std::deque<int64_t>& start_ns() const { return start_ns_; }
-    const std::deque<int64_t>& durations() const { return durations_; }
-    const std::deque<UniqueTid>& utids() const { return utids_; }
-    const std::deque<StringId>& cats() const { return cats_; }
-    const std::deque<StringId>& names() const { return names_; }
-    const std::deque<uint8_t>& depths() const { return depths_; }
-    const std::deque<int64_t>& stack_ids() const { return stack_ids_; }
-    const std::deque<int64_t>& parent_stack_ids() const {
+    const ChunkedColumn<int64_t>& start_ns() const { return start_ns_; }
+    const ChunkedColumn<int64_t>& durations() const { return durations_; }
+    const ChunkedColumn<UniqueTid>& utids() const { return utids_; }
+    const ChunkedColumn<StringId>& cats() const { return cats_; }
+    const ChunkedColumn<StringId>& names() const { return names_; }
+    const ChunkedColumn<uint8_t>& depths() const { return depths_; }
+    const ChunkedColumn<int64_t>& stack_ids() const { return stack_ids_; }
+    const ChunkedColumn<int64_t>& parent_stack_ids() const {
       return parent_stack_ids_;
     }
 
    private:
-    std::deque<int64_t> start_ns_;
-    std::deque<int64_t> durations_;
-    std::deque<UniqueTid> utids_;
-    std::deque<StringId> cats_;
-    std::deque<StringId> names_;
-    std::deque<uint8_t> depths_;
-    std::deque<int64_t> stack_ids_;
-    std::deque<int64_t> parent_stack_ids_;
+    ChunkedColumn<int64_t> start_ns_;
+    ChunkedColumn<int64_t> durations_;
+    ChunkedColumn<UniqueTid> utids_;
+    ChunkedColumn<StringId> cats_;
+    ChunkedColumn<StringId> names_;
+    ChunkedColumn<uint8_t> depths_;
+    ChunkedColumn<int64_t> stack_ids_;
+    ChunkedColumn<int64_t> parent_stack_ids_;
   };
 
   class CounterDefinitions {
@@ -346,31 +418,31 @@ class TraceStorage {
       // TODO(lalitm): this is a perf bottleneck and likely we can do something
       // quite a bit better here.
       uint64_t digest = hash.digest();
-      auto it = hash_to_row_idx_.find(digest);
-      if (it != hash_to_row_idx_.end())
-        return it->second;
+      const Id* row = hash_to_row_idx_.Find(digest);
+      if (row)
+        return *row;
 
       name_ids_.emplace_back(name_id);
       refs_.emplace_back(ref);
       types_.emplace_back(type);
-      hash_to_row_idx_.emplace(digest, size() - 1);
+      hash_to_row_idx_.Insert(digest, size() - 1);
       return size() - 1;
     }
 
     uint32_t size() const { return static_cast<uint32_t>(name_ids_.size()); }
 
-    const std::deque<StringId>& name_ids() const { return name_ids_; }
+    const ChunkedColumn<StringId>& name_ids() const { return name_ids_; }
 
-    const std::deque<int64_t>& refs() const { return refs_; }
+    const ChunkedColumn<int64_t>& refs() const { return refs_; }
 
-    const std::deque<RefType>& types() const { return types_; }
+    const ChunkedColumn<RefType>& types() const { return types_; }
 
    private:
-    std::deque<StringId> name_ids_;
-    std::deque<int64_t> refs_;
-    std::deque<RefType> types_;
+    ChunkedColumn<StringId> name_ids_;
+    ChunkedColumn<int64_t> refs_;
+    ChunkedColumn<RefType> types_;
 
-    std::unordered_map<uint64_t, uint32_t> hash_to_row_idx_;
+    base::FlatHashMap<uint64_t, Id> hash_to_row_idx_;
   };
 
   class CounterValues {
@@ -389,21 +461,21 @@ class TraceStorage {
 
     uint32_t size() const { return static_cast<uint32_t>(counter_ids_.size()); }
 
-    const std::deque<CounterDefinitions::Id>& counter_ids() const {
+    const ChunkedColumn<CounterDefinitions::Id>& counter_ids() const {
       return counter_ids_;
     }
 
-    const std::deque<int64_t>& timestamps() const { return timestamps_; }
+    const ChunkedColumn<int64_t>& timestamps() const { return timestamps_; }
 
-    const std::deque<double>& values() const { return values_; }
+    const ChunkedColumn<double>& values() const { return values_; }
 
-    const std::deque<ArgSetId>& arg_set_ids() const { return arg_set_ids_; }
+    const ChunkedColumn<ArgSetId>& arg_set_ids() const { return arg_set_ids_; }
 
    private:
-    std::deque<CounterDefinitions::Id> counter_ids_;
-    std::deque<int64_t> timestamps_;
-    std::deque<double> values_;
-    std::deque<ArgSetId> arg_set_ids_;
+    ChunkedColumn<CounterDefinitions::Id> counter_ids_;
+    ChunkedColumn<int64_t> timestamps_;
+    ChunkedColumn<double> values_;
+    ChunkedColumn<ArgSetId> arg_set_ids_;
   };
 
   class SqlStats {
@@ -446,25 +518,25 @@ class TraceStorage {
 
     size_t instant_count() const { return timestamps_.size(); }
 
-    const std::deque<int64_t>& timestamps() const { return timestamps_; }
+    const ChunkedColumn<int64_t>& timestamps() const { return timestamps_; }
 
-    const std::deque<StringId>& name_ids() const { return name_ids_; }
+    const ChunkedColumn<StringId>& name_ids() const { return name_ids_; }
 
-    const std::deque<double>& values() const { return values_; }
+    const ChunkedColumn<double>& values() const { return values_; }
 
-    const std::deque<int64_t>& refs() const { return refs_; }
+    const ChunkedColumn<int64_t>& refs() const { return refs_; }
 
-    const std::deque<RefType>& types() const { return types_; }
+    const ChunkedColumn<RefType>& types() const { return types_; }
 
-    const std::deque<ArgSetId>& arg_set_ids() const { return arg_set_ids_; }
+    const ChunkedColumn<ArgSetId>& arg_set_ids() const { return arg_set_ids_; }
 
    private:
-    std::deque<int64_t> timestamps_;
-    std::deque<StringId> name_ids_;
-    std::deque<double> values_;
-    std::deque<int64_t> refs_;
-    std::deque<RefType> types_;
-    std::deque<ArgSetId> arg_set_ids_;
+    ChunkedColumn<int64_t> timestamps_;
+    ChunkedColumn<StringId> name_ids_;
+    ChunkedColumn<double> values_;
+    ChunkedColumn<int64_t> refs_;
+    ChunkedColumn<RefType> types_;
+    ChunkedColumn<ArgSetId> arg_set_ids_;
   };
 
   class RawEvents {
@@ -486,22 +558,22 @@ class TraceStorage {
 
     size_t raw_event_count() const { return timestamps_.size(); }
 
-    const std::deque<int64_t>& timestamps() const { return timestamps_; }
+    const ChunkedColumn<int64_t>& timestamps() const { return timestamps_; }
 
-    const std::deque<StringId>& name_ids() const { return name_ids_; }
+    const ChunkedColumn<StringId>& name_ids() const { return name_ids_; }
 
-    const std::deque<uint32_t>& cpus() const { return cpus_; }
+    const ChunkedColumn<uint32_t>& cpus() const { return cpus_; }
 
-    const std::deque<UniqueTid>& utids() const { return utids_; }
+    const ChunkedColumn<UniqueTid>& utids() const { return utids_; }
 
-    const std::deque<ArgSetId>& arg_set_ids() const { return arg_set_ids_; }
+    const ChunkedColumn<ArgSetId>& arg_set_ids() const { return arg_set_ids_; }
 
    private:
-    std::deque<int64_t> timestamps_;
-    std::deque<StringId> name_ids_;
-    std::deque<uint32_t> cpus_;
-    std::deque<UniqueTid> utids_;
-    std::deque<ArgSetId> arg_set_ids_;
+    ChunkedColumn<int64_t> timestamps_;
+    ChunkedColumn<StringId> name_ids_;
+    ChunkedColumn<uint32_t> cpus_;
+    ChunkedColumn<UniqueTid> utids_;
+    ChunkedColumn<ArgSetId> arg_set_ids_;
   };
 
   class AndroidLogs {
@@ -521,18 +593,18 @@ class TraceStorage {
 
     size_t size() const { return timestamps_.size(); }
 
-    const std::deque<int64_t>& timestamps() const { return timestamps_; }
-    const std::deque<UniqueTid>& utids() const { return utids_; }
-    const std::deque<uint8_t>& prios() const { return prios_; }
-    const std::deque<StringId>& tag_ids() const { return tag_ids_; }
-    const std::deque<StringId>& msg_ids() const { return msg_ids_; }
+    const ChunkedColumn<int64_t>& timestamps() const { return timestamps_; }
+    const ChunkedColumn<UniqueTid>& utids() const { return utids_; }
+    const ChunkedColumn<uint8_t>& prios() const { return prios_; }
+    const ChunkedColumn<StringId>& tag_ids() const { return tag_ids_; }
+    const ChunkedColumn<StringId>& msg_ids() const { return msg_ids_; }
 
    private:
-    std::deque<int64_t> timestamps_;
-    std::deque<UniqueTid> utids_;
-    std::deque<uint8_t> prios_;
-    std::deque<StringId> tag_ids_;
-    std::deque<StringId> msg_ids_;
+    ChunkedColumn<int64_t> timestamps_;
+    ChunkedColumn<UniqueTid> utids_;
+    ChunkedColumn<uint8_t> prios_;
+    ChunkedColumn<StringId> tag_ids_;
+    ChunkedColumn<StringId> msg_ids_;
   };
 
   struct Stats {
@@ -591,9 +663,12 @@ class TraceStorage {
   }
 
   // Reading methods.
-  const std::string& GetString(StringId id) const {
-    PERFETTO_DCHECK(id < string_pool_.size());
-    return string_pool_[id];
+  // The returned view is always null-terminated and never null: the string
+  // with id 0 is the empty string.
+  NullTermStringView GetString(StringId id) const {
+    if (id == 0)
+      return NullTermStringView("", 0);
+    return string_pool_.Get(id);
   }
 
   const Process& GetProcess(UniquePid upid) const {
@@ -651,7 +726,7 @@ class TraceStorage {
   const RawEvents& raw_events() const { return raw_events_; }
   RawEvents* mutable_raw_events() { return &raw_events_; }
 
-  const std::vector<std::string>& string_pool() const { return string_pool_; }
+  const StringPool& string_pool() const { return string_pool_; }
 
   // |unique_processes_| always contains at least 1 element becuase the 0th ID
   // is reserved to indicate an invalid process.
@@ -662,7 +737,7 @@ class TraceStorage {
   size_t thread_count() const { return unique_threads_.size(); }
 
   // Number of interned strings in the pool. Includes the empty string w/ ID=0.
-  size_t string_count() const { return string_pool_.size(); }
+  size_t string_count() const { return string_pool_.size() + 1; }
 
   // Start / end ts (in nanoseconds) across the parsed trace events.
   // Returns (0, 0) if the trace is empty.
@@ -671,9 +746,7 @@ class TraceStorage {
  private:
   static constexpr uint8_t kRowIdTableShift = 32;
 
-  using StringHash = uint64_t;
-
-  TraceStorage& operator=(const TraceStorage&) = default;
+  TraceStorage& operator=(TraceStorage&&) = default;
 
   // Stats about parsing the trace.
   StatsMap stats_{};
@@ -684,11 +757,9 @@ class TraceStorage {
   // Args for all other tables.
   Args args_;
 
-  // One entry for each unique string in the trace.
-  std::vector<std::string> string_pool_;
-
-  // One entry for each unique string in the trace.
-  std::unordered_map<StringHash, StringId> string_index_;
+  // One entry for each unique string in the trace. The empty string is never
+  // added to the pool and uses the id of the null string (0) instead.
+  StringPool string_pool_;
 
   // One entry for each UniquePid, with UniquePid as the index.
   // Never hold on to pointers to Process, as vector resize will
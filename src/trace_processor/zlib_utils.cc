@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/trace_processor/zlib_utils.h"
+
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace perfetto {
+namespace trace_processor {
+
+bool ZlibInflate(const uint8_t* data,
+                 size_t size,
+                 std::unique_ptr<uint8_t[]>* out,
+                 size_t* out_size) {
+  if (size > std::numeric_limits<uInt>::max())
+    return false;
+
+  z_stream stream{};
+  if (inflateInit(&stream) != Z_OK)
+    return false;
+  stream.next_in = const_cast<uint8_t*>(data);
+  stream.avail_in = static_cast<uInt>(size);
+
+  // Traces usually compress ~4-8x, start from there and double as needed.
+  size_t capacity = std::max(size * 4, size_t(4096));
+  std::unique_ptr<uint8_t[]> buf(new uint8_t[capacity]);
+  size_t used = 0;
+  int res = Z_OK;
+  while (res == Z_OK) {
+    if (used == capacity) {
+      std::unique_ptr<uint8_t[]> new_buf(new uint8_t[capacity * 2]);
+      memcpy(new_buf.get(), buf.get(), used);
+      buf = std::move(new_buf);
+      capacity *= 2;
+    }
+    size_t avail_out = std::min(capacity - used,
+                                size_t(std::numeric_limits<uInt>::max()));
+    stream.next_out = buf.get() + used;
+    stream.avail_out = static_cast<uInt>(avail_out);
+    res = inflate(&stream, Z_NO_FLUSH);
+    used += avail_out - stream.avail_out;
+    // Z_BUF_ERROR means that no progress was possible: the input is truncated
+    // if the output buffer wasn't full.
+    if (res == Z_BUF_ERROR && used == capacity)
+      res = Z_OK;
+  }
+  inflateEnd(&stream);
+
+  // Trailing data after the end of the zlib stream is an error as well.
+  if (res != Z_STREAM_END || stream.avail_in != 0)
+    return false;
+  *out = std::move(buf);
+  *out_size = used;
+  return true;
+}
+
+}  // namespace trace_processor
+}  // namespace perfetto
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACE_PROCESSOR_ZLIB_UTILS_H_
+#define SRC_TRACE_PROCESSOR_ZLIB_UTILS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+namespace perfetto {
+namespace trace_processor {
+
+// Inflates the zlib stream in [data, data + size), as written in the
+// TracePacket.compressed_packets field, into |out|. Returns false if the data
+// is not a complete and valid zlib stream.
+bool ZlibInflate(const uint8_t* data,
+                 size_t size,
+                 std::unique_ptr<uint8_t[]>* out,
+                 size_t* out_size);
+
+}  // namespace trace_processor
+}  // namespace perfetto
+
+#endif  // SRC_TRACE_PROCESSOR_ZLIB_UTILS_H_
@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/traced/probes/ftrace/compact_sched.h"
+
+#include <string.h>
+
+#include "perfetto/protozero/proto_utils.h"
+#include "src/traced/probes/ftrace/ftrace_metadata.h"
+
+#include "perfetto/trace/ftrace/ftrace_event.pbzero.h"
+#include "perfetto/trace/ftrace/ftrace_event_bundle.pbzero.h"
+#include "perfetto/trace/ftrace/sched.pbzero.h"
+
+namespace perfetto {
+
+namespace {
+
+using protos::pbzero::FtraceEvent;
+using protos::pbzero::SchedSwitchFtraceEvent;
+using protos::pbzero::SchedWakingFtraceEvent;
+
+const Event* FindEvent(const std::vector<Event>& events,
+                       uint32_t proto_field_id) {
+  for (const Event& event : events) {
+    if (event.ftrace_event_id && event.proto_field_id == proto_field_id)
+      return &event;
+  }
+  return nullptr;
+}
+
+// Sets |*offset| to the offset of the field |proto_field_id| of |event| if it
+// has the translation strategy |strategy|.
+bool FindField(const Event& event,
+               uint32_t proto_field_id,
+               TranslationStrategy strategy,
+               uint16_t* offset) {
+  for (const Field& field : event.fields) {
+    if (field.proto_field_id != proto_field_id)
+      continue;
+    if (field.strategy != strategy)
+      return false;
+    *offset = field.ftrace_offset;
+    return true;
+  }
+  return false;
+}
+
+CompactSchedSwitchFormat ValidateSchedSwitch(const Event& event) {
+  using SS = SchedSwitchFtraceEvent;
+  CompactSchedSwitchFormat format;
+  bool valid = true;
+  valid &= FindField(event, SS::kPrevCommFieldNumber, kFixedCStringToString,
+                     &format.prev_comm_offset);
+  valid &= FindField(event, SS::kPrevPidFieldNumber, kPid32ToInt32,
+                     &format.prev_pid_offset);
+  valid &= FindField(event, SS::kPrevPrioFieldNumber, kInt32ToInt32,
+                     &format.prev_prio_offset);
+  valid &= FindField(event, SS::kNextCommFieldNumber, kFixedCStringToString,
+                     &format.next_comm_offset);
+  valid &= FindField(event, SS::kNextPidFieldNumber, kPid32ToInt32,
+                     &format.next_pid_offset);
+  valid &= FindField(event, SS::kNextPrioFieldNumber, kInt32ToInt32,
+                     &format.next_prio_offset);
+  if (FindField(event, SS::kPrevStateFieldNumber, kInt64ToInt64,
+                &format.prev_state_offset)) {
+    format.prev_state_size = 8;
+  } else if (FindField(event, SS::kPrevStateFieldNumber, kInt32ToInt64,
+                       &format.prev_state_offset)) {
+    format.prev_state_size = 4;
+  } else {
+    valid = false;
+  }
+  if (!valid)
+    return CompactSchedSwitchFormat();
+  format.event_id = static_cast<uint16_t>(event.ftrace_event_id);
+  format.size = event.size;
+  return format;
+}
+
+CompactSchedWakingFormat ValidateSchedWaking(
+    const Event& event,
+    const std::vector<Field>& common_fields) {
+  using SW = SchedWakingFtraceEvent;
+  CompactSchedWakingFormat format;
+  bool valid = false;
+  for (const Field& field : common_fields) {
+    if (field.proto_field_id == FtraceEvent::kPidFieldNumber &&
+        field.strategy == kCommonPid32ToInt32) {
+      format.common_pid_offset = field.ftrace_offset;
+      valid = true;
+    }
+  }
+  valid &= FindField(event, SW::kCommFieldNumber, kFixedCStringToString,
+                     &format.comm_offset);
+  valid &= FindField(event, SW::kPidFieldNumber, kPid32ToInt32,
+                     &format.pid_offset);
+  valid &= FindField(event, SW::kPrioFieldNumber, kInt32ToInt32,
+                     &format.prio_offset);
+  valid &= FindField(event, SW::kSuccessFieldNumber, kInt32ToInt32,
+                     &format.success_offset);
+  valid &= FindField(event, SW::kTargetCpuFieldNumber, kInt32ToInt32,
+                     &format.target_cpu_offset);
+  if (!valid)
+    return CompactSchedWakingFormat();
+  format.event_id = static_cast<uint16_t>(event.ftrace_event_id);
+  format.size = event.size;
+  return format;
+}
+
+template <typename T>
+T ReadField(const uint8_t* start, uint16_t offset) {
+  T t;
+  memcpy(&t, start + offset, sizeof(T));
+  return t;
+}
+
+// Comms are char[16] in the kernel.
+constexpr size_t kCommSize = 16;
+
+}  // namespace
+
+CompactSchedEventFormat ValidateFormatForCompactSched(
+    const std::vector<Event>& events,
+    const std::vector<Field>& common_fields) {
+  CompactSchedEventFormat format;
+  const Event* sched_switch =
+      FindEvent(events, FtraceEvent::kSchedSwitchFieldNumber);
+  if (sched_switch)
+    format.sched_switch = ValidateSchedSwitch(*sched_switch);
+  const Event* sched_waking =
+      FindEvent(events, FtraceEvent::kSchedWakingFieldNumber);
+  if (sched_waking)
+    format.sched_waking = ValidateSchedWaking(*sched_waking, common_fields);
+  return format;
+}
+
+template <typename T>
+void CompactSchedBuffer::Column::Append(T value) {
+  uint8_t buf[10];
+  uint8_t* end = protozero::proto_utils::WriteVarInt(value, buf);
+  data_.insert(data_.end(), buf, end);
+}
+
+CompactSchedBuffer::CompactSchedBuffer(const CompactSchedEventFormat* format)
+    : format_(format) {}
+
+CompactSchedBuffer::~CompactSchedBuffer() = default;
+
+bool CompactSchedBuffer::MaybeAppendEvent(uint16_t ftrace_event_id,
+                                          uint64_t timestamp,
+                                          const uint8_t* start,
+                                          const uint8_t* end,
+                                          FtraceMetadata* metadata) {
+  const size_t length = static_cast<size_t>(end - start);
+
+  const CompactSchedSwitchFormat& ss = format_->sched_switch;
+  if (ss.event_id && ftrace_event_id == ss.event_id) {
+    if (ss.size > length)
+      return false;
+    int32_t prev_comm = InternComm(start + ss.prev_comm_offset, kCommSize);
+    int32_t next_comm = InternComm(start + ss.next_comm_offset, kCommSize);
+    if (prev_comm < 0 || next_comm < 0)
+      return false;
+
+    int32_t prev_pid = ReadField<int32_t>(start, ss.prev_pid_offset);
+    int32_t next_pid = ReadField<int32_t>(start, ss.next_pid_offset);
+    int64_t prev_state =
+        ss.prev_state_size == 8
+            ? ReadField<int64_t>(start, ss.prev_state_offset)
+            : ReadField<int32_t>(start, ss.prev_state_offset);
+
+    switch_timestamp_.Append(timestamp - last_switch_timestamp_);
+    last_switch_timestamp_ = timestamp;
+    switch_prev_comm_index_.Append(static_cast<uint32_t>(prev_comm));
+    switch_prev_pid_.Append(prev_pid);
+    switch_prev_prio_.Append(ReadField<int32_t>(start, ss.prev_prio_offset));
+    switch_prev_state_.Append(prev_state);
+    switch_next_comm_index_.Append(static_cast<uint32_t>(next_comm));
+    switch_next_pid_.Append(next_pid);
+    switch_next_prio_.Append(ReadField<int32_t>(start, ss.next_prio_offset));
+    num_switch_++;
+
+    // The common_pid of a sched_switch is always its prev_pid.
+    metadata->AddCommonPid(prev_pid);
+    metadata->AddPid(next_pid);
+    metadata->FinishEvent();
+    return true;
+  }
+
+  const CompactSchedWakingFormat& sw = format_->sched_waking;
+  if (sw.event_id && ftrace_event_id == sw.event_id) {
+    if (sw.size > length)
+      return false;
+    int32_t comm = InternComm(start + sw.comm_offset, kCommSize);
+    if (comm < 0)
+      return false;
+
+    int32_t common_pid = ReadField<int32_t>(start, sw.common_pid_offset);
+    int32_t pid = ReadField<int32_t>(start, sw.pid_offset);
+
+    waking_timestamp_.Append(timestamp - last_waking_timestamp_);
+    last_waking_timestamp_ = timestamp;
+    waking_common_pid_.Append(common_pid);
+    waking_comm_index_.Append(static_cast<uint32_t>(comm));
+    waking_pid_.Append(pid);
+    waking_prio_.Append(ReadField<int32_t>(start, sw.prio_offset));
+    waking_success_.Append(ReadField<int32_t>(start, sw.success_offset));
+    waking_target_cpu_.Append(ReadField<int32_t>(start, sw.target_cpu_offset));
+    num_waking_++;
+
+    metadata->AddCommonPid(common_pid);
+    metadata->AddPid(pid);
+    metadata->FinishEvent();
+    return true;
+  }
+
+  return false;
+}
+
+int32_t CompactSchedBuffer::InternComm(const uint8_t* start, size_t size) {
+  const char* comm = reinterpret_cast<const char*>(start);
+  size_t len = strnlen(comm, size);
+  for (size_t i = 0; i < intern_table_.size(); i++) {
+    const std::string& interned = intern_table_[i];
+    if (interned.size() == len && memcmp(interned.data(), comm, len) == 0)
+      return static_cast<int32_t>(i);
+  }
+  if (intern_table_.size() >= kMaxInternedComms)
+    return -1;
+  intern_table_.emplace_back(comm, len);
+  return static_cast<int32_t>(intern_table_.size() - 1);
+}
+
+void CompactSchedBuffer::WriteAndReset(
+    protos::pbzero::FtraceEventBundle* bundle) {
+  if (empty()) {
+    Reset();
+    return;
+  }
+  auto* compact = bundle->set_compact_sched();
+  for (const std::string& comm : intern_table_)
+    compact->add_intern_table(comm.data(), comm.size());
+
+  if (num_switch_) {
+    compact->set_switch_timestamp(switch_timestamp_.data(),
+                                  switch_timestamp_.size());
+    compact->set_switch_prev_comm_index(switch_prev_comm_index_.data(),
+                                        switch_prev_comm_index_.size());
+    compact->set_switch_prev_pid(switch_prev_pid_.data(),
+                                 switch_prev_pid_.size());
+    compact->set_switch_prev_prio(switch_prev_prio_.data(),
+                                  switch_prev_prio_.size());
+    compact->set_switch_prev_state(switch_prev_state_.data(),
+                                   switch_prev_state_.size());
+    compact->set_switch_next_comm_index(switch_next_comm_index_.data(),
+                                        switch_next_comm_index_.size());
+    compact->set_switch_next_pid(switch_next_pid_.data(),
+                                 switch_next_pid_.size());
+    compact->set_switch_next_prio(switch_next_prio_.data(),
+                                  switch_next_prio_.size());
+  }
+
+  if (num_waking_) {
+    compact->set_waking_timestamp(waking_timestamp_.data(),
+                                  waking_timestamp_.size());
+    compact->set_waking_common_pid(waking_common_pid_.data(),
+                                   waking_common_pid_.size());
+    compact->set_waking_comm_index(waking_comm_index_.data(),
+                                   waking_comm_index_.size());
+    compact->set_waking_pid(waking_pid_.data(), waking_pid_.size());
+    compact->set_waking_prio(waking_prio_.data(), waking_prio_.size());
+    compact->set_waking_success(waking_success_.data(),
+                                waking_success_.size());
+    compact->set_waking_target_cpu(waking_target_cpu_.data(),
+                                   waking_target_cpu_.size());
+  }
+  Reset();
+}
+
+void CompactSchedBuffer::Reset() {
+  intern_table_.clear();
+
+  num_switch_ = 0;
+  last_switch_timestamp_ = 0;
+  switch_timestamp_.clear();
+  switch_prev_comm_index_.clear();
+  switch_prev_pid_.clear();
+  switch_prev_prio_.clear();
+  switch_prev_state_.clear();
+  switch_next_comm_index_.clear();
+  switch_next_pid_.clear();
+  switch_next_prio_.clear();
+
+  num_waking_ = 0;
+  last_waking_timestamp_ = 0;
+  waking_timestamp_.clear();
+  waking_common_pid_.clear();
+  waking_comm_index_.clear();
+  waking_pid_.clear();
+  waking_prio_.clear();
+  waking_success_.clear();
+  waking_target_cpu_.clear();
+}
+
+}  // namespace perfetto
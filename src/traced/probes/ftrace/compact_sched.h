@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACED_PROBES_FTRACE_COMPACT_SCHED_H_
+#define SRC_TRACED_PROBES_FTRACE_COMPACT_SCHED_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "src/traced/probes/ftrace/event_info_constants.h"
+
+namespace perfetto {
+
+struct FtraceMetadata;
+
+namespace protos {
+namespace pbzero {
+class FtraceEventBundle;
+}  // namespace pbzero
+}  // namespace protos
+
+// Offsets of the fields of sched_switch that are written in the compact
+// format. Only valid if |event_id| is not 0.
+struct CompactSchedSwitchFormat {
+  uint16_t event_id = 0;
+  uint16_t size = 0;
+  uint16_t prev_comm_offset = 0;
+  uint16_t prev_pid_offset = 0;
+  uint16_t prev_prio_offset = 0;
+  uint16_t prev_state_offset = 0;
+  // Either 4 or 8, as prev_state is a long.
+  uint16_t prev_state_size = 0;
+  uint16_t next_comm_offset = 0;
+  uint16_t next_pid_offset = 0;
+  uint16_t next_prio_offset = 0;
+};
+
+// As above, for sched_waking.
+struct CompactSchedWakingFormat {
+  uint16_t event_id = 0;
+  uint16_t size = 0;
+  uint16_t common_pid_offset = 0;
+  uint16_t comm_offset = 0;
+  uint16_t pid_offset = 0;
+  uint16_t prio_offset = 0;
+  uint16_t success_offset = 0;
+  uint16_t target_cpu_offset = 0;
+};
+
+struct CompactSchedEventFormat {
+  CompactSchedSwitchFormat sched_switch;
+  CompactSchedWakingFormat sched_waking;
+};
+
+// Returns the offsets of the fields of sched_switch and sched_waking in
+// |events|, whose fields have been merged with the kernel format files. An
+// event whose fields don't have the types the compact format expects gets an
+// |event_id| of 0, and is written as a normal FtraceEvent.
+CompactSchedEventFormat ValidateFormatForCompactSched(
+    const std::vector<Event>& events,
+    const std::vector<Field>& common_fields);
+
+// Accumulates the sched_switch and sched_waking events of a page in columns,
+// which are written at the end of the FtraceEventBundle of the page.
+class CompactSchedBuffer {
+ public:
+  // Strings are interned in a table local to the bundle, which is searched
+  // linearly: a page holds at most ~60 sched_switch events, and in practice
+  // far fewer distinct comms.
+  static constexpr size_t kMaxInternedComms = 256;
+
+  explicit CompactSchedBuffer(const CompactSchedEventFormat* format);
+  ~CompactSchedBuffer();
+
+  // Appends the event beginning at |start| if it is a sched_switch or a
+  // sched_waking with a known format. Returns false, and doesn't touch
+  // |metadata|, if the event must be written as a FtraceEvent instead.
+  bool MaybeAppendEvent(uint16_t ftrace_event_id,
+                        uint64_t timestamp,
+                        const uint8_t* start,
+                        const uint8_t* end,
+                        FtraceMetadata* metadata);
+
+  // Writes the accumulated events, if any, into |bundle| and clears them.
+  void WriteAndReset(protos::pbzero::FtraceEventBundle* bundle);
+
+  void Reset();
+
+  bool empty() const { return num_switch_ == 0 && num_waking_ == 0; }
+
+ private:
+  // A column of varints, encoded like a packed repeated field.
+  class Column {
+   public:
+    template <typename T>
+    void Append(T value);
+
+    const uint8_t* data() const { return data_.data(); }
+    size_t size() const { return data_.size(); }
+    void clear() { data_.clear(); }
+
+   private:
+    std::vector<uint8_t> data_;
+  };
+
+  // Returns the index of the null terminated string in [start, start + size)
+  // in |intern_table_|, or -1 if the table is full.
+  int32_t InternComm(const uint8_t* start, size_t size);
+
+  const CompactSchedEventFormat* const format_;
+
+  std::vector<std::string> intern_table_;
+
+  uint32_t num_switch_ = 0;
+  uint64_t last_switch_timestamp_ = 0;
+  Column switch_timestamp_;
+  Column switch_prev_comm_index_;
+  Column switch_prev_pid_;
+  Column switch_prev_prio_;
+  Column switch_prev_state_;
+  Column switch_next_comm_index_;
+  Column switch_next_pid_;
+  Column switch_next_prio_;
+
+  uint32_t num_waking_ = 0;
+  uint64_t last_waking_timestamp_ = 0;
+  Column waking_timestamp_;
+  Column waking_common_pid_;
+  Column waking_comm_index_;
+  Column waking_pid_;
+  Column waking_prio_;
+  Column waking_success_;
+  Column waking_target_cpu_;
+};
+
+}  // namespace perfetto
+
+#endif  // SRC_TRACED_PROBES_FTRACE_COMPACT_SCHED_H_
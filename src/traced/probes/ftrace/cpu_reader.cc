@@ -70,20 +70,6 @@ struct TimeStamp {
   uint64_t tv_sec;
 };
 
-bool ReadIntoString(const uint8_t* start,
-                    const uint8_t* end,
-                    uint32_t field_id,
-                    protozero::Message* out) {
-  for (const uint8_t* c = start; c < end; c++) {
-    if (*c != '\0')
-      continue;
-    out->AppendBytes(field_id, reinterpret_cast<const char*>(start),
-                     static_cast<uintptr_t>(c - start));
-    return true;
-  }
-  return false;
-}
-
 bool ReadDataLoc(const uint8_t* start,
                  const uint8_t* field_start,
                  const uint8_t* end,
@@ -107,7 +93,8 @@ bool ReadDataLoc(const uint8_t* start,
     PERFETTO_DFATAL("Buffer overflowed.");
     return false;
   }
-  ReadIntoString(string_start, string_end, field.proto_field_id, message);
+  CpuReader::ReadIntoString(string_start, string_end, field.proto_field_id,
+                            message);
   return true;
 }
 
@@ -158,6 +145,7 @@ CpuReader::CpuReader(const ProtoTranslationTable* table,
     : table_(table),
       thread_sync_(thread_sync),
       cpu_(cpu),
+      compact_sched_buffer_(&table->compact_sched_format()),
       trace_fd_(std::move(fd)) {
   // Make reads from the raw pipe blocking so that splice() can sleep.
   PERFETTO_CHECK(trace_fd_);
@@ -419,8 +407,15 @@ void CpuReader::Drain(const std::set<FtraceDataSource*>& data_sources) {
         // changes, change proto_trace_parser.cc accordingly.
         bundle->set_cpu(static_cast<uint32_t>(cpu_));
 
-        size_t evt_size = ParsePage(page, filter, bundle, table_, metadata);
+        CompactSchedBuffer* compact_sched = nullptr;
+        if (data_source->config().compact_sched())
+          compact_sched = &compact_sched_buffer_;
+
+        size_t evt_size =
+            ParsePage(page, filter, bundle, table_, metadata, compact_sched);
         PERFETTO_DCHECK(evt_size);
+        if (compact_sched)
+          compact_sched->WriteAndReset(bundle);
         bundle->set_overwrite_count(metadata->overwrite_count);
       }
     }
@@ -440,7 +435,8 @@ size_t CpuReader::ParsePage(const uint8_t* ptr,
                             const EventFilter* filter,
                             FtraceEventBundle* bundle,
                             const ProtoTranslationTable* table,
-                            FtraceMetadata* metadata) {
+                            FtraceMetadata* metadata,
+                            CompactSchedBuffer* compact_sched) {
   const uint8_t* const start_of_page = ptr;
   const uint8_t* const end_of_page = ptr + base::kPageSize;
 
@@ -523,7 +519,10 @@ size_t CpuReader::ParsePage(const uint8_t* ptr,
         uint16_t ftrace_event_id;
         if (!ReadAndAdvance<uint16_t>(&ptr, end, &ftrace_event_id))
           return 0;
-        if (filter->IsEventEnabled(ftrace_event_id)) {
+        if (filter->IsEventEnabled(ftrace_event_id) &&
+            !(compact_sched &&
+              compact_sched->MaybeAppendEvent(ftrace_event_id, timestamp,
+                                              start, next, metadata))) {
           protos::pbzero::FtraceEvent* event = bundle->add_event();
           event->set_timestamp(timestamp);
           if (!ParseEvent(ftrace_event_id, start, next, table, event, metadata))
@@ -538,6 +537,21 @@ size_t CpuReader::ParsePage(const uint8_t* ptr,
   return static_cast<size_t>(ptr - start_of_page);
 }
 
+// static
+bool CpuReader::ReadIntoString(const uint8_t* start,
+                               const uint8_t* end,
+                               uint32_t field_id,
+                               protozero::Message* out) {
+  for (const uint8_t* c = start; c < end; c++) {
+    if (*c != '\0')
+      continue;
+    out->AppendBytes(field_id, reinterpret_cast<const char*>(start),
+                     static_cast<uintptr_t>(c - start));
+    return true;
+  }
+  return false;
+}
+
 // |start| is the start of the current event.
 // |end| is the end of the buffer.
 bool CpuReader::ParseEvent(uint16_t ftrace_event_id,
@@ -559,6 +573,16 @@ bool CpuReader::ParseEvent(uint16_t ftrace_event_id,
     return false;
   }
 
+  // The hottest events have decoders specialized at compile time for their
+  // usual layouts, used when the layout reported by the kernel matches.
+  EventDecoder decoder = table->GetEventDecoder(ftrace_event_id);
+  if (decoder) {
+    bool success = decoder(start, end, message, metadata);
+    message->Finalize();
+    metadata->FinishEvent();
+    return success;
+  }
+
   bool success = true;
   for (const Field& field : table->common_fields())
     success &= ParseField(field, start, end, message, metadata);
@@ -34,6 +34,7 @@
 #include "perfetto/protozero/message.h"
 #include "perfetto/protozero/message_handle.h"
 #include "perfetto/traced/data_source_types.h"
+#include "src/traced/probes/ftrace/compact_sched.h"
 #include "src/traced/probes/ftrace/ftrace_config.h"
 #include "src/traced/probes/ftrace/ftrace_metadata.h"
 #include "src/traced/probes/ftrace/page_pool.h"
@@ -93,6 +94,13 @@ class CpuReader {
     return t;
   }
 
+  // Appends the null terminated string in [start, end) as |field_id|.
+  // Returns false if there is no null terminator before |end|.
+  static bool ReadIntoString(const uint8_t* start,
+                             const uint8_t* end,
+                             uint32_t field_id,
+                             protozero::Message* out);
+
   template <typename T>
   static void ReadInode(const uint8_t* start,
                         uint32_t field_id,
@@ -153,11 +161,15 @@ class CpuReader {
   // run time (e.g. field offset and size) information necessary to do this.
   // The table is initialized once at start time by the ftrace controller
   // which passes it to the CpuReader which passes it here.
+  // If |compact_sched| is not null, the sched_switch and sched_waking events
+  // it supports are appended to it rather than written into the bundle. The
+  // caller has to write it into the bundle with WriteAndReset().
   static size_t ParsePage(const uint8_t* ptr,
                           const EventFilter*,
                           protos::pbzero::FtraceEventBundle*,
                           const ProtoTranslationTable* table,
-                          FtraceMetadata*);
+                          FtraceMetadata*,
+                          CompactSchedBuffer* compact_sched = nullptr);
 
   // Parse a single raw ftrace event beginning at |start| and ending at |end|
   // and write it into the provided bundle as a proto.
@@ -194,6 +206,7 @@ class CpuReader {
   FtraceThreadSync* const thread_sync_;
   const size_t cpu_;
   PagePool pool_;
+  CompactSchedBuffer compact_sched_buffer_;
   base::ScopedFile trace_fd_;
   std::thread worker_thread_;
   PERFETTO_THREAD_CHECKER(thread_checker_)
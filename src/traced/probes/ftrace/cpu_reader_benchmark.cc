@@ -12,6 +12,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string.h>
+
+#include <vector>
+
 #include "benchmark/benchmark.h"
 
 #include "src/traced/probes/ftrace/cpu_reader.h"
@@ -324,3 +328,89 @@ static void BM_ParsePageFullOfSchedSwitch(benchmark::State& state) {
   }
 }
 BENCHMARK(BM_ParsePageFullOfSchedSwitch);
+
+namespace {
+
+// Returns a zeroed record of |event| with the common_pid set and every string
+// field null terminated, which is enough for both decoders to parse it.
+std::vector<uint8_t> MakeEventRecord(const ProtoTranslationTable* table,
+                                     const perfetto::Event& event) {
+  // Leave room for the trailing buffer of kCStringToString fields.
+  std::vector<uint8_t> record(event.size + 64u, 0);
+  const perfetto::Field& pid_field = table->common_fields().at(0);
+  int32_t pid = 1234;
+  memcpy(&record[pid_field.ftrace_offset], &pid, sizeof(pid));
+  for (const perfetto::Field& field : event.fields) {
+    if (field.strategy == perfetto::kFixedCStringToString ||
+        field.strategy == perfetto::kCStringToString) {
+      memcpy(&record[field.ftrace_offset], "comm", 4);
+    }
+  }
+  return record;
+}
+
+// Parses one |group|/|name| event per iteration. With state.range(0) == 0 the
+// event goes through the field by field interpretation used when the layout
+// reported by the kernel doesn't match any specialized decoder.
+void BenchmarkParseEvent(benchmark::State& state,
+                         const char* group,
+                         const char* name) {
+  ScatteredStreamWriterNullDelegate delegate(perfetto::base::kPageSize);
+  ScatteredStreamWriter stream(&delegate);
+  FtraceEventBundle writer;
+
+  // This kernel has the layouts the specialized decoders know about.
+  ProtoTranslationTable* table = GetTable("android_seed_N2F62_3.10.49");
+  size_t id = table->EventToFtraceId(GroupAndName(group, name));
+  const perfetto::Event* event = table->GetEventById(id);
+  PERFETTO_CHECK(event && table->GetEventDecoder(id));
+  std::vector<uint8_t> record = MakeEventRecord(table, *event);
+  const uint8_t* start = record.data();
+  const uint8_t* end = record.data() + record.size();
+
+  const bool specialized = state.range(0) != 0;
+  FtraceMetadata metadata{};
+  while (state.KeepRunning()) {
+    writer.Reset(&stream);
+    if (specialized) {
+      CpuReader::ParseEvent(static_cast<uint16_t>(id), start, end, table,
+                            writer.add_event(), &metadata);
+    } else {
+      protozero::Message* message = writer.add_event();
+      for (const perfetto::Field& field : table->common_fields())
+        CpuReader::ParseField(field, start, end, message, &metadata);
+      protozero::Message* nested =
+          message->BeginNestedMessage<protozero::Message>(
+              event->proto_field_id);
+      for (const perfetto::Field& field : event->fields)
+        CpuReader::ParseField(field, start, end, nested, &metadata);
+      message->Finalize();
+      metadata.FinishEvent();
+    }
+    metadata.Clear();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+  state.SetLabel(specialized ? "specialized" : "interpreted");
+}
+
+}  // namespace
+
+static void BM_ParseEventSchedSwitch(benchmark::State& state) {
+  BenchmarkParseEvent(state, "sched", "sched_switch");
+}
+BENCHMARK(BM_ParseEventSchedSwitch)->Arg(0)->Arg(1);
+
+static void BM_ParseEventSchedWakeup(benchmark::State& state) {
+  BenchmarkParseEvent(state, "sched", "sched_wakeup");
+}
+BENCHMARK(BM_ParseEventSchedWakeup)->Arg(0)->Arg(1);
+
+static void BM_ParseEventCpuFrequency(benchmark::State& state) {
+  BenchmarkParseEvent(state, "power", "cpu_frequency");
+}
+BENCHMARK(BM_ParseEventCpuFrequency)->Arg(0)->Arg(1);
+
+static void BM_ParseEventPrint(benchmark::State& state) {
+  BenchmarkParseEvent(state, "ftrace", "print");
+}
+BENCHMARK(BM_ParseEventPrint)->Arg(0)->Arg(1);
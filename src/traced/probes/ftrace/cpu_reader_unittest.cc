@@ -690,6 +690,196 @@ TEST(CpuReaderTest, ParseSixSchedSwitch) {
   }
 }
 
+// Decodes a column of a FtraceEventBundle.CompactSched.
+std::vector<int64_t> DecodeCompactColumn(const std::string& column) {
+  std::vector<int64_t> values;
+  const uint8_t* ptr = reinterpret_cast<const uint8_t*>(column.data());
+  const uint8_t* end = ptr + column.size();
+  while (ptr < end) {
+    uint64_t value = 0;
+    const uint8_t* next = protozero::proto_utils::ParseVarInt(ptr, end, &value);
+    if (next == ptr)
+      break;
+    values.push_back(static_cast<int64_t>(value));
+    ptr = next;
+  }
+  return values;
+}
+
+TEST(CpuReaderTest, ParseSixSchedSwitchCompact) {
+  const ExamplePage* test_case = &g_six_sched_switch;
+
+  BundleProvider bundle_provider(base::kPageSize);
+  ProtoTranslationTable* table = GetTable(test_case->name);
+  auto page = PageFromXxd(test_case->data);
+  ASSERT_TRUE(table->compact_sched_format().sched_switch.event_id);
+
+  EventFilter filter;
+  filter.AddEnabledEvent(
+      table->EventToFtraceId(GroupAndName("sched", "sched_switch")));
+
+  FtraceMetadata metadata{};
+  CompactSchedBuffer compact_sched(&table->compact_sched_format());
+  ASSERT_TRUE(CpuReader::ParsePage(page.get(), &filter,
+                                   bundle_provider.writer(), table, &metadata,
+                                   &compact_sched));
+  compact_sched.WriteAndReset(bundle_provider.writer());
+  EXPECT_TRUE(compact_sched.empty());
+
+  auto bundle = bundle_provider.ParseProto();
+  ASSERT_TRUE(bundle);
+  EXPECT_EQ(bundle->event().size(), 0);
+  ASSERT_TRUE(bundle->has_compact_sched());
+  const auto& compact = bundle->compact_sched();
+
+  std::vector<std::string> comms(compact.intern_table().begin(),
+                                 compact.intern_table().end());
+  auto comm = [&comms](int64_t index) {
+    return comms.at(static_cast<size_t>(index));
+  };
+
+  std::vector<int64_t> timestamps =
+      DecodeCompactColumn(compact.switch_timestamp());
+  ASSERT_EQ(timestamps.size(), 6u);
+  uint64_t ts = static_cast<uint64_t>(timestamps[0] + timestamps[1]);
+  EXPECT_TRUE(WithinOneMicrosecond(ts, 1045157, 725035));
+
+  EXPECT_EQ(comm(DecodeCompactColumn(compact.switch_prev_comm_index())[1]),
+            "sleep");
+  EXPECT_EQ(DecodeCompactColumn(compact.switch_prev_pid())[1], 3733);
+  EXPECT_EQ(DecodeCompactColumn(compact.switch_prev_prio())[1], 120);
+  EXPECT_EQ(comm(DecodeCompactColumn(compact.switch_next_comm_index())[1]),
+            "rcuop/0");
+  EXPECT_EQ(DecodeCompactColumn(compact.switch_next_pid())[1], 10);
+  EXPECT_EQ(DecodeCompactColumn(compact.switch_next_prio())[1], 120);
+  EXPECT_EQ(DecodeCompactColumn(compact.switch_prev_state()).size(), 6u);
+  EXPECT_FALSE(compact.has_waking_timestamp());
+
+  // Pids are still reported for the process scraping.
+  EXPECT_THAT(metadata.pids, Contains(3733));
+  EXPECT_THAT(metadata.pids, Contains(10));
+}
+
+TEST(CpuReaderTest, ParseSchedWakingCompact) {
+  ProtoTranslationTable* table =
+      GetTable("android_walleye_OPM5.171019.017.A1_4.4.88");
+  const CompactSchedWakingFormat& format =
+      table->compact_sched_format().sched_waking;
+  ASSERT_TRUE(format.event_id);
+
+  struct SchedWaking {
+    uint32_t time_delta;
+    int32_t common_pid;
+    const char* comm;
+    int32_t pid;
+    int32_t prio;
+    int32_t success;
+    int32_t target_cpu;
+  };
+  const SchedWaking kEvents[] = {
+      {0, 3733, "rcu_preempt", 7, 120, 1, 0},
+      {1000, 7, "sleep", 3733, 120, 1, 2},
+      {25, 3733, "rcu_preempt", 7, 98, 1, 1},
+  };
+
+  // See the sched_waking format in the walleye data: 8 bytes of common fields
+  // followed by comm[16], pid, prio, success and target_cpu.
+  const uint32_t kEventSize = 40;
+  BinaryWriter writer;
+  writer.Write<uint64_t>(1045157722134000);  // Page timestamp.
+  writer.Write<uint64_t>(3 * (4 + kEventSize));  // Page size.
+  for (const SchedWaking& event : kEvents) {
+    writer.Write<uint32_t>(event.time_delta << 5 | kEventSize / 4);
+    writer.Write<uint16_t>(format.event_id);  // common_type
+    writer.Write<uint8_t>(0);                 // common_flags
+    writer.Write<uint8_t>(0);                 // common_preempt_count
+    writer.Write<int32_t>(event.common_pid);
+    writer.WriteFixedString(16, event.comm);
+    writer.Write<int32_t>(event.pid);
+    writer.Write<int32_t>(event.prio);
+    writer.Write<int32_t>(event.success);
+    writer.Write<int32_t>(event.target_cpu);
+  }
+  std::unique_ptr<uint8_t[]> page(new uint8_t[base::kPageSize]());
+  memcpy(page.get(), writer.GetCopy().get(), writer.written());
+
+  EventFilter filter;
+  filter.AddEnabledEvent(
+      table->EventToFtraceId(GroupAndName("sched", "sched_waking")));
+
+  // The events parsed without the compact format are the reference.
+  BundleProvider expected_bundle_provider(base::kPageSize);
+  FtraceMetadata expected_metadata{};
+  ASSERT_TRUE(CpuReader::ParsePage(page.get(), &filter,
+                                   expected_bundle_provider.writer(), table,
+                                   &expected_metadata));
+  auto expected_bundle = expected_bundle_provider.ParseProto();
+  ASSERT_TRUE(expected_bundle);
+  ASSERT_EQ(expected_bundle->event().size(), 3);
+
+  BundleProvider bundle_provider(base::kPageSize);
+  FtraceMetadata metadata{};
+  CompactSchedBuffer compact_sched(&table->compact_sched_format());
+  ASSERT_TRUE(CpuReader::ParsePage(page.get(), &filter,
+                                   bundle_provider.writer(), table, &metadata,
+                                   &compact_sched));
+  compact_sched.WriteAndReset(bundle_provider.writer());
+  EXPECT_TRUE(compact_sched.empty());
+
+  auto bundle = bundle_provider.ParseProto();
+  ASSERT_TRUE(bundle);
+  EXPECT_EQ(bundle->event().size(), 0);
+  ASSERT_TRUE(bundle->has_compact_sched());
+  const auto& compact = bundle->compact_sched();
+  EXPECT_FALSE(compact.has_switch_timestamp());
+
+  std::vector<std::string> comms(compact.intern_table().begin(),
+                                 compact.intern_table().end());
+  EXPECT_EQ(comms.size(), 2u);
+  std::vector<int64_t> timestamps =
+      DecodeCompactColumn(compact.waking_timestamp());
+  std::vector<int64_t> common_pids =
+      DecodeCompactColumn(compact.waking_common_pid());
+  std::vector<int64_t> comm_indexes =
+      DecodeCompactColumn(compact.waking_comm_index());
+  std::vector<int64_t> pids = DecodeCompactColumn(compact.waking_pid());
+  std::vector<int64_t> prios = DecodeCompactColumn(compact.waking_prio());
+  std::vector<int64_t> successes =
+      DecodeCompactColumn(compact.waking_success());
+  std::vector<int64_t> target_cpus =
+      DecodeCompactColumn(compact.waking_target_cpu());
+  ASSERT_EQ(timestamps.size(), 3u);
+  ASSERT_EQ(common_pids.size(), 3u);
+  ASSERT_EQ(comm_indexes.size(), 3u);
+  ASSERT_EQ(pids.size(), 3u);
+  ASSERT_EQ(prios.size(), 3u);
+  ASSERT_EQ(successes.size(), 3u);
+  ASSERT_EQ(target_cpus.size(), 3u);
+
+  uint64_t ts = 0;
+  for (size_t i = 0; i < 3; i++) {
+    const protos::FtraceEvent& expected =
+        expected_bundle->event().Get(static_cast<int>(i));
+    ASSERT_TRUE(expected.has_sched_waking());
+    const protos::SchedWakingFtraceEvent& waking = expected.sched_waking();
+    ts += static_cast<uint64_t>(timestamps[i]);
+    EXPECT_EQ(ts, expected.timestamp());
+    EXPECT_EQ(common_pids[i], static_cast<int64_t>(expected.pid()));
+    EXPECT_EQ(comms.at(static_cast<size_t>(comm_indexes[i])), waking.comm());
+    EXPECT_EQ(pids[i], waking.pid());
+    EXPECT_EQ(prios[i], waking.prio());
+    EXPECT_EQ(successes[i], waking.success());
+    EXPECT_EQ(target_cpus[i], waking.target_cpu());
+  }
+  EXPECT_EQ(comms.at(static_cast<size_t>(comm_indexes[1])), "sleep");
+  EXPECT_EQ(pids[1], 3733);
+  EXPECT_EQ(target_cpus[1], 2);
+
+  // Pids are still reported for the process scraping.
+  EXPECT_THAT(metadata.pids, Contains(3733));
+  EXPECT_THAT(metadata.pids, Contains(7));
+}
+
 TEST_F(CpuReaderTableTest, ParseAllFields) {
   using FakeEventProvider =
       ProtoProvider<pbzero::FakeFtraceEvent, FakeFtraceEvent>;
@@ -1778,4 +1968,161 @@ TEST(CpuReaderTest, ParseExt4WithOverwrite) {
   EXPECT_EQ(metadata.overwrite_count, 192ul);
 }
 
+// Parses |page| with the table for the format files in |name| and with a
+// copy of it which has no specialized decoders, and checks that every event
+// comes out with the same bytes both ways. Returns the events in |bundle|.
+void ParseWithAndWithoutDecoders(
+    const std::string& name,
+    const uint8_t* page,
+    std::unique_ptr<protos::FtraceEventBundle>* bundle) {
+  const ProtoTranslationTable* table = GetTable(name);
+  ASSERT_TRUE(table);
+  FtraceProcfs ftrace("src/traced/probes/ftrace/test/data/" + name + "/");
+  auto interpreter_table = ProtoTranslationTable::Create(
+      &ftrace, GetStaticEventInfo(), GetStaticCommonFieldsInfo());
+  ASSERT_TRUE(interpreter_table);
+  interpreter_table->ClearEventDecodersForTesting();
+
+  EventFilter filter;
+  for (size_t id = 1; id <= table->largest_id(); id++)
+    filter.AddEnabledEvent(id);
+
+  BundleProvider bundle_provider(base::kPageSize);
+  FtraceMetadata metadata{};
+  ASSERT_TRUE(CpuReader::ParsePage(page, &filter, bundle_provider.writer(),
+                                   table, &metadata));
+  *bundle = bundle_provider.ParseProto();
+  ASSERT_TRUE(*bundle);
+
+  BundleProvider expected_bundle_provider(base::kPageSize);
+  FtraceMetadata expected_metadata{};
+  ASSERT_TRUE(CpuReader::ParsePage(page, &filter,
+                                   expected_bundle_provider.writer(),
+                                   interpreter_table.get(), &expected_metadata));
+  auto expected_bundle = expected_bundle_provider.ParseProto();
+  ASSERT_TRUE(expected_bundle);
+
+  ASSERT_EQ((*bundle)->event().size(), expected_bundle->event().size());
+  for (int i = 0; i < (*bundle)->event().size(); i++) {
+    EXPECT_EQ((*bundle)->event().Get(i).SerializeAsString(),
+              expected_bundle->event().Get(i).SerializeAsString())
+        << "event " << i;
+  }
+  EXPECT_EQ(metadata.pids, expected_metadata.pids);
+}
+
+TEST(CpuReaderTest, SpecializedDecodersMatchInterpreter) {
+  // sched_switch and print on a 64-bit kernel.
+  const ProtoTranslationTable* table = GetTable("synthetic");
+  ASSERT_TRUE(table);
+  ASSERT_TRUE(table->GetEventDecoder(
+      table->EventToFtraceId(GroupAndName("sched", "sched_switch"))));
+  ASSERT_TRUE(table->GetEventDecoder(
+      table->EventToFtraceId(GroupAndName("ftrace", "print"))));
+
+  const ExamplePage* pages[] = {&g_single_print, &g_three_prints,
+                                &g_six_sched_switch, &g_full_page_sched_switch};
+  for (const ExamplePage* test_case : pages) {
+    auto page = PageFromXxd(test_case->data);
+    std::unique_ptr<protos::FtraceEventBundle> bundle;
+    ASSERT_NO_FATAL_FAILURE(
+        ParseWithAndWithoutDecoders(test_case->name, page.get(), &bundle));
+    EXPECT_GT(bundle->event().size(), 0);
+  }
+}
+
+TEST(CpuReaderTest, SpecializedDecodersMatchInterpreter32Bit) {
+  // On this 32-bit kernel longs are 4 bytes, see the sched_switch and print
+  // formats in its data: these events use the SchedSwitch32 and Print32
+  // layouts.
+  const std::string kName = "android_seed_N2F62_3.10.49";
+  const ProtoTranslationTable* table = GetTable(kName);
+  ASSERT_TRUE(table);
+  auto id_of = [table](const char* group, const char* name) {
+    return static_cast<uint16_t>(
+        table->EventToFtraceId(GroupAndName(group, name)));
+  };
+  const uint16_t kSchedSwitchId = id_of("sched", "sched_switch");
+  const uint16_t kSchedWakeupId = id_of("sched", "sched_wakeup");
+  const uint16_t kCpuFrequencyId = id_of("power", "cpu_frequency");
+  const uint16_t kPrintId = id_of("ftrace", "print");
+  for (uint16_t id :
+       {kSchedSwitchId, kSchedWakeupId, kCpuFrequencyId, kPrintId}) {
+    ASSERT_TRUE(table->GetEventDecoder(id)) << "event " << id;
+  }
+
+  const uint32_t kSchedSwitchSize = 60;
+  const uint32_t kSchedWakeupSize = 40;
+  const uint32_t kCpuFrequencySize = 16;
+  const uint32_t kPrintSize = 28;  // 12 bytes of fields, buf and padding.
+  auto write_common = [](BinaryWriter* writer, uint32_t time_delta,
+                         uint32_t size, uint16_t id, int32_t pid) {
+    writer->Write<uint32_t>(time_delta << 5 | size / 4);
+    writer->Write<uint16_t>(id);  // common_type
+    writer->Write<uint8_t>(0);    // common_flags
+    writer->Write<uint8_t>(0);    // common_preempt_count
+    writer->Write<int32_t>(pid);  // common_pid
+  };
+
+  BinaryWriter writer;
+  writer.Write<uint64_t>(1045157722134000);  // Page timestamp.
+  writer.Write<uint64_t>(4 * 4 + kSchedSwitchSize + kSchedWakeupSize +
+                         kCpuFrequencySize + kPrintSize);  // Page size.
+
+  write_common(&writer, 0, kSchedSwitchSize, kSchedSwitchId, 3733);
+  writer.WriteFixedString(16, "rcu_preempt");
+  writer.Write<int32_t>(3733);  // prev_pid
+  writer.Write<int32_t>(120);   // prev_prio
+  writer.Write<int32_t>(1);     // prev_state, a 4 byte long.
+  writer.WriteFixedString(16, "sleep");
+  writer.Write<int32_t>(7);    // next_pid
+  writer.Write<int32_t>(98);   // next_prio
+
+  write_common(&writer, 100, kSchedWakeupSize, kSchedWakeupId, 7);
+  writer.WriteFixedString(16, "rcu_preempt");
+  writer.Write<int32_t>(3733);  // pid
+  writer.Write<int32_t>(120);   // prio
+  writer.Write<int32_t>(1);     // success
+  writer.Write<int32_t>(2);     // target_cpu
+
+  write_common(&writer, 100, kCpuFrequencySize, kCpuFrequencyId, 0);
+  writer.Write<uint32_t>(1900800);  // state
+  writer.Write<uint32_t>(3);        // cpu_id
+
+  write_common(&writer, 100, kPrintSize, kPrintId, 7);
+  writer.Write<uint32_t>(0xc0123456);  // ip, a 4 byte long.
+  writer.WriteFixedString(16, "hello world\n");
+
+  std::unique_ptr<uint8_t[]> page(new uint8_t[base::kPageSize]());
+  memcpy(page.get(), writer.GetCopy().get(), writer.written());
+
+  std::unique_ptr<protos::FtraceEventBundle> bundle;
+  ASSERT_NO_FATAL_FAILURE(
+      ParseWithAndWithoutDecoders(kName, page.get(), &bundle));
+  ASSERT_EQ(bundle->event().size(), 4);
+
+  const auto& sched_switch = bundle->event().Get(0).sched_switch();
+  EXPECT_EQ(bundle->event().Get(0).pid(), 3733u);
+  EXPECT_EQ(sched_switch.prev_comm(), "rcu_preempt");
+  EXPECT_EQ(sched_switch.prev_pid(), 3733);
+  EXPECT_EQ(sched_switch.prev_prio(), 120);
+  EXPECT_EQ(sched_switch.prev_state(), 1);
+  EXPECT_EQ(sched_switch.next_comm(), "sleep");
+  EXPECT_EQ(sched_switch.next_pid(), 7);
+  EXPECT_EQ(sched_switch.next_prio(), 98);
+
+  const auto& sched_wakeup = bundle->event().Get(1).sched_wakeup();
+  EXPECT_EQ(sched_wakeup.comm(), "rcu_preempt");
+  EXPECT_EQ(sched_wakeup.pid(), 3733);
+  EXPECT_EQ(sched_wakeup.target_cpu(), 2);
+
+  const auto& cpu_frequency = bundle->event().Get(2).cpu_frequency();
+  EXPECT_EQ(cpu_frequency.state(), 1900800u);
+  EXPECT_EQ(cpu_frequency.cpu_id(), 3u);
+
+  const auto& print = bundle->event().Get(3).print();
+  EXPECT_EQ(print.ip(), 0xc0123456u);
+  EXPECT_EQ(print.buf(), "hello world\n");
+}
+
 }  // namespace perfetto
@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/traced/probes/ftrace/event_decoders.h"
+
+#include "perfetto/base/logging.h"
+#include "perfetto/protozero/message.h"
+#include "src/traced/probes/ftrace/cpu_reader.h"
+#include "src/traced/probes/ftrace/ftrace_metadata.h"
+
+#include "perfetto/trace/ftrace/ftrace_event.pbzero.h"
+#include "perfetto/trace/ftrace/power.pbzero.h"
+#include "perfetto/trace/ftrace/print.pbzero.h"
+#include "perfetto/trace/ftrace/sched.pbzero.h"
+
+namespace perfetto {
+
+namespace {
+
+using protos::pbzero::CpuFrequencyFtraceEvent;
+using protos::pbzero::FtraceEvent;
+using protos::pbzero::PrintFtraceEvent;
+using protos::pbzero::SchedSwitchFtraceEvent;
+using protos::pbzero::SchedWakeupFtraceEvent;
+
+// The same as CpuReader::ParseField() with every Field member known at compile
+// time: the switch below is folded away and the reads have a constant size.
+// Only the strategies used by the layouts below are supported.
+template <uint16_t kOffset,
+          uint16_t kSize,
+          TranslationStrategy kStrategy,
+          uint32_t kProtoFieldId>
+struct FieldLayout {
+  static bool Matches(const Field& field) {
+    return field.ftrace_offset == kOffset && field.ftrace_size == kSize &&
+           field.strategy == kStrategy && field.proto_field_id == kProtoFieldId;
+  }
+
+  static bool Parse(const uint8_t* start,
+                    const uint8_t* end,
+                    protozero::Message* message,
+                    FtraceMetadata* metadata) {
+    PERFETTO_DCHECK(start + kOffset + kSize <= end);
+    const uint8_t* field_start = start + kOffset;
+    switch (kStrategy) {
+      case kUint32ToUint32:
+      case kUint32ToUint64:
+        CpuReader::ReadIntoVarInt<uint32_t>(field_start, kProtoFieldId,
+                                            message);
+        return true;
+      case kUint64ToUint64:
+        CpuReader::ReadIntoVarInt<uint64_t>(field_start, kProtoFieldId,
+                                            message);
+        return true;
+      case kInt32ToInt32:
+      case kInt32ToInt64:
+        CpuReader::ReadIntoVarInt<int32_t>(field_start, kProtoFieldId,
+                                           message);
+        return true;
+      case kInt64ToInt64:
+        CpuReader::ReadIntoVarInt<int64_t>(field_start, kProtoFieldId,
+                                           message);
+        return true;
+      case kFixedCStringToString:
+        return CpuReader::ReadIntoString(field_start, field_start + kSize,
+                                         kProtoFieldId, message);
+      case kCStringToString:
+        return CpuReader::ReadIntoString(field_start, end, kProtoFieldId,
+                                         message);
+      case kPid32ToInt32:
+      case kPid32ToInt64:
+        CpuReader::ReadPid(field_start, kProtoFieldId, message, metadata);
+        return true;
+      case kCommonPid32ToInt32:
+      case kCommonPid32ToInt64:
+        CpuReader::ReadCommonPid(field_start, kProtoFieldId, message,
+                                 metadata);
+        return true;
+      default:
+        break;
+    }
+    PERFETTO_FATAL("Unsupported strategy in a specialized decoder");
+  }
+};
+
+// A sequence of FieldLayouts, matched against and parsed in proto order (the
+// order of Event::fields).
+template <typename... Fields>
+struct FieldList;
+
+template <>
+struct FieldList<> {
+  static bool Matches(const Field*) { return true; }
+  static bool Parse(const uint8_t*,
+                    const uint8_t*,
+                    protozero::Message*,
+                    FtraceMetadata*) {
+    return true;
+  }
+};
+
+template <typename First, typename... Rest>
+struct FieldList<First, Rest...> {
+  static bool Matches(const Field* fields) {
+    return First::Matches(fields[0]) && FieldList<Rest...>::Matches(fields + 1);
+  }
+  static bool Parse(const uint8_t* start,
+                    const uint8_t* end,
+                    protozero::Message* message,
+                    FtraceMetadata* metadata) {
+    // Like ParseEvent(), keep going after a field fails to parse.
+    bool success = First::Parse(start, end, message, metadata);
+    success &= FieldList<Rest...>::Parse(start, end, message, metadata);
+    return success;
+  }
+};
+
+// The layout of the common fields we read: only common_pid, which has the
+// same offset on all the kernels we know of.
+using CommonFields = FieldList<
+    FieldLayout<4, 4, kCommonPid32ToInt32, FtraceEvent::kPidFieldNumber>>;
+constexpr size_t kNumCommonFields = 1;
+
+// The full layout of an event whose sub-message is field |kProtoFieldId| of
+// FtraceEvent.
+template <uint32_t kProtoFieldId, typename... Fields>
+struct EventLayout {
+  static bool Matches(const Event& event) {
+    return event.proto_field_id == kProtoFieldId &&
+           event.fields.size() == sizeof...(Fields) &&
+           FieldList<Fields...>::Matches(event.fields.data());
+  }
+
+  static bool Decode(const uint8_t* start,
+                     const uint8_t* end,
+                     protozero::Message* message,
+                     FtraceMetadata* metadata) {
+    bool success = CommonFields::Parse(start, end, message, metadata);
+    protozero::Message* nested =
+        message->BeginNestedMessage<protozero::Message>(kProtoFieldId);
+    success &= FieldList<Fields...>::Parse(start, end, nested, metadata);
+    return success;
+  }
+};
+
+// The layouts below are the ones in the format files of the kernels in
+// test/data. On 32-bit kernels longs are 4 bytes, which shifts the fields that
+// follow them.
+
+using SchedSwitch64 = EventLayout<
+    FtraceEvent::kSchedSwitchFieldNumber,
+    FieldLayout<8,
+                16,
+                kFixedCStringToString,
+                SchedSwitchFtraceEvent::kPrevCommFieldNumber>,
+    FieldLayout<24, 4, kPid32ToInt32, SchedSwitchFtraceEvent::kPrevPidFieldNumber>,
+    FieldLayout<28, 4, kInt32ToInt32, SchedSwitchFtraceEvent::kPrevPrioFieldNumber>,
+    FieldLayout<32,
+                8,
+                kInt64ToInt64,
+                SchedSwitchFtraceEvent::kPrevStateFieldNumber>,
+    FieldLayout<40,
+                16,
+                kFixedCStringToString,
+                SchedSwitchFtraceEvent::kNextCommFieldNumber>,
+    FieldLayout<56, 4, kPid32ToInt32, SchedSwitchFtraceEvent::kNextPidFieldNumber>,
+    FieldLayout<60,
+                4,
+                kInt32ToInt32,
+                SchedSwitchFtraceEvent::kNextPrioFieldNumber>>;
+
+using SchedSwitch32 = EventLayout<
+    FtraceEvent::kSchedSwitchFieldNumber,
+    FieldLayout<8,
+                16,
+                kFixedCStringToString,
+                SchedSwitchFtraceEvent::kPrevCommFieldNumber>,
+    FieldLayout<24, 4, kPid32ToInt32, SchedSwitchFtraceEvent::kPrevPidFieldNumber>,
+    FieldLayout<28, 4, kInt32ToInt32, SchedSwitchFtraceEvent::kPrevPrioFieldNumber>,
+    FieldLayout<32,
+                4,
+                kInt32ToInt64,
+                SchedSwitchFtraceEvent::kPrevStateFieldNumber>,
+    FieldLayout<36,
+                16,
+                kFixedCStringToString,
+                SchedSwitchFtraceEvent::kNextCommFieldNumber>,
+    FieldLayout<52, 4, kPid32ToInt32, SchedSwitchFtraceEvent::kNextPidFieldNumber>,
+    FieldLayout<56,
+                4,
+                kInt32ToInt32,
+                SchedSwitchFtraceEvent::kNextPrioFieldNumber>>;
+
+using SchedWakeup = EventLayout<
+    FtraceEvent::kSchedWakeupFieldNumber,
+    FieldLayout<8, 16, kFixedCStringToString, SchedWakeupFtraceEvent::kCommFieldNumber>,
+    FieldLayout<24, 4, kPid32ToInt32, SchedWakeupFtraceEvent::kPidFieldNumber>,
+    FieldLayout<28, 4, kInt32ToInt32, SchedWakeupFtraceEvent::kPrioFieldNumber>,
+    FieldLayout<32, 4, kInt32ToInt32, SchedWakeupFtraceEvent::kSuccessFieldNumber>,
+    FieldLayout<36,
+                4,
+                kInt32ToInt32,
+                SchedWakeupFtraceEvent::kTargetCpuFieldNumber>>;
+
+using CpuFrequency = EventLayout<
+    FtraceEvent::kCpuFrequencyFieldNumber,
+    FieldLayout<8, 4, kUint32ToUint32, CpuFrequencyFtraceEvent::kStateFieldNumber>,
+    FieldLayout<12, 4, kUint32ToUint32, CpuFrequencyFtraceEvent::kCpuIdFieldNumber>>;
+
+using Print64 = EventLayout<
+    FtraceEvent::kPrintFieldNumber,
+    FieldLayout<8, 8, kUint64ToUint64, PrintFtraceEvent::kIpFieldNumber>,
+    FieldLayout<16, 0, kCStringToString, PrintFtraceEvent::kBufFieldNumber>>;
+
+using Print32 = EventLayout<
+    FtraceEvent::kPrintFieldNumber,
+    FieldLayout<8, 4, kUint32ToUint64, PrintFtraceEvent::kIpFieldNumber>,
+    FieldLayout<12, 0, kCStringToString, PrintFtraceEvent::kBufFieldNumber>>;
+
+struct KnownLayout {
+  bool (*matches)(const Event&);
+  EventDecoder decoder;
+};
+
+const KnownLayout kKnownLayouts[] = {
+    {&SchedSwitch64::Matches, &SchedSwitch64::Decode},
+    {&SchedSwitch32::Matches, &SchedSwitch32::Decode},
+    {&SchedWakeup::Matches, &SchedWakeup::Decode},
+    {&CpuFrequency::Matches, &CpuFrequency::Decode},
+    {&Print64::Matches, &Print64::Decode},
+    {&Print32::Matches, &Print32::Decode},
+};
+
+}  // namespace
+
+EventDecoder FindEventDecoder(const Event& event,
+                              const std::vector<Field>& common_fields) {
+  if (common_fields.size() != kNumCommonFields ||
+      !CommonFields::Matches(common_fields.data())) {
+    return nullptr;
+  }
+  for (const KnownLayout& layout : kKnownLayouts) {
+    if (layout.matches(event))
+      return layout.decoder;
+  }
+  return nullptr;
+}
+
+}  // namespace perfetto
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACED_PROBES_FTRACE_EVENT_DECODERS_H_
+#define SRC_TRACED_PROBES_FTRACE_EVENT_DECODERS_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "src/traced/probes/ftrace/event_info_constants.h"
+
+namespace protozero {
+class Message;
+}  // namespace protozero
+
+namespace perfetto {
+
+struct FtraceMetadata;
+
+// Decodes the common fields and the fields of a single raw ftrace event
+// beginning at |start| into |message|, which is the FtraceEvent proto. It
+// behaves exactly like the field-by-field interpretation in
+// CpuReader::ParseEvent(), but for one binary layout fixed at compile time.
+// Doesn't finalize |message|.
+using EventDecoder = bool (*)(const uint8_t* start,
+                              const uint8_t* end,
+                              protozero::Message* message,
+                              FtraceMetadata* metadata);
+
+// Returns the decoder specialized for the binary layout of |event| (after its
+// fields have been merged with the kernel format file), or nullptr if the
+// layout reported by the kernel doesn't match any of the layouts known at
+// compile time. Only the hottest events (sched_switch, sched_wakeup,
+// cpu_frequency and print) have specialized decoders.
+EventDecoder FindEventDecoder(const Event& event,
+                              const std::vector<Field>& common_fields);
+
+}  // namespace perfetto
+
+#endif  // SRC_TRACED_PROBES_FTRACE_EVENT_DECODERS_H_
@@ -454,12 +454,16 @@ ProtoTranslationTable::ProtoTranslationTable(
       largest_id_(events_.size() - 1),
       common_fields_(std::move(common_fields)),
       ftrace_page_header_spec_(ftrace_page_header_spec) {
+  event_decoders_.resize(events_.size());
   for (const Event& event : events) {
+    event_decoders_[event.ftrace_event_id] =
+        FindEventDecoder(events_.at(event.ftrace_event_id), common_fields_);
     group_and_name_to_event_[GroupAndName(event.group, event.name)] =
         &events_.at(event.ftrace_event_id);
     name_to_events_[event.name].push_back(&events_.at(event.ftrace_event_id));
     group_to_events_[event.group].push_back(&events_.at(event.ftrace_event_id));
   }
+  compact_sched_format_ = ValidateFormatForCompactSched(events_, common_fields_);
 }
 
 const Event* ProtoTranslationTable::GetOrCreateEvent(
@@ -26,6 +26,8 @@
 #include <vector>
 
 #include "perfetto/base/scoped_file.h"
+#include "src/traced/probes/ftrace/compact_sched.h"
+#include "src/traced/probes/ftrace/event_decoders.h"
 #include "src/traced/probes/ftrace/event_info.h"
 #include "src/traced/probes/ftrace/format_parser.h"
 
@@ -119,6 +121,24 @@ class ProtoTranslationTable {
     return &events_.at(id);
   }
 
+  // Returns the decoder specialized for the layout of the event with ftrace id
+  // |id|, or nullptr if the event has to be interpreted field by field.
+  EventDecoder GetEventDecoder(size_t id) const {
+    if (id >= event_decoders_.size())
+      return nullptr;
+    return event_decoders_[id];
+  }
+
+  // Makes all the events go through the field by field interpretation, so
+  // that tests can compare its output with the specialized decoders'.
+  void ClearEventDecodersForTesting() {
+    event_decoders_.assign(event_decoders_.size(), nullptr);
+  }
+
+  const CompactSchedEventFormat& compact_sched_format() const {
+    return compact_sched_format_;
+  }
+
   size_t EventToFtraceId(const GroupAndName& group_and_name) const {
     if (!group_and_name_to_event_.count(group_and_name))
       return 0;
@@ -168,6 +188,10 @@ class ProtoTranslationTable {
   std::map<std::string, std::vector<const Event*>> name_to_events_;
   std::map<std::string, std::vector<const Event*>> group_to_events_;
   std::vector<Field> common_fields_;
+  // Indexed by ftrace event id, like |events_|. Events created later by
+  // GetOrCreateEvent() are generic and never have a specialized decoder.
+  std::vector<EventDecoder> event_decoders_;
+  CompactSchedEventFormat compact_sched_format_;
   FtracePageHeaderSpec ftrace_page_header_spec_{};
   std::set<std::string> interned_strings_;
 };
@@ -146,6 +146,43 @@ TEST(TranslationTableTest, Seed) {
   }
 }
 
+TEST(TranslationTableTest, EventDecoders) {
+  auto id_of = [](const ProtoTranslationTable& table, const char* group,
+                  const char* name) {
+    return table.EventToFtraceId(GroupAndName(group, name));
+  };
+
+  {
+    FtraceProcfs ftrace_procfs(
+        "src/traced/probes/ftrace/test/data/android_seed_N2F62_3.10.49/");
+    auto table = ProtoTranslationTable::Create(
+        &ftrace_procfs, GetStaticEventInfo(), GetStaticCommonFieldsInfo());
+    PERFETTO_CHECK(table);
+    EXPECT_TRUE(table->GetEventDecoder(id_of(*table, "sched", "sched_switch")));
+    EXPECT_TRUE(table->GetEventDecoder(id_of(*table, "sched", "sched_wakeup")));
+    EXPECT_TRUE(
+        table->GetEventDecoder(id_of(*table, "power", "cpu_frequency")));
+    EXPECT_TRUE(table->GetEventDecoder(id_of(*table, "ftrace", "print")));
+    EXPECT_FALSE(
+        table->GetEventDecoder(id_of(*table, "ext4", "ext4_da_write_begin")));
+    EXPECT_FALSE(table->GetEventDecoder(0));
+    EXPECT_FALSE(table->GetEventDecoder(table->largest_id() + 1));
+  }
+
+  {
+    // Events on this kernel have 4 more bytes of common fields, which shifts
+    // all the other fields: they are interpreted field by field.
+    FtraceProcfs ftrace_procfs(
+        "src/traced/probes/ftrace/test/data/android_hammerhead_MRA59G_3.4.0/");
+    auto table = ProtoTranslationTable::Create(
+        &ftrace_procfs, GetStaticEventInfo(), GetStaticCommonFieldsInfo());
+    PERFETTO_CHECK(table);
+    EXPECT_FALSE(
+        table->GetEventDecoder(id_of(*table, "sched", "sched_switch")));
+    EXPECT_FALSE(table->GetEventDecoder(id_of(*table, "ftrace", "print")));
+  }
+}
+
 TEST_P(TranslationTableCreationTest, Create) {
   MockFtraceProcfs ftrace;
   std::vector<Field> common_fields;
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/tracing/core/async_file_writer.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <tuple>
+
+#include "perfetto/base/build_config.h"
+#include "perfetto/base/file_utils.h"
+#include "perfetto/base/logging.h"
+#include "perfetto/base/utils.h"
+
+namespace perfetto {
+
+namespace {
+
+// Size of the staging buffer used with O_DIRECT.
+constexpr size_t kDirectIoBufSize = 256 * AsyncFileWriter::kDirectIoBlockSize;
+
+// Max number of batches kept around for reuse after being written.
+constexpr size_t kMaxFreeBatches = 4;
+
+bool SetDirectIo(int fd, bool enabled) {
+#if PERFETTO_BUILDFLAG(PERFETTO_OS_LINUX) || \
+    PERFETTO_BUILDFLAG(PERFETTO_OS_ANDROID)
+  int flags = fcntl(fd, F_GETFL);
+  if (flags < 0)
+    return false;
+  flags = enabled ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+  return fcntl(fd, F_SETFL, flags) == 0;
+#else
+  base::ignore_result(fd);
+  base::ignore_result(enabled);
+  return false;
+#endif
+}
+
+}  // namespace
+
+// static
+constexpr size_t AsyncFileWriter::kDirectIoBlockSize;
+
+AsyncFileWriter::AsyncFileWriter(int fd, const Options& options)
+    : fd_(fd), options_(options) {
+  if (options_.direct_io) {
+    // O_DIRECT requires the file offset to be aligned as well.
+    off_t offset = lseek(fd_, 0, SEEK_CUR);
+    if (offset < 0 || offset % kDirectIoBlockSize != 0 ||
+        !SetDirectIo(fd_, true)) {
+      PERFETTO_ELOG("O_DIRECT not supported for the trace file, ignoring");
+      options_.direct_io = false;
+    } else {
+      direct_io_buf_ = base::PagedMemory::Allocate(kDirectIoBufSize);
+    }
+  }
+  thread_ = std::thread(&AsyncFileWriter::ThreadMain, this);
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+size_t AsyncFileWriter::WritePackets(TracePacket* packets,
+                                     size_t num_packets) {
+  Batch batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_batches_.empty()) {
+      batch = std::move(free_batches_.back());
+      free_batches_.pop_back();
+    }
+  }
+
+  size_t batch_size = 0;
+  for (size_t i = 0; i < num_packets; i++) {
+    // The preamble takes at most 8 bytes (see TracePacket::preamble_).
+    batch_size += packets[i].size() + 8;
+  }
+  batch.reserve(batch_size);
+  for (size_t i = 0; i < num_packets; i++) {
+    TracePacket& packet = packets[i];
+    char* preamble;
+    size_t preamble_size;
+    std::tie(preamble, preamble_size) = packet.GetProtoPreamble();
+    batch.insert(batch.end(), preamble, preamble + preamble_size);
+    for (const Slice& slice : packet.slices()) {
+      const uint8_t* start = static_cast<const uint8_t*>(slice.start);
+      batch.insert(batch.end(), start, start + slice.size);
+    }
+  }
+
+  const size_t size = batch.size();
+  if (size == 0)
+    return 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued_bytes_ += size;
+    queue_.emplace_back(std::move(batch));
+  }
+  cv_.notify_one();
+  return size;
+}
+
+size_t AsyncFileWriter::queued_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queued_bytes_;
+}
+
+bool AsyncFileWriter::has_failed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return failed_;
+}
+
+void AsyncFileWriter::ThreadMain() {
+  for (;;) {
+    Batch batch;
+    bool failed;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return !queue_.empty() || quit_; });
+      if (queue_.empty())
+        break;  // |quit_| is set and all the batches have been written.
+      batch = std::move(queue_.front());
+      queue_.pop_front();
+      failed = failed_;
+    }
+
+    // Keep dropping batches once a write failed, the service will stop
+    // queuing new ones as soon as it notices.
+    bool success = !failed && WriteBatch(batch);
+    if (success && options_.sync_every_batch)
+      success = base::FlushFile(fd_);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!success && !failed) {
+      PERFETTO_PLOG("Failed to write into the trace file");
+      failed_ = true;
+    }
+    queued_bytes_ -= batch.size();
+    if (free_batches_.size() < kMaxFreeBatches) {
+      batch.clear();
+      free_batches_.emplace_back(std::move(batch));
+    }
+  }
+
+  if (options_.direct_io && !FlushDirectIoTail()) {
+    PERFETTO_PLOG("Failed to write into the trace file");
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_ = true;
+  }
+}
+
+bool AsyncFileWriter::WriteBatch(const Batch& batch) {
+  if (options_.direct_io)
+    return WriteDirect(batch.data(), batch.size());
+  ssize_t wr_size = base::WriteAll(fd_, batch.data(), batch.size());
+  return wr_size == static_cast<ssize_t>(batch.size());
+}
+
+bool AsyncFileWriter::WriteDirect(const uint8_t* data, size_t size) {
+  uint8_t* buf = static_cast<uint8_t*>(direct_io_buf_.Get());
+  while (size > 0) {
+    size_t copy_size = std::min(size, kDirectIoBufSize - direct_io_buf_used_);
+    memcpy(buf + direct_io_buf_used_, data, copy_size);
+    direct_io_buf_used_ += copy_size;
+    data += copy_size;
+    size -= copy_size;
+
+    // Write all the full blocks and move the partial one, if any, to the
+    // beginning of the buffer.
+    size_t aligned_size =
+        direct_io_buf_used_ - direct_io_buf_used_ % kDirectIoBlockSize;
+    if (aligned_size == 0)
+      continue;
+    ssize_t wr_size = base::WriteAll(fd_, buf, aligned_size);
+    if (wr_size != static_cast<ssize_t>(aligned_size))
+      return false;
+    direct_io_buf_used_ -= aligned_size;
+    memmove(buf, buf + aligned_size, direct_io_buf_used_);
+  }
+  return true;
+}
+
+// The last partial block can't be written with O_DIRECT. Switch back to
+// buffered writes for it.
+bool AsyncFileWriter::FlushDirectIoTail() {
+  if (!SetDirectIo(fd_, false))
+    return false;
+  if (direct_io_buf_used_ == 0)
+    return true;
+  ssize_t wr_size =
+      base::WriteAll(fd_, direct_io_buf_.Get(), direct_io_buf_used_);
+  bool success = wr_size == static_cast<ssize_t>(direct_io_buf_used_);
+  direct_io_buf_used_ = 0;
+  return success;
+}
+
+}  // namespace perfetto
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACING_CORE_ASYNC_FILE_WRITER_H_
+#define SRC_TRACING_CORE_ASYNC_FILE_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "perfetto/base/paged_memory.h"
+#include "perfetto/tracing/core/trace_packet.h"
+
+namespace perfetto {
+
+// Writes trace packets into a file from a dedicated thread, on behalf of
+// TracingServiceImpl for write_into_file sessions. The packets are copied into
+// a batch, so that their slices (which point into the TraceBuffer) can be
+// released right away, and queued to the writer thread. The caller is expected
+// to stop queuing batches while is_queue_full().
+//
+// The file descriptor is not owned and must outlive this object.
+class AsyncFileWriter {
+ public:
+  struct Options {
+    // Max size of the queued batches before is_queue_full() returns true.
+    size_t max_queued_bytes = 16 * 1024 * 1024;
+
+    // Writes the file with O_DIRECT, in blocks of kDirectIoBlockSize bytes.
+    // Falls back to buffered writes if O_DIRECT is not supported.
+    bool direct_io = false;
+
+    // fdatasync() the file after writing each batch.
+    bool sync_every_batch = false;
+  };
+
+  // Alignment (of both memory and file offset) and granularity of writes
+  // with O_DIRECT.
+  static constexpr size_t kDirectIoBlockSize = 4096;
+
+  AsyncFileWriter(int fd, const Options&);
+
+  // Waits for all the queued batches to be written before returning. Doesn't
+  // close nor fdatasync() the file.
+  ~AsyncFileWriter();
+
+  // Encodes the packets as a root trace.proto message (each of them prefixed by
+  // its preamble, as in TracePacket::GetProtoPreamble()) into a new batch and
+  // queues it to the writer thread. Returns the size of the batch.
+  size_t WritePackets(TracePacket* packets, size_t num_packets);
+
+  size_t queued_bytes() const;
+
+  bool is_queue_full() const {
+    return queued_bytes() >= options_.max_queued_bytes;
+  }
+
+  // True if a write failed. Batches queued after a failure are dropped.
+  bool has_failed() const;
+
+  bool direct_io() const { return options_.direct_io; }
+
+ private:
+  AsyncFileWriter(const AsyncFileWriter&) = delete;
+  AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+  using Batch = std::vector<uint8_t>;
+
+  // Writer thread methods.
+  void ThreadMain();
+  bool WriteBatch(const Batch&);
+  bool WriteDirect(const uint8_t* data, size_t size);
+  bool FlushDirectIoTail();
+
+  const int fd_;
+  Options options_;
+
+  // Only accessed on the writer thread. With O_DIRECT, data is staged into
+  // this aligned buffer and written in blocks of kDirectIoBlockSize.
+  base::PagedMemory direct_io_buf_;
+  size_t direct_io_buf_used_ = 0;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+
+  // All the fields below are protected by |mutex_|.
+  std::deque<Batch> queue_;
+  std::vector<Batch> free_batches_;  // Recycled to avoid reallocations.
+  size_t queued_bytes_ = 0;
+  bool failed_ = false;
+  bool quit_ = false;
+
+  std::thread thread_;  // Keep last, starts running in the constructor.
+};
+
+}  // namespace perfetto
+
+#endif  // SRC_TRACING_CORE_ASYNC_FILE_WRITER_H_
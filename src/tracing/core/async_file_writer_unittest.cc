@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/tracing/core/async_file_writer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "perfetto/base/file_utils.h"
+#include "perfetto/base/scoped_file.h"
+#include "perfetto/base/temp_file.h"
+
+namespace perfetto {
+namespace {
+
+// Returns |num_packets| packets made of two slices each, backed by |storage|.
+std::vector<TracePacket> CreatePackets(size_t num_packets,
+                                       std::vector<std::string>* storage) {
+  std::vector<TracePacket> packets;
+  for (size_t i = 0; i < num_packets; i++) {
+    storage->emplace_back(i * 37 % 300 + 1, static_cast<char>('a' + i % 26));
+    storage->emplace_back(i % 7 + 1, static_cast<char>('A' + i % 26));
+  }
+  for (size_t i = 0; i < num_packets; i++) {
+    packets.emplace_back();
+    for (size_t j = 0; j < 2; j++) {
+      const std::string& str = (*storage)[i * 2 + j];
+      packets.back().AddSlice(str.data(), str.size());
+    }
+  }
+  return packets;
+}
+
+// Encodes the packets as written into the file by the service.
+std::string Serialize(std::vector<TracePacket>* packets) {
+  std::string res;
+  for (TracePacket& packet : *packets) {
+    char* preamble;
+    size_t preamble_size;
+    std::tie(preamble, preamble_size) = packet.GetProtoPreamble();
+    res.append(preamble, preamble_size);
+    for (const Slice& slice : packet.slices())
+      res.append(static_cast<const char*>(slice.start), slice.size);
+  }
+  return res;
+}
+
+void WriteAndCheck(const AsyncFileWriter::Options& options) {
+  base::TempFile tmp_file = base::TempFile::Create();
+  std::vector<std::string> storage;
+  std::vector<TracePacket> packets = CreatePackets(1000, &storage);
+  {
+    AsyncFileWriter writer(tmp_file.fd(), options);
+    // Queue the packets in batches of different sizes.
+    size_t i = 0;
+    for (size_t batch_size = 1; i < packets.size(); batch_size *= 2) {
+      batch_size = std::min(batch_size, packets.size() - i);
+      EXPECT_GT(writer.WritePackets(&packets[i], batch_size), 0u);
+      i += batch_size;
+    }
+  }
+  std::string contents;
+  ASSERT_TRUE(base::ReadFile(tmp_file.path(), &contents));
+  EXPECT_EQ(Serialize(&packets), contents);
+}
+
+TEST(AsyncFileWriterTest, Write) {
+  WriteAndCheck(AsyncFileWriter::Options());
+}
+
+TEST(AsyncFileWriterTest, WriteAndSyncEveryBatch) {
+  AsyncFileWriter::Options options;
+  options.sync_every_batch = true;
+  WriteAndCheck(options);
+}
+
+// O_DIRECT might not be supported by the filesystem of the temp file, in
+// which case this tests the fallback to buffered writes.
+TEST(AsyncFileWriterTest, WriteDirectIo) {
+  AsyncFileWriter::Options options;
+  options.direct_io = true;
+  WriteAndCheck(options);
+}
+
+TEST(AsyncFileWriterTest, QueueFull) {
+  base::TempFile tmp_file = base::TempFile::Create();
+  std::vector<std::string> storage;
+  std::vector<TracePacket> packets = CreatePackets(1, &storage);
+  AsyncFileWriter::Options options;
+  options.max_queued_bytes = 0;
+  AsyncFileWriter writer(tmp_file.fd(), options);
+  EXPECT_TRUE(writer.is_queue_full());
+  EXPECT_EQ(0u, writer.WritePackets(packets.data(), 0));
+}
+
+TEST(AsyncFileWriterTest, WriteFailure) {
+  base::ScopedFile fd(open("/dev/null", O_RDONLY));
+  ASSERT_TRUE(fd);
+  std::vector<std::string> storage;
+  std::vector<TracePacket> packets = CreatePackets(10, &storage);
+  AsyncFileWriter writer(*fd, AsyncFileWriter::Options());
+  ASSERT_GT(writer.WritePackets(packets.data(), packets.size()), 0u);
+  for (int i = 0; i < 1000 && !writer.has_failed(); i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_TRUE(writer.has_failed());
+}
+
+}  // namespace
+}  // namespace perfetto
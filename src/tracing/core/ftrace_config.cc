@@ -45,7 +45,8 @@ bool FtraceConfig::operator==(const FtraceConfig& other) const {
          (atrace_categories_ == other.atrace_categories_) &&
          (atrace_apps_ == other.atrace_apps_) &&
          (buffer_size_kb_ == other.buffer_size_kb_) &&
-         (drain_period_ms_ == other.drain_period_ms_);
+         (drain_period_ms_ == other.drain_period_ms_) &&
+         (compact_sched_ == other.compact_sched_);
 }
 #pragma GCC diagnostic pop
 
@@ -88,6 +89,10 @@ void FtraceConfig::FromProto(const perfetto::protos::FtraceConfig& proto) {
                 "size mismatch");
   drain_period_ms_ =
       static_cast<decltype(drain_period_ms_)>(proto.drain_period_ms());
+
+  static_assert(sizeof(compact_sched_) == sizeof(proto.compact_sched()),
+                "size mismatch");
+  compact_sched_ = static_cast<decltype(compact_sched_)>(proto.compact_sched());
   unknown_fields_ = proto.unknown_fields();
 }
 
@@ -122,6 +127,11 @@ void FtraceConfig::ToProto(perfetto::protos::FtraceConfig* proto) const {
                 "size mismatch");
   proto->set_drain_period_ms(
       static_cast<decltype(proto->drain_period_ms())>(drain_period_ms_));
+
+  static_assert(sizeof(compact_sched_) == sizeof(proto->compact_sched()),
+                "size mismatch");
+  proto->set_compact_sched(
+      static_cast<decltype(proto->compact_sched())>(compact_sched_));
   *(proto->mutable_unknown_fields()) = unknown_fields_;
 }
 
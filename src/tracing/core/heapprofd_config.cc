@@ -154,7 +154,8 @@ operator=(HeapprofdConfig::ContinuousDumpConfig&&) = default;
 bool HeapprofdConfig::ContinuousDumpConfig::operator==(
     const HeapprofdConfig::ContinuousDumpConfig& other) const {
   return (dump_phase_ms_ == other.dump_phase_ms_) &&
-         (dump_interval_ms_ == other.dump_interval_ms_);
+         (dump_interval_ms_ == other.dump_interval_ms_) &&
+         (incremental_ == other.incremental_);
 }
 #pragma GCC diagnostic pop
 
@@ -168,6 +169,10 @@ void HeapprofdConfig::ContinuousDumpConfig::FromProto(
                 "size mismatch");
   dump_interval_ms_ =
       static_cast<decltype(dump_interval_ms_)>(proto.dump_interval_ms());
+
+  static_assert(sizeof(incremental_) == sizeof(proto.incremental()),
+                "size mismatch");
+  incremental_ = static_cast<decltype(incremental_)>(proto.incremental());
   unknown_fields_ = proto.unknown_fields();
 }
 
@@ -184,6 +189,11 @@ void HeapprofdConfig::ContinuousDumpConfig::ToProto(
                 "size mismatch");
   proto->set_dump_interval_ms(
       static_cast<decltype(proto->dump_interval_ms())>(dump_interval_ms_));
+
+  static_assert(sizeof(incremental_) == sizeof(proto->incremental()),
+                "size mismatch");
+  proto->set_incremental(
+      static_cast<decltype(proto->incremental())>(incremental_));
   *(proto->mutable_unknown_fields()) = unknown_fields_;
 }
 
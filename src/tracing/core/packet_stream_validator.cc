@@ -57,6 +57,10 @@ bool PacketStreamValidator::Validate(const Slices& slices) {
   if (!packet.synchronization_marker().empty())
     return false;
 
+  // Compressed packets would allow to smuggle packets with trusted fields.
+  if (!packet.compressed_packets().empty())
+    return false;
+
   // We are deliberately not checking for clock_snapshot for the moment. It's
   // unclear if we want to allow producers to snapshot their clocks. Ideally we
   // want a security model where producers can only snapshot their own clocks
@@ -171,5 +171,15 @@ TEST(PacketStreamValidatorTest, TrailingGarbage) {
   EXPECT_FALSE(PacketStreamValidator::Validate(seq));
 }
 
+TEST(PacketStreamValidatorTest, CompressedPackets) {
+  protos::TracePacket proto;
+  proto.set_compressed_packets("not really compressed");
+  std::string ser_buf = proto.SerializeAsString();
+
+  Slices seq;
+  seq.emplace_back(&ser_buf[0], ser_buf.size());
+  EXPECT_FALSE(PacketStreamValidator::Validate(seq));
+}
+
 }  // namespace
 }  // namespace perfetto
@@ -56,8 +56,19 @@ SharedMemoryArbiterImpl::SharedMemoryArbiterImpl(
     : task_runner_(task_runner),
       producer_endpoint_(producer_endpoint),
       shmem_abi_(reinterpret_cast<uint8_t*>(start), size, page_size),
+      writer_page_hints_(new std::atomic<uint32_t>[kMaxWriterID + 1]),
       active_writer_ids_(kMaxWriterID),
-      weak_ptr_factory_(this) {}
+      weak_ptr_factory_(this) {
+  // WriterIDs are allocated sequentially starting from 1, so scatter them over
+  // the SMB with Fibonacci hashing. The first writer starts from page 0.
+  const uint64_t num_pages = shmem_abi_.num_pages();
+  writer_page_hints_[0].store(0, std::memory_order_relaxed);
+  for (uint32_t id = 1; id <= kMaxWriterID; id++) {
+    const uint64_t hash = static_cast<uint32_t>((id - 1) * 0x9E3779B9u);
+    const auto page_idx = static_cast<uint32_t>((hash * num_pages) >> 32);
+    writer_page_hints_[id].store(page_idx, std::memory_order_relaxed);
+  }
+}
 
 Chunk SharedMemoryArbiterImpl::GetNewChunk(
     const SharedMemoryABI::ChunkHeader& header,
@@ -68,48 +79,53 @@ Chunk SharedMemoryArbiterImpl::GetNewChunk(
   static const unsigned kMaxStallIntervalUs = 100000;
   static const int kLogAfterNStalls = 3;
 
-  for (;;) {
-    // TODO(primiano): Probably this lock is not really required and this code
-    // could be rewritten leveraging only the Try* atomic operations in
-    // SharedMemoryABI. But let's not be too adventurous for the moment.
-    {
-      std::lock_guard<std::mutex> scoped_lock(lock_);
-      const size_t initial_page_idx = page_idx_;
-      for (size_t i = 0; i < shmem_abi_.num_pages(); i++) {
-        page_idx_ = (initial_page_idx + i) % shmem_abi_.num_pages();
-        bool is_new_page = false;
-
-        // TODO(primiano): make the page layout dynamic.
-        auto layout = SharedMemoryArbiterImpl::default_page_layout;
+  const WriterID writer_id = header.writer_id.load(std::memory_order_relaxed);
+  PERFETTO_DCHECK(writer_id <= kMaxWriterID);
+  std::atomic<uint32_t>* page_hint = &writer_page_hints_[writer_id];
+  const size_t num_pages = shmem_abi_.num_pages();
 
-        if (shmem_abi_.is_page_free(page_idx_)) {
-          // TODO(primiano): Use the |size_hint| here to decide the layout.
-          is_new_page = shmem_abi_.TryPartitionPage(page_idx_, layout);
-        }
-        uint32_t free_chunks;
-        if (is_new_page) {
-          free_chunks = (1 << SharedMemoryABI::kNumChunksForLayout[layout]) - 1;
-        } else {
-          free_chunks = shmem_abi_.GetFreeChunks(page_idx_);
-        }
+  for (;;) {
+    // No lock is required here: partitioning a page and acquiring a chunk are
+    // compare-and-swap operations on the page layout word, so concurrent
+    // writers racing on the same chunk will see all but one Try*() fail.
+    const size_t initial_page_idx =
+        page_hint->load(std::memory_order_relaxed) % num_pages;
+    for (size_t i = 0; i < num_pages; i++) {
+      const size_t page_idx = (initial_page_idx + i) % num_pages;
+      bool is_new_page = false;
+
+      // TODO(primiano): make the page layout dynamic.
+      auto layout = SharedMemoryArbiterImpl::default_page_layout;
+
+      if (shmem_abi_.is_page_free(page_idx)) {
+        // TODO(primiano): Use the |size_hint| here to decide the layout.
+        is_new_page = shmem_abi_.TryPartitionPage(page_idx, layout);
+      }
+      uint32_t free_chunks;
+      if (is_new_page) {
+        free_chunks = (1 << SharedMemoryABI::kNumChunksForLayout[layout]) - 1;
+      } else {
+        free_chunks = shmem_abi_.GetFreeChunks(page_idx);
+      }
 
-        for (uint32_t chunk_idx = 0; free_chunks;
-             chunk_idx++, free_chunks >>= 1) {
-          if (!(free_chunks & 1))
-            continue;
-          // We found a free chunk.
-          Chunk chunk = shmem_abi_.TryAcquireChunkForWriting(
-              page_idx_, chunk_idx, &header);
-          if (!chunk.is_valid())
-            continue;
-          if (stall_count > kLogAfterNStalls) {
-            PERFETTO_LOG("Recovered from stall after %d iterations",
-                         stall_count);
-          }
-          return chunk;
+      for (uint32_t chunk_idx = 0; free_chunks;
+           chunk_idx++, free_chunks >>= 1) {
+        if (!(free_chunks & 1))
+          continue;
+        // We found a free chunk.
+        Chunk chunk =
+            shmem_abi_.TryAcquireChunkForWriting(page_idx, chunk_idx, &header);
+        if (!chunk.is_valid())
+          continue;
+        page_hint->store(static_cast<uint32_t>(page_idx),
+                         std::memory_order_relaxed);
+        if (stall_count > kLogAfterNStalls) {
+          PERFETTO_LOG("Recovered from stall after %d iterations",
+                       stall_count);
         }
+        return chunk;
       }
-    }  // std::lock_guard<std::mutex>
+    }
 
     // All chunks are taken (either kBeingWritten by us or kBeingRead by the
     // Service). TODO: at this point we should return a bankrupcy chunk, not
@@ -155,6 +171,21 @@ void SharedMemoryArbiterImpl::UpdateCommitDataRequest(Chunk chunk,
                                                       BufferID target_buffer,
                                                       PatchList* patch_list) {
   // Note: chunk will be invalid if the call came from SendPatches().
+  // Mark the chunk as complete before taking the lock, the state transition is
+  // atomic and doesn't need to be serialized with the other writers. The chunk
+  // must be complete before it's added to |commit_data_req_|, otherwise another
+  // thread could send the request to the service before the transition.
+  size_t page_idx = SharedMemoryABI::kInvalidPageIdx;
+  uint8_t chunk_idx = 0;
+  size_t chunk_size = 0;
+  if (chunk.is_valid()) {
+    PERFETTO_DCHECK(chunk.writer_id() == writer_id);
+    chunk_idx = chunk.chunk_idx();
+    chunk_size = chunk.size();
+    page_idx = shmem_abi_.ReleaseChunkAsComplete(std::move(chunk));
+    // DO NOT access |chunk| after this point, has been std::move()-d above.
+  }
+
   bool should_post_callback = false;
   bool should_commit_synchronously = false;
   base::WeakPtr<SharedMemoryArbiterImpl> weak_this;
@@ -167,15 +198,9 @@ void SharedMemoryArbiterImpl::UpdateCommitDataRequest(Chunk chunk,
       should_post_callback = true;
     }
 
-    // If a valid chunk is specified, return it and attach it to the request.
-    if (chunk.is_valid()) {
-      PERFETTO_DCHECK(chunk.writer_id() == writer_id);
-      uint8_t chunk_idx = chunk.chunk_idx();
-      bytes_pending_commit_ += chunk.size();
-      size_t page_idx = shmem_abi_.ReleaseChunkAsComplete(std::move(chunk));
-
-      // DO NOT access |chunk| after this point, has been std::move()-d above.
-
+    // If a valid chunk was specified, attach it to the request.
+    if (page_idx != SharedMemoryABI::kInvalidPageIdx) {
+      bytes_pending_commit_ += chunk_size;
       CommitDataRequest::ChunksToMove* ctm =
           commit_data_req_->add_chunks_to_move();
       ctm->set_page(static_cast<uint32_t>(page_idx));
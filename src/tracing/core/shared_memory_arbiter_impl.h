@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -45,9 +46,14 @@ class TaskRunner;
 // This class handles the shared memory buffer on the producer side. It is used
 // to obtain thread-local chunks and to partition pages from several threads.
 // There is one arbiter instance per Producer.
-// This class is thread-safe and uses locks to do so. Data sources are supposed
-// to interact with this sporadically, only when they run out of space on their
-// current thread-local chunk.
+// This class is thread-safe. Acquiring a chunk doesn't take any lock: it relies
+// only on the atomic page layout words of the SharedMemoryABI, and each writer
+// starts scanning the SMB from its own page, to keep concurrent writers from
+// contending on the same pages. Returning a chunk takes a short lock to append
+// it to the pending CommitDataRequest, which is batched and sent to the service
+// in a single task. Data sources are supposed to interact with this
+// sporadically, only when they run out of space on their current thread-local
+// chunk.
 class SharedMemoryArbiterImpl : public SharedMemoryArbiter {
  public:
   // Args:
@@ -131,10 +137,17 @@ class SharedMemoryArbiterImpl : public SharedMemoryArbiter {
   base::TaskRunner* const task_runner_;
   TracingService::ProducerEndpoint* const producer_endpoint_;
 
+  // Thread-safe, all the state transitions of the chunks are atomic.
+  SharedMemoryABI shmem_abi_;
+
+  // Index of the page where each WriterID got its last chunk from, which is
+  // where GetNewChunk() starts looking for the next one. Initially the writers
+  // are spread evenly over the SMB. Accessed without the lock, it's only a
+  // hint.
+  std::unique_ptr<std::atomic<uint32_t>[]> writer_page_hints_;
+
   // --- Begin lock-protected members ---
   std::mutex lock_;
-  SharedMemoryABI shmem_abi_;
-  size_t page_idx_ = 0;
   std::unique_ptr<CommitDataRequest> commit_data_req_;
   size_t bytes_pending_commit_ = 0;  // SUM(chunk.size() : commit_data_req_).
   IdAllocator<WriterID> active_writer_ids_;
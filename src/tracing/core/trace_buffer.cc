@@ -16,6 +16,7 @@
 
 #include "src/tracing/core/trace_buffer.h"
 
+#include <algorithm>
 #include <limits>
 
 #include "perfetto/base/logging.h"
@@ -94,9 +95,8 @@ bool TraceBuffer::Initialize(size_t size) {
   stats_.set_buffer_size(size);
   max_chunk_size_ = std::min(size, ChunkRecord::kMaxSize);
   wptr_ = begin();
-  index_.clear();
-  last_chunk_id_written_.clear();
-  read_iter_ = GetReadIterForSequence(index_.end());
+  sequences_.clear();
+  read_iter_ = GetReadIterForSequence(0);
   return true;
 }
 
@@ -146,14 +146,17 @@ void TraceBuffer::CopyChunkUntrusted(ProducerID producer_id_trusted,
   record.flags = chunk_flags;
   ChunkMeta::Key key(record);
 
+  // Sequences are never removed from |sequences_|, so |seq| stays valid until
+  // the end of this function.
+  SequenceIndex* seq = GetOrCreateSequence(producer_id_trusted, writer_id);
+
   // Check whether we have already copied the same chunk previously. This may
   // happen if the service scrapes chunks in a potentially incomplete state
   // before receiving commit requests for them from the producer. Note that the
   // service may scrape and thus override chunks in arbitrary order since the
   // chunks aren't ordered in the SMB.
-  const auto it = index_.find(key);
-  if (PERFETTO_UNLIKELY(it != index_.end())) {
-    ChunkMeta* record_meta = &it->second;
+  ChunkMeta* record_meta = seq->Find(chunk_id);
+  if (PERFETTO_UNLIKELY(record_meta)) {
     ChunkRecord* prev = record_meta->chunk_record;
 
     // Verify that the old chunk's metadata corresponds to the new one.
@@ -174,13 +177,10 @@ void TraceBuffer::CopyChunkUntrusted(ProducerID producer_id_trusted,
     // chunk N after having read from chunk N+1, thereby violating sequential
     // read of packets. This shouldn't happen if the producer is well-behaved,
     // because it shouldn't start chunk N+1 before completing chunk N.
-    ChunkMeta::Key subsequent_key = key;
     static_assert(std::numeric_limits<ChunkID>::max() == kMaxChunkID,
                   "ChunkID wraps");
-    subsequent_key.chunk_id++;
-    const auto subsequent_it = index_.find(subsequent_key);
-    if (subsequent_it != index_.end() &&
-        subsequent_it->second.num_fragments_read > 0) {
+    const ChunkMeta* subsequent_meta = seq->Find(chunk_id + 1);
+    if (subsequent_meta && subsequent_meta->num_fragments_read > 0) {
       stats_.set_abi_violations(stats_.abi_violations() + 1);
       PERFETTO_DCHECK(suppress_sanity_dchecks_for_testing_);
       return;
@@ -268,10 +268,8 @@ void TraceBuffer::CopyChunkUntrusted(ProducerID producer_id_trusted,
   // Now first insert the new chunk. At the end, if necessary, add the padding.
   stats_.set_chunks_written(stats_.chunks_written() + 1);
   stats_.set_bytes_written(stats_.bytes_written() + record_size);
-  auto it_and_inserted = index_.emplace(
-      key, ChunkMeta(GetChunkRecordAt(wptr_), num_fragments, chunk_complete,
-                     chunk_flags, producer_uid_trusted));
-  PERFETTO_DCHECK(it_and_inserted.second);
+  seq->Insert(ChunkMeta(GetChunkRecordAt(wptr_), chunk_id, num_fragments,
+                        chunk_complete, chunk_flags, producer_uid_trusted));
   TRACE_BUFFER_DLOG("  copying @ [%lu - %lu] %zu", wptr_ - begin(),
                     uintptr_t(wptr_ - begin()) + record_size, record_size);
   WriteChunkRecord(wptr_, record, src, size);
@@ -296,8 +294,7 @@ void TraceBuffer::CopyChunkUntrusted(ProducerID producer_id_trusted,
   // last_chunk_id shouldn't be updated even though it's larger (e.g. |chunk_id|
   // = kMaxChunkId and |last_chunk_id| = 1; chunk_id - last_chunk_id =
   // kMaxChunkId - 1).
-  auto producer_and_writer_id = std::make_pair(producer_id_trusted, writer_id);
-  ChunkID& last_chunk_id = last_chunk_id_written_[producer_and_writer_id];
+  ChunkID& last_chunk_id = seq->last_chunk_id_written;
   static_assert(std::numeric_limits<ChunkID>::max() == kMaxChunkID,
                 "This code assumes that ChunkID wraps at kMaxChunkID");
   if (chunk_id - last_chunk_id < kMaxChunkID / 2) {
@@ -322,7 +319,6 @@ ssize_t TraceBuffer::DeleteNextChunksFor(size_t bytes_to_clear) {
   TRACE_BUFFER_DLOG("Delete [%zu %zu]", wptr_ - begin(), search_end - begin());
   DcheckIsAlignedAndWithinBounds(wptr_);
   PERFETTO_DCHECK(search_end <= end());
-  std::vector<ChunkMap::iterator> index_delete;
   uint64_t chunks_overwritten = stats_.chunks_overwritten();
   uint64_t bytes_overwritten = stats_.bytes_overwritten();
   uint64_t padding_bytes_cleared = stats_.padding_bytes_cleared();
@@ -344,29 +340,26 @@ ssize_t TraceBuffer::DeleteNextChunksFor(size_t bytes_to_clear) {
       return 0;
     }
 
-    // Remove |next_chunk| from the index, unless it's a padding record (padding
-    // records are not part of the index).
+    // |next_chunk| will be removed from the index below, unless it's a padding
+    // record (padding records are not part of the index).
     if (PERFETTO_LIKELY(!next_chunk.is_padding)) {
-      ChunkMeta::Key key(next_chunk);
-      auto it = index_.find(key);
-      bool will_remove = false;
-      if (PERFETTO_LIKELY(it != index_.end())) {
-        const ChunkMeta& meta = it->second;
-        if (PERFETTO_UNLIKELY(meta.num_fragments_read < meta.num_fragments)) {
+      SequenceIndex* seq =
+          FindSequence(next_chunk.producer_id, next_chunk.writer_id);
+      const ChunkMeta* meta = seq ? seq->Find(next_chunk.chunk_id) : nullptr;
+      if (PERFETTO_LIKELY(meta)) {
+        if (PERFETTO_UNLIKELY(meta->num_fragments_read < meta->num_fragments)) {
           if (overwrite_policy_ == kDiscard)
             return -1;
           chunks_overwritten++;
           bytes_overwritten += next_chunk.size;
         }
-        index_delete.push_back(it);
-        will_remove = true;
       }
       TRACE_BUFFER_DLOG("  del index {%" PRIu32 ",%" PRIu32
                         ",%u} @ [%lu - %lu] %d",
-                        key.producer_id, key.writer_id, key.chunk_id,
-                        next_chunk_ptr - begin(),
-                        next_chunk_ptr - begin() + next_chunk.size, removed);
-      PERFETTO_DCHECK(will_remove);
+                        next_chunk.producer_id, next_chunk.writer_id,
+                        next_chunk.chunk_id, next_chunk_ptr - begin(),
+                        next_chunk_ptr - begin() + next_chunk.size, !!meta);
+      PERFETTO_DCHECK(meta);
     } else {
       padding_bytes_cleared += next_chunk.size;
     }
@@ -380,9 +373,17 @@ ssize_t TraceBuffer::DeleteNextChunksFor(size_t bytes_to_clear) {
     PERFETTO_CHECK(next_chunk_ptr <= end());
   }
 
-  // Remove from the index.
-  for (auto it : index_delete) {
-    index_.erase(it);
+  // Remove from the index. This is done in a second pass, so that the index is
+  // left untouched when failing above in kDiscard mode. The records are still
+  // intact at this point as nothing has been written yet.
+  for (uint8_t* ptr = wptr_; ptr < next_chunk_ptr;) {
+    const ChunkRecord& chunk = *GetChunkRecordAt(ptr);
+    if (PERFETTO_LIKELY(!chunk.is_padding)) {
+      SequenceIndex* seq = FindSequence(chunk.producer_id, chunk.writer_id);
+      if (PERFETTO_LIKELY(seq))
+        seq->Erase(chunk.chunk_id);
+    }
+    ptr += chunk.size;
   }
   stats_.set_chunks_overwritten(chunks_overwritten);
   stats_.set_bytes_overwritten(bytes_overwritten);
@@ -410,12 +411,13 @@ bool TraceBuffer::TryPatchChunkContents(ProducerID producer_id,
                                         size_t patches_size,
                                         bool other_patches_pending) {
   ChunkMeta::Key key(producer_id, writer_id, chunk_id);
-  auto it = index_.find(key);
-  if (it == index_.end()) {
+  SequenceIndex* seq = FindSequence(producer_id, writer_id);
+  ChunkMeta* meta = seq ? seq->Find(chunk_id) : nullptr;
+  if (!meta) {
     stats_.set_patches_failed(stats_.patches_failed() + 1);
     return false;
   }
-  ChunkMeta& chunk_meta = it->second;
+  ChunkMeta& chunk_meta = *meta;
 
   // Check that the index is consistent with the actual ProducerID/WriterID
   // stored in the ChunkRecord.
@@ -467,77 +469,165 @@ bool TraceBuffer::TryPatchChunkContents(ProducerID producer_id,
 }
 
 void TraceBuffer::BeginRead() {
-  read_iter_ = GetReadIterForSequence(index_.begin());
+  read_iter_ = GetReadIterForSequence(0);
 #if PERFETTO_DCHECK_IS_ON()
   changed_since_last_read_ = false;
 #endif
 }
 
 TraceBuffer::SequenceIterator TraceBuffer::GetReadIterForSequence(
-    ChunkMap::iterator seq_begin) {
+    size_t sequence_idx) {
+  // Skip the sequences whose chunks have all been deleted.
+  while (sequence_idx < sequences_.size() && sequences_[sequence_idx].empty())
+    sequence_idx++;
+
   SequenceIterator iter;
-  iter.seq_begin = seq_begin;
-  if (seq_begin == index_.end()) {
-    iter.cur = iter.seq_end = index_.end();
+  if (sequence_idx >= sequences_.size()) {
+    iter.sequence_idx = sequences_.size();
     return iter;
   }
 
-#if PERFETTO_DCHECK_IS_ON()
-  // Either |seq_begin| is == index_.begin() or the item immediately before must
-  // belong to a different {ProducerID, WriterID} sequence.
-  if (seq_begin != index_.begin() && seq_begin != index_.end()) {
-    auto prev_it = seq_begin;
-    prev_it--;
-    PERFETTO_DCHECK(
-        seq_begin == index_.begin() ||
-        std::tie(prev_it->first.producer_id, prev_it->first.writer_id) <
-            std::tie(seq_begin->first.producer_id, seq_begin->first.writer_id));
-  }
-#endif
-
-  // Find the first entry that has a greater {ProducerID, WriterID} (or just
-  // index_.end() if we reached the end).
-  ChunkMeta::Key key = seq_begin->first;  // Deliberate copy.
-  key.chunk_id = kMaxChunkID;
-  iter.seq_end = index_.upper_bound(key);
-  PERFETTO_DCHECK(iter.seq_begin != iter.seq_end);
-
-  // Now find the first entry between [seq_begin, seq_end) that is
-  // > last_chunk_id_written_. This is where we the sequence will start (see
-  // notes about wrapping of IDs in the header).
-  auto producer_and_writer_id = std::make_pair(key.producer_id, key.writer_id);
-  PERFETTO_DCHECK(last_chunk_id_written_.count(producer_and_writer_id));
-  iter.wrapping_id = last_chunk_id_written_[producer_and_writer_id];
-  key.chunk_id = iter.wrapping_id;
-  iter.cur = index_.upper_bound(key);
+  SequenceIndex& seq = sequences_[sequence_idx];
+  iter.sequence_idx = sequence_idx;
+  iter.seq_producer_id = seq.producer_id;
+  iter.seq_writer_id = seq.writer_id;
+  iter.seq_begin = seq.begin();
+  iter.seq_end = seq.end();
+
+  // Now find the first entry that is > |last_chunk_id_written|. This is where
+  // the sequence will start (see notes about wrapping of IDs in the header).
+  iter.wrapping_id = seq.last_chunk_id_written;
+  iter.cur = seq.UpperBound(iter.wrapping_id);
   if (iter.cur == iter.seq_end)
     iter.cur = iter.seq_begin;
   return iter;
 }
 
+size_t TraceBuffer::LowerBoundSequence(ProducerID producer_id,
+                                       WriterID writer_id) const {
+  const auto key = std::make_pair(producer_id, writer_id);
+  auto it = std::lower_bound(
+      sequences_.begin(), sequences_.end(), key,
+      [](const SequenceIndex& seq, const std::pair<ProducerID, WriterID>& k) {
+        return std::make_pair(seq.producer_id, seq.writer_id) < k;
+      });
+  return static_cast<size_t>(it - sequences_.begin());
+}
+
+TraceBuffer::SequenceIndex* TraceBuffer::FindSequence(ProducerID producer_id,
+                                                      WriterID writer_id) {
+  size_t idx = LowerBoundSequence(producer_id, writer_id);
+  if (idx == sequences_.size())
+    return nullptr;
+  SequenceIndex* seq = &sequences_[idx];
+  if (seq->producer_id != producer_id || seq->writer_id != writer_id)
+    return nullptr;
+  return seq;
+}
+
+TraceBuffer::SequenceIndex* TraceBuffer::GetOrCreateSequence(
+    ProducerID producer_id,
+    WriterID writer_id) {
+  size_t idx = LowerBoundSequence(producer_id, writer_id);
+  if (idx == sequences_.size() || sequences_[idx].producer_id != producer_id ||
+      sequences_[idx].writer_id != writer_id) {
+    sequences_.emplace(sequences_.begin() + static_cast<ptrdiff_t>(idx),
+                       producer_id, writer_id);
+  }
+  return &sequences_[idx];
+}
+
+TraceBuffer::ChunkMeta* TraceBuffer::SequenceIndex::UpperBound(
+    ChunkID chunk_id) {
+  // Fast path for the common case of reading (or appending) past the last
+  // chunk.
+  if (empty() || chunks.back().chunk_id <= chunk_id)
+    return end();
+  return std::upper_bound(
+      begin(), end(), chunk_id,
+      [](ChunkID id, const ChunkMeta& meta) { return id < meta.chunk_id; });
+}
+
+TraceBuffer::ChunkMeta* TraceBuffer::SequenceIndex::Find(ChunkID chunk_id) {
+  ChunkMeta* it = std::lower_bound(
+      begin(), end(), chunk_id,
+      [](const ChunkMeta& meta, ChunkID id) { return meta.chunk_id < id; });
+  if (it == end() || it->chunk_id != chunk_id)
+    return nullptr;
+  return it;
+}
+
+TraceBuffer::ChunkMeta* TraceBuffer::SequenceIndex::Insert(
+    const ChunkMeta& meta) {
+  ChunkMeta* pos = UpperBound(meta.chunk_id);
+  PERFETTO_DCHECK(pos == begin() || (pos - 1)->chunk_id != meta.chunk_id);
+
+  // Common case: chunks are copied in ChunkID order.
+  if (pos == end()) {
+    chunks.push_back(meta);
+    return &chunks.back();
+  }
+
+  // Out of order chunk older than all the others: reuse the room left by the
+  // erased entries, if any.
+  if (pos == begin() && first > 0) {
+    chunks[--first] = meta;
+    return begin();
+  }
+
+  auto it = chunks.insert(chunks.begin() + (pos - chunks.data()), meta);
+  return &*it;
+}
+
+void TraceBuffer::SequenceIndex::Erase(ChunkID chunk_id) {
+  PERFETTO_DCHECK(!empty());
+
+  // Common case: chunks are deleted in the same order they have been written,
+  // which is the ChunkID order (unless the ChunkID wrapped).
+  if (begin()->chunk_id == chunk_id) {
+    first++;
+    // Compact the array once the erased entries are the majority, to keep the
+    // cost of erasing amortized O(1) without wasting too much memory.
+    if (first == chunks.size()) {
+      chunks.clear();
+      first = 0;
+    } else if (first >= 64 && first * 2 >= chunks.size()) {
+      chunks.erase(chunks.begin(),
+                   chunks.begin() + static_cast<ptrdiff_t>(first));
+      first = 0;
+    }
+    return;
+  }
+
+  ChunkMeta* meta = Find(chunk_id);
+  PERFETTO_DCHECK(meta);
+  if (meta)
+    chunks.erase(chunks.begin() + (meta - chunks.data()));
+}
+
 void TraceBuffer::SequenceIterator::MoveNext() {
   // Stop iterating when we reach the end of the sequence.
   // Note: |seq_begin| might be == |seq_end|.
-  if (cur == seq_end || cur->first.chunk_id == wrapping_id) {
+  if (cur == seq_end || cur->chunk_id == wrapping_id) {
     cur = seq_end;
     return;
   }
 
   // If the current chunk wasn't completed yet, we shouldn't advance past it as
   // it may be rewritten with additional packets.
-  if (!cur->second.is_complete()) {
+  if (!cur->is_complete()) {
     cur = seq_end;
     return;
   }
 
-  ChunkID last_chunk_id = cur->first.chunk_id;
+  ChunkID last_chunk_id = cur->chunk_id;
   if (++cur == seq_end)
     cur = seq_begin;
 
   // There may be a missing chunk in the sequence of chunks, in which case the
   // next chunk's ID won't follow the last one's. If so, skip the rest of the
   // sequence. We'll return to it later once the hole is filled.
-  if (last_chunk_id + 1 != cur->first.chunk_id)
+  if (last_chunk_id + 1 != cur->chunk_id)
     cur = seq_end;
 }
 
@@ -567,17 +657,13 @@ bool TraceBuffer::ReadNextTracePacket(
 #endif
   for (;; read_iter_.MoveNext()) {
     if (PERFETTO_UNLIKELY(!read_iter_.is_valid())) {
-      // We ran out of chunks in the current {ProducerID, WriterID} sequence or
-      // we just reached the index_.end().
-
-      if (PERFETTO_UNLIKELY(read_iter_.seq_end == index_.end()))
+      // We ran out of chunks in the current {ProducerID, WriterID} sequence,
+      // move to the next one, if any.
+      // Note: GetReadIterForSequence() knows how to deal with indexes past the
+      // end of |sequences_|.
+      read_iter_ = GetReadIterForSequence(read_iter_.sequence_idx + 1);
+      if (PERFETTO_UNLIKELY(!read_iter_.is_valid()))
         return false;
-
-      // We reached the end of sequence, move to the next one.
-      // Note: ++read_iter_.seq_end might become index_.end(), but
-      // GetReadIterForSequence() knows how to deal with that.
-      read_iter_ = GetReadIterForSequence(read_iter_.seq_end);
-      PERFETTO_DCHECK(read_iter_.is_valid() && read_iter_.cur != index_.end());
       previous_packet_dropped = true;
     }
 
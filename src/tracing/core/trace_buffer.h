@@ -22,8 +22,8 @@
 
 #include <array>
 #include <limits>
-#include <map>
 #include <tuple>
+#include <vector>
 
 #include "perfetto/base/logging.h"
 #include "perfetto/base/paged_memory.h"
@@ -108,8 +108,8 @@ class TracePacket;
 // quite useful in future to recover the buffer from crash reports).
 //
 // However, in order to keep some operations (patching and reading) fast, a
-// lookaside index is maintained (in |index_|), keeping each chunk in the buffer
-// indexed by their {ProducerID, WriterID, ChunkID} tuple.
+// lookaside index is maintained (in |sequences_|), keeping each chunk in the
+// buffer indexed by their {ProducerID, WriterID, ChunkID} tuple.
 //
 // Patching data out-of-band
 // -------------------------
@@ -322,8 +322,10 @@ class TraceBuffer {
   //    have been read already and should be skipped in a future read pass.
   // This struct should not have any field that is essential for reconstructing
   // the contents of the buffer from a crash dump.
+  // The {ProducerID, WriterID} part of the ID is not stored here but in the
+  // SequenceIndex that contains the entry.
   struct ChunkMeta {
-    // Key used for sorting in the map.
+    // Full ID of a chunk.
     struct Key {
       Key(ProducerID p, WriterID w, ChunkID c)
           : producer_id{p}, writer_id{w}, chunk_id{c} {}
@@ -331,14 +333,6 @@ class TraceBuffer {
       explicit Key(const ChunkRecord& cr)
           : Key(cr.producer_id, cr.writer_id, cr.chunk_id) {}
 
-      // Note that this sorting doesn't keep into account the fact that ChunkID
-      // will wrap over at some point. The extra logic in SequenceIterator deals
-      // with that.
-      bool operator<(const Key& other) const {
-        return std::tie(producer_id, writer_id, chunk_id) <
-               std::tie(other.producer_id, other.writer_id, other.chunk_id);
-      }
-
       bool operator==(const Key& other) const {
         return std::tie(producer_id, writer_id, chunk_id) ==
                std::tie(other.producer_id, other.writer_id, other.chunk_id);
@@ -367,8 +361,17 @@ class TraceBuffer {
       kLastReadPacketSkipped = 1 << 1
     };
 
-    ChunkMeta(ChunkRecord* r, uint16_t p, bool complete, uint8_t f, uid_t u)
-        : chunk_record{r}, trusted_uid{u}, flags{f}, num_fragments{p} {
+    ChunkMeta(ChunkRecord* r,
+              ChunkID c,
+              uint16_t p,
+              bool complete,
+              uint8_t f,
+              uid_t u)
+        : chunk_record{r},
+          trusted_uid{u},
+          chunk_id{c},
+          flags{f},
+          num_fragments{p} {
       if (complete)
         index_flags = kComplete;
     }
@@ -395,8 +398,12 @@ class TraceBuffer {
       }
     }
 
-    ChunkRecord* const chunk_record;  // Addr of ChunkRecord within |data_|.
-    const uid_t trusted_uid;          // uid of the producer.
+    // Not const as entries are moved around within SequenceIndex::chunks.
+    ChunkRecord* chunk_record;  // Addr of ChunkRecord within |data_|.
+    uid_t trusted_uid;          // uid of the producer.
+
+    // Matches |chunk_record->chunk_id|.
+    ChunkID chunk_id;
 
     // Flags set by TraceBuffer to track the state of the chunk in the index.
     uint8_t index_flags = 0;
@@ -417,12 +424,52 @@ class TraceBuffer {
     uint16_t cur_fragment_offset = 0;
   };
 
-  using ChunkMap = std::map<ChunkMeta::Key, ChunkMeta>;
+  // The lookaside index of all the chunks of a {ProducerID, WriterID}
+  // sequence, sorted by ChunkID (this doesn't take into account the fact that
+  // ChunkID wraps over, SequenceIterator deals with that).
+  // The entries are kept in a contiguous array rather than in a tree: chunks
+  // are almost always copied in ChunkID order and deleted oldest-first when the
+  // buffer wraps, so insertions happen at the back and deletions at the front,
+  // both in amortized O(1). Lookups are a binary search over contiguous memory.
+  // Pointers to the entries are invalidated by Insert() and Erase().
+  struct SequenceIndex {
+    SequenceIndex(ProducerID p, WriterID w) : producer_id(p), writer_id(w) {}
+
+    ChunkMeta* begin() { return chunks.data() + first; }
+    ChunkMeta* end() { return chunks.data() + chunks.size(); }
+    bool empty() const { return first == chunks.size(); }
+    size_t size() const { return chunks.size() - first; }
+
+    // Returns the first entry with ChunkID > |chunk_id|, or end().
+    ChunkMeta* UpperBound(ChunkID chunk_id);
+
+    // Returns nullptr if |chunk_id| is not in the index.
+    ChunkMeta* Find(ChunkID chunk_id);
+
+    // |meta.chunk_id| must not be in the index already.
+    ChunkMeta* Insert(const ChunkMeta& meta);
+
+    // |chunk_id| must be in the index.
+    void Erase(ChunkID chunk_id);
+
+    ProducerID producer_id;
+    WriterID writer_id;
+
+    // Keeps track of the highest ChunkID written for the sequence, taking
+    // into account a potential overflow of ChunkIDs. In the case of overflow,
+    // stores the highest ChunkID written since the overflow.
+    ChunkID last_chunk_id_written = 0;
+
+    // The entries in [first, chunks.size()) are valid. The ones before
+    // |first| have been erased from the front and are compacted away lazily.
+    std::vector<ChunkMeta> chunks;
+    size_t first = 0;
+  };
 
-  // Allows to iterate over a sub-sequence of |index_| for all keys belonging to
-  // the same {ProducerID,WriterID}. Furthermore takes into account the wrapping
-  // of ChunkID. Instances are valid only as long as the |index_| is not altered
-  // (can be used safely only between adjacent ReadNextTracePacket() calls).
+  // Allows to iterate over the chunks of a SequenceIndex, taking into account
+  // the wrapping of ChunkID. Instances are valid only as long as the index is
+  // not altered (can be used safely only between adjacent
+  // ReadNextTracePacket() calls).
   // The order of the iteration will proceed in the following order:
   // |wrapping_id| + 1 -> |seq_end|, |seq_begin| -> |wrapping_id|.
   // Practical example:
@@ -433,38 +480,46 @@ class TraceBuffer {
   //   through a CopyChunkUntrusted()).
   // The resulting iteration order will be: c5, c6, c7, c0, c1, c2, c3, c4.
   struct SequenceIterator {
-    // Points to the 1st key (the one with the numerically min ChunkID).
-    ChunkMap::iterator seq_begin;
+    // Position of the sequence in |sequences_|. == sequences_.size() once all
+    // the sequences have been iterated.
+    size_t sequence_idx = 0;
 
-    // Points one past the last key (the one with the numerically max ChunkID).
-    ChunkMap::iterator seq_end;
+    ProducerID seq_producer_id = 0;
+    WriterID seq_writer_id = 0;
 
-    // Current iterator, always >= seq_begin && <= seq_end.
-    ChunkMap::iterator cur;
+    // Points to the 1st entry (the one with the numerically min ChunkID).
+    ChunkMeta* seq_begin = nullptr;
+
+    // Points one past the last entry (the one with the numerically max
+    // ChunkID).
+    ChunkMeta* seq_end = nullptr;
+
+    // Current entry, always >= seq_begin && <= seq_end.
+    ChunkMeta* cur = nullptr;
 
     // The latest ChunkID written. Determines the start/end of the sequence.
-    ChunkID wrapping_id;
+    ChunkID wrapping_id = 0;
 
     bool is_valid() const { return cur != seq_end; }
 
     ProducerID producer_id() const {
       PERFETTO_DCHECK(is_valid());
-      return cur->first.producer_id;
+      return seq_producer_id;
     }
 
     WriterID writer_id() const {
       PERFETTO_DCHECK(is_valid());
-      return cur->first.writer_id;
+      return seq_writer_id;
     }
 
     ChunkID chunk_id() const {
       PERFETTO_DCHECK(is_valid());
-      return cur->first.chunk_id;
+      return cur->chunk_id;
     }
 
     ChunkMeta& operator*() {
       PERFETTO_DCHECK(is_valid());
-      return cur->second;
+      return *cur;
     }
 
     // Moves |cur| to the next chunk in the index.
@@ -493,14 +548,21 @@ class TraceBuffer {
 
   bool Initialize(size_t size);
 
-  // Returns an object that allows to iterate over chunks in the |index_| that
-  // have the same {ProducerID, WriterID} of
-  // |seq_begin.first.{producer,writer}_id|. |seq_begin| must be an iterator to
-  // the first entry in the |index_| that has a different {ProducerID, WriterID}
-  // from the previous one. It is valid for |seq_begin| to be == index_.end()
-  // (i.e. if the index is empty). The iteration takes care of ChunkID wrapping,
-  // by using |last_chunk_id_|.
-  SequenceIterator GetReadIterForSequence(ChunkMap::iterator seq_begin);
+  // Returns an object that allows to iterate over the chunks of the first
+  // non-empty sequence in |sequences_| at or after |sequence_idx|. If there is
+  // none, the returned iterator is not valid and its |sequence_idx| is
+  // sequences_.size(). The iteration takes care of ChunkID wrapping, by using
+  // |last_chunk_id_written|.
+  SequenceIterator GetReadIterForSequence(size_t sequence_idx);
+
+  // Returns the position of the first sequence in |sequences_| which is not
+  // less than {ProducerID, WriterID}, or sequences_.size().
+  size_t LowerBoundSequence(ProducerID, WriterID) const;
+
+  // Returns nullptr if there is no such sequence.
+  SequenceIndex* FindSequence(ProducerID, WriterID);
+
+  SequenceIndex* GetOrCreateSequence(ProducerID, WriterID);
 
   // Used as a last resort when a buffer corruption is detected.
   void ClearContentsAndResetRWCursors();
@@ -604,8 +666,14 @@ class TraceBuffer {
   uint8_t* wptr_ = nullptr;    // Write pointer.
 
   // An index that keeps track of the positions and metadata of each
-  // ChunkRecord.
-  ChunkMap index_;
+  // ChunkRecord, grouped by sequence and sorted by {ProducerID, WriterID}.
+  // Sequences are never removed, even when all their chunks are gone, to keep
+  // track of their |last_chunk_id_written|.
+  //
+  // TODO(primiano): should clean up sequences. Right now it grows without
+  // bounds (although realistically is not a problem unless we have too many
+  // producers/writers within the same trace session).
+  std::vector<SequenceIndex> sequences_;
 
   // Read iterator used for ReadNext(). It is reset by calling BeginRead().
   // It becomes invalid after any call to methods that alters the |index_|.
@@ -618,15 +686,6 @@ class TraceBuffer {
   // a write fails because it would overwrite unread chunks.
   bool discard_writes_ = false;
 
-  // Keeps track of the highest ChunkID written for a given sequence, taking
-  // into account a potential overflow of ChunkIDs. In the case of overflow,
-  // stores the highest ChunkID written since the overflow.
-  //
-  // TODO(primiano): should clean up keys from this map. Right now it grows
-  // without bounds (although realistically is not a problem unless we have too
-  // many producers/writers within the same trace session).
-  std::map<std::pair<ProducerID, WriterID>, ChunkID> last_chunk_id_written_;
-
   // Statistics about buffer usage.
   TraceStats::BufferStats stats_;
 
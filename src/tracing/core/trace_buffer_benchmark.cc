@@ -0,0 +1,125 @@
+// Copyright (C) 2019 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "perfetto/base/logging.h"
+#include "perfetto/tracing/core/basic_types.h"
+#include "perfetto/tracing/core/trace_packet.h"
+#include "src/tracing/core/trace_buffer.h"
+
+namespace {
+
+using perfetto::ChunkID;
+using perfetto::TraceBuffer;
+using perfetto::TracePacket;
+using perfetto::WriterID;
+
+constexpr size_t kBufferSize = 32 * 1024 * 1024;
+constexpr size_t kChunkSize = 4096;
+constexpr size_t kPacketSize = 256;
+constexpr uint16_t kPacketsPerChunk = kChunkSize / kPacketSize;
+
+// Returns the payload of a chunk filled with |kPacketsPerChunk| packets of
+// |kPacketSize| bytes each (including their 2-bytes varint size header).
+std::vector<uint8_t> MakeChunkPayload() {
+  static_assert(kPacketSize - 2 >= 128 && kPacketSize - 2 < 16384,
+                "The size header must be a 2-bytes varint");
+  std::vector<uint8_t> payload;
+  payload.reserve(kChunkSize);
+  for (uint16_t i = 0; i < kPacketsPerChunk; i++) {
+    const size_t size = kPacketSize - 2;
+    payload.push_back(static_cast<uint8_t>(0x80 | (size & 0x7f)));
+    payload.push_back(static_cast<uint8_t>(size >> 7));
+    payload.insert(payload.end(), size, static_cast<uint8_t>('a' + i % 26));
+  }
+  return payload;
+}
+
+// Copies one chunk for each of the |num_writers| sequences, round-robin, like
+// the service does when committing chunks from a producer with many threads.
+void CopyChunks(TraceBuffer* buf,
+                const std::vector<uint8_t>& payload,
+                WriterID num_writers,
+                ChunkID* chunk_id) {
+  for (WriterID w = 1; w <= num_writers; w++) {
+    buf->CopyChunkUntrusted(/*producer_id_trusted=*/1,
+                            /*producer_uid_trusted=*/0, w, *chunk_id,
+                            kPacketsPerChunk, /*chunk_flags=*/0,
+                            /*chunk_complete=*/true, payload.data(),
+                            payload.size());
+  }
+  (*chunk_id)++;
+}
+
+// Writes chunks of state.range(0) writers into a buffer which is never read
+// back, so that it keeps wrapping and overwriting the oldest chunks.
+void BM_TraceBuffer_WR_Overwrite(benchmark::State& state) {
+  const WriterID num_writers = static_cast<WriterID>(state.range(0));
+  std::unique_ptr<TraceBuffer> buf = TraceBuffer::Create(kBufferSize);
+  PERFETTO_CHECK(buf);
+  const std::vector<uint8_t> payload = MakeChunkPayload();
+  ChunkID chunk_id = 0;
+
+  // Fill the buffer first, so that the steady state (each write overwrites a
+  // chunk) is measured.
+  while (buf->stats().bytes_written() < kBufferSize)
+    CopyChunks(buf.get(), payload, num_writers, &chunk_id);
+
+  for (auto _ : state)
+    CopyChunks(buf.get(), payload, num_writers, &chunk_id);
+
+  state.SetBytesProcessed(int64_t(state.iterations()) * num_writers *
+                          int64_t(payload.size()));
+}
+
+// Alternates writing chunks of state.range(0) writers with reading back all
+// their packets, like the service does in a periodic ReadBuffers() session.
+void BM_TraceBuffer_WR_ReadBack(benchmark::State& state) {
+  const WriterID num_writers = static_cast<WriterID>(state.range(0));
+  std::unique_ptr<TraceBuffer> buf = TraceBuffer::Create(kBufferSize);
+  PERFETTO_CHECK(buf);
+  const std::vector<uint8_t> payload = MakeChunkPayload();
+  ChunkID chunk_id = 0;
+  constexpr size_t kChunksPerRead = 16;
+
+  uint64_t packets_read = 0;
+  for (auto _ : state) {
+    for (size_t i = 0; i < kChunksPerRead; i++)
+      CopyChunks(buf.get(), payload, num_writers, &chunk_id);
+
+    buf->BeginRead();
+    for (;;) {
+      TracePacket packet;
+      TraceBuffer::PacketSequenceProperties props{};
+      bool previous_packet_dropped;
+      if (!buf->ReadNextTracePacket(&packet, &props, &previous_packet_dropped))
+        break;
+      packets_read++;
+    }
+  }
+
+  PERFETTO_CHECK(packets_read == uint64_t(state.iterations()) * num_writers *
+                                     kChunksPerRead * kPacketsPerChunk);
+  state.SetBytesProcessed(int64_t(state.iterations()) * num_writers *
+                          int64_t(kChunksPerRead * payload.size()));
+}
+
+}  // namespace
+
+BENCHMARK(BM_TraceBuffer_WR_Overwrite)->RangeMultiplier(4)->Range(1, 256);
+BENCHMARK(BM_TraceBuffer_WR_ReadBack)->RangeMultiplier(4)->Range(1, 256);
@@ -120,9 +120,10 @@ class TraceBufferTest : public testing::Test {
   }
 
   SequenceIterator GetReadIterForSequence(ProducerID p, WriterID w) {
-    TraceBuffer::ChunkMeta::Key key(p, w, 0);
+    if (!trace_buffer_->FindSequence(p, w))
+      return SequenceIterator();
     return trace_buffer_->GetReadIterForSequence(
-        trace_buffer_->index_.lower_bound(key));
+        trace_buffer_->LowerBoundSequence(p, w));
   }
 
   void SuppressSanityDchecksForTesting() {
@@ -131,9 +132,10 @@ class TraceBufferTest : public testing::Test {
 
   std::vector<ChunkMetaKey> GetIndex() {
     std::vector<ChunkMetaKey> keys;
-    keys.reserve(trace_buffer_->index_.size());
-    for (const auto& it : trace_buffer_->index_)
-      keys.push_back(it.first);
+    for (auto& seq : trace_buffer_->sequences_) {
+      for (const auto* meta = seq.begin(); meta != seq.end(); meta++)
+        keys.emplace_back(seq.producer_id, seq.writer_id, meta->chunk_id);
+    }
     return keys;
   }
 
@@ -1332,6 +1334,94 @@ TEST_F(TraceBufferTest, Iterator_ManyStreamsWrapping) {
   ASSERT_TRUE(IteratorSeqEq(ProducerID(3), WriterID(1), {Neg(-1), 0, 1}));
 }
 
+// -------------------
+// Index tests
+// -------------------
+
+// Chunks copied out of order must be kept sorted by ChunkID in the index of
+// their sequence.
+TEST_F(TraceBufferTest, Index_OutOfOrderChunks) {
+  ResetBuffer(64 * 1024);
+  AppendChunks({
+      {ProducerID(2), WriterID(1), ChunkID(3)},
+      {ProducerID(1), WriterID(1), ChunkID(3)},
+      {ProducerID(1), WriterID(1), ChunkID(1)},
+      {ProducerID(2), WriterID(1), ChunkID(0)},
+      {ProducerID(1), WriterID(1), ChunkID(0)},
+      {ProducerID(1), WriterID(1), ChunkID(2)},
+      {ProducerID(2), WriterID(1), ChunkID(2)},
+      {ProducerID(2), WriterID(1), ChunkID(1)},
+  });
+  ASSERT_THAT(GetIndex(),
+              ElementsAre(ChunkMetaKey(1, 1, 0), ChunkMetaKey(1, 1, 1),
+                          ChunkMetaKey(1, 1, 2), ChunkMetaKey(1, 1, 3),
+                          ChunkMetaKey(2, 1, 0), ChunkMetaKey(2, 1, 1),
+                          ChunkMetaKey(2, 1, 2), ChunkMetaKey(2, 1, 3)));
+  ASSERT_TRUE(IteratorSeqEq(ProducerID(1), WriterID(1), {0, 1, 2, 3}));
+  ASSERT_TRUE(IteratorSeqEq(ProducerID(2), WriterID(1), {0, 1, 2, 3}));
+}
+
+// Keeps overwriting a small buffer with chunks of several writers and checks
+// that the index always contains exactly the chunks left in the buffer, which
+// are read back in order.
+TEST_F(TraceBufferTest, Index_LongRunningOverwrite) {
+  const size_t kChunkSize = 128;
+  ResetBuffer(4096);
+  const size_t kChunksInBuffer = 4096 / kChunkSize;
+  auto seed = [](WriterID w, ChunkID c) {
+    return static_cast<char>('a' + (w * 7 + c) % 26);
+  };
+
+  for (ChunkID c = 0; c < 1000; c++) {
+    for (WriterID w = 1; w <= 3; w++) {
+      CreateChunk(ProducerID(1), w, c)
+          .AddPacket(kChunkSize - 16, seed(w, c))
+          .CopyIntoTraceBuffer();
+    }
+
+    // Read back once in a while, which leaves the index in a mix of read and
+    // unread chunks.
+    if (c % 100 != 50)
+      continue;
+    std::vector<ChunkMetaKey> index = GetIndex();
+    ASSERT_EQ(kChunksInBuffer, index.size());
+    trace_buffer()->BeginRead();
+    for (const ChunkMetaKey& key : index) {
+      TraceBuffer::PacketSequenceProperties props{};
+      ASSERT_THAT(ReadPacket(&props),
+                  ElementsAre(FakePacketFragment(
+                      kChunkSize - 16, seed(key.writer_id, key.chunk_id))));
+      ASSERT_EQ(key.writer_id, props.writer_id);
+    }
+    ASSERT_THAT(ReadPacket(), IsEmpty());
+  }
+
+  // The buffer contains the last chunks of each writer, the ones of the last
+  // writer included in the wrapping being the oldest.
+  ASSERT_THAT(
+      GetIndex(),
+      ElementsAre(ChunkMetaKey(1, 1, 989), ChunkMetaKey(1, 1, 990),
+                  ChunkMetaKey(1, 1, 991), ChunkMetaKey(1, 1, 992),
+                  ChunkMetaKey(1, 1, 993), ChunkMetaKey(1, 1, 994),
+                  ChunkMetaKey(1, 1, 995), ChunkMetaKey(1, 1, 996),
+                  ChunkMetaKey(1, 1, 997), ChunkMetaKey(1, 1, 998),
+                  ChunkMetaKey(1, 1, 999), ChunkMetaKey(1, 2, 989),
+                  ChunkMetaKey(1, 2, 990), ChunkMetaKey(1, 2, 991),
+                  ChunkMetaKey(1, 2, 992), ChunkMetaKey(1, 2, 993),
+                  ChunkMetaKey(1, 2, 994), ChunkMetaKey(1, 2, 995),
+                  ChunkMetaKey(1, 2, 996), ChunkMetaKey(1, 2, 997),
+                  ChunkMetaKey(1, 2, 998), ChunkMetaKey(1, 2, 999),
+                  ChunkMetaKey(1, 3, 990), ChunkMetaKey(1, 3, 991),
+                  ChunkMetaKey(1, 3, 992), ChunkMetaKey(1, 3, 993),
+                  ChunkMetaKey(1, 3, 994), ChunkMetaKey(1, 3, 995),
+                  ChunkMetaKey(1, 3, 996), ChunkMetaKey(1, 3, 997),
+                  ChunkMetaKey(1, 3, 998), ChunkMetaKey(1, 3, 999)));
+  ASSERT_TRUE(TryPatchChunkContents(ProducerID(1), WriterID(3), ChunkID(990),
+                                    {{5, {{'X', 'X', 'X', 'X'}}}}));
+  ASSERT_FALSE(TryPatchChunkContents(ProducerID(1), WriterID(3), ChunkID(989),
+                                     {{5, {{'X', 'X', 'X', 'X'}}}}));
+}
+
 // -------------------
 // Re-writing same chunk id
 // -------------------
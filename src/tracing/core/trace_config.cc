@@ -58,7 +58,12 @@ bool TraceConfig::operator==(const TraceConfig& other) const {
          (flush_timeout_ms_ == other.flush_timeout_ms_) &&
          (disable_clock_snapshotting_ == other.disable_clock_snapshotting_) &&
          (notify_traceur_ == other.notify_traceur_) &&
-         (trigger_config_ == other.trigger_config_);
+         (trigger_config_ == other.trigger_config_) &&
+         (compression_type_ == other.compression_type_) &&
+         (file_write_async_ == other.file_write_async_) &&
+         (file_write_max_queued_kb_ == other.file_write_max_queued_kb_) &&
+         (file_write_direct_io_ == other.file_write_direct_io_) &&
+         (file_sync_policy_ == other.file_sync_policy_);
 }
 #pragma GCC diagnostic pop
 
@@ -144,6 +149,33 @@ void TraceConfig::FromProto(const perfetto::protos::TraceConfig& proto) {
       static_cast<decltype(notify_traceur_)>(proto.notify_traceur());
 
   trigger_config_.FromProto(proto.trigger_config());
+
+  static_assert(sizeof(compression_type_) == sizeof(proto.compression_type()),
+                "size mismatch");
+  compression_type_ =
+      static_cast<decltype(compression_type_)>(proto.compression_type());
+
+  static_assert(sizeof(file_write_async_) == sizeof(proto.file_write_async()),
+                "size mismatch");
+  file_write_async_ =
+      static_cast<decltype(file_write_async_)>(proto.file_write_async());
+
+  static_assert(sizeof(file_write_max_queued_kb_) ==
+                    sizeof(proto.file_write_max_queued_kb()),
+                "size mismatch");
+  file_write_max_queued_kb_ = static_cast<decltype(file_write_max_queued_kb_)>(
+      proto.file_write_max_queued_kb());
+
+  static_assert(
+      sizeof(file_write_direct_io_) == sizeof(proto.file_write_direct_io()),
+      "size mismatch");
+  file_write_direct_io_ = static_cast<decltype(file_write_direct_io_)>(
+      proto.file_write_direct_io());
+
+  static_assert(sizeof(file_sync_policy_) == sizeof(proto.file_sync_policy()),
+                "size mismatch");
+  file_sync_policy_ =
+      static_cast<decltype(file_sync_policy_)>(proto.file_sync_policy());
   unknown_fields_ = proto.unknown_fields();
 }
 
@@ -233,6 +265,35 @@ void TraceConfig::ToProto(perfetto::protos::TraceConfig* proto) const {
       static_cast<decltype(proto->notify_traceur())>(notify_traceur_));
 
   trigger_config_.ToProto(proto->mutable_trigger_config());
+
+  static_assert(sizeof(compression_type_) == sizeof(proto->compression_type()),
+                "size mismatch");
+  proto->set_compression_type(
+      static_cast<decltype(proto->compression_type())>(compression_type_));
+
+  static_assert(sizeof(file_write_async_) == sizeof(proto->file_write_async()),
+                "size mismatch");
+  proto->set_file_write_async(
+      static_cast<decltype(proto->file_write_async())>(file_write_async_));
+
+  static_assert(sizeof(file_write_max_queued_kb_) ==
+                    sizeof(proto->file_write_max_queued_kb()),
+                "size mismatch");
+  proto->set_file_write_max_queued_kb(
+      static_cast<decltype(proto->file_write_max_queued_kb())>(
+          file_write_max_queued_kb_));
+
+  static_assert(
+      sizeof(file_write_direct_io_) == sizeof(proto->file_write_direct_io()),
+      "size mismatch");
+  proto->set_file_write_direct_io(
+      static_cast<decltype(proto->file_write_direct_io())>(
+          file_write_direct_io_));
+
+  static_assert(sizeof(file_sync_policy_) == sizeof(proto->file_sync_policy()),
+                "size mismatch");
+  proto->set_file_sync_policy(
+      static_cast<decltype(proto->file_sync_policy())>(file_sync_policy_));
   *(proto->mutable_unknown_fields()) = unknown_fields_;
 }
 
@@ -49,7 +49,12 @@ bool TraceStats::operator==(const TraceStats& other) const {
          (tracing_sessions_ == other.tracing_sessions_) &&
          (total_buffers_ == other.total_buffers_) &&
          (chunks_discarded_ == other.chunks_discarded_) &&
-         (patches_discarded_ == other.patches_discarded_);
+         (patches_discarded_ == other.patches_discarded_) &&
+         (file_write_batches_ == other.file_write_batches_) &&
+         (file_write_max_queued_bytes_ ==
+          other.file_write_max_queued_bytes_) &&
+         (file_write_backpressure_events_ ==
+          other.file_write_backpressure_events_);
 }
 #pragma GCC diagnostic pop
 
@@ -100,6 +105,26 @@ void TraceStats::FromProto(const perfetto::protos::TraceStats& proto) {
                 "size mismatch");
   patches_discarded_ =
       static_cast<decltype(patches_discarded_)>(proto.patches_discarded());
+
+  static_assert(
+      sizeof(file_write_batches_) == sizeof(proto.file_write_batches()),
+      "size mismatch");
+  file_write_batches_ =
+      static_cast<decltype(file_write_batches_)>(proto.file_write_batches());
+
+  static_assert(sizeof(file_write_max_queued_bytes_) ==
+                    sizeof(proto.file_write_max_queued_bytes()),
+                "size mismatch");
+  file_write_max_queued_bytes_ =
+      static_cast<decltype(file_write_max_queued_bytes_)>(
+          proto.file_write_max_queued_bytes());
+
+  static_assert(sizeof(file_write_backpressure_events_) ==
+                    sizeof(proto.file_write_backpressure_events()),
+                "size mismatch");
+  file_write_backpressure_events_ =
+      static_cast<decltype(file_write_backpressure_events_)>(
+          proto.file_write_backpressure_events());
   unknown_fields_ = proto.unknown_fields();
 }
 
@@ -156,6 +181,26 @@ void TraceStats::ToProto(perfetto::protos::TraceStats* proto) const {
       "size mismatch");
   proto->set_patches_discarded(
       static_cast<decltype(proto->patches_discarded())>(patches_discarded_));
+
+  static_assert(
+      sizeof(file_write_batches_) == sizeof(proto->file_write_batches()),
+      "size mismatch");
+  proto->set_file_write_batches(
+      static_cast<decltype(proto->file_write_batches())>(file_write_batches_));
+
+  static_assert(sizeof(file_write_max_queued_bytes_) ==
+                    sizeof(proto->file_write_max_queued_bytes()),
+                "size mismatch");
+  proto->set_file_write_max_queued_bytes(
+      static_cast<decltype(proto->file_write_max_queued_bytes())>(
+          file_write_max_queued_bytes_));
+
+  static_assert(sizeof(file_write_backpressure_events_) ==
+                    sizeof(proto->file_write_backpressure_events()),
+                "size mismatch");
+  proto->set_file_write_backpressure_events(
+      static_cast<decltype(proto->file_write_backpressure_events())>(
+          file_write_backpressure_events_));
   *(proto->mutable_unknown_fields()) = unknown_fields_;
 }
 
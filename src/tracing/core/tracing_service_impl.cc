@@ -51,6 +51,7 @@
 #include "src/tracing/core/packet_stream_validator.h"
 #include "src/tracing/core/shared_memory_arbiter_impl.h"
 #include "src/tracing/core/trace_buffer.h"
+#include "src/tracing/core/zlib_compressor.h"
 
 #include "perfetto/trace/clock_snapshot.pb.h"
 #include "perfetto/trace/system_info.pb.h"
@@ -393,6 +394,16 @@ bool TracingServiceImpl::EnableTracing(ConsumerEndpointImpl* consumer,
     tracing_session->write_period_ms = write_period_ms;
     tracing_session->max_file_size_bytes = cfg.max_file_size_bytes();
     tracing_session->bytes_written_into_file = 0;
+    if (cfg.file_write_async()) {
+      AsyncFileWriter::Options options;
+      if (cfg.file_write_max_queued_kb())
+        options.max_queued_bytes = cfg.file_write_max_queued_kb() * 1024ul;
+      options.direct_io = cfg.file_write_direct_io();
+      options.sync_every_batch = cfg.file_sync_policy() ==
+                                 TraceConfig::FILE_SYNC_POLICY_EVERY_BATCH;
+      tracing_session->file_writer.reset(
+          new AsyncFileWriter(*tracing_session->write_into_file, options));
+    }
   }
 
   // Initialize the log buffers.
@@ -1330,6 +1341,23 @@ void TracingServiceImpl::ReadBuffers(TracingSessionID tsid,
     return;
   }
 
+  // If the file writer thread is lagging behind, leave the data in the trace
+  // buffers and try again at the next period, rather than queuing more. This
+  // doesn't apply to the final read, when tracing is disabled.
+  AsyncFileWriter* file_writer = tracing_session->file_writer.get();
+  if (file_writer && tracing_session->write_period_ms &&
+      file_writer->is_queue_full()) {
+    tracing_session->file_write_backpressure_events++;
+    auto weak_this = weak_ptr_factory_.GetWeakPtr();
+    task_runner_->PostDelayedTask(
+        [weak_this, tsid] {
+          if (weak_this)
+            weak_this->ReadBuffers(tsid, nullptr);
+        },
+        tracing_session->delay_to_next_write_period_ms());
+    return;
+  }
+
   std::vector<TracePacket> packets;
   packets.reserve(1024);  // Just an educated guess to avoid trivial expansions.
 
@@ -1406,22 +1434,12 @@ void TracingServiceImpl::ReadBuffers(TracingSessionID tsid,
       // truncated packets are also rejected, so the producer can't give us a
       // partial packet (e.g., a truncated string) which only becomes valid when
       // the trusted data is appended here.
-      protos::TrustedPacket trusted_packet;
-      trusted_packet.set_trusted_uid(
-          static_cast<int32_t>(sequence_properties.producer_uid_trusted));
-      trusted_packet.set_trusted_packet_sequence_id(
+      packet.AddSlice(trusted_packet_arena_.Encode(
+          sequence_properties.producer_uid_trusted,
           tracing_session->GetPacketSequenceID(
               sequence_properties.producer_id_trusted,
-              sequence_properties.writer_id));
-      if (previous_packet_dropped)
-        trusted_packet.set_previous_packet_dropped(previous_packet_dropped);
-      static constexpr size_t kTrustedBufSize = 16;
-      Slice slice = Slice::Allocate(kTrustedBufSize);
-      PERFETTO_CHECK(
-          trusted_packet.SerializeToArray(slice.own_data(), kTrustedBufSize));
-      slice.size = static_cast<size_t>(trusted_packet.GetCachedSize());
-      PERFETTO_DCHECK(slice.size > 0 && slice.size <= kTrustedBufSize);
-      packet.AddSlice(std::move(slice));
+              sequence_properties.writer_id),
+          previous_packet_dropped));
 
       // Append the packet (inclusive of the trusted uid) to |packets|.
       packets_bytes += packet.size();
@@ -1432,6 +1450,14 @@ void TracingServiceImpl::ReadBuffers(TracingSessionID tsid,
     }  // for(packets...)
   }    // for(buffers...)
 
+  if (tracing_session->config.compression_type() ==
+      TraceConfig::COMPRESSION_TYPE_DEFLATE) {
+    ZlibCompressPackets(&packets);
+    total_slices = 0;
+    for (const TracePacket& packet : packets)
+      total_slices += packet.slices().size();
+  }
+
   // If the caller asked us to write into a file by setting
   // |write_into_file| == true in the trace config, drain the packets read
   // (if any) into the given file descriptor.
@@ -1440,64 +1466,95 @@ void TracingServiceImpl::ReadBuffers(TracingSessionID tsid,
                                   ? tracing_session->max_file_size_bytes
                                   : std::numeric_limits<size_t>::max();
 
-    // When writing into a file, the file should look like a root trace.proto
-    // message. Each packet should be prepended with a proto preamble stating
-    // its field id (within trace.proto) and size. Hence the addition below.
-    const size_t max_iovecs = total_slices + packets.size();
-
-    size_t num_iovecs = 0;
     bool stop_writing_into_file = tracing_session->write_period_ms == 0;
-    std::unique_ptr<struct iovec[]> iovecs(new struct iovec[max_iovecs]);
-    size_t num_iovecs_at_last_packet = 0;
-    uint64_t bytes_about_to_be_written = 0;
-    for (TracePacket& packet : packets) {
-      std::tie(iovecs[num_iovecs].iov_base, iovecs[num_iovecs].iov_len) =
-          packet.GetProtoPreamble();
-      bytes_about_to_be_written += iovecs[num_iovecs].iov_len;
-      num_iovecs++;
-      for (const Slice& slice : packet.slices()) {
-        // writev() doesn't change the passed pointer. However, struct iovec
-        // take a non-const ptr because it's the same struct used by readv().
-        // Hence the const_cast here.
-        char* start = static_cast<char*>(const_cast<void*>(slice.start));
-        bytes_about_to_be_written += slice.size;
-        iovecs[num_iovecs++] = {start, slice.size};
-      }
+    uint64_t total_wr_size = 0;
+    int fd = *tracing_session->write_into_file;
 
-      if (tracing_session->bytes_written_into_file +
-              bytes_about_to_be_written >=
-          max_size) {
-        stop_writing_into_file = true;
-        num_iovecs = num_iovecs_at_last_packet;
-        break;
+    if (file_writer) {
+      // Only queue the packets that fit within |max_size|, the writer thread
+      // takes care of the actual write.
+      size_t num_packets = 0;
+      uint64_t bytes_about_to_be_written = 0;
+      for (TracePacket& packet : packets) {
+        bytes_about_to_be_written +=
+            std::get<1>(packet.GetProtoPreamble()) + packet.size();
+        if (tracing_session->bytes_written_into_file +
+                bytes_about_to_be_written >=
+            max_size) {
+          stop_writing_into_file = true;
+          break;
+        }
+        num_packets++;
       }
+      total_wr_size = file_writer->WritePackets(packets.data(), num_packets);
+      if (total_wr_size) {
+        tracing_session->file_write_batches++;
+        tracing_session->file_write_max_queued_bytes =
+            std::max(tracing_session->file_write_max_queued_bytes,
+                     static_cast<uint64_t>(file_writer->queued_bytes()));
+      }
+      if (file_writer->has_failed())
+        stop_writing_into_file = true;
+    } else {
+      // When writing into a file, the file should look like a root trace.proto
+      // message. Each packet should be prepended with a proto preamble stating
+      // its field id (within trace.proto) and size. Hence the addition below.
+      const size_t max_iovecs = total_slices + packets.size();
+
+      size_t num_iovecs = 0;
+      std::unique_ptr<struct iovec[]> iovecs(new struct iovec[max_iovecs]);
+      size_t num_iovecs_at_last_packet = 0;
+      uint64_t bytes_about_to_be_written = 0;
+      for (TracePacket& packet : packets) {
+        std::tie(iovecs[num_iovecs].iov_base, iovecs[num_iovecs].iov_len) =
+            packet.GetProtoPreamble();
+        bytes_about_to_be_written += iovecs[num_iovecs].iov_len;
+        num_iovecs++;
+        for (const Slice& slice : packet.slices()) {
+          // writev() doesn't change the passed pointer. However, struct iovec
+          // take a non-const ptr because it's the same struct used by readv().
+          // Hence the const_cast here.
+          char* start = static_cast<char*>(const_cast<void*>(slice.start));
+          bytes_about_to_be_written += slice.size;
+          iovecs[num_iovecs++] = {start, slice.size};
+        }
 
-      num_iovecs_at_last_packet = num_iovecs;
-    }
-    PERFETTO_DCHECK(num_iovecs <= max_iovecs);
-    int fd = *tracing_session->write_into_file;
-
-    uint64_t total_wr_size = 0;
+        if (tracing_session->bytes_written_into_file +
+                bytes_about_to_be_written >=
+            max_size) {
+          stop_writing_into_file = true;
+          num_iovecs = num_iovecs_at_last_packet;
+          break;
+        }
 
-    // writev() can take at most IOV_MAX entries per call. Batch them.
-    constexpr size_t kIOVMax = IOV_MAX;
-    for (size_t i = 0; i < num_iovecs; i += kIOVMax) {
-      int iov_batch_size = static_cast<int>(std::min(num_iovecs - i, kIOVMax));
-      ssize_t wr_size = PERFETTO_EINTR(writev(fd, &iovecs[i], iov_batch_size));
-      if (wr_size <= 0) {
-        PERFETTO_PLOG("writev() failed");
-        stop_writing_into_file = true;
-        break;
+        num_iovecs_at_last_packet = num_iovecs;
       }
-      total_wr_size += static_cast<size_t>(wr_size);
-    }
+      PERFETTO_DCHECK(num_iovecs <= max_iovecs);
+
+      // writev() can take at most IOV_MAX entries per call. Batch them.
+      constexpr size_t kIOVMax = IOV_MAX;
+      for (size_t i = 0; i < num_iovecs; i += kIOVMax) {
+        int iov_batch_size =
+            static_cast<int>(std::min(num_iovecs - i, kIOVMax));
+        ssize_t wr_size =
+            PERFETTO_EINTR(writev(fd, &iovecs[i], iov_batch_size));
+        if (wr_size <= 0) {
+          PERFETTO_PLOG("writev() failed");
+          stop_writing_into_file = true;
+          break;
+        }
+        total_wr_size += static_cast<size_t>(wr_size);
+      }
+    }  // if (file_writer)
 
     tracing_session->bytes_written_into_file += total_wr_size;
 
     PERFETTO_DLOG("Draining into file, written: %" PRIu64 " KB, stop: %d",
                   (total_wr_size + 1023) / 1024, stop_writing_into_file);
     if (stop_writing_into_file) {
-      // Ensure all data was written to the file before we close it.
+      // Ensure all data was written to the file before we close it. This
+      // blocks until the file writer thread, if any, has drained its queue.
+      tracing_session->file_writer.reset();
       base::FlushFile(fd);
       tracing_session->write_into_file.reset();
       tracing_session->write_period_ms = 0;
@@ -2081,6 +2138,11 @@ TraceStats TracingServiceImpl::GetTraceStats(TracingSession* tracing_session) {
   trace_stats.set_total_buffers(static_cast<uint32_t>(buffers_.size()));
   trace_stats.set_chunks_discarded(chunks_discarded_);
   trace_stats.set_patches_discarded(patches_discarded_);
+  trace_stats.set_file_write_batches(tracing_session->file_write_batches);
+  trace_stats.set_file_write_max_queued_bytes(
+      tracing_session->file_write_max_queued_bytes);
+  trace_stats.set_file_write_backpressure_events(
+      tracing_session->file_write_backpressure_events);
 
   for (BufferID buf_id : tracing_session->buffers_index) {
     TraceBuffer* buf = GetBufferByID(buf_id);
@@ -37,7 +37,9 @@
 #include "perfetto/tracing/core/trace_config.h"
 #include "perfetto/tracing/core/trace_stats.h"
 #include "perfetto/tracing/core/tracing_service.h"
+#include "src/tracing/core/async_file_writer.h"
 #include "src/tracing/core/id_allocator.h"
+#include "src/tracing/core/trusted_packet_arena.h"
 
 namespace perfetto {
 
@@ -454,6 +456,15 @@ class TracingServiceImpl : public TracingService {
     uint32_t write_period_ms = 0;
     uint64_t max_file_size_bytes = 0;
     uint64_t bytes_written_into_file = 0;
+
+    // Set when the TraceConfig has |file_write_async| == true. Writes into
+    // |write_into_file| from a dedicated thread. Declared after
+    // |write_into_file| so that it's destroyed (and waits for the pending
+    // writes) before the file is closed.
+    std::unique_ptr<AsyncFileWriter> file_writer;
+    uint64_t file_write_batches = 0;
+    uint64_t file_write_max_queued_bytes = 0;
+    uint64_t file_write_backpressure_events = 0;
   };
 
   TracingServiceImpl(const TracingServiceImpl&) = delete;
@@ -526,6 +537,9 @@ class TracingServiceImpl : public TracingService {
   uint8_t sync_marker_packet_[32];  // Lazily initialized.
   size_t sync_marker_packet_size_ = 0;
 
+  // Holds the trusted fields appended to the packets read in ReadBuffers().
+  TrustedPacketArena trusted_packet_arena_;
+
   // Stats.
   uint64_t chunks_discarded_ = 0;
   uint64_t patches_discarded_ = 0;
@@ -1361,6 +1361,75 @@ TEST_F(TracingServiceImplTest, WriteIntoFileAndStopOnMaxSize) {
   }
 }
 
+TEST_F(TracingServiceImplTest, WriteIntoFileAsync) {
+  std::unique_ptr<MockConsumer> consumer = CreateMockConsumer();
+  consumer->Connect(svc.get());
+
+  std::unique_ptr<MockProducer> producer = CreateMockProducer();
+  producer->Connect(svc.get(), "mock_producer");
+  producer->RegisterDataSource("data_source");
+
+  TraceConfig trace_config;
+  trace_config.add_buffers()->set_size_kb(4096);
+  auto* ds_config = trace_config.add_data_sources()->mutable_config();
+  ds_config->set_name("data_source");
+  ds_config->set_target_buffer(0);
+  trace_config.set_write_into_file(true);
+  trace_config.set_file_write_period_ms(1);
+  trace_config.set_file_write_async(true);
+  trace_config.set_file_write_direct_io(true);
+  trace_config.set_file_sync_policy(TraceConfig::FILE_SYNC_POLICY_EVERY_BATCH);
+  base::TempFile tmp_file = base::TempFile::Create();
+  consumer->EnableTracing(trace_config, base::ScopedFile(dup(tmp_file.fd())));
+
+  producer->WaitForTracingSetup();
+  producer->WaitForDataSourceSetup("data_source");
+  producer->WaitForDataSourceStart("data_source");
+
+  static const int kNumTestPackets = 100;
+  std::unique_ptr<TraceWriter> writer =
+      producer->CreateTraceWriter("data_source");
+  for (int i = 0; i < kNumTestPackets; i++) {
+    // Write the packets in a few batches, so that they are drained into the
+    // file by multiple ReadBuffers() passes.
+    if (i % 25 == 0) {
+      writer->Flush();
+      WaitForNextSyncMarker();
+    }
+    std::string payload(static_cast<size_t>(i + 1), 'A' + (i % 25));
+    writer->NewTracePacket()->set_for_testing()->set_str(payload.c_str());
+  }
+  writer->Flush();
+  writer.reset();
+
+  consumer->DisableTracing();
+  producer->WaitForDataSourceStop("data_source");
+  consumer->WaitForTracingDisabled();
+
+  // All the queued batches must have been written when tracing is disabled.
+  std::string trace_raw;
+  ASSERT_TRUE(base::ReadFile(tmp_file.path().c_str(), &trace_raw));
+  protos::Trace trace;
+  ASSERT_TRUE(trace.ParseFromString(trace_raw));
+
+  int num_test_packets = 0;
+  uint64_t max_file_write_batches = 0;
+  for (const protos::TracePacket& packet : trace.packet()) {
+    if (packet.has_trace_stats()) {
+      max_file_write_batches = std::max(
+          max_file_write_batches, packet.trace_stats().file_write_batches());
+    }
+    if (!packet.has_for_testing())
+      continue;
+    std::string payload(static_cast<size_t>(num_test_packets + 1),
+                        'A' + (num_test_packets % 25));
+    ASSERT_EQ(payload, packet.for_testing().str());
+    num_test_packets++;
+  }
+  ASSERT_EQ(kNumTestPackets, num_test_packets);
+  ASSERT_GT(max_file_write_batches, 0u);
+}
+
 // Test the logic that allows the trace config to set the shm total size and
 // page size from the trace config. Also check that, if the config doesn't
 // specify a value we fall back on the hint provided by the producer.
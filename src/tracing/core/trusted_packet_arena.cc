@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/tracing/core/trusted_packet_arena.h"
+
+#include "perfetto/base/logging.h"
+#include "perfetto/protozero/proto_utils.h"
+#include "perfetto/trace/trusted_packet.pb.h"
+
+namespace perfetto {
+
+namespace {
+
+constexpr uint32_t kTrustedUidFieldNumber =
+    protos::TrustedPacket::kTrustedUidFieldNumber;
+constexpr uint32_t kTrustedPacketSequenceIdFieldNumber =
+    protos::TrustedPacket::kTrustedPacketSequenceIdFieldNumber;
+constexpr uint32_t kPreviousPacketDroppedFieldNumber =
+    protos::TrustedPacket::kPreviousPacketDroppedFieldNumber;
+
+}  // namespace
+
+// static
+constexpr size_t TrustedPacketArena::kMaxEncodedSize;
+
+TrustedPacketArena::TrustedPacketArena(size_t block_size)
+    : block_size_(block_size) {
+  PERFETTO_CHECK(block_size_ >= kMaxEncodedSize);
+}
+
+TrustedPacketArena::~TrustedPacketArena() = default;
+
+Slice TrustedPacketArena::Encode(uid_t trusted_uid,
+                                 uint32_t packet_sequence_id,
+                                 bool previous_packet_dropped) {
+  using protozero::proto_utils::MakeTagVarInt;
+  using protozero::proto_utils::WriteVarInt;
+
+  if (static_cast<size_t>(block_end_ - wptr_) < kMaxEncodedSize) {
+    // The previous block, if any, stays alive until the slices pointing into
+    // it are destroyed.
+    uint8_t* block = new uint8_t[block_size_];
+    block_.reset(block, std::default_delete<uint8_t[]>());
+    wptr_ = block;
+    block_end_ = block + block_size_;
+  }
+
+  uint8_t* const start = wptr_;
+  uint8_t* ptr = start;
+  ptr = WriteVarInt(MakeTagVarInt(kTrustedUidFieldNumber), ptr);
+  ptr = WriteVarInt(static_cast<int32_t>(trusted_uid), ptr);
+  ptr = WriteVarInt(MakeTagVarInt(kTrustedPacketSequenceIdFieldNumber), ptr);
+  ptr = WriteVarInt(packet_sequence_id, ptr);
+  if (previous_packet_dropped) {
+    ptr = WriteVarInt(MakeTagVarInt(kPreviousPacketDroppedFieldNumber), ptr);
+    *(ptr++) = 1;
+  }
+  const size_t size = static_cast<size_t>(ptr - start);
+  PERFETTO_DCHECK(size <= kMaxEncodedSize);
+  wptr_ = ptr;
+  return Slice(start, size, block_);
+}
+
+}  // namespace perfetto
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACING_CORE_TRUSTED_PACKET_ARENA_H_
+#define SRC_TRACING_CORE_TRUSTED_PACKET_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "perfetto/tracing/core/basic_types.h"
+#include "perfetto/tracing/core/slice.h"
+
+namespace perfetto {
+
+// Encodes the trusted fields that the service appends to each packet read from
+// a TraceBuffer (see TracingServiceImpl::ReadBuffers()). The fields are encoded
+// with protozero into fixed-size blocks, each of them shared by the slices of
+// many packets, rather than into a heap buffer per packet. A block is freed
+// once the arena has moved on to the next one and all the slices pointing into
+// it have been destroyed.
+class TrustedPacketArena {
+ public:
+  // Upper bound to the size of the encoded fields: the tags of
+  // trusted_uid (3), trusted_packet_sequence_id (10) and
+  // previous_packet_dropped (42) take 1, 1 and 2 bytes. The values take up to
+  // 10 (negative int32), 5 and 1 bytes.
+  static constexpr size_t kMaxEncodedSize = 20;
+
+  explicit TrustedPacketArena(size_t block_size = 4096);
+  ~TrustedPacketArena();
+
+  // Returns a slice containing the TrustedPacket fields
+  // {trusted_uid, trusted_packet_sequence_id, previous_packet_dropped}. The
+  // last one is omitted if false, like libprotobuf does for proto3 fields.
+  Slice Encode(uid_t trusted_uid,
+               uint32_t packet_sequence_id,
+               bool previous_packet_dropped);
+
+ private:
+  TrustedPacketArena(const TrustedPacketArena&) = delete;
+  TrustedPacketArena& operator=(const TrustedPacketArena&) = delete;
+
+  const size_t block_size_;
+  std::shared_ptr<const uint8_t> block_;
+  uint8_t* wptr_ = nullptr;
+  uint8_t* block_end_ = nullptr;
+};
+
+}  // namespace perfetto
+
+#endif  // SRC_TRACING_CORE_TRUSTED_PACKET_ARENA_H_
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/tracing/core/trusted_packet_arena.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "perfetto/trace/trusted_packet.pb.h"
+
+namespace perfetto {
+namespace {
+
+std::string ToString(const Slice& slice) {
+  return std::string(reinterpret_cast<const char*>(slice.start), slice.size);
+}
+
+std::string SerializeWithLibprotobuf(uid_t uid,
+                                     uint32_t sequence_id,
+                                     bool previous_packet_dropped) {
+  protos::TrustedPacket packet;
+  packet.set_trusted_uid(static_cast<int32_t>(uid));
+  packet.set_trusted_packet_sequence_id(sequence_id);
+  if (previous_packet_dropped)
+    packet.set_previous_packet_dropped(true);
+  return packet.SerializeAsString();
+}
+
+TEST(TrustedPacketArenaTest, MatchesLibprotobuf) {
+  TrustedPacketArena arena;
+  const uid_t kUids[] = {0, 1, 1000, 99999, 0x7fffffff, kInvalidUid};
+  const uint32_t kSequenceIds[] = {1, 127, 128, 0xffffffff};
+  for (uid_t uid : kUids) {
+    for (uint32_t seq_id : kSequenceIds) {
+      for (bool dropped : {false, true}) {
+        Slice slice = arena.Encode(uid, seq_id, dropped);
+        EXPECT_LE(slice.size, TrustedPacketArena::kMaxEncodedSize);
+        EXPECT_EQ(SerializeWithLibprotobuf(uid, seq_id, dropped),
+                  ToString(slice));
+      }
+    }
+  }
+}
+
+TEST(TrustedPacketArenaTest, SlicesOutliveArenaAndBlocks) {
+  std::vector<Slice> slices;
+  {
+    // A tiny block size, to force many block switches.
+    TrustedPacketArena arena(TrustedPacketArena::kMaxEncodedSize);
+    for (uint32_t i = 1; i <= 1000; i++)
+      slices.emplace_back(arena.Encode(i, i, i % 2 == 0));
+  }
+  for (uint32_t i = 1; i <= 1000; i++) {
+    EXPECT_EQ(SerializeWithLibprotobuf(i, i, i % 2 == 0),
+              ToString(slices[i - 1]));
+  }
+}
+
+}  // namespace
+}  // namespace perfetto
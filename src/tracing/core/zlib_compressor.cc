@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/tracing/core/zlib_compressor.h"
+
+#include <zlib.h>
+
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "perfetto/base/logging.h"
+#include "perfetto/protozero/proto_utils.h"
+#include "perfetto/trace/trusted_packet.pb.h"
+
+namespace perfetto {
+
+namespace {
+
+using protozero::proto_utils::MakeTagLengthDelimited;
+using protozero::proto_utils::WriteVarInt;
+
+// The TracePacket.compressed_packets field is only written by the service,
+// hence the field id is taken from the TrustedPacket proto.
+constexpr uint32_t kCompressedPacketsFieldNumber =
+    protos::TrustedPacket::kCompressedPacketsFieldNumber;
+
+// Max size of the proto preamble of the compressed_packets field: its tag and
+// its size, both as varints.
+constexpr size_t kMaxPreambleSize = 5 + 5;
+
+// Size of the first output slice, which is large enough for the typical
+// compression ratio of traces. The following ones are
+// kMaxCompressedSliceSize.
+constexpr size_t kInitialSliceSize = 16 * 1024;
+
+// Compresses a sequence of packets into a single TracePacket.
+class PacketCompressor {
+ public:
+  PacketCompressor() {
+    stream_.zalloc = Z_NULL;
+    stream_.zfree = Z_NULL;
+    stream_.opaque = Z_NULL;
+    PERFETTO_CHECK(deflateInit(&stream_, Z_DEFAULT_COMPRESSION) == Z_OK);
+  }
+
+  ~PacketCompressor() { deflateEnd(&stream_); }
+
+  void AddPacket(TracePacket* packet) {
+    char* preamble;
+    size_t preamble_size;
+    std::tie(preamble, preamble_size) = packet->GetProtoPreamble();
+    Deflate(preamble, preamble_size, Z_NO_FLUSH);
+    for (const Slice& slice : packet->slices())
+      Deflate(slice.start, slice.size, Z_NO_FLUSH);
+    uncompressed_size_ += preamble_size + packet->size();
+  }
+
+  // Finishes the zlib stream and returns the TracePacket that contains it.
+  TracePacket Finish() {
+    Deflate(nullptr, 0, Z_FINISH);
+    slices_.back().size = used_;
+
+    // The size of the compressed data is known only now, so the preamble goes
+    // into its own slice in front of the data slices.
+    size_t data_size = 0;
+    for (const Slice& slice : slices_)
+      data_size += slice.size;
+    PERFETTO_CHECK(data_size <= protozero::proto_utils::kMaxMessageLength);
+    Slice preamble = Slice::Allocate(kMaxPreambleSize);
+    uint8_t* end = WriteVarInt(
+        MakeTagLengthDelimited(kCompressedPacketsFieldNumber),
+        preamble.own_data());
+    end = WriteVarInt(data_size, end);
+    preamble.size = static_cast<size_t>(end - preamble.own_data());
+
+    TracePacket packet;
+    packet.AddSlice(std::move(preamble));
+    for (Slice& slice : slices_)
+      packet.AddSlice(std::move(slice));
+    slices_.clear();
+    return packet;
+  }
+
+  size_t uncompressed_size() const { return uncompressed_size_; }
+
+ private:
+  void Deflate(const void* data, size_t size, int flush) {
+    stream_.next_in = static_cast<Bytef*>(const_cast<void*>(data));
+    stream_.avail_in = static_cast<uInt>(size);
+    for (;;) {
+      // The compressed data is written into a list of slices rather than a
+      // single buffer, so that each of them can be sent in one IPC.
+      if (slices_.empty() || used_ == slices_.back().size) {
+        slices_.emplace_back(Slice::Allocate(
+            slices_.empty() ? kInitialSliceSize : kMaxCompressedSliceSize));
+        used_ = 0;
+      }
+      Slice& slice = slices_.back();
+      stream_.next_out = slice.own_data() + used_;
+      stream_.avail_out = static_cast<uInt>(slice.size - used_);
+      int res = deflate(&stream_, flush);
+      PERFETTO_CHECK(res == Z_OK || res == Z_STREAM_END || res == Z_BUF_ERROR);
+      used_ = slice.size - stream_.avail_out;
+      if (flush == Z_FINISH) {
+        if (res == Z_STREAM_END)
+          return;
+      } else if (stream_.avail_in == 0 && stream_.avail_out > 0) {
+        return;
+      }
+    }
+  }
+
+  z_stream stream_;
+  std::vector<Slice> slices_;
+  size_t used_ = 0;  // Bytes used of the last slice in |slices_|.
+  size_t uncompressed_size_ = 0;
+};
+
+}  // namespace
+
+void ZlibCompressPackets(std::vector<TracePacket>* packets) {
+  if (packets->empty())
+    return;
+
+  std::vector<TracePacket> compressed_packets;
+  std::unique_ptr<PacketCompressor> compressor;
+  for (TracePacket& packet : *packets) {
+    if (!compressor)
+      compressor.reset(new PacketCompressor());
+    compressor->AddPacket(&packet);
+    if (compressor->uncompressed_size() >= kMaxUncompressedBytesPerPacket) {
+      compressed_packets.emplace_back(compressor->Finish());
+      compressor.reset();
+    }
+  }
+  if (compressor)
+    compressed_packets.emplace_back(compressor->Finish());
+  *packets = std::move(compressed_packets);
+}
+
+}  // namespace perfetto
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACING_CORE_ZLIB_COMPRESSOR_H_
+#define SRC_TRACING_CORE_ZLIB_COMPRESSOR_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "perfetto/tracing/core/trace_packet.h"
+
+namespace perfetto {
+
+// Upper bound to the size of the packets that are compressed together into a
+// single TracePacket. This bounds the memory needed to decompress a packet.
+constexpr size_t kMaxUncompressedBytesPerPacket = 512 * 1024;
+
+// Upper bound to the size of the slices of the compressed packets. A
+// compressed packet can be larger than an IPC frame, but each of its slices
+// must fit in one (see ConsumerIPCService::RemoteConsumer::SendTraceData()).
+constexpr size_t kMaxCompressedSliceSize = 64 * 1024;
+
+// Replaces |packets| with a (much shorter) list of TracePacket(s) which have
+// only the compressed_packets field set. The field contains the original
+// packets encoded as a Trace proto (i.e., each one with the same preamble that
+// is used when writing them into a file) and compressed as a zlib stream.
+// Order is preserved: decompressing the returned packets in order yields the
+// original packets in the original order.
+void ZlibCompressPackets(std::vector<TracePacket>* packets);
+
+}  // namespace perfetto
+
+#endif  // SRC_TRACING_CORE_ZLIB_COMPRESSOR_H_
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/tracing/core/zlib_compressor.h"
+
+#include <zlib.h>
+
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "perfetto/trace/trace.pb.h"
+#include "perfetto/trace/trace_packet.pb.h"
+
+namespace perfetto {
+namespace {
+
+std::string Inflate(const std::string& compressed) {
+  z_stream stream{};
+  EXPECT_EQ(inflateInit(&stream), Z_OK);
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  stream.avail_in = static_cast<uInt>(compressed.size());
+  std::string res;
+  char buf[4096];
+  int ret;
+  do {
+    stream.next_out = reinterpret_cast<Bytef*>(buf);
+    stream.avail_out = sizeof(buf);
+    ret = inflate(&stream, Z_NO_FLUSH);
+    EXPECT_TRUE(ret == Z_OK || ret == Z_STREAM_END);
+    res.append(buf, sizeof(buf) - stream.avail_out);
+  } while (ret == Z_OK);
+  inflateEnd(&stream);
+  return res;
+}
+
+// Decompresses |packets| and returns the original packets.
+std::vector<protos::TracePacket> Decompress(
+    const std::vector<TracePacket>& packets) {
+  std::vector<protos::TracePacket> res;
+  for (const TracePacket& packet : packets) {
+    protos::TracePacket proto;
+    EXPECT_TRUE(packet.Decode(&proto));
+    EXPECT_TRUE(proto.has_compressed_packets());
+    protos::Trace trace;
+    EXPECT_TRUE(trace.ParseFromString(Inflate(proto.compressed_packets())));
+    for (const auto& inner : trace.packet())
+      res.emplace_back(inner);
+  }
+  return res;
+}
+
+TEST(ZlibCompressorTest, NoPackets) {
+  std::vector<TracePacket> packets;
+  ZlibCompressPackets(&packets);
+  EXPECT_TRUE(packets.empty());
+}
+
+TEST(ZlibCompressorTest, RoundTrip) {
+  std::vector<std::string> serialized;
+  for (int i = 0; i < 100; i++) {
+    protos::TracePacket proto;
+    proto.mutable_for_testing()->set_str("payload " + std::to_string(i));
+    proto.set_timestamp(static_cast<uint64_t>(i));
+    serialized.emplace_back(proto.SerializeAsString());
+  }
+
+  // Split each packet in two slices, like the service does with the trusted
+  // fields.
+  std::vector<TracePacket> packets(serialized.size());
+  for (size_t i = 0; i < serialized.size(); i++) {
+    const std::string& ser = serialized[i];
+    packets[i].AddSlice(&ser[0], 3);
+    packets[i].AddSlice(&ser[3], ser.size() - 3);
+  }
+
+  ZlibCompressPackets(&packets);
+  ASSERT_EQ(packets.size(), 1u);
+  // The compressed_packets preamble and the compressed data.
+  ASSERT_EQ(packets[0].slices().size(), 2u);
+
+  std::vector<protos::TracePacket> decompressed = Decompress(packets);
+  ASSERT_EQ(decompressed.size(), serialized.size());
+  for (size_t i = 0; i < serialized.size(); i++)
+    ASSERT_EQ(decompressed[i].SerializeAsString(), serialized[i]);
+}
+
+// Packets larger than kMaxUncompressedBytesPerPacket in total are split in
+// several compressed packets. Random data doesn't compress, which exercises
+// the split of the output into several slices.
+TEST(ZlibCompressorTest, LargeInput) {
+  std::minstd_rand0 rnd(0);
+  std::vector<std::string> serialized;
+  size_t total_size = 0;
+  while (total_size < kMaxUncompressedBytesPerPacket * 3) {
+    std::string payload(rnd() % 10000, '\0');
+    for (char& c : payload)
+      c = static_cast<char>(rnd());
+    protos::TracePacket proto;
+    proto.mutable_for_testing()->set_str(payload);
+    serialized.emplace_back(proto.SerializeAsString());
+    total_size += serialized.back().size();
+  }
+
+  std::vector<TracePacket> packets(serialized.size());
+  for (size_t i = 0; i < serialized.size(); i++)
+    packets[i].AddSlice(&serialized[i][0], serialized[i].size());
+
+  ZlibCompressPackets(&packets);
+  EXPECT_GE(packets.size(), 3u);
+  EXPECT_LE(packets.size(), 4u);
+  for (const TracePacket& packet : packets) {
+    EXPECT_GT(packet.slices().size(), 2u);
+    for (const Slice& slice : packet.slices())
+      EXPECT_LE(slice.size, kMaxCompressedSliceSize);
+  }
+
+  std::vector<protos::TracePacket> decompressed = Decompress(packets);
+  ASSERT_EQ(decompressed.size(), serialized.size());
+  for (size_t i = 0; i < serialized.size(); i++)
+    ASSERT_EQ(decompressed[i].SerializeAsString(), serialized[i]);
+}
+
+}  // namespace
+}  // namespace perfetto
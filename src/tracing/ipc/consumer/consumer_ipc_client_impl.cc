@@ -25,6 +25,8 @@
 #include "perfetto/tracing/core/observable_events.h"
 #include "perfetto/tracing/core/trace_config.h"
 #include "perfetto/tracing/core/trace_stats.h"
+#include "src/tracing/ipc/posix_shared_memory.h"
+#include "src/tracing/ipc/read_buffers_ring.h"
 
 // TODO(fmayer): Add a test to check to what happens when ConsumerIPCClientImpl
 // gets destroyed w.r.t. the Consumer pointer. Also think to lifetime of the
@@ -36,17 +38,21 @@ namespace perfetto {
 std::unique_ptr<TracingService::ConsumerEndpoint> ConsumerIPCClient::Connect(
     const char* service_sock_name,
     Consumer* consumer,
-    base::TaskRunner* task_runner) {
+    base::TaskRunner* task_runner,
+    size_t read_buffers_shm_size) {
   return std::unique_ptr<TracingService::ConsumerEndpoint>(
-      new ConsumerIPCClientImpl(service_sock_name, consumer, task_runner));
+      new ConsumerIPCClientImpl(service_sock_name, consumer, task_runner,
+                                read_buffers_shm_size));
 }
 
 ConsumerIPCClientImpl::ConsumerIPCClientImpl(const char* service_sock_name,
                                              Consumer* consumer,
-                                             base::TaskRunner* task_runner)
+                                             base::TaskRunner* task_runner,
+                                             size_t read_buffers_shm_size)
     : consumer_(consumer),
       ipc_channel_(ipc::Client::CreateInstance(service_sock_name, task_runner)),
       consumer_port_(this /* event_listener */),
+      read_buffers_shm_size_(read_buffers_shm_size),
       weak_ptr_factory_(this) {
   ipc_channel_->BindService(consumer_port_.GetWeakPtr());
 }
@@ -152,8 +158,10 @@ void ConsumerIPCClientImpl::ReadBuffers() {
       [this](ipc::AsyncResult<protos::ReadBuffersResponse> response) {
         OnReadBuffersResponse(std::move(response));
       });
-  consumer_port_.ReadBuffers(protos::ReadBuffersRequest(),
-                             std::move(async_response));
+  protos::ReadBuffersRequest req;
+  req.set_shared_memory_size_hint_bytes(
+      static_cast<uint32_t>(read_buffers_shm_size_));
+  consumer_port_.ReadBuffers(req, std::move(async_response));
 }
 
 void ConsumerIPCClientImpl::OnReadBuffersResponse(
@@ -163,14 +171,48 @@ void ConsumerIPCClientImpl::OnReadBuffersResponse(
     return;
   }
   std::vector<TracePacket> trace_packets;
+
+  // The packets in the shared memory buffer precede the ones in |slices|.
+  const bool uses_shm = response->has_shared_memory_write_offset();
+  if (uses_shm && !ReadPacketsFromSharedMemory(
+                      response->shared_memory_write_offset(), &trace_packets)) {
+    PERFETTO_ELOG("Failed to read the ReadBuffers() shared memory buffer");
+    return;
+  }
+
   for (auto& resp_slice : *response->mutable_slices()) {
     partial_packet_.AddSlice(
         Slice(std::unique_ptr<std::string>(resp_slice.release_data())));
     if (resp_slice.last_slice_for_packet())
       trace_packets.emplace_back(std::move(partial_packet_));
   }
+  auto weak_this = weak_ptr_factory_.GetWeakPtr();
   if (!trace_packets.empty() || !response.has_more())
     consumer_->OnTraceData(std::move(trace_packets), response.has_more());
+
+  // The consumer is done with the packets pointing into the shared memory
+  // buffer: let the service reuse that space.
+  if (!weak_this || !uses_shm || !connected_)
+    return;
+  protos::NotifyReadBuffersConsumedRequest req;
+  req.set_shared_memory_read_offset(read_buffers_ring_->read_pos());
+  consumer_port_.NotifyReadBuffersConsumed(
+      req, ipc::Deferred<protos::NotifyReadBuffersConsumedResponse>());
+}
+
+bool ConsumerIPCClientImpl::ReadPacketsFromSharedMemory(
+    uint64_t write_offset,
+    std::vector<TracePacket>* trace_packets) {
+  if (!read_buffers_ring_) {
+    // The service passes the buffer along with the first response using it.
+    base::ScopedFile shm_fd = ipc_channel_->TakeReceivedFD();
+    if (!shm_fd)
+      return false;
+    read_buffers_shm_ = PosixSharedMemory::AttachToFd(std::move(shm_fd));
+    read_buffers_ring_.reset(new ReadBuffersRing(read_buffers_shm_->start(),
+                                                 read_buffers_shm_->size()));
+  }
+  return read_buffers_ring_->ReadPackets(write_offset, trace_packets);
 }
 
 void ConsumerIPCClientImpl::OnEnableTracingResponse(
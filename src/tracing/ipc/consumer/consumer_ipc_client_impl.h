@@ -42,6 +42,8 @@ class Client;
 }  // namespace ipc
 
 class Consumer;
+class PosixSharedMemory;
+class ReadBuffersRing;
 class TraceConfig;
 
 // Exposes a Service endpoint to Consumer(s), proxying all requests through a
@@ -53,7 +55,8 @@ class ConsumerIPCClientImpl : public TracingService::ConsumerEndpoint,
  public:
   ConsumerIPCClientImpl(const char* service_sock_name,
                         Consumer*,
-                        base::TaskRunner*);
+                        base::TaskRunner*,
+                        size_t read_buffers_shm_size);
   ~ConsumerIPCClientImpl() override;
 
   // TracingService::ConsumerEndpoint implementation.
@@ -81,6 +84,11 @@ class ConsumerIPCClientImpl : public TracingService::ConsumerEndpoint,
   void OnReadBuffersResponse(ipc::AsyncResult<protos::ReadBuffersResponse>);
   void OnEnableTracingResponse(ipc::AsyncResult<protos::EnableTracingResponse>);
 
+  // Reads the packets notified by a ReadBuffersResponse from the shared memory
+  // buffer. Returns false if the buffer is missing or malformed.
+  bool ReadPacketsFromSharedMemory(uint64_t write_offset,
+                                   std::vector<TracePacket>*);
+
   // TODO(primiano): think to dtor order, do we rely on any specific sequence?
   Consumer* const consumer_;
 
@@ -100,6 +108,13 @@ class ConsumerIPCClientImpl : public TracingService::ConsumerEndpoint,
   // one with |last_slice_for_packet| == true is received.
   TracePacket partial_packet_;
 
+  // See ConsumerIPCClient::Connect(). When not zero, the service is asked to
+  // pass the packets through |read_buffers_shm_|, which is received along
+  // with the first ReadBuffersResponse.
+  const size_t read_buffers_shm_size_;
+  std::unique_ptr<PosixSharedMemory> read_buffers_shm_;
+  std::unique_ptr<ReadBuffersRing> read_buffers_ring_;
+
   // Keep last.
   base::WeakPtrFactory<ConsumerIPCClientImpl> weak_ptr_factory_;
 };
@@ -31,9 +31,13 @@
 #include "perfetto/base/logging.h"
 #include "perfetto/base/temp_file.h"
 
-#if PERFETTO_BUILDFLAG(PERFETTO_OS_ANDROID)
+#if PERFETTO_BUILDFLAG(PERFETTO_OS_ANDROID) || \
+    PERFETTO_BUILDFLAG(PERFETTO_OS_LINUX)
 #include <linux/memfd.h>
 #include <sys/syscall.h>
+#define PERFETTO_USE_MEMFD() 1
+#else
+#define PERFETTO_USE_MEMFD() 0
 #endif
 
 namespace perfetto {
@@ -41,14 +45,16 @@ namespace perfetto {
 // static
 std::unique_ptr<PosixSharedMemory> PosixSharedMemory::Create(size_t size) {
   base::ScopedFile fd;
-#if PERFETTO_BUILDFLAG(PERFETTO_OS_ANDROID)
+#if PERFETTO_USE_MEMFD()
   bool is_memfd = false;
   fd.reset(static_cast<int>(syscall(__NR_memfd_create, "perfetto_shmem",
                                     MFD_CLOEXEC | MFD_ALLOW_SEALING)));
   is_memfd = !!fd;
 
   if (!fd) {
-    // TODO: if this fails on Android we should fall back on ashmem.
+    // TODO: if this fails on Android we should fall back on ashmem. On Linux
+    // the unlinked temporary file below is used instead (e.g. pre-3.17
+    // kernels).
     PERFETTO_DPLOG("memfd_create() failed");
   }
 #endif
@@ -59,7 +65,7 @@ std::unique_ptr<PosixSharedMemory> PosixSharedMemory::Create(size_t size) {
   PERFETTO_CHECK(fd);
   int res = ftruncate(fd.get(), static_cast<off_t>(size));
   PERFETTO_CHECK(res == 0);
-#if PERFETTO_BUILDFLAG(PERFETTO_OS_ANDROID)
+#if PERFETTO_USE_MEMFD()
   if (is_memfd) {
     res = fcntl(*fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
     PERFETTO_DCHECK(res == 0);
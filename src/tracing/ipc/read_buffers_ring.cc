@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/tracing/ipc/read_buffers_ring.h"
+
+#include <string.h>
+
+#include "perfetto/base/logging.h"
+#include "perfetto/base/utils.h"
+#include "perfetto/tracing/core/trace_packet.h"
+
+namespace perfetto {
+
+namespace {
+
+constexpr size_t kHeaderSize = sizeof(uint32_t);
+
+// Size taken in the buffer by a packet of |packet_size| bytes.
+inline size_t RecordSize(size_t packet_size) {
+  return base::AlignUp<kHeaderSize>(kHeaderSize + packet_size);
+}
+
+}  // namespace
+
+// static
+constexpr uint32_t ReadBuffersRing::kWrapMarker;
+
+ReadBuffersRing::ReadBuffersRing(void* start, size_t size)
+    : start_(static_cast<uint8_t*>(start)), size_(size) {
+  PERFETTO_CHECK(size_ > 0 && size_ % kHeaderSize == 0);
+}
+
+bool ReadBuffersRing::CanFit(size_t packet_size) const {
+  return packet_size < kWrapMarker && RecordSize(packet_size) <= size_;
+}
+
+bool ReadBuffersRing::TryWritePacket(const TracePacket& packet) {
+  const size_t packet_size = packet.size();
+  if (!CanFit(packet_size))
+    return false;
+  const size_t record_size = RecordSize(packet_size);
+  size_t index = static_cast<size_t>(write_pos_ % size_);
+  const size_t bytes_to_end = size_ - index;
+
+  // Packets are never split across the end of the buffer.
+  const bool needs_wrap = record_size > bytes_to_end;
+  const size_t bytes_needed = record_size + (needs_wrap ? bytes_to_end : 0);
+  const uint64_t bytes_free = size_ - (write_pos_ - read_pos_);
+  if (bytes_needed > bytes_free)
+    return false;
+
+  if (needs_wrap) {
+    memcpy(start_ + index, &kWrapMarker, kHeaderSize);
+    write_pos_ += bytes_to_end;
+    index = 0;
+  }
+  const uint32_t header = static_cast<uint32_t>(packet_size);
+  memcpy(start_ + index, &header, kHeaderSize);
+  uint8_t* wptr = start_ + index + kHeaderSize;
+  for (const Slice& slice : packet.slices()) {
+    memcpy(wptr, slice.start, slice.size);
+    wptr += slice.size;
+  }
+  write_pos_ += record_size;
+  return true;
+}
+
+bool ReadBuffersRing::SetReadPosition(uint64_t read_pos) {
+  if (read_pos < read_pos_ || read_pos > write_pos_)
+    return false;
+  read_pos_ = read_pos;
+  return true;
+}
+
+bool ReadBuffersRing::ReadPackets(uint64_t write_pos,
+                                  std::vector<TracePacket>* packets) {
+  if (write_pos < read_pos_ || write_pos - read_pos_ > size_)
+    return false;
+  while (read_pos_ < write_pos) {
+    const size_t index = static_cast<size_t>(read_pos_ % size_);
+    const size_t bytes_to_end = size_ - index;
+    uint32_t header;
+    memcpy(&header, start_ + index, kHeaderSize);
+    if (header == kWrapMarker) {
+      if (bytes_to_end > write_pos - read_pos_)
+        return false;
+      read_pos_ += bytes_to_end;
+      continue;
+    }
+    const size_t record_size = RecordSize(header);
+    if (record_size > bytes_to_end || record_size > write_pos - read_pos_)
+      return false;
+    packets->emplace_back();
+    packets->back().AddSlice(start_ + index + kHeaderSize, header);
+    read_pos_ += record_size;
+  }
+  write_pos_ = write_pos;
+  return true;
+}
+
+}  // namespace perfetto
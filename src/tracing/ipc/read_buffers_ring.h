@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_TRACING_IPC_READ_BUFFERS_RING_H_
+#define SRC_TRACING_IPC_READ_BUFFERS_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace perfetto {
+
+class TracePacket;
+
+// The ring buffer used by ReadBuffers() to pass trace packets from the service
+// to a consumer through shared memory, rather than serializing them into the
+// IPC replies. See ReadBuffersResponse.shared_memory_write_offset in
+// consumer_port.proto for the format.
+// The read and write positions are offsets since the creation of the ring,
+// which are exchanged over IPC: neither side relies on the other one updating
+// any state in the shared memory. The service uses the write methods and the
+// consumer the read ones, each on its own mapping of the buffer.
+class ReadBuffersRing {
+ public:
+  // Stored in place of the size of a packet when the next packet starts at
+  // the beginning of the buffer.
+  static constexpr uint32_t kWrapMarker = 0xffffffff;
+
+  // |size| must be a multiple of 4.
+  ReadBuffersRing(void* start, size_t size);
+
+  // Returns false if a packet of |packet_size| bytes would not fit into the
+  // buffer even when it is empty.
+  bool CanFit(size_t packet_size) const;
+
+  // Copies |packet| into the buffer. Returns false if there is not enough free
+  // space for it until the consumer has read more packets.
+  bool TryWritePacket(const TracePacket& packet);
+
+  // Sets the position up to which the consumer has read the buffer, as
+  // reported over IPC. Returns false if |read_pos| is not valid.
+  bool SetReadPosition(uint64_t read_pos);
+
+  // Appends to |packets| the packets written between the current read position
+  // and |write_pos|. The packets are not copied: their slices point into the
+  // buffer and are valid only until the space is handed back to the service.
+  // Returns false if the content of the buffer is malformed.
+  bool ReadPackets(uint64_t write_pos, std::vector<TracePacket>* packets);
+
+  uint64_t read_pos() const { return read_pos_; }
+  uint64_t write_pos() const { return write_pos_; }
+  size_t size() const { return size_; }
+
+ private:
+  ReadBuffersRing(const ReadBuffersRing&) = delete;
+  ReadBuffersRing& operator=(const ReadBuffersRing&) = delete;
+
+  uint8_t* const start_;
+  const size_t size_;
+  uint64_t read_pos_ = 0;
+  uint64_t write_pos_ = 0;
+};
+
+}  // namespace perfetto
+
+#endif  // SRC_TRACING_IPC_READ_BUFFERS_RING_H_
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/tracing/ipc/read_buffers_ring.h"
+
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "perfetto/tracing/core/trace_packet.h"
+
+namespace perfetto {
+namespace {
+
+constexpr size_t kRingSize = 256;
+
+class ReadBuffersRingTest : public ::testing::Test {
+ protected:
+  ReadBuffersRingTest()
+      : buf_(new uint32_t[kRingSize / sizeof(uint32_t)]),
+        writer_(buf_.get(), kRingSize),
+        reader_(buf_.get(), kRingSize) {
+    memset(buf_.get(), 0xcc, kRingSize);
+  }
+
+  // Writes a packet made of two slices, to check that they are coalesced.
+  bool WritePacket(const std::string& content) {
+    size_t half = content.size() / 2;
+    TracePacket packet;
+    packet.AddSlice(content.data(), half);
+    packet.AddSlice(content.data() + half, content.size() - half);
+    return writer_.TryWritePacket(packet);
+  }
+
+  std::vector<std::string> ReadPackets() {
+    std::vector<TracePacket> packets;
+    EXPECT_TRUE(reader_.ReadPackets(writer_.write_pos(), &packets));
+    std::vector<std::string> contents;
+    for (const TracePacket& packet : packets) {
+      EXPECT_EQ(1u, packet.slices().size());
+      const Slice& slice = packet.slices().front();
+      contents.emplace_back(reinterpret_cast<const char*>(slice.start),
+                            slice.size);
+    }
+    return contents;
+  }
+
+  std::unique_ptr<uint32_t[]> buf_;
+  ReadBuffersRing writer_;
+  ReadBuffersRing reader_;
+};
+
+TEST_F(ReadBuffersRingTest, WriteAndRead) {
+  ASSERT_TRUE(WritePacket("a"));
+  ASSERT_TRUE(WritePacket("bcdef"));
+  ASSERT_TRUE(WritePacket(""));
+  EXPECT_EQ(8u + 12u + 4u, writer_.write_pos());
+  EXPECT_EQ(std::vector<std::string>({"a", "bcdef", ""}), ReadPackets());
+  EXPECT_EQ(writer_.write_pos(), reader_.read_pos());
+
+  // Nothing new to read.
+  EXPECT_TRUE(ReadPackets().empty());
+}
+
+TEST_F(ReadBuffersRingTest, CanFit) {
+  EXPECT_TRUE(writer_.CanFit(0));
+  EXPECT_TRUE(writer_.CanFit(kRingSize - 4));
+  EXPECT_FALSE(writer_.CanFit(kRingSize - 3));
+  EXPECT_FALSE(writer_.CanFit(kRingSize));
+}
+
+TEST_F(ReadBuffersRingTest, FullUntilRead) {
+  const std::string content(60, 'x');  // 64 bytes per record.
+  for (size_t i = 0; i < kRingSize / 64; i++)
+    ASSERT_TRUE(WritePacket(content));
+  EXPECT_FALSE(WritePacket(""));
+  EXPECT_EQ(kRingSize / 64, ReadPackets().size());
+
+  // The space is reusable only once the consumer reports its position.
+  EXPECT_FALSE(WritePacket(content));
+  ASSERT_TRUE(writer_.SetReadPosition(64));
+  ASSERT_TRUE(WritePacket(content));
+  EXPECT_FALSE(WritePacket(""));
+}
+
+TEST_F(ReadBuffersRingTest, Wrap) {
+  const std::string first(100, 'a');   // 104 bytes per record.
+  const std::string second(150, 'b');  // 156 bytes per record.
+  ASSERT_TRUE(WritePacket(first));
+  ASSERT_TRUE(WritePacket(first));
+  EXPECT_EQ(std::vector<std::string>({first, first}), ReadPackets());
+  ASSERT_TRUE(writer_.SetReadPosition(reader_.read_pos()));
+
+  // Doesn't fit into the 48 bytes left at the end, so it is written at the
+  // beginning of the buffer after a wrap marker.
+  ASSERT_TRUE(WritePacket(second));
+  EXPECT_EQ(kRingSize + 156, writer_.write_pos());
+  EXPECT_EQ(std::vector<std::string>({second}), ReadPackets());
+  ASSERT_TRUE(writer_.SetReadPosition(reader_.read_pos()));
+
+  // Go around the buffer a few times with packets of varying sizes.
+  for (int i = 0; i < 10; i++) {
+    std::string content(static_cast<size_t>(20 + i * 11),
+                        static_cast<char>('c' + i));
+    ASSERT_TRUE(WritePacket(content));
+    EXPECT_EQ(std::vector<std::string>({content}), ReadPackets());
+    ASSERT_TRUE(writer_.SetReadPosition(reader_.read_pos()));
+  }
+}
+
+TEST_F(ReadBuffersRingTest, RejectInvalidPositions) {
+  ASSERT_TRUE(WritePacket("abc"));
+
+  // Past the write position.
+  EXPECT_FALSE(writer_.SetReadPosition(writer_.write_pos() + 4));
+  std::vector<TracePacket> packets;
+  EXPECT_FALSE(reader_.ReadPackets(kRingSize + 8, &packets));
+
+  // In the middle of a record.
+  EXPECT_FALSE(reader_.ReadPackets(4, &packets));
+  EXPECT_TRUE(packets.empty());
+
+  // A corrupted size.
+  buf_[0] = 1000;
+  EXPECT_FALSE(reader_.ReadPackets(writer_.write_pos(), &packets));
+  EXPECT_TRUE(packets.empty());
+}
+
+}  // namespace
+}  // namespace perfetto
@@ -17,10 +17,14 @@
 #include "src/tracing/ipc/service/consumer_ipc_service.h"
 
 #include <inttypes.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include "perfetto/base/logging.h"
 #include "perfetto/base/scoped_file.h"
 #include "perfetto/base/task_runner.h"
+#include "perfetto/base/utils.h"
 #include "perfetto/ipc/basic_types.h"
 #include "perfetto/ipc/host.h"
 #include "perfetto/tracing/core/shared_memory_abi.h"
@@ -29,9 +33,34 @@
 #include "perfetto/tracing/core/trace_packet.h"
 #include "perfetto/tracing/core/trace_stats.h"
 #include "perfetto/tracing/core/tracing_service.h"
+#include "src/tracing/core/zlib_compressor.h"
+#include "src/tracing/ipc/posix_shared_memory.h"
+#include "src/tracing/ipc/read_buffers_ring.h"
 
 namespace perfetto {
 
+namespace {
+
+// Bounds for the size of the shared memory buffer used by ReadBuffers(), which
+// is requested by the consumer.
+constexpr size_t kMinReadBuffersShmSize = 64 * 1024;
+constexpr size_t kMaxReadBuffersShmSize = 32 * 1024 * 1024;
+
+// Returns a copy of |packet| which owns its memory.
+TracePacket CopyPacket(const TracePacket& packet) {
+  Slice slice = Slice::Allocate(packet.size());
+  uint8_t* wptr = slice.own_data();
+  for (const Slice& src : packet.slices()) {
+    memcpy(wptr, src.start, src.size);
+    wptr += src.size;
+  }
+  TracePacket copy;
+  copy.AddSlice(std::move(slice));
+  return copy;
+}
+
+}  // namespace
+
 ConsumerIPCService::ConsumerIPCService(TracingService* core_service)
     : core_service_(core_service), weak_ptr_factory_(this) {}
 
@@ -103,13 +132,31 @@ void ConsumerIPCService::DisableTracing(const protos::DisableTracingRequest&,
 }
 
 // Called by the IPC layer.
-void ConsumerIPCService::ReadBuffers(const protos::ReadBuffersRequest&,
+void ConsumerIPCService::ReadBuffers(const protos::ReadBuffersRequest& req,
                                      DeferredReadBuffersResponse resp) {
   RemoteConsumer* remote_consumer = GetConsumerForCurrentRequest();
   remote_consumer->read_buffers_response = std::move(resp);
+  if (req.shared_memory_size_hint_bytes() > 0)
+    remote_consumer->EnableSharedMemoryReads(
+        req.shared_memory_size_hint_bytes());
   remote_consumer->service_endpoint->ReadBuffers();
 }
 
+// Called by the IPC layer.
+void ConsumerIPCService::NotifyReadBuffersConsumed(
+    const protos::NotifyReadBuffersConsumedRequest& req,
+    DeferredNotifyReadBuffersConsumedResponse resp) {
+  GetConsumerForCurrentRequest()->OnSharedMemoryRead(
+      req.shared_memory_read_offset());
+
+  // The consumer doesn't expect any meaningful response, avoid a useless IPC
+  // in that case.
+  if (resp.IsBound()) {
+    resp.Resolve(
+        ipc::AsyncResult<protos::NotifyReadBuffersConsumedResponse>::Create());
+  }
+}
+
 // Called by the IPC layer.
 void ConsumerIPCService::FreeBuffers(const protos::FreeBuffersRequest&,
                                      DeferredFreeBuffersResponse resp) {
@@ -204,6 +251,8 @@ void ConsumerIPCService::OnFlushCallback(
 // RemoteConsumer methods
 ////////////////////////////////////////////////////////////////////////////////
 
+constexpr size_t ConsumerIPCService::RemoteConsumer::kMaxPendingPacketsBytes;
+
 ConsumerIPCService::RemoteConsumer::RemoteConsumer() = default;
 ConsumerIPCService::RemoteConsumer::~RemoteConsumer() = default;
 
@@ -230,19 +279,134 @@ void ConsumerIPCService::RemoteConsumer::OnTraceData(
   if (!read_buffers_response.IsBound())
     return;
 
+  if (!use_shared_memory_) {
+    SendTraceData(std::move(trace_packets), has_more);
+    return;
+  }
+  const size_t num_new_packets = trace_packets.size();
+  for (TracePacket& packet : trace_packets) {
+    pending_packets_bytes_ += packet.size();
+    pending_packets_.emplace_back(std::move(packet));
+  }
+  pending_packets_complete_ = !has_more;
+  WritePendingPacketsToSharedMemory();
+
+  // The service keeps handing over packets regardless of the consumer acking
+  // them. If the consumer doesn't keep up, send the pending packets through
+  // the IPC reply instead of buffering the whole trace. This is throttled by
+  // the socket, and the consumer reads them after the packets in the shared
+  // memory buffer, so the order is preserved.
+  if (pending_packets_bytes_ > kMaxPendingPacketsBytes) {
+    SendPendingPacketsInline();
+    return;
+  }
+
+  // The packets point into the trace buffer, which can be overwritten as soon
+  // as this returns. Copy the ones that have to wait for the consumer.
+  const size_t num_to_copy = std::min(num_new_packets, pending_packets_.size());
+  for (auto it = pending_packets_.end() - static_cast<ptrdiff_t>(num_to_copy);
+       it != pending_packets_.end(); ++it) {
+    *it = CopyPacket(*it);
+  }
+}
+
+void ConsumerIPCService::RemoteConsumer::EnableSharedMemoryReads(
+    size_t size_hint) {
+  if (!read_buffers_shm_) {
+    size_t size = std::min(std::max(size_hint, kMinReadBuffersShmSize),
+                           kMaxReadBuffersShmSize);
+    read_buffers_shm_ = PosixSharedMemory::Create(
+        base::AlignUp<base::kPageSize>(size));
+    read_buffers_ring_.reset(new ReadBuffersRing(read_buffers_shm_->start(),
+                                                 read_buffers_shm_->size()));
+  }
+  use_shared_memory_ = true;
+  pending_packets_.clear();
+  pending_packets_bytes_ = 0;
+  pending_packets_complete_ = false;
+}
+
+void ConsumerIPCService::RemoteConsumer::OnSharedMemoryRead(
+    uint64_t read_pos) {
+  if (!read_buffers_ring_ || !read_buffers_ring_->SetReadPosition(read_pos)) {
+    PERFETTO_DLOG("Invalid NotifyReadBuffersConsumed() offset");
+    return;
+  }
+  if (use_shared_memory_ && read_buffers_response.IsBound())
+    WritePendingPacketsToSharedMemory();
+}
+
+void ConsumerIPCService::RemoteConsumer::WritePendingPacketsToSharedMemory() {
+  bool wrote_packets = false;
+  while (!pending_packets_.empty()) {
+    TracePacket& packet = pending_packets_.front();
+    if (!read_buffers_ring_->CanFit(packet.size())) {
+      // The packet is too big for the shared memory buffer. Send it inline,
+      // the consumer reads it after the packets notified so far.
+      std::vector<TracePacket> inline_packets;
+      pending_packets_bytes_ -= packet.size();
+      inline_packets.emplace_back(std::move(packet));
+      pending_packets_.pop_front();
+      SendTraceData(std::move(inline_packets), /*has_more=*/true);
+      wrote_packets = false;
+      continue;
+    }
+    // If the packet doesn't fit, NotifyReadBuffersConsumed() will resume
+    // writing once the consumer has read the packets notified so far.
+    if (!read_buffers_ring_->TryWritePacket(packet))
+      break;
+    pending_packets_bytes_ -= packet.size();
+    pending_packets_.pop_front();
+    wrote_packets = true;
+  }
+
+  const bool done = pending_packets_complete_ && pending_packets_.empty();
+  if (wrote_packets || done)
+    SendTraceData(std::vector<TracePacket>(), /*has_more=*/!done);
+  if (done)
+    use_shared_memory_ = false;
+}
+
+void ConsumerIPCService::RemoteConsumer::SendPendingPacketsInline() {
+  std::vector<TracePacket> packets;
+  packets.reserve(pending_packets_.size());
+  for (TracePacket& packet : pending_packets_)
+    packets.emplace_back(std::move(packet));
+  pending_packets_.clear();
+  pending_packets_bytes_ = 0;
+
+  const bool done = pending_packets_complete_;
+  SendTraceData(std::move(packets), /*has_more=*/!done);
+  if (done)
+    use_shared_memory_ = false;
+}
+
+void ConsumerIPCService::RemoteConsumer::SendTraceData(
+    std::vector<TracePacket> trace_packets,
+    bool has_more) {
   auto result = ipc::AsyncResult<protos::ReadBuffersResponse>::Create();
 
   // A TracePacket might be too big to fit into a single IPC message (max
   // kIPCBufferSize). However a TracePacket is made of slices and each slice
   // is way smaller than kIPCBufferSize (a slice size is effectively bounded by
-  // the max chunk size of the SharedMemoryABI). When sending a TracePacket,
-  // if its slices don't fit within one IPC, chunk them over several contiguous
-  // IPCs using the |last_slice_for_packet| for glueing on the other side.
+  // the max chunk size of the SharedMemoryABI, or by kMaxCompressedSliceSize
+  // for compressed packets). When sending a TracePacket, if its slices don't
+  // fit within one IPC, chunk them over several contiguous IPCs using the
+  // |last_slice_for_packet| for glueing on the other side.
   static_assert(ipc::kIPCBufferSize >= SharedMemoryABI::kMaxPageSize * 2,
                 "kIPCBufferSize too small given the max possible slice size");
+  static_assert(ipc::kIPCBufferSize >= kMaxCompressedSliceSize * 2,
+                "kIPCBufferSize too small given the max compressed slice size");
 
   auto send_ipc_reply = [this, &result](bool more) {
     result.set_has_more(more);
+    if (use_shared_memory_) {
+      result->set_shared_memory_write_offset(read_buffers_ring_->write_pos());
+      if (!read_buffers_shm_fd_sent_) {
+        result.set_fd(read_buffers_shm_->fd());
+        read_buffers_shm_fd_sent_ = true;
+      }
+    }
     read_buffers_response.Resolve(std::move(result));
     result = ipc::AsyncResult<protos::ReadBuffersResponse>::Create();
   };
@@ -17,14 +17,17 @@
 #ifndef SRC_TRACING_IPC_SERVICE_CONSUMER_IPC_SERVICE_H_
 #define SRC_TRACING_IPC_SERVICE_CONSUMER_IPC_SERVICE_H_
 
+#include <deque>
 #include <list>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "perfetto/base/weak_ptr.h"
 #include "perfetto/ipc/basic_types.h"
 #include "perfetto/tracing/core/consumer.h"
+#include "perfetto/tracing/core/trace_packet.h"
 #include "perfetto/tracing/core/tracing_service.h"
 
 #include "perfetto/ipc/consumer_port.ipc.h"
@@ -35,6 +38,9 @@ namespace ipc {
 class Host;
 }  // namespace ipc
 
+class PosixSharedMemory;
+class ReadBuffersRing;
+
 // Implements the Consumer port of the IPC service. This class proxies requests
 // and responses between the core service logic (|svc_|) and remote Consumer(s)
 // on the IPC socket, through the methods overriddden from ConsumerPort.
@@ -63,6 +69,9 @@ class ConsumerIPCService : public protos::ConsumerPort {
                      DeferredGetTraceStatsResponse) override;
   void ObserveEvents(const protos::ObserveEventsRequest&,
                      DeferredObserveEventsResponse) override;
+  void NotifyReadBuffersConsumed(
+      const protos::NotifyReadBuffersConsumedRequest&,
+      DeferredNotifyReadBuffersConsumedResponse) override;
   void OnClientDisconnected() override;
 
  private:
@@ -87,6 +96,22 @@ class ConsumerIPCService : public protos::ConsumerPort {
 
     void CloseObserveEventsResponseStream();
 
+    // Creates the shared memory buffer used to pass the trace packets to the
+    // consumer, if not created already, and uses it for the current
+    // ReadBuffers() call.
+    void EnableSharedMemoryReads(size_t size_hint);
+
+    // Called when the consumer reports that it has read the shared memory
+    // buffer up to |read_pos|.
+    void OnSharedMemoryRead(uint64_t read_pos);
+
+    // Upper bound to the size of |pending_packets_|. Past this, the pending
+    // packets are sent through the IPC reply rather than the shared memory
+    // buffer.
+    static constexpr size_t kMaxPendingPacketsBytes = 1024 * 1024;
+
+    size_t pending_packets_bytes() const { return pending_packets_bytes_; }
+
     // The interface obtained from the core service business logic through
     // TracingService::ConnectConsumer(this). This allows to invoke methods for
     // a specific Consumer on the Service business logic.
@@ -113,8 +138,37 @@ class ConsumerIPCService : public protos::ConsumerPort {
     // After ObserveEvents() is invoked, this binds the async callback that
     // allows to stream ObservableEvents back to the client.
     DeferredObserveEventsResponse observe_events_response;
+
+   private:
+    // Serializes |trace_packets| into one or more ReadBuffersResponse(s).
+    void SendTraceData(std::vector<TracePacket> trace_packets, bool has_more);
+
+    // Copies as many |pending_packets_| as the free space allows into the
+    // shared memory buffer and notifies the consumer.
+    void WritePendingPacketsToSharedMemory();
+
+    // Sends all the |pending_packets_| through the IPC reply.
+    void SendPendingPacketsInline();
+
+    // The shared memory buffer used when the consumer passes a
+    // |shared_memory_size_hint_bytes| to ReadBuffers(). It is created on the
+    // first such call and reused for the following ones.
+    std::unique_ptr<PosixSharedMemory> read_buffers_shm_;
+    std::unique_ptr<ReadBuffersRing> read_buffers_ring_;
+    bool read_buffers_shm_fd_sent_ = false;
+
+    // True while serving a ReadBuffers() call through |read_buffers_ring_|.
+    bool use_shared_memory_ = false;
+
+    // Copies of the packets received from the core service which didn't fit
+    // yet into |read_buffers_ring_|, and whether they include the last ones.
+    std::deque<TracePacket> pending_packets_;
+    size_t pending_packets_bytes_ = 0;
+    bool pending_packets_complete_ = false;
   };
 
+  friend class ConsumerIPCServiceTest;
+
   // This has to be a container that doesn't invalidate iterators.
   using PendingFlushResponses = std::list<DeferredFlushResponse>;
 
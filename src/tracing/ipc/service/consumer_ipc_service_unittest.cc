@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/tracing/ipc/service/consumer_ipc_service.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "perfetto/base/scoped_file.h"
+#include "perfetto/tracing/core/trace_packet.h"
+#include "src/tracing/ipc/posix_shared_memory.h"
+#include "src/tracing/ipc/read_buffers_ring.h"
+
+namespace perfetto {
+
+class ConsumerIPCServiceTest : public ::testing::Test {
+ protected:
+  using RemoteConsumer = ConsumerIPCService::RemoteConsumer;
+
+  // Reads the packets passed by |consumer_| through the ReadBuffersResponse(s)
+  // like ConsumerIPCClientImpl does, i.e. first the ones in the shared memory
+  // buffer and then the ones in the reply.
+  void SetUp() override {
+    consumer_.read_buffers_response.Bind(
+        [this](ipc::AsyncResult<protos::ReadBuffersResponse> response) {
+          ASSERT_TRUE(response);
+          if (response->has_shared_memory_write_offset()) {
+            if (!ring_) {
+              ASSERT_GE(response.fd(), 0);
+              shm_ = PosixSharedMemory::AttachToFd(
+                  base::ScopedFile(dup(response.fd())));
+              ring_.reset(new ReadBuffersRing(shm_->start(), shm_->size()));
+            }
+            std::vector<TracePacket> packets;
+            ASSERT_TRUE(ring_->ReadPackets(
+                response->shared_memory_write_offset(), &packets));
+            for (const TracePacket& packet : packets) {
+              std::string content;
+              for (const Slice& slice : packet.slices())
+                content.append(static_cast<const char*>(slice.start),
+                               slice.size);
+              received_.emplace_back(std::move(content));
+            }
+          }
+          for (const auto& slice : response->slices()) {
+            partial_packet_.append(slice.data());
+            if (slice.last_slice_for_packet()) {
+              received_.emplace_back(std::move(partial_packet_));
+              partial_packet_.clear();
+            }
+          }
+          all_packets_received_ = !response.has_more();
+        });
+  }
+
+  // Acks all the packets read from the shared memory buffer so far.
+  void AckSharedMemoryReads() {
+    if (ring_)
+      consumer_.OnSharedMemoryRead(ring_->read_pos());
+  }
+
+  RemoteConsumer consumer_;
+  std::unique_ptr<PosixSharedMemory> shm_;
+  std::unique_ptr<ReadBuffersRing> ring_;
+  std::vector<std::string> received_;
+  std::string partial_packet_;
+  bool all_packets_received_ = false;
+};
+
+namespace {
+
+// The service hands over packets regardless of the consumer acking them. When
+// the consumer is slow, the packets which don't fit into the shared memory
+// buffer must not pile up in the service.
+TEST_F(ConsumerIPCServiceTest, PendingPacketsAreBounded) {
+  const size_t kMaxPendingBytes = RemoteConsumer::kMaxPendingPacketsBytes;
+  const size_t kShmSize = 64 * 1024;
+  const size_t kPacketSize = 1000;
+  const size_t kPacketsPerBatch = 32;
+  const size_t kNumBatches = 512;  // 16 MB in total.
+  consumer_.EnableSharedMemoryReads(kShmSize);
+
+  std::vector<std::string> expected;
+  size_t max_pending_bytes = 0;
+  for (size_t batch = 0; batch < kNumBatches; batch++) {
+    // Like the trace buffer, |contents| is overwritten as soon as
+    // OnTraceData() returns.
+    std::vector<std::string> contents;
+    std::vector<TracePacket> packets(kPacketsPerBatch);
+    for (size_t i = 0; i < kPacketsPerBatch; i++) {
+      std::string content = std::to_string(expected.size());
+      content.resize(kPacketSize, static_cast<char>('a' + batch % 26));
+      expected.push_back(content);
+      contents.emplace_back(std::move(content));
+      packets[i].AddSlice(contents[i].data(), contents[i].size());
+    }
+    consumer_.OnTraceData(std::move(packets), batch + 1 < kNumBatches);
+    for (std::string& content : contents)
+      std::fill(content.begin(), content.end(), '?');
+    max_pending_bytes =
+        std::max(max_pending_bytes, consumer_.pending_packets_bytes());
+
+    // The consumer acks only once in a while.
+    if (batch % 64 == 63)
+      AckSharedMemoryReads();
+  }
+  for (size_t i = 0; i < 1000 && !all_packets_received_; i++)
+    AckSharedMemoryReads();
+
+  EXPECT_TRUE(all_packets_received_);
+  EXPECT_GT(max_pending_bytes, 0u);
+  EXPECT_LE(max_pending_bytes, kMaxPendingBytes);
+  EXPECT_EQ(expected, received_);
+}
+
+}  // namespace
+}  // namespace perfetto
@@ -16,10 +16,14 @@
 
 #include <inttypes.h>
 #include <unistd.h>
+#include <zlib.h>
+
+#include <random>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "perfetto/base/temp_file.h"
+#include "perfetto/ipc/basic_types.h"
 #include "perfetto/tracing/core/consumer.h"
 #include "perfetto/tracing/core/data_source_config.h"
 #include "perfetto/tracing/core/data_source_descriptor.h"
@@ -109,6 +113,26 @@ void CheckTraceStats(const protos::TracePacket& packet) {
   EXPECT_EQ(0u, buf_stats.abi_violations());
 }
 
+std::string Inflate(const std::string& compressed) {
+  z_stream stream{};
+  EXPECT_EQ(inflateInit(&stream), Z_OK);
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  stream.avail_in = static_cast<uInt>(compressed.size());
+  std::string res;
+  char buf[4096];
+  int ret;
+  do {
+    stream.next_out = reinterpret_cast<Bytef*>(buf);
+    stream.avail_out = sizeof(buf);
+    ret = inflate(&stream, Z_NO_FLUSH);
+    EXPECT_TRUE(ret == Z_OK || ret == Z_STREAM_END);
+    res.append(buf, sizeof(buf) - stream.avail_out);
+  } while (ret == Z_OK);
+  inflateEnd(&stream);
+  return res;
+}
+
 class TracingIntegrationTest : public ::testing::Test {
  public:
   void SetUp() override {
@@ -322,6 +346,165 @@ TEST_F(TracingIntegrationTest, WithIPCTransport) {
   task_runner_->RunUntilCheckpoint("on_tracing_disabled");
 }
 
+TEST_F(TracingIntegrationTest, ReadBuffersThroughSharedMemory) {
+  // Reconnect the consumer, asking for a shared memory buffer much smaller
+  // than the trace, so that the service has to wait for the consumer to read
+  // it a few times.
+  const size_t kReadBuffersShmSize = 64 * 1024;
+  consumer_endpoint_ = ConsumerIPCClient::Connect(
+      kConsumerSockName, &consumer_, task_runner_.get(), kReadBuffersShmSize);
+  auto on_consumer_connect =
+      task_runner_->CreateCheckpoint("on_consumer_reconnect");
+  EXPECT_CALL(consumer_, OnConnect()).WillOnce(Invoke(on_consumer_connect));
+  task_runner_->RunUntilCheckpoint("on_consumer_reconnect");
+
+  TraceConfig trace_config;
+  trace_config.add_buffers()->set_size_kb(4096);
+  auto* ds_config = trace_config.add_data_sources()->mutable_config();
+  ds_config->set_name("perfetto.test");
+  ds_config->set_target_buffer(0);
+  consumer_endpoint_->EnableTracing(trace_config);
+
+  BufferID global_buf_id = 0;
+  auto on_create_ds_instance =
+      task_runner_->CreateCheckpoint("on_create_ds_instance");
+  EXPECT_CALL(producer_, OnTracingSetup());
+  EXPECT_CALL(producer_, SetupDataSource(_, _));
+  EXPECT_CALL(producer_, StartDataSource(_, _))
+      .WillOnce(Invoke([on_create_ds_instance, &global_buf_id](
+                           DataSourceInstanceID, const DataSourceConfig& cfg) {
+        global_buf_id = static_cast<BufferID>(cfg.target_buffer());
+        on_create_ds_instance();
+      }));
+  task_runner_->RunUntilCheckpoint("on_create_ds_instance");
+
+  std::unique_ptr<TraceWriter> writer =
+      producer_endpoint_->CreateTraceWriter(global_buf_id);
+  ASSERT_TRUE(writer);
+
+  // The last packet doesn't fit into the shared memory buffer, and is passed
+  // through the IPC reply instead.
+  std::vector<std::string> expected;
+  for (size_t i = 0; i < 40; i++)
+    expected.emplace_back(5000 + i * 100, static_cast<char>('a' + i % 26));
+  expected.emplace_back(kReadBuffersShmSize + 1000, 'z');
+  for (size_t i = 0; i < expected.size(); i++) {
+    writer->NewTracePacket()->set_for_testing()->set_str(expected[i].data(),
+                                                         expected[i].size());
+    if (i % 8 == 7 || i + 2 >= expected.size()) {
+      std::string checkpoint_name = "on_data_committed_" + std::to_string(i);
+      auto on_data_committed = task_runner_->CreateCheckpoint(checkpoint_name);
+      writer->Flush(on_data_committed);
+      task_runner_->RunUntilCheckpoint(checkpoint_name);
+    }
+  }
+
+  consumer_endpoint_->ReadBuffers();
+  std::vector<std::string> received;
+  auto all_packets_rx = task_runner_->CreateCheckpoint("all_packets_rx");
+  EXPECT_CALL(consumer_, OnTracePackets(_, _))
+      .WillRepeatedly(Invoke([&received, all_packets_rx](
+                                 std::vector<TracePacket>* packets,
+                                 bool has_more) {
+        for (auto& encoded_packet : *packets) {
+          protos::TracePacket packet;
+          ASSERT_TRUE(encoded_packet.Decode(&packet));
+          if (packet.has_for_testing())
+            received.push_back(packet.for_testing().str());
+        }
+        if (!has_more)
+          all_packets_rx();
+      }));
+  task_runner_->RunUntilCheckpoint("all_packets_rx");
+  EXPECT_EQ(expected, received);
+
+  consumer_endpoint_->DisableTracing();
+  auto on_tracing_disabled =
+      task_runner_->CreateCheckpoint("on_tracing_disabled");
+  EXPECT_CALL(producer_, StopDataSource(_));
+  EXPECT_CALL(consumer_, OnTracingDisabled())
+      .WillOnce(Invoke(on_tracing_disabled));
+  task_runner_->RunUntilCheckpoint("on_tracing_disabled");
+}
+
+// Compressed packets can be larger than an IPC frame, check that they are
+// split over several IPCs and glued back together by the consumer.
+TEST_F(TracingIntegrationTest, CompressedReadBuffers) {
+  TraceConfig trace_config;
+  trace_config.add_buffers()->set_size_kb(4096);
+  auto* ds_config = trace_config.add_data_sources()->mutable_config();
+  ds_config->set_name("perfetto.test");
+  ds_config->set_target_buffer(0);
+  trace_config.set_compression_type(TraceConfig::COMPRESSION_TYPE_DEFLATE);
+  consumer_endpoint_->EnableTracing(trace_config);
+
+  BufferID global_buf_id = 0;
+  auto on_create_ds_instance =
+      task_runner_->CreateCheckpoint("on_create_ds_instance");
+  EXPECT_CALL(producer_, OnTracingSetup());
+  EXPECT_CALL(producer_, SetupDataSource(_, _));
+  EXPECT_CALL(producer_, StartDataSource(_, _))
+      .WillOnce(Invoke([on_create_ds_instance, &global_buf_id](
+                           DataSourceInstanceID, const DataSourceConfig& cfg) {
+        global_buf_id = static_cast<BufferID>(cfg.target_buffer());
+        on_create_ds_instance();
+      }));
+  task_runner_->RunUntilCheckpoint("on_create_ds_instance");
+
+  std::unique_ptr<TraceWriter> writer =
+      producer_endpoint_->CreateTraceWriter(global_buf_id);
+  ASSERT_TRUE(writer);
+
+  // Random data doesn't compress: the large packet is compressed into a
+  // packet which is larger than kIPCBufferSize.
+  std::minstd_rand0 rnd(0);
+  std::vector<std::string> expected;
+  expected.emplace_back("small");
+  expected.emplace_back(3 * ipc::kIPCBufferSize, '\0');
+  for (char& c : expected.back())
+    c = static_cast<char>(rnd());
+  expected.emplace_back("small again");
+  for (const std::string& str : expected)
+    writer->NewTracePacket()->set_for_testing()->set_str(str.data(),
+                                                         str.size());
+  auto on_data_committed = task_runner_->CreateCheckpoint("on_data_committed");
+  writer->Flush(on_data_committed);
+  task_runner_->RunUntilCheckpoint("on_data_committed");
+
+  consumer_endpoint_->ReadBuffers();
+  std::vector<std::string> received;
+  auto all_packets_rx = task_runner_->CreateCheckpoint("all_packets_rx");
+  EXPECT_CALL(consumer_, OnTracePackets(_, _))
+      .WillRepeatedly(Invoke([&received, all_packets_rx](
+                                 std::vector<TracePacket>* packets,
+                                 bool has_more) {
+        for (auto& encoded_packet : *packets) {
+          protos::TracePacket packet;
+          ASSERT_TRUE(encoded_packet.Decode(&packet));
+          ASSERT_TRUE(packet.has_compressed_packets());
+          protos::Trace trace;
+          ASSERT_TRUE(
+              trace.ParseFromString(Inflate(packet.compressed_packets())));
+          for (const protos::TracePacket& inner : trace.packet()) {
+            if (inner.has_for_testing())
+              received.push_back(inner.for_testing().str());
+          }
+        }
+        if (!has_more)
+          all_packets_rx();
+      }));
+  task_runner_->RunUntilCheckpoint("all_packets_rx");
+  EXPECT_EQ(expected, received);
+
+  consumer_endpoint_->DisableTracing();
+  auto on_tracing_disabled =
+      task_runner_->CreateCheckpoint("on_tracing_disabled");
+  EXPECT_CALL(producer_, StopDataSource(_));
+  EXPECT_CALL(consumer_, OnTracingDisabled())
+      .WillOnce(Invoke(on_tracing_disabled));
+  task_runner_->RunUntilCheckpoint("on_tracing_disabled");
+}
+
 TEST_F(TracingIntegrationTest, WriteIntoFile) {
   // Start tracing.
   TraceConfig trace_config;
@@ -13,19 +13,29 @@
 // limitations under the License.
 
 #include <gtest/gtest.h>
+#include <functional>
+#include <future>
 #include <random>
+#include <thread>
 
 #include "benchmark/benchmark.h"
+#include "perfetto/base/paged_memory.h"
+#include "perfetto/base/thread_task_runner.h"
 #include "perfetto/base/time.h"
 #include "perfetto/traced/traced.h"
+#include "perfetto/tracing/core/commit_data_request.h"
 #include "perfetto/tracing/core/trace_config.h"
 #include "perfetto/tracing/core/trace_packet.h"
+#include "perfetto/tracing/core/trace_writer.h"
+#include "perfetto/tracing/core/tracing_service.h"
 #include "src/base/test/test_task_runner.h"
+#include "src/tracing/core/shared_memory_arbiter_impl.h"
 #include "test/task_runner_thread.h"
 #include "test/task_runner_thread_delegates.h"
 #include "test/test_helper.h"
 
 #include "perfetto/trace/trace_packet.pb.h"
+#include "perfetto/trace/test_event.pbzero.h"
 #include "perfetto/trace/trace_packet.pbzero.h"
 
 namespace perfetto {
@@ -207,6 +217,99 @@ static void BenchmarkConsumer(benchmark::State& state) {
                          read_time_taken_ns);
 }
 
+// A producer endpoint that plays the role of the service: it frees the chunks
+// as soon as they are committed, so that the writers never stall.
+class ChunkRecyclingProducerEndpoint
+    : public TracingService::ProducerEndpoint {
+ public:
+  void RegisterDataSource(const DataSourceDescriptor&) override {}
+  void UnregisterDataSource(const std::string&) override {}
+  void RegisterTraceWriter(uint32_t, uint32_t) override {}
+  void UnregisterTraceWriter(uint32_t) override {}
+  void NotifyFlushComplete(FlushRequestID) override {}
+  void NotifyDataSourceStarted(DataSourceInstanceID) override {}
+  void NotifyDataSourceStopped(DataSourceInstanceID) override {}
+  void ActivateTriggers(const std::vector<std::string>&) override {}
+  SharedMemory* shared_memory() const override { return nullptr; }
+  size_t shared_buffer_page_size_kb() const override { return 0; }
+  std::unique_ptr<TraceWriter> CreateTraceWriter(BufferID) override {
+    return nullptr;
+  }
+
+  void CommitData(const CommitDataRequest& req,
+                  CommitDataCallback callback) override {
+    SharedMemoryABI* abi = arbiter->shmem_abi_for_testing();
+    for (const auto& ctm : req.chunks_to_move()) {
+      auto chunk = abi->TryAcquireChunkForReading(ctm.page(), ctm.chunk());
+      if (chunk.is_valid())
+        abi->ReleaseChunkAsFree(std::move(chunk));
+    }
+    if (callback)
+      callback();
+  }
+
+  SharedMemoryArbiterImpl* arbiter = nullptr;
+};
+
+// Measures the throughput of state.range(0) threads, each with its own
+// TraceWriter, writing packets into the same shared memory buffer. Packets are
+// large compared to the chunks, so this is dominated by the contention on
+// SharedMemoryArbiterImpl::GetNewChunk() and ReturnCompletedChunk().
+void BenchmarkMultiWriter(benchmark::State& state) {
+  static constexpr size_t kPageSize = 4096;
+  static constexpr size_t kBufferSize = 256 * kPageSize;
+  const size_t num_threads = static_cast<size_t>(state.range(0));
+  const uint32_t packets_per_thread =
+      IsBenchmarkFunctionalOnly() ? 100 : 10000;
+
+  // The arbiter must be created and destroyed on its task runner thread.
+  auto task_runner = base::ThreadTaskRunner::CreateAndStart();
+  auto run_on_task_runner = [&task_runner](std::function<void()> fn) {
+    std::promise<void> done;
+    task_runner.get()->PostTask([&fn, &done] {
+      fn();
+      done.set_value();
+    });
+    done.get_future().wait();
+  };
+
+  auto buffer = base::PagedMemory::Allocate(kBufferSize);
+  ChunkRecyclingProducerEndpoint endpoint;
+  std::unique_ptr<SharedMemoryArbiterImpl> arbiter;
+  run_on_task_runner([&] {
+    arbiter.reset(new SharedMemoryArbiterImpl(
+        buffer.Get(), kBufferSize, kPageSize, &endpoint, task_runner.get()));
+  });
+  endpoint.arbiter = arbiter.get();
+
+  std::vector<std::unique_ptr<TraceWriter>> writers;
+  for (size_t i = 0; i < num_threads; i++)
+    writers.emplace_back(arbiter->CreateTraceWriter(1 /* target_buffer */));
+
+  const std::string payload(512, 'x');
+  for (auto _ : state) {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; i++) {
+      TraceWriter* writer = writers[i].get();
+      threads.emplace_back([writer, &payload, packets_per_thread] {
+        for (uint32_t j = 0; j < packets_per_thread; j++) {
+          auto packet = writer->NewTracePacket();
+          packet->set_for_testing()->set_str(payload.data(), payload.size());
+        }
+      });
+    }
+    for (auto& thread : threads)
+      thread.join();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(num_threads) *
+                          packets_per_thread);
+
+  // The tasks posted by the writers run before the arbiter is destroyed.
+  writers.clear();
+  run_on_task_runner([&arbiter] { arbiter.reset(); });
+}
+
 void SaturateCpuProducerArgs(benchmark::internal::Benchmark* b) {
   int min_message_count = 16;
   int max_message_count = IsBenchmarkFunctionalOnly() ? 1024 : 1024 * 1024;
@@ -246,6 +349,12 @@ void ConstantRateConsumerArgs(benchmark::internal::Benchmark* b) {
   }
 }
 
+void MultiWriterArgs(benchmark::internal::Benchmark* b) {
+  int max_threads = IsBenchmarkFunctionalOnly() ? 2 : 16;
+  for (int threads = 1; threads <= max_threads; threads *= 2)
+    b->Arg(threads);
+}
+
 }  // namespace
 
 static void BM_EndToEnd_Producer_SaturateCpu(benchmark::State& state) {
@@ -284,4 +393,13 @@ BENCHMARK(BM_EndToEnd_Consumer_ConstantRate)
     ->UseRealTime()
     ->Apply(ConstantRateConsumerArgs);
 
+static void BM_EndToEnd_Producer_MultiWriter(benchmark::State& state) {
+  BenchmarkMultiWriter(state);
+}
+
+BENCHMARK(BM_EndToEnd_Producer_MultiWriter)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime()
+    ->Apply(MultiWriterArgs);
+
 }  // namespace perfetto
@@ -255,6 +255,57 @@ void DumpProfilePacket(std::vector<ProfilePacket>& packet_fragments,
   }
 }
 
+// Full dumps and the latest samples of the incremental dumps seen so far.
+struct ProfileSnapshot {
+  // Interned data and callstacks of all the previous incremental dumps.
+  ProfilePacket interned;
+  // pid -> callstack id -> latest sample.
+  std::map<uint64_t, std::map<uint64_t, ProfilePacket::HeapSample>> samples;
+};
+
+// Merges the fragments of an incremental dump into |snapshot| and returns a
+// single packet with the full dump, as if incremental dumps were disabled.
+ProfilePacket MergeIncrementalDump(
+    const std::vector<ProfilePacket>& packet_fragments,
+    ProfileSnapshot* snapshot) {
+  ProfilePacket& interned = snapshot->interned;
+  for (const ProfilePacket& packet : packet_fragments) {
+    for (const ProfilePacket::InternedString& interned_string :
+         packet.strings())
+      *interned.add_strings() = interned_string;
+    for (const ProfilePacket::Frame& frame : packet.frames())
+      *interned.add_frames() = frame;
+    for (const ProfilePacket::Callstack& callstack : packet.callstacks())
+      *interned.add_callstacks() = callstack;
+    for (const ProfilePacket::Mapping& mapping : packet.mappings())
+      *interned.add_mappings() = mapping;
+  }
+
+  ProfilePacket full = interned;
+  // The processes in this dump, with their latest stats but without samples.
+  std::map<uint64_t, ProfilePacket::ProcessHeapSamples> processes;
+  for (const ProfilePacket& packet : packet_fragments) {
+    for (const ProfilePacket::ProcessHeapSamples& samples :
+         packet.process_dumps()) {
+      std::map<uint64_t, ProfilePacket::HeapSample>& latest =
+          snapshot->samples[samples.pid()];
+      for (const ProfilePacket::HeapSample& sample : samples.samples())
+        latest[sample.callstack_id()] = sample;
+      ProfilePacket::ProcessHeapSamples& process = processes[samples.pid()];
+      process = samples;
+      process.clear_samples();
+    }
+  }
+
+  for (auto& pid_and_process : processes) {
+    ProfilePacket::ProcessHeapSamples* process = full.add_process_dumps();
+    *process = std::move(pid_and_process.second);
+    for (const auto& id_and_sample : snapshot->samples[process->pid()])
+      *process->add_samples() = id_and_sample.second;
+  }
+  return full;
+}
+
 }  // namespace
 
 int TraceToProfile(std::istream* input, std::ostream* output) {
@@ -262,8 +313,9 @@ int TraceToProfile(std::istream* input, std::ostream* output) {
   size_t itr = 0;
   PERFETTO_CHECK(mkdtemp(&temp_dir[0]));
   std::vector<ProfilePacket> rolling_profile_packets;
-  ForEachPacketInTrace(input, [&temp_dir, &itr, &rolling_profile_packets](
-                                  const protos::TracePacket& packet) {
+  ProfileSnapshot snapshot;
+  ForEachPacketInTrace(input, [&temp_dir, &itr, &rolling_profile_packets,
+                               &snapshot](const protos::TracePacket& packet) {
     if (!packet.has_profile_packet())
       return;
     rolling_profile_packets.emplace_back(packet.profile_packet());
@@ -273,8 +325,16 @@ int TraceToProfile(std::istream* input, std::ostream* output) {
         PERFETTO_CHECK(rolling_profile_packets[i - 1].index() + 1 ==
                        rolling_profile_packets[i].index());
       }
-      DumpProfilePacket(rolling_profile_packets,
-                        temp_dir + "/heap_dump." + std::to_string(++itr) + ".");
+      std::string file_prefix =
+          temp_dir + "/heap_dump." + std::to_string(++itr) + ".";
+      if (rolling_profile_packets[0].incremental()) {
+        std::vector<ProfilePacket> full_dump;
+        full_dump.emplace_back(
+            MergeIncrementalDump(rolling_profile_packets, &snapshot));
+        DumpProfilePacket(full_dump, file_prefix);
+      } else {
+        DumpProfilePacket(rolling_profile_packets, file_prefix);
+      }
       rolling_profile_packets.clear();
     }
   });
@@ -18,14 +18,17 @@
 
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <memory>
 #include <ostream>
 #include <utility>
 
 #include "perfetto/base/logging.h"
+#include "perfetto/protozero/proto_decoder.h"
 #include "perfetto/trace/ftrace/ftrace_stats.pb.h"
 #include "perfetto/traced/sys_stats_counters.h"
+#include "src/trace_processor/zlib_utils.h"
 
 #include "perfetto/trace/trace.pb.h"
 #include "perfetto/trace/trace_packet.pb.h"
@@ -33,6 +36,43 @@
 namespace perfetto {
 namespace trace_to_text {
 
+namespace {
+
+// If the packet in [data, data + size) wraps compressed packets, inflates them
+// and invokes |f| for each of them. Returns false if the packet is a regular
+// one.
+bool ForEachCompressedPacket(
+    const char* data,
+    size_t size,
+    const std::function<void(std::unique_ptr<char[]>, size_t)>& f) {
+  protozero::ProtoDecoder decoder(reinterpret_cast<const uint8_t*>(data),
+                                 size);
+  protozero::Field field = decoder.FindField(
+      protos::TracePacket::kCompressedPacketsFieldNumber);
+  if (!field)
+    return false;
+
+  std::unique_ptr<uint8_t[]> inflated;
+  size_t inflated_size = 0;
+  if (!trace_processor::ZlibInflate(field.data(), field.size(), &inflated,
+                                    &inflated_size)) {
+    PERFETTO_ELOG("Skipping invalid compressed packets");
+    return true;
+  }
+
+  protozero::ProtoDecoder trace(inflated.get(), inflated_size);
+  for (auto packet = trace.ReadField(); packet; packet = trace.ReadField()) {
+    if (packet.id() != protos::Trace::kPacketFieldNumber)
+      continue;
+    std::unique_ptr<char[]> buf(new char[packet.size()]);
+    memcpy(buf.get(), packet.data(), packet.size());
+    f(std::move(buf), packet.size());
+  }
+  return true;
+}
+
+}  // namespace
+
 void ForEachPacketBlobInTrace(
     std::istream* input,
     const std::function<void(std::unique_ptr<char[]>, size_t)>& f) {
@@ -74,6 +114,8 @@ void ForEachPacketBlobInTrace(
     input->read(buf.get(), static_cast<std::streamsize>(field_size));
     bytes_processed += field_size;
 
+    if (ForEachCompressedPacket(buf.get(), field_size, f))
+      continue;
     f(std::move(buf), field_size);
   }
 }